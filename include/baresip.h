@@ -76,7 +76,14 @@ enum sipansbeep {
 enum jbuf_type {
 	JBUF_OFF,
 	JBUF_FIXED,
-	JBUF_ADAPTIVE
+	JBUF_ADAPTIVE,
+	JBUF_PERCENTILE
+};
+
+/** Jitter buffer packet storage */
+enum jbuf_storage {
+	JBUF_STORAGE_LIST = 0,  /**< Sorted linked list of packets       */
+	JBUF_STORAGE_RING,      /**< Ring indexed by RTP sequence number */
 };
 
 /** Defines the incoming out-of-dialog request mode */
@@ -359,6 +366,7 @@ int  conf_get_vidsz(const struct conf *conf, const char *name,
 		    struct vidsz *sz);
 int  conf_get_sa(const struct conf *conf, const char *name, struct sa *sa);
 enum jbuf_type conf_get_jbuf_type(const struct pl *pl);
+enum jbuf_storage conf_get_jbuf_storage(const struct pl *pl);
 bool conf_aubuf_adaptive(const struct pl *pl);
 void conf_close(void);
 struct conf *conf_cur(void);
@@ -379,11 +387,18 @@ static inline bool in_range(const struct range *rng, uint32_t val)
 enum rtp_receive_mode {
 	RECEIVE_MODE_MAIN = 0,  /**< RTP RX is processed in main thread      */
 	RECEIVE_MODE_THREAD,    /**< RTP RX is processed in separate thread  */
+	RECEIVE_MODE_POOL,      /**< RTP RX is processed in shared loop pool */
 };
 
 enum rtp_receive_mode resolve_receive_mode(const struct pl *fmt);
 const char *rtp_receive_mode_str(enum rtp_receive_mode rxmode);
 
+/** Audio transmit mode */
+enum audio_tx_mode {
+	AUDIO_TX_THREAD = 0,  /**< One TX thread per audio stream       */
+	AUDIO_TX_POOL,        /**< Shared pool of TX scheduler threads  */
+};
+
 
 /** SIP User-Agent */
 struct config_sip {
@@ -399,6 +414,8 @@ struct config_sip {
 	enum tls_resume_mode tls_resume; /** TLS resumption mode    */
 	uint8_t tos;            /**< Type-of-Service for SIP        */
 	uint32_t reg_filt;	/**< Registrar filter transport mask*/
+	uint32_t reg_rate;      /**< Max. REGISTERs per second, 0=off */
+	uint32_t reg_spread;    /**< Spread of REGISTERs [s], 0=off */
 };
 
 /** Call config */
@@ -423,6 +440,9 @@ struct config_audio {
 	uint32_t channels_play; /**< Opt. channels for player       */
 	uint32_t channels_src;  /**< Opt. channels for source       */
 	bool level;             /**< Enable audio level indication  */
+	bool lattrace;          /**< Enable audio latency tracing   */
+	bool timestretch;       /**< Time-stretch received audio    */
+	bool txdrift;           /**< TX clock drift compensation    */
 	int src_fmt;            /**< Audio source sample format     */
 	int play_fmt;           /**< Audio playback sample format   */
 	int enc_fmt;            /**< Audio encoder sample format    */
@@ -430,6 +450,8 @@ struct config_audio {
 	struct range buffer;    /**< Audio receive buffer in [ms]   */
 	double silence;         /**< Silence volume in [dB]         */
 	uint32_t telev_pt;      /**< Payload type for tel.-event    */
+	enum audio_tx_mode txmode; /**< Audio transmit mode         */
+	uint32_t txpool;        /**< Number of TX pool threads      */
 };
 
 /** Video */
@@ -445,6 +467,8 @@ struct config_video {
 	double fps;             /**< Video framerate                */
 	bool fullscreen;        /**< Enable fullscreen display      */
 	int enc_fmt;            /**< Encoder pixelfmt (enum vidfmt) */
+	uint32_t txbatch;       /**< Max. RTP packets per send call */
+	bool txgso;             /**< Use UDP GSO for batched send   */
 };
 
 /** Audio/Video Transport */
@@ -458,11 +482,15 @@ struct config_avt {
 		enum jbuf_type jbtype;  /**< Jitter buffer type     */
 		struct range jbuf_del;  /**< Max./Min. Delay [ms]   */
 		uint32_t jbuf_sz;       /**< Max. buffer  [packets] */
+		enum jbuf_storage jbstore; /**< Packet storage      */
+		uint32_t jbuf_pct;      /**< Delay percentile [%]   */
 	} audio, video;
 	bool rtp_stats;         /**< Enable RTP statistics          */
 	uint32_t rtp_timeout;   /**< RTP Timeout in seconds (0=off) */
 	bool bundle;            /**< Media Multiplexing (BUNDLE)    */
 	enum rtp_receive_mode rxmode;   /**< RTP RX processing mode */
+	uint32_t rxpool;        /**< Number of RX loops for pool    */
+	uint32_t rxbatch;       /**< Max. RX datagrams/call (0=off) */
 };
 
 /** Network Configuration */
@@ -727,6 +755,42 @@ void aufilt_unregister(struct aufilt *af);
 void aufilt_enable(struct list *aufiltl, const char *name, bool enable);
 
 
+/*
+ * Audio DSP kernels
+ */
+
+/** Instruction set of the audio DSP kernels */
+enum audsp_isa {
+	AUDSP_SCALAR = 0,
+	AUDSP_SSE2,
+	AUDSP_AVX2,
+	AUDSP_NEON,
+};
+
+void audsp_init(void);
+int  audsp_set_isa(enum audsp_isa isa);
+enum audsp_isa audsp_isa(void);
+const char *audsp_isa_name(enum audsp_isa isa);
+
+void audsp_s16_to_float(float *dst, const int16_t *src, size_t n);
+void audsp_float_to_s16(int16_t *dst, const float *src, size_t n);
+void audsp_s16_to_s32(int32_t *dst, const int16_t *src, size_t n);
+void audsp_s32_to_s16(int16_t *dst, const int32_t *src, size_t n);
+void audsp_s32_to_float(float *dst, const int32_t *src, size_t n);
+void audsp_float_to_s32(int32_t *dst, const float *src, size_t n);
+int  audsp_convert(void *dst, int dst_fmt, const void *src, int src_fmt,
+		   size_t n);
+
+void audsp_add_s16(int16_t *dst, const int16_t *src, size_t n);
+void audsp_add_float(float *dst, const float *src, size_t n);
+void audsp_gain_s16(int16_t *v, size_t n, float gain);
+void audsp_gain_float(float *v, size_t n, float gain);
+void audsp_fade_s16(int16_t *v, size_t n, float gain, float step,
+		    float lim);
+void audsp_fade_float(float *v, size_t n, float gain, float step,
+		      float lim);
+
+
 /*
  * Log
  */
@@ -755,6 +819,10 @@ void log_enable_info(bool enable);
 void log_enable_stdout(bool enable);
 void log_enable_timestamps(bool enable);
 void log_enable_color(bool enable);
+int  log_async_start(size_t ringsz, size_t budget);
+void log_async_stop(void);
+uint64_t log_async_dropped(void);
+int  log_async_debug(struct re_printf *pf, void *unused);
 
 #ifdef HAVE_RE_ARG
 #define loglv(level, fmt, ...)                                                \
@@ -860,6 +928,13 @@ struct dnsc     *net_dnsc(const struct network *net);
 int net_set_dnsc(struct network *net, struct dnsc *dnsc);
 
 
+/*
+ * Metrics
+ */
+
+int metric_print_openmetrics(struct re_printf *pf, void *unused);
+
+
 /*
  * Play - audio file player
  */
@@ -878,6 +953,7 @@ int  play_tone(struct play **playp, struct player *player,
 void play_set_finish_handler(struct play *play, play_finish_h *fh, void *arg);
 int  play_init(struct player **playerp);
 void play_set_path(struct player *player, const char *path);
+int  play_preload(struct player *player, const char *filename);
 
 
 /*
@@ -932,7 +1008,46 @@ enum bevent_ev {
 };
 
 
+/** Baresip event class */
+enum bevent_class {
+	BEVENT_CLASS_UA,
+	BEVENT_CLASS_CALL,
+	BEVENT_CLASS_APP,
+	BEVENT_CLASS_SIP,
+	BEVENT_CLASS_UNDEFINED
+};
+
+
+/** Event bus delivery mode */
+enum bevent_sub_mode {
+	BEVENT_SUB_SYNC = 0,  /**< Delivered when the event is emitted     */
+	BEVENT_SUB_ASYNC,     /**< Queued and delivered from the main loop */
+	BEVENT_SUB_THREAD,    /**< Queued and delivered from own thread    */
+};
+
+
+/** Event bus encoding options, subscribers with equal options share the
+ *  encoded event */
+enum bevent_sub_opt {
+	BEVENT_SUB_OPT_EVENT  = 1 << 0,  /**< Add "event":true first     */
+	BEVENT_SUB_OPT_JBSTAT = 1 << 1,  /**< Add audio_jb_ms to VU_RX   */
+};
+
+
+/** Event encoded to JSON, shared by all event bus subscribers */
+struct bevent_json {
+	enum bevent_ev ev;       /**< Event type                    */
+	enum bevent_class ec;    /**< Event class                   */
+	const char *json;        /**< JSON object, zero-terminated  */
+	size_t len;              /**< Length of the JSON object     */
+};
+
+#define BEVENT_CLASS_BIT(ec) (1u << (ec))
+#define BEVENT_EV_BIT(ev) (1ULL << (ev))
+
+
 struct bevent;
+struct bevent_sub;
 
 
 /** SIP auto answer method */
@@ -945,6 +1060,7 @@ enum answer_method {
 
 /** Defines the Baresip event handler */
 typedef void (bevent_h)(enum bevent_ev ev, struct bevent *event, void *arg);
+typedef void (bevent_json_h)(const struct bevent_json *bj, void *arg);
 typedef void (options_resp_h)(int err, const struct sip_msg *msg, void *arg);
 typedef void (refer_resp_h)(int err, const struct sip_msg *msg, void *arg);
 
@@ -952,6 +1068,7 @@ typedef void (ua_exit_h)(void *arg);
 
 /* Multiple instances */
 int  ua_alloc(struct ua **uap, const char *aor);
+int  ua_alloc_account(struct ua **uap, struct account *acc);
 int  ua_connect(struct ua *ua, struct call **callp,
 		const char *from_uri, const char *req_uri,
 		enum vidmode vmode);
@@ -1043,6 +1160,7 @@ struct sipevent_sock *uag_sipevent_sock(void);
 struct call *uag_call_find(const char *id);
 struct call *uag_call_find_pl(const struct pl *id);
 void uag_filter_calls(call_list_h *listh, call_match_h *matchh, void *arg);
+int  uag_reg_sched_debug(struct re_printf *pf);
 
 
 /*
@@ -1451,6 +1569,7 @@ int  audio_set_player(struct audio *au, const char *mod, const char *device);
 void audio_level_put(const struct audio *au, bool tx, double lvl);
 int  audio_level_get(const struct audio *au, double *level);
 int  audio_debug(struct re_printf *pf, const struct audio *a);
+int  audio_latency_debug(struct re_printf *pf, const struct audio *a);
 struct stream *audio_strm(const struct audio *au);
 uint64_t audio_jb_current_value(const struct audio *au);
 int  audio_set_bitrate(struct audio *au, uint32_t bitrate);
@@ -1598,6 +1717,7 @@ struct jbuf_stat {
 	uint32_t c_packets;    /**< Current packets                         */
 	uint32_t c_jitter;     /**< Current jitter delay in [ms]            */
 	int32_t  c_skew;       /**< Current jitter buffer skew in [ms]      */
+	uint32_t c_delay_pct;  /**< Percentile of frames within c_delay [%] */
 };
 
 
@@ -1606,6 +1726,8 @@ int jbuf_alloc(struct jbuf **jbp, uint32_t mind, uint32_t maxd,
 void jbuf_set_srate(struct jbuf *jb, uint32_t srate);
 void jbuf_set_id(struct jbuf *jb, struct pl *id);
 int  jbuf_set_type(struct jbuf *jb, enum jbuf_type jbtype);
+int  jbuf_set_storage(struct jbuf *jb, enum jbuf_storage storage);
+int  jbuf_set_percentile(struct jbuf *jb, uint32_t pct);
 void jbuf_set_gnack(struct jbuf *jb, struct rtp_sock *rtp);
 int  jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem);
 int  jbuf_get(struct jbuf *jb, struct rtp_header *hdr, void **mem);
@@ -1752,6 +1874,13 @@ enum bevent_ev bevent_get_value(const struct bevent *event);
 const char *bevent_get_text(const struct bevent *event);
 void bevent_set_error(struct bevent *event, int err);
 void bevent_stop(struct bevent *event);
+const char *bevent_class_str(enum bevent_class ec);
+int  bevent_sub_alloc(struct bevent_sub **subp, enum bevent_sub_mode mode,
+		      uint32_t qlen, bevent_json_h *jh, void *arg);
+void bevent_sub_filter(struct bevent_sub *sub, uint32_t classmask,
+		       uint64_t evmask);
+void bevent_sub_set_opts(struct bevent_sub *sub, uint32_t opts);
+uint64_t bevent_sub_dropped(const struct bevent_sub *sub);
 
 /*
  * Baresip instance
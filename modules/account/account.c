@@ -3,6 +3,7 @@
  *
  * Copyright (C) 2010 - 2015 Alfred E. Heggestad
  */
+#include <string.h>
 #include <re.h>
 #include <baresip.h>
 
@@ -24,9 +25,49 @@
   "User 2 with ICE" <sip:user@192.0.2.4;transport=tcp>;medianat=ice
   "User 3 with IPv6" <sip:user@[2001:db8:0:16:216:6fff:fe91:614c]:5070>
  \endverbatim
+ *
+ * Large files are decoded by several threads. The number of threads is
+ * set with this config option:
+ *
+ \verbatim
+  account_threads   4   # decoder threads
+ \endverbatim
  */
 
 
+enum {
+	THREADS_DEFAULT = 4,     /**< Default number of decoder threads   */
+	THREADS_MAX     = 16,    /**< Maximum number of decoder threads   */
+	PARALLEL_MIN    = 256,   /**< Min. accounts for parallel decoding */
+};
+
+
+/** One account line of the accounts file */
+struct acc_rec {
+	char *line;              /**< SIP address line                    */
+	struct account *acc;     /**< Decoded account                     */
+	struct ua *ua;           /**< User-Agent for this account         */
+	int err;                 /**< Decode error                        */
+};
+
+
+/** The records of the accounts file */
+struct loader {
+	struct acc_rec *recv;    /**< Account records                     */
+	size_t recc;             /**< Number of account records           */
+	size_t recsz;            /**< Allocated number of records         */
+};
+
+
+/** Decoder, decodes a range of the account records */
+struct decoder {
+	thrd_t thrd;             /**< Decoder thread                      */
+	bool run;                /**< Thread is running                   */
+	struct acc_rec *recv;    /**< First account record                */
+	size_t recc;             /**< Number of account records           */
+};
+
+
 static int account_write_template(const char *file)
 {
 	FILE *f = NULL;
@@ -123,48 +164,144 @@ static int account_write_template(const char *file)
 }
 
 
+static void loader_reset(struct loader *ld)
+{
+	size_t i;
+
+	for (i=0; i<ld->recc; i++) {
+		mem_deref(ld->recv[i].line);
+		mem_deref(ld->recv[i].acc);
+	}
+
+	mem_deref(ld->recv);
+	memset(ld, 0, sizeof(*ld));
+}
+
+
 /**
- * Add a User-Agent (UA)
+ * Collect an account line
  *
  * @param addr SIP Address string
- * @param arg  Handler argument (unused)
+ * @param arg  Loader
  *
  * @return 0 if success, otherwise errorcode
  */
 static int line_handler(const struct pl *addr, void *arg)
 {
-	char buf[1024];
-	struct ua *ua;
+	struct loader *ld = arg;
+	struct acc_rec *rec;
+
+	if (ld->recc == ld->recsz) {
+		size_t sz = ld->recsz ? ld->recsz * 2 : 64;
+		struct acc_rec *recv;
+
+		recv = mem_realloc(ld->recv, sz * sizeof(*recv));
+		if (!recv)
+			return ENOMEM;
+
+		memset(&recv[ld->recsz], 0,
+		       (sz - ld->recsz) * sizeof(*recv));
+
+		ld->recv  = recv;
+		ld->recsz = sz;
+	}
+
+	rec = &ld->recv[ld->recc++];
+
+	return pl_strdup(&rec->line, addr);
+}
+
+
+static int decode_thread(void *arg)
+{
+	struct decoder *dec = arg;
+	size_t i;
+
+	for (i=0; i<dec->recc; i++) {
+		struct acc_rec *rec = &dec->recv[i];
+
+		rec->err = account_alloc(&rec->acc, rec->line);
+	}
+
+	return 0;
+}
+
+
+/**
+ * Decode all account records. The records are split in equal ranges,
+ * one per decoder thread. The calling thread decodes the first range.
+ *
+ * @param ld       Loader
+ * @param nthreads Number of decoder threads
+ *
+ * @return Number of used decoder threads
+ */
+static uint32_t decode_all(struct loader *ld, uint32_t nthreads)
+{
+	struct decoder decv[THREADS_MAX];
+	size_t chunk;
+	uint32_t i, n;
+
+	if (ld->recc < PARALLEL_MIN || !nthreads)
+		nthreads = 1;
+
+	nthreads = min(nthreads, (uint32_t)THREADS_MAX);
+	chunk    = (ld->recc + nthreads - 1) / nthreads;
+
+	memset(decv, 0, sizeof(decv));
+
+	for (n=0; n<nthreads && n * chunk < ld->recc; n++) {
+		struct decoder *dec = &decv[n];
+
+		dec->recv = &ld->recv[n * chunk];
+		dec->recc = min(chunk, ld->recc - n * chunk);
+
+		if (n == 0)
+			continue;
+
+		dec->run = 0 == thread_create_name(&dec->thrd,
+						   "account decoder",
+						   decode_thread, dec);
+	}
+
+	for (i=0; i<n; i++) {
+		struct decoder *dec = &decv[i];
+
+		if (!dec->run)
+			decode_thread(dec);
+	}
+
+	for (i=0; i<n; i++) {
+		if (decv[i].run)
+			thrd_join(decv[i].thrd, NULL);
+	}
+
+	return n;
+}
+
+
+/**
+ * Add a User-Agent (UA)
+ *
+ * @param rec Account record
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+static int ua_add(struct acc_rec *rec)
+{
 	struct account *acc;
 	int err;
-	(void)arg;
 
-	(void)pl_strcpy(addr, buf, sizeof(buf));
-
-	err = ua_alloc(&ua, buf);
+	err = ua_alloc_account(&rec->ua, rec->acc);
 	if (err)
 		return err;
 
-	acc = ua_account(ua);
+	acc = ua_account(rec->ua);
 	if (!acc) {
 		warning("account: no account for this ua\n");
 		return ENOENT;
 	}
 
-	if (account_regint(acc)) {
-		int e;
-
-		if (!account_prio(acc))
-			e = ua_register(ua);
-		else
-			e = ua_fallback(ua);
-
-		if (e) {
-			warning("account: failed to register ua"
-				" '%s' (%m)\n", account_aor(acc), e);
-		}
-	}
-
 	/* prompt password if auth_user is set, but auth_pass is not  */
 	if (str_isset(account_auth_user(acc)) &&
 	    !str_isset(account_auth_pass(acc))) {
@@ -187,6 +324,31 @@ static int line_handler(const struct pl *addr, void *arg)
 }
 
 
+static void register_all(const struct loader *ld)
+{
+	size_t i;
+
+	for (i=0; i<ld->recc; i++) {
+		struct ua *ua = ld->recv[i].ua;
+		struct account *acc = ua_account(ua);
+		int e;
+
+		if (!ua || !account_regint(acc))
+			continue;
+
+		if (!account_prio(acc))
+			e = ua_register(ua);
+		else
+			e = ua_fallback(ua);
+
+		if (e) {
+			warning("account: failed to register ua"
+				" '%s' (%m)\n", account_aor(acc), e);
+		}
+	}
+}
+
+
 /**
  * Read the SIP accounts from the ~/.baresip/accounts file
  *
@@ -195,9 +357,15 @@ static int line_handler(const struct pl *addr, void *arg)
 static int account_read_file(void)
 {
 	char path[256] = "", file[256] = "";
+	struct loader ld;
+	uint32_t nthreads = THREADS_DEFAULT;
+	uint64_t t0, t1, t2, t3, t4;
 	uint32_t n;
+	size_t i;
 	int err;
 
+	memset(&ld, 0, sizeof(ld));
+
 	err = conf_path_get(path, sizeof(path));
 	if (err) {
 		warning("account: conf_path_get (%m)\n", err);
@@ -216,20 +384,53 @@ static int account_read_file(void)
 			return err;
 	}
 
-	err = conf_parse(file, line_handler, NULL);
+	(void)conf_get_u32(conf_cur(), "account_threads", &nthreads);
+
+	t0 = tmr_jiffies();
+
+	err = conf_parse(file, line_handler, &ld);
 	if (err)
-		return err;
+		goto out;
+
+	t1 = tmr_jiffies();
+
+	nthreads = decode_all(&ld, nthreads);
+
+	t2 = tmr_jiffies();
+
+	for (i=0; i<ld.recc && !err; i++) {
+		struct acc_rec *rec = &ld.recv[i];
+
+		err = rec->err ? rec->err : ua_add(rec);
+	}
+
+	t3 = tmr_jiffies();
+
+	register_all(&ld);
+
+	t4 = tmr_jiffies();
+
+	if (err)
+		goto out;
 
 	n = list_count(uag_list());
 	info("Populated %u account%s\n", n, 1==n ? "" : "s");
 
+	info("account: loaded in %llu ms (read %llu ms, decode %llu ms"
+	     " with %u thread%s, ua %llu ms, register %llu ms)\n",
+	     t4 - t0, t1 - t0, t2 - t1, nthreads, 1==nthreads ? "" : "s",
+	     t3 - t2, t4 - t3);
+
 	if (list_isempty(uag_list())) {
 		info("account: No SIP accounts found\n"
 			" -- check your config "
 			"or add an account using 'uanew' command\n");
 	}
 
-	return 0;
+ out:
+	loader_reset(&ld);
+
+	return err;
 }
 
 
@@ -96,6 +96,11 @@ static int decode_update(struct aufilt_dec_st **stp, void **ctx,
 static int process_frame(void *buf, enum aufmt target_fmt,
 			 struct auframe *af)
 {
+	/* vectorized kernels for S16LE, S32LE and FLOAT */
+	if (0 == audsp_convert(buf, target_fmt, af->sampv, af->fmt,
+			       af->sampc))
+		goto out;
+
 	switch (target_fmt) {
 
 	case AUFMT_S16LE:
@@ -112,6 +117,7 @@ static int process_frame(void *buf, enum aufmt target_fmt,
 		return ENOTSUP;
 	}
 
+ out:
 	af->sampv = buf;
 	af->fmt   = target_fmt;
 
@@ -69,6 +69,20 @@ static void dec_destructor(void *arg)
 }
 
 
+static void to_s16(int16_t *dst, int fmt, void *src, size_t n)
+{
+	if (audsp_convert(dst, AUFMT_S16LE, src, fmt, n))
+		auconv_to_s16(dst, fmt, src, n);
+}
+
+
+static void from_s16(int fmt, void *dst, const int16_t *src, size_t n)
+{
+	if (audsp_convert(dst, fmt, src, AUFMT_S16LE, n))
+		auconv_from_s16(fmt, dst, src, n);
+}
+
+
 static int sampv_alloc(struct auresamp_st *st, struct auframe *af)
 {
 	size_t psize_out;
@@ -185,7 +199,7 @@ static int common_resample(struct auresamp_st *st, struct auframe *af)
 		if (err)
 			return err;
 
-		auconv_to_s16(st->sampv, af->fmt, af->sampv, af->sampc);
+		to_s16(st->sampv, af->fmt, af->sampv, af->sampc);
 		sampv = st->sampv;
 	}
 
@@ -209,7 +223,7 @@ static int common_resample(struct auresamp_st *st, struct auframe *af)
 	af->srate = st->oprm.srate;
 	af->ch    = st->oprm.ch;
 	if (st->oprm.fmt != AUFMT_S16LE) {
-		auconv_from_s16(st->oprm.fmt, st->sampv, st->rsampv, rsampc);
+		from_s16(st->oprm.fmt, st->sampv, st->rsampv, rsampc);
 		af->sampv = st->sampv;
 	}
 	else {
@@ -91,6 +91,7 @@ struct ctrl_st {
 	char *command;              /**< Current command                     */
 	struct mqueue *mqueue;      /**< Queue processed in main thread      */
 	struct mbuf *mb;            /**< Command response buffer             */
+	struct bevent_sub *sub;     /**< Event bus subscriber                */
 
 	struct {
 		mtx_t mtx;
@@ -231,47 +232,19 @@ on_handle_invoke(DBusBaresip *interface,
 
 
 /*
- * Relay UA events
+ * Relay UA events. Delivered synchronously, so that the D-Bus signals keep
+ * their order with the command responses and the SIP message signals,
+ * which are emitted from the main thread as well.
  */
-static void event_handler(enum bevent_ev ev, struct bevent *event, void *arg)
+static void event_handler(const struct bevent_json *bj, void *arg)
 {
 	struct ctrl_st *st = arg;
-	struct mbuf *buf;
-	struct re_printf pf;
-	struct odict *od = NULL;
-	int err = 0;
-	const char *class;
-	const char *etype = bevent_str(ev);
 
 	if (!st->interface)
 		return;
 
-	buf = mbuf_alloc(192);
-	err = odict_alloc(&od, 8);
-	if (!buf || err)
-		goto out;
-
-	pf.vph = print_handler;
-	pf.arg = buf;
-	err = bevent_odict_encode(od, event);
-	if (err)
-		goto out;
-
-	class = odict_string(od, "class");
-	err = json_encode_odict(&pf, od);
-	if (err) {
-		warning("ctrl_dbus: failed to encode json (%m)\n", err);
-		goto out;
-	}
-
-	mbuf_write_u8(buf, 0);
-	mbuf_set_pos(buf, 0);
-	dbus_baresip_emit_event(st->interface, class ? class : "other", etype,
-			(const char *) mbuf_buf(buf));
-
- out:
-	mem_deref(buf);
-	mem_deref(od);
+	dbus_baresip_emit_event(st->interface, bevent_class_str(bj->ec),
+				bevent_str(bj->ev), bj->json);
 }
 
 
@@ -318,6 +291,8 @@ out:
 static void ctrl_destructor(void *arg)
 {
 	struct ctrl_st *st = arg;
+
+	mem_deref(st->sub);
 	if (re_atomic_rlx(&st->run)) {
 		re_atomic_rlx_set(&st->run, false);
 		g_main_loop_quit(st->loop);
@@ -464,7 +439,8 @@ static int ctrl_init(void)
 	if (err)
 		goto outerr;
 
-	err = bevent_register(event_handler, m_st);
+	err = bevent_sub_alloc(&m_st->sub, BEVENT_SUB_SYNC, 0,
+			       event_handler, m_st);
 	if (err)
 		goto outerr;
 
@@ -500,7 +476,6 @@ outerr:
 
 static int ctrl_close(void)
 {
-	bevent_unregister(event_handler);
 	message_unlisten(baresip_message(), message_handler);
 	m_st = mem_deref(m_st);
 	return 0;
@@ -87,12 +87,16 @@
  */
 
 
-enum {CTRL_PORT = 4444};
+enum {
+	CTRL_PORT  = 4444,
+	EVENT_QLEN = 64,    /* queued events, covers a burst of call events */
+};
 
 struct ctrl_st {
 	struct tcp_sock *ts;
 	struct tcp_conn *tc;
 	struct netstring *ns;
+	struct bevent_sub *sub;
 };
 
 static struct ctrl_st *ctrl = NULL;  /* allow only one instance */
@@ -250,47 +254,35 @@ static void tcp_conn_handler(const struct sa *peer, void *arg)
 
 
 /*
- * Relay UA events
+ * Relay UA events. The event is encoded once by the event bus, with the
+ * "event" flag first, and delivered from the main loop.
  */
-static void event_handler(enum bevent_ev ev, struct bevent *event, void *arg)
+static void event_handler(const struct bevent_json *bj, void *arg)
 {
 	struct ctrl_st *st = arg;
-	struct mbuf *buf = mbuf_alloc(1024);
-	struct re_printf pf = {print_handler, buf};
-	struct odict *od = NULL;
+	struct mbuf *buf;
 	int err;
-	(void)ev;
 
-	buf->pos = NETSTRING_HEADER_SIZE;
+	if (!st->tc)
+		return;
 
-	err = odict_alloc(&od, 8);
-	if (err)
+	buf = mbuf_alloc(NETSTRING_HEADER_SIZE + bj->len);
+	if (!buf)
 		return;
 
-	err = odict_entry_add(od, "event", ODICT_BOOL, true);
-	err |= bevent_odict_encode(od, event);
-	if (err) {
-		warning("ctrl_tcp: failed to encode event (%m)\n", err);
+	buf->pos = NETSTRING_HEADER_SIZE;
+	err = mbuf_write_mem(buf, (const uint8_t *)bj->json, bj->len);
+	if (err)
 		goto out;
-	}
 
-	err = json_encode_odict(&pf, od);
+	buf->pos = NETSTRING_HEADER_SIZE;
+	err = tcp_send(st->tc, buf);
 	if (err) {
-		warning("ctrl_tcp: failed to encode event JSON (%m)\n", err);
-		goto out;
-	}
-
-	if (st->tc) {
-		buf->pos = NETSTRING_HEADER_SIZE;
-		err = tcp_send(st->tc, buf);
-		if (err) {
-			warning("ctrl_tcp: failed to send event (%m)\n", err);
-		}
+		warning("ctrl_tcp: failed to send event (%m)\n", err);
 	}
 
  out:
 	mem_deref(buf);
-	mem_deref(od);
 }
 
 
@@ -343,6 +335,7 @@ static void ctrl_destructor(void *arg)
 {
 	struct ctrl_st *st = arg;
 
+	mem_deref(st->sub);
 	mem_deref(st->tc);
 	mem_deref(st->ts);
 	mem_deref(st->ns);
@@ -393,10 +386,13 @@ static int ctrl_init(void)
 	if (err)
 		return err;
 
-	err = bevent_register(event_handler, ctrl);
+	err = bevent_sub_alloc(&ctrl->sub, BEVENT_SUB_ASYNC, EVENT_QLEN,
+			       event_handler, ctrl);
 	if (err)
 		return err;
 
+	bevent_sub_set_opts(ctrl->sub, BEVENT_SUB_OPT_EVENT);
+
 	err = message_listen(baresip_message(), message_handler, ctrl);
 	if (err)
 		return err;
@@ -407,7 +403,6 @@ static int ctrl_init(void)
 
 static int ctrl_close(void)
 {
-	bevent_unregister(event_handler);
 	message_unlisten(baresip_message(), message_handler);
 	ctrl = mem_deref(ctrl);
 
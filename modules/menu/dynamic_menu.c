@@ -40,6 +40,15 @@ static int call_audio_debug(struct re_printf *pf, void *arg)
 }
 
 
+static int call_audio_latency(struct re_printf *pf, void *arg)
+{
+	struct cmd_arg *carg = arg;
+	struct ua *ua = carg->data ? carg->data : menu_uacur();
+
+	return audio_latency_debug(pf, call_audio(ua_call(ua)));
+}
+
+
 static int cmd_find_call(struct re_printf *pf, void *arg)
 {
 	struct cmd_arg *carg = arg;
@@ -450,6 +459,7 @@ static const struct cmd callcmdv[] = {
 
 {"aubitrate",    0,  CMD_PRM, "Set audio bitrate",    set_audio_bitrate    },
 {"audio_debug", 'A',       0, "Audio stream",         call_audio_debug     },
+{"audio_latency", 0,       0, "Audio latency trace",  call_audio_latency   },
 {"callfind",     0,  CMD_PRM, "Find call <callid>",   cmd_find_call        },
 {"hold",        'x',       0, "Call hold",            cmd_call_hold        },
 {"line",        '@', CMD_PRM, "Set current call <line>", set_current_call  },
@@ -1269,6 +1269,38 @@ out:
 }
 
 
+static void preload_aufiles(void)
+{
+	static const char *keyv[][2] = {
+		{"ring_aufile",           "ring.wav"},
+		{"callwaiting_aufile",    "callwaiting.wav"},
+		{"ringback_aufile",       "ringback.wav"},
+		{"notfound_aufile",       "notfound.wav"},
+		{"busy_aufile",           "busy.wav"},
+		{"error_aufile",          "error.wav"},
+		{"sip_autoanswer_aufile", "autoanswer.wav"},
+	};
+	char file[256];
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(keyv); i++) {
+		int err;
+
+		if (conf_get_str(conf_cur(), keyv[i][0], file, sizeof(file)))
+			str_ncpy(file, keyv[i][1], sizeof(file));
+
+		if (!str_cmp(file, "none"))
+			continue;
+
+		err = play_preload(baresip_player(), file);
+		if (err)
+			debug("menu: could not preload %s (%m)\n", file, err);
+	}
+
+	if (menu.message_tone)
+		(void)play_preload(baresip_player(), "message.wav");
+}
+
+
 static int module_init(void)
 {
 	struct pl val;
@@ -1326,6 +1358,8 @@ static int module_init(void)
 		menu.statmode = STATMODE_CALL;
 	}
 
+	preload_aufiles();
+
 	err = static_menu_register();
 	err |= dial_menu_register();
 	if (err)
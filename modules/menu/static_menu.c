@@ -1027,6 +1027,7 @@ out:
  */
 static int ua_print_reg_status(struct re_printf *pf, void *unused)
 {
+	const struct config *cfg = conf_config();
 	struct le *le;
 	int err;
 	uint32_t i = 0;
@@ -1043,6 +1044,9 @@ static int ua_print_reg_status(struct re_printf *pf, void *unused)
 		err |= ua_print_status(pf, ua);
 	}
 
+	if (cfg->sip.reg_rate || cfg->sip.reg_spread)
+		err |= uag_reg_sched_debug(pf);
+
 	err |= re_hprintf(pf, "\n");
 
 	return err;
@@ -482,36 +482,55 @@ static int decode_update(struct aufilt_dec_st **stp, void **ctx,
  *
  * @param st   mixausrc status object
  * @param dir  fading direction (fade-in / fade-out)
+ * @param n    number of samples in frame
+ * @param gain Pointer to start gain factor
+ * @param lim  Pointer to gain limit
  *
- * @return float sample multiplication factor
+ * @return number of samples to fade
  */
-static float fade_linear(struct mixstatus *st, enum mixmode dir)
+static size_t fade_linear(struct mixstatus *st, enum mixmode dir, size_t n,
+			  float *gain, float *lim)
 {
 	float factor = st->i_fade * st->delta_fade;
-	++st->i_fade;
+	size_t m = st->i_fade < st->n_fade ? st->n_fade - st->i_fade : 0;
 
-	if (dir == FM_FADEIN)
-		return (st->minvol + factor) > 1.0f ? 1.0f
-						    : st->minvol + factor;
-	else
-		return (1.0f - factor) < st->minvol ? st->minvol
-						    : 1.0f - factor;
+	if (dir == FM_FADEIN) {
+		*gain = st->minvol + factor;
+		*lim  = 1.0f;
+	}
+	else {
+		*gain = 1.0f - factor;
+		*lim  = st->minvol;
+	}
+
+	m = min(m, n);
+	st->i_fade = (uint16_t)(st->i_fade + m);
+
+	return m;
 }
 
 
 static void fade_int16(struct mixstatus *st, int16_t *data, size_t n,
 	enum mixmode dir)
 {
-	for (size_t i = 0; (i < n) && (st->i_fade < st->n_fade); ++i)
-		data[i] = (int16_t)(data[i] * fade_linear(st, dir));
+	float gain, lim;
+	size_t m = fade_linear(st, dir, n, &gain, &lim);
+
+	audsp_fade_s16(data, m, gain,
+		       dir == FM_FADEIN ? st->delta_fade : -st->delta_fade,
+		       lim);
 }
 
 
 static void fade_float(struct mixstatus *st, float *data, size_t n,
 	enum mixmode dir)
 {
-	for (size_t i = 0; (i < n) && (st->i_fade < st->n_fade); ++i)
-		data[i] *= fade_linear(st, dir);
+	float gain, lim;
+	size_t m = fade_linear(st, dir, n, &gain, &lim);
+
+	audsp_fade_float(data, m, gain,
+			 dir == FM_FADEIN ? st->delta_fade : -st->delta_fade,
+			 lim);
 }
 
 
@@ -531,15 +550,13 @@ static int fadeframe(struct mixstatus *st, struct auframe *af,
 
 static void clear_int16(struct mixstatus *st, int16_t *data, size_t n)
 {
-	for (size_t i = 0; i < n; ++i)
-		data[i] = (int16_t)(data[i] * st->minvol);
+	audsp_gain_s16(data, n, st->minvol);
 }
 
 
 static void clear_float(struct mixstatus *st, float *data, size_t n)
 {
-	for (size_t i = 0; i < n; ++i)
-		data[i] *= st->minvol;
+	audsp_gain_float(data, n, st->minvol);
 }
 
 
@@ -567,10 +584,11 @@ static void mix_int16(struct mixstatus *st, int16_t *data, size_t n)
 
 static void mix_float(struct mixstatus *st, float *data, size_t n)
 {
+	const float *mix = (const float *)(void *)st->mixbuf;
 	size_t i;
 	for (i = 0; i < n; i++)
 		data[i] = data[i] * st->minvol +
-			(st->ausvol * st->mixbuf[i]);
+			(st->ausvol * mix[i]);
 }
 
 
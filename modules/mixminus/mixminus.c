@@ -10,92 +10,251 @@
 #include <rem.h>
 #include <baresip.h>
 
+
+/**
+ * @defgroup mixminus mixminus
+ *
+ * Conference bridge with N-1 mixing
+ *
+ * All conference participants are mixed by a central bridge, with a
+ * common internal format (48000 Hz, mono, S16LE) and a fixed frame size.
+ *
+ * The decoder of each participant resamples the received audio to the
+ * bridge format and writes it to the input buffer of the participant.
+ *
+ * Once per frame, the bridge reads one frame from every input buffer and
+ * sums all of them up to one full mix. The output of each participant is
+ * then the full mix minus its own input, which is written to the output
+ * buffer of the participant. This is O(N) work per frame.
+ *
+ * The bridge is clocked by the encoders: every encoder advances the bridge
+ * to the current time, then reads its output buffer and resamples it to
+ * the encoder format. The buffers never block, an underrun gives silence.
+ */
+
+
 enum {
 	MAX_SRATE       = 48000,  /* Maximum sample rate in [Hz] */
 	MAX_CHANNELS    =     2,  /* Maximum number of channels  */
 	MAX_PTIME       =    60,  /* Maximum packet time in [ms] */
 
-	AUDIO_SAMPSZ    = MAX_SRATE * MAX_CHANNELS * MAX_PTIME / 1000
+	AUDIO_SAMPSZ    = MAX_SRATE * MAX_CHANNELS * MAX_PTIME / 1000,
+
+	BRIDGE_SRATE    = 48000,  /* Bridge sample rate in [Hz]  */
+	BRIDGE_CH       =     1,  /* Bridge channels             */
+	BRIDGE_PTIME    =    10,  /* Bridge frame time in [ms]   */
+	BRIDGE_SAMPC    = BRIDGE_SRATE * BRIDGE_CH * BRIDGE_PTIME / 1000,
+	BRIDGE_FRAMESZ  = BRIDGE_SAMPC * sizeof(int16_t),
+	BRIDGE_CATCHUP  =    10,  /* Max. frames to catch up     */
 };
 
-struct mix {
-	struct aubuf *ab;
-	const struct audio *au;
-	struct aufilt_prm prm;
-	bool ready;
-	struct le le_priv;
+
+/** One conference participant, shared by its encoder and decoder */
+struct party {
+	struct le le;
+	const struct audio *au;       /**< Audio object, used as id         */
+	struct aubuf *inab;           /**< Decoded audio, bridge format     */
+	struct aubuf *outab;          /**< Mix-minus audio, bridge format   */
+	int16_t inv[BRIDGE_SAMPC];    /**< Input of the current frame       */
 };
 
 struct mixminus_enc {
 	struct aufilt_enc_st af;  /* inheritance */
-	mtx_t *mtx;
-	const struct audio *au;
-	struct list mixers;
-	int16_t *sampv;
+	struct party *party;
+	int16_t *bsampv;
 	int16_t *rsampv;
 	int16_t *fsampv;
 	struct auresamp resamp;
 	struct aufilt_prm prm;
-	struct le le_priv;
+	bool active;
 };
 
 struct mixminus_dec {
 	struct aufilt_dec_st af;  /* inheritance */
-
-	const struct audio *au;
+	struct party *party;
 	int16_t *fsampv;
+	int16_t *rsampv;
+	struct auresamp resamp;
 	struct aufilt_prm prm;
+	uint32_t srate;           /* resampler input rate     */
+	uint8_t ch;               /* resampler input channels */
 };
 
-static struct list encs;
+static struct {
+	struct list partyl;           /**< Participants (struct party)      */
+	mtx_t *mtx;                   /**< Protects partyl and the mix      */
+	uint64_t jfs;                 /**< Time of the next frame [us]      */
+	int32_t mixv[BRIDGE_SAMPC];   /**< Full mix of the current frame    */
+} bridge;
 
 
-static void enc_destructor(void *arg)
+static inline int16_t clip16(int32_t v)
 {
-	struct mixminus_enc *st = arg;
-	struct mixminus_enc *enc;
+	return v > 32767 ? 32767 : (v < -32768 ? -32768 : (int16_t)v);
+}
 
-	list_flush(&st->mixers);
-	mem_deref(st->sampv);
-	mem_deref(st->rsampv);
-	mem_deref(st->fsampv);
-	list_unlink(&st->le_priv);
 
-	for (struct le *le = list_head(&encs); le; le = le->next) {
-		enc = le->data;
-		if (!enc)
-			continue;
+/*
+ * Bridge mixing kernels with 32-bit accumulation, written as plain
+ * branch-free loops over contiguous arrays so that the compiler can
+ * vectorize them. The other kernels are from the audsp library.
+ */
 
-		mtx_lock(enc->mtx);
-		struct le *lem = list_head(&enc->mixers);
+static void mix_add(int32_t *restrict mixv, const int16_t *restrict v,
+		    size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		mixv[i] += v[i];
+}
+
+
+static void mix_minus(int16_t *restrict outv, const int32_t *restrict mixv,
+		      const int16_t *restrict v, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		outv[i] = clip16(mixv[i] - v[i]);
+}
+
+
+static void to_s16(int16_t *dst, int fmt, void *src, size_t n)
+{
+	if (audsp_convert(dst, AUFMT_S16LE, src, fmt, n))
+		auconv_to_s16(dst, fmt, src, n);
+}
+
+
+static void from_s16(int fmt, void *dst, const int16_t *src, size_t n)
+{
+	if (audsp_convert(dst, fmt, src, AUFMT_S16LE, n))
+		auconv_from_s16(fmt, dst, src, n);
+}
+
+
+static void party_destructor(void *arg)
+{
+	struct party *p = arg;
+
+	mtx_lock(bridge.mtx);
+	list_unlink(&p->le);
+	mtx_unlock(bridge.mtx);
+
+	mem_deref(p->inab);
+	mem_deref(p->outab);
+}
+
+
+static int party_get(struct party **pp, const struct audio *au)
+{
+	struct party *p = NULL;
+	struct le *le;
+	int err = 0;
 
-		while (lem) {
-			struct mix *mix = lem->data;
-			lem = lem->next;
+	mtx_lock(bridge.mtx);
 
-			if (st->au != mix->au)
-				continue;
+	for (le = list_head(&bridge.partyl); le; le = le->next) {
+		struct party *q = le->data;
 
-			mix->ready = false;
-			list_unlink(&mix->le_priv);
-			mem_deref(mix);
+		/* skip a party that is being destroyed */
+		if (q->au == au && mem_nrefs(q) > 0) {
+			p = mem_ref(q);
+			goto out;
 		}
-		mtx_unlock(enc->mtx);
 	}
 
-	mem_deref(st->mtx);
+	p = mem_zalloc(sizeof(*p), NULL);
+	if (!p) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	p->au = au;
+
+	err  = aubuf_alloc(&p->inab, BRIDGE_FRAMESZ, 10 * BRIDGE_FRAMESZ);
+	err |= aubuf_alloc(&p->outab, 2 * BRIDGE_FRAMESZ,
+			   10 * BRIDGE_FRAMESZ);
+	if (err) {
+		mem_deref(p->inab);
+		mem_deref(p->outab);
+		p = mem_deref(p);
+		goto out;
+	}
+
+	list_append(&bridge.partyl, &p->le, p);
+	mem_destructor(p, party_destructor);
+
+ out:
+	mtx_unlock(bridge.mtx);
+
+	if (!err)
+		*pp = p;
+
+	return err;
 }
 
-static void dec_destructor(void *arg)
+
+/* Must be called with bridge.mtx */
+static void bridge_frame(void)
 {
-	struct mixminus_dec *st = arg;
+	struct le *le;
+
+	memset(bridge.mixv, 0, sizeof(bridge.mixv));
+
+	LIST_FOREACH(&bridge.partyl, le) {
+		struct party *p = le->data;
+
+		if (!audio_is_conference(p->au))
+			continue;
+
+		aubuf_read_samp(p->inab, p->inv, BRIDGE_SAMPC);
+		mix_add(bridge.mixv, p->inv, BRIDGE_SAMPC);
+	}
+
+	LIST_FOREACH(&bridge.partyl, le) {
+		struct party *p = le->data;
+		int16_t outv[BRIDGE_SAMPC];
+
+		if (!audio_is_conference(p->au))
+			continue;
+
+		mix_minus(outv, bridge.mixv, p->inv, BRIDGE_SAMPC);
+		aubuf_write_samp(p->outab, outv, BRIDGE_SAMPC);
+	}
+}
+
+
+/* Run all frames that are due, must be called with bridge.mtx */
+static void bridge_advance(uint64_t now)
+{
+	const uint64_t frame_us = BRIDGE_PTIME * 1000;
+
+	if (!bridge.jfs || now > bridge.jfs + BRIDGE_CATCHUP * frame_us)
+		bridge.jfs = now;
+
+	while (bridge.jfs <= now) {
+		bridge_frame();
+		bridge.jfs += frame_us;
+	}
+}
+
+
+static void enc_destructor(void *arg)
+{
+	struct mixminus_enc *st = arg;
+
+	mem_deref(st->party);
+	mem_deref(st->bsampv);
+	mem_deref(st->rsampv);
 	mem_deref(st->fsampv);
 }
 
-static void mix_destructor(void *arg)
+
+static void dec_destructor(void *arg)
 {
-	struct mix *mix = arg;
-	mem_deref(mix->ab);
+	struct mixminus_dec *st = arg;
+
+	mem_deref(st->party);
+	mem_deref(st->fsampv);
+	mem_deref(st->rsampv);
 }
 
 
@@ -103,10 +262,8 @@ static int encode_update(struct aufilt_enc_st **stp, void **ctx,
 			 const struct aufilt *af, struct aufilt_prm *prm,
 			 const struct audio *au)
 {
-	struct mixminus_enc *st, *enc;
-	struct mix *mix;
+	struct mixminus_enc *st;
 	size_t psize;
-	struct le *le;
 	int err;
 	(void)af;
 
@@ -120,80 +277,37 @@ static int encode_update(struct aufilt_enc_st **stp, void **ctx,
 	if (!st)
 		return ENOMEM;
 
-	err = mutex_alloc(&st->mtx);
-	if (err)
-		return ENOMEM;
-
 	psize = AUDIO_SAMPSZ * sizeof(int16_t);
 
-	st->sampv = mem_zalloc(psize, NULL);
-	if (!st->sampv)
-		return ENOMEM;
-
+	st->bsampv = mem_zalloc(psize, NULL);
 	st->rsampv = mem_zalloc(psize, NULL);
-	if (!st->rsampv)
-		return ENOMEM;
-
 	st->fsampv = mem_zalloc(psize, NULL);
-	if (!st->fsampv)
-		return ENOMEM;
+	if (!st->bsampv || !st->rsampv || !st->fsampv) {
+		err = ENOMEM;
+		goto out;
+	}
 
 	st->prm = *prm;
-	st->au = au;
 	auresamp_init(&st->resamp);
 
-	list_append(&encs, &st->le_priv, st);
-
-	/* add mix to other encs */
-	for (le = list_head(&encs); le; le = le->next) {
-		enc = le->data;
-		if (!enc)
-			continue;
-		if (enc->au == au)
-			continue;
-
-		mix = mem_zalloc(sizeof(*mix), mix_destructor);
-		if (!mix)
-			return ENOMEM;
-		psize = st->prm.srate * st->prm.ch * 20 / 1000;
-		err = aubuf_alloc(&mix->ab, psize, 5 * psize);
-		if (err)
-			return err;
-
-		mix->au = st->au; /* using audio object as id */
-		mix->ready = false;
-
-		mtx_lock(enc->mtx);
-		list_append(&enc->mixers, &mix->le_priv, mix);
-		mtx_unlock(enc->mtx);
+	err = auresamp_setup(&st->resamp, BRIDGE_SRATE, BRIDGE_CH,
+			     prm->srate, prm->ch);
+	if (err) {
+		warning("mixminus: encoder: unsupported format"
+			" %u Hz %u ch (%m)\n", prm->srate, prm->ch, err);
 	}
 
-	/* add other mixes to new enc */
-	for (le = list_head(&encs); le; le = le->next) {
-		enc = le->data;
-		if (!enc)
-			continue;
-		if (enc->au == au)
-			continue;
-
-		mix = mem_zalloc(sizeof(*mix), mix_destructor);
-		if (!mix)
-			return ENOMEM;
-
-		psize = enc->prm.srate * enc->prm.ch * 20 / 1000;
-		err = aubuf_alloc(&mix->ab, psize, 5 * psize);
-		if (err)
-			return err;
+	st->active = !err;
 
-		mix->au = enc->au; /* using audio object as id */
-		mix->ready = false;
+	err = party_get(&st->party, au);
 
-		list_append(&st->mixers, &mix->le_priv, mix);
-	}
-
-	*stp = (struct aufilt_enc_st *) st;
+ out:
+	if (err)
+		mem_deref(st);
+	else
+		*stp = (struct aufilt_enc_st *)st;
 
-	return 0;
+	return err;
 }
 
 
@@ -203,10 +317,10 @@ static int decode_update(struct aufilt_dec_st **stp, void **ctx,
 {
 	struct mixminus_dec *st;
 	size_t psize;
+	int err;
 	(void)af;
-	(void)prm;
 
-	if (!stp || !ctx)
+	if (!stp || !ctx || !prm)
 		return EINVAL;
 
 	if (*stp)
@@ -219,178 +333,130 @@ static int decode_update(struct aufilt_dec_st **stp, void **ctx,
 	psize = AUDIO_SAMPSZ * sizeof(int16_t);
 
 	st->fsampv = mem_zalloc(psize, NULL);
-	if (!st->fsampv)
-		return ENOMEM;
+	st->rsampv = mem_zalloc(psize, NULL);
+	if (!st->fsampv || !st->rsampv) {
+		err = ENOMEM;
+		goto out;
+	}
 
-	st->au = au;
 	st->prm = *prm;
+	auresamp_init(&st->resamp);
 
-	*stp = (struct aufilt_dec_st *)st;
-
-	return 0;
-}
-
-
-static void read_samp(struct aubuf *ab, int16_t *sampv, size_t sampc,
-		      size_t stime)
-{
-	size_t i;
-	size_t psize = sampc * 2;
+	err = party_get(&st->party, au);
 
-	for (i = 0; i < stime - 1; i++) {
-		if (aubuf_cur_size(ab) < psize) {
-			sys_msleep(1);
-		}
-		else {
-			break;
-		}
-	}
+ out:
+	if (err)
+		mem_deref(st);
+	else
+		*stp = (struct aufilt_dec_st *)st;
 
-	aubuf_read_samp(ab, sampv, sampc);
+	return err;
 }
 
 
 static int encode(struct aufilt_enc_st *aufilt_enc_st, struct auframe *af)
 {
 	struct mixminus_enc *enc = (struct mixminus_enc *)aufilt_enc_st;
-	size_t i, inc, outc, stime;
-	struct le *lem;
-	struct mix *mix;
 	int16_t *sampv = af->sampv;
-	int16_t *sampv_mix = enc->sampv;
-	int32_t sample;
-	int err = 0;
-
-	stime = 1000 * af->sampc / (enc->prm.srate * enc->prm.ch);
+	int16_t *mixv = enc->bsampv;
+	size_t n, outc;
+	int err;
 
-	if (enc->prm.fmt != AUFMT_S16LE) {
-		auconv_to_s16(enc->fsampv, enc->prm.fmt, af->sampv, af->sampc);
-		sampv = enc->fsampv;
-	}
+	if (!enc->active || !audio_is_conference(enc->party->au))
+		return 0;
 
-	mtx_lock(enc->mtx);
-	for (lem = list_head(&enc->mixers); lem; lem = lem->next) {
-		mix = lem->data;
-		if (!mix)
-			continue;
+	/* number of bridge samples for this frame */
+	n = af->sampc / enc->prm.ch * BRIDGE_CH * BRIDGE_SRATE /
+		enc->prm.srate;
+	if (n > AUDIO_SAMPSZ)
+		return EINVAL;
 
-		if (!audio_is_conference(mix->au))
-			continue;
+	mtx_lock(bridge.mtx);
+	bridge_advance(tmr_jiffies_usec());
+	mtx_unlock(bridge.mtx);
 
-		if (!mix->ready) {
-			mix->ready = true;
-			continue;
-		}
+	aubuf_read_samp(enc->party->outab, enc->bsampv, n);
 
-		if (!mix->prm.srate || !mix->prm.ch)
-			continue;
+	if (enc->resamp.resample) {
+		outc = AUDIO_SAMPSZ;
+		mixv = enc->rsampv;
 
-		err = auresamp_setup(&enc->resamp, mix->prm.srate, mix->prm.ch,
-				     enc->prm.srate, enc->prm.ch);
+		err = auresamp(&enc->resamp, mixv, &outc, enc->bsampv, n);
 		if (err) {
-			warning("mixminus/auresamp_setup error (%m)\n", err);
-			goto out;
-		}
-
-		if (enc->resamp.resample) {
-			outc = AUDIO_SAMPSZ;
-			sampv_mix = enc->rsampv;
-
-			if (enc->prm.srate > mix->prm.srate) {
-				inc = af->sampc / enc->resamp.ratio;
-			}
-			else {
-				inc = af->sampc * enc->resamp.ratio;
-			}
-
-			if (enc->prm.ch == 2 && mix->prm.ch == 1) {
-				inc = inc / 2;
-			}
-
-			if (enc->prm.ch == 1 && mix->prm.ch == 2) {
-				inc = inc * 2;
-			}
-
-			read_samp(mix->ab, enc->sampv, inc, stime);
-
-			err = auresamp(&enc->resamp, sampv_mix, &outc,
-				       enc->sampv, inc);
-			if (err) {
-				warning("mixminus/auresamp error (%m)\n", err);
-				goto out;
-			}
-			if (outc != af->sampc) {
-				warning("mixminus/auresamp sample count "
-					"error\n");
-				err = EINVAL;
-				goto out;
-			}
-		}
-		else {
-			read_samp(mix->ab, sampv_mix, af->sampc, stime);
+			warning("mixminus/auresamp error (%m)\n", err);
+			return err;
 		}
 
-		for (i = 0; i < af->sampc; i++) {
-			sample = sampv[i] + sampv_mix[i];
-
-			/* soft clipping */
-			if (sample >= 32767)
-				sample = 32767;
-			if (sample <= -32767)
-				sample = -32767;
-			sampv[i] = sample;
+		if (outc != af->sampc) {
+			warning("mixminus/auresamp sample count error\n");
+			return EINVAL;
 		}
 	}
 
 	if (enc->prm.fmt != AUFMT_S16LE) {
-		auconv_from_s16(enc->prm.fmt, af->sampv, sampv,
-				af->sampc);
+		to_s16(enc->fsampv, enc->prm.fmt, af->sampv, af->sampc);
+		sampv = enc->fsampv;
 	}
 
-out:
-	mtx_unlock(enc->mtx);
-	return err;
+	audsp_add_s16(sampv, mixv, af->sampc);
+
+	if (enc->prm.fmt != AUFMT_S16LE)
+		from_s16(enc->prm.fmt, af->sampv, sampv, af->sampc);
+
+	return 0;
 }
 
 
 static int decode(struct aufilt_dec_st *aufilt_dec_st, struct auframe *af)
 {
 	struct mixminus_dec *dec = (struct mixminus_dec *)aufilt_dec_st;
-	struct mixminus_enc *enc;
-	struct le *le;
-	struct le *lem;
-	struct mix *mix;
-	int16_t *sampv;
+	int16_t *sampv = af->sampv;
+	size_t outc = af->sampc;
+	int err;
 
-	for (le = list_head(&encs); le; le = le->next) {
-		enc = le->data;
-		if (!enc)
-			continue;
+	if (!audio_is_conference(dec->party->au))
+		return 0;
+
+	if (af->srate && af->ch) {
+		dec->prm.srate = af->srate;
+		dec->prm.ch    = af->ch;
+	}
 
-		for (lem = list_head(&enc->mixers); lem; lem = lem->next) {
-			mix = lem->data;
+	if (dec->prm.srate != dec->srate || dec->prm.ch != dec->ch) {
 
-			if (!mix || dec->au != mix->au)
-				continue;
+		err = auresamp_setup(&dec->resamp, dec->prm.srate,
+				     dec->prm.ch, BRIDGE_SRATE, BRIDGE_CH);
+		if (err) {
+			warning("mixminus: decoder: unsupported format"
+				" %u Hz %u ch (%m)\n",
+				dec->prm.srate, dec->prm.ch, err);
+		}
 
-			if (!mix->ready)
-				continue;
+		dec->srate = dec->prm.srate;
+		dec->ch    = err ? 0 : dec->prm.ch;
+	}
 
-			mix->prm.ch = dec->prm.ch;
-			mix->prm.srate = dec->prm.srate;
+	if (!dec->ch)
+		return 0;
 
-			sampv = af->sampv;
+	if (dec->prm.fmt != AUFMT_S16LE) {
+		to_s16(dec->fsampv, dec->prm.fmt, af->sampv, af->sampc);
+		sampv = dec->fsampv;
+	}
 
-			if (dec->prm.fmt != AUFMT_S16LE) {
-				sampv = dec->fsampv;
-				auconv_to_s16(sampv, dec->prm.fmt,
-					      (void *)af->sampv, af->sampc);
-			}
+	if (dec->resamp.resample) {
+		outc = AUDIO_SAMPSZ;
 
-			aubuf_write_samp(mix->ab, sampv, af->sampc);
-		}
+		err = auresamp(&dec->resamp, dec->rsampv, &outc,
+			       sampv, af->sampc);
+		if (err)
+			return 0;
+
+		sampv = dec->rsampv;
 	}
 
+	aubuf_write_samp(dec->party->inab, sampv, outc);
+
 	return 0;
 }
 
@@ -423,32 +489,28 @@ static int enable_conference(struct re_printf *pf, void *arg)
 
 static int debug_conference(struct re_printf *pf, void *arg)
 {
-	struct mixminus_enc *enc;
-	struct mix *mix;
-	struct le *le, *lem;
+	struct le *le;
 	(void)pf;
 	(void)arg;
 
-	for (le = list_head(&encs); le; le = le->next) {
-		enc = le->data;
-		if (!enc)
-			continue;
+	mtx_lock(bridge.mtx);
 
-		info("mixminus/enc au %p:"
-		     "ch %d srate %d fmt %s, is_conference (%s)\n",
-		     enc->au, enc->prm.ch, enc->prm.srate,
-		     aufmt_name(enc->prm.fmt),
-		     audio_is_conference(enc->au) ? "true" : "false");
+	info("mixminus: bridge %u Hz %u ch, %u ms frames, %u parties\n",
+	     BRIDGE_SRATE, BRIDGE_CH, BRIDGE_PTIME,
+	     list_count(&bridge.partyl));
 
-		for (lem = list_head(&enc->mixers); lem; lem = lem->next) {
-			mix = lem->data;
+	LIST_FOREACH(&bridge.partyl, le) {
+		struct party *p = le->data;
 
-			info("\tmix au %p: ch %d srate %d %H\n", mix->au,
-			     mix->prm.ch, mix->prm.srate, aubuf_debug,
-			     mix->ab);
-		}
+		info("\tparty au %p: is_conference (%s)\n"
+		     "\t  in  %H\n"
+		     "\t  out %H\n",
+		     p->au, audio_is_conference(p->au) ? "true" : "false",
+		     aubuf_debug, p->inab, aubuf_debug, p->outab);
 	}
 
+	mtx_unlock(bridge.mtx);
+
 	return 0;
 }
 
@@ -470,6 +532,10 @@ static int module_init(void)
 {
 	int err;
 
+	err = mutex_alloc(&bridge.mtx);
+	if (err)
+		return err;
+
 	aufilt_register(baresip_aufiltl(), &mixminus);
 	err  = cmd_register(baresip_commands(), cmdv, RE_ARRAY_SIZE(cmdv));
 
@@ -481,6 +547,10 @@ static int module_close(void)
 {
 	cmd_unregister(baresip_commands(), cmdv);
 	aufilt_unregister(&mixminus);
+
+	bridge.mtx = mem_deref(bridge.mtx);
+	bridge.jfs = 0;
+
 	return 0;
 }
 
@@ -34,9 +34,13 @@ static void fd_handler(int flags, void *arg)
 	struct mqtt *mqtt = arg;
 	(void)flags;
 
+	mtx_lock(&mqtt->lock);
+
 	mosquitto_loop_read(mqtt->mosq, 1);
 
 	mosquitto_loop_write(mqtt->mosq, 1);
+
+	mtx_unlock(&mqtt->lock);
 }
 
 
@@ -47,7 +51,9 @@ static void tmr_handler(void *data)
 
 	tmr_start(&mqtt->tmr, 500, tmr_handler, mqtt);
 
+	mtx_lock(&mqtt->lock);
 	ret = mosquitto_loop_misc(mqtt->mosq);
+	mtx_unlock(&mqtt->lock);
 	if (ret != MOSQ_ERR_SUCCESS) {
 		warning("mqtt: error in loop (%s)\n", mosquitto_strerror(ret));
 	}
@@ -85,7 +91,9 @@ static void tmr_reconnect(void *data)
 	struct mqtt *mqtt = data;
 	int err;
 
+	mtx_lock(&mqtt->lock);
 	err = mosquitto_reconnect(mqtt->mosq);
+	mtx_unlock(&mqtt->lock);
 	if (err == MOSQ_ERR_SUCCESS) {
 		mqtt->fd = mosquitto_socket(mqtt->mosq);
 
@@ -129,6 +137,11 @@ static int module_init(void)
 
 	tmr_init(&s_mqtt.tmr);
 
+	/* recursive, the callbacks of mosquitto_loop_read() may publish */
+	if (mtx_init(&s_mqtt.lock, mtx_plain | mtx_recursive)
+	    != thrd_success)
+		return ENOMEM;
+
 	mosquitto_lib_init();
 
 	/* Get configuration data */
@@ -232,7 +245,7 @@ static int module_close(void)
 {
 	s_mqtt.fhs = fd_close(s_mqtt.fhs);
 
-	mqtt_publish_close();
+	mqtt_publish_close(&s_mqtt);
 
 	mqtt_subscribe_close();
 
@@ -248,6 +261,8 @@ static int module_close(void)
 
 	mosquitto_lib_cleanup();
 
+	mtx_destroy(&s_mqtt.lock);
+
 	info("mqtt: module unloaded\n");
 
 	return 0;
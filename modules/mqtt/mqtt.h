@@ -13,6 +13,8 @@ struct mqtt {
 	struct tmr tmr;
 	re_sock_t fd;
 	struct re_fhs *fhs;
+	struct bevent_sub *sub;
+	mtx_t lock;		/* Serialises mosquitto calls */
 };
 
 
@@ -30,6 +32,6 @@ void mqtt_subscribe_close(void);
  */
 
 int  mqtt_publish_init(struct mqtt *mqtt);
-void mqtt_publish_close(void);
+void mqtt_publish_close(struct mqtt *mqtt);
 int  mqtt_publish_message(struct mqtt *mqtt, const char *topic,
 			  const char *fmt, ...);
@@ -16,41 +16,49 @@
  */
 
 
+enum {
+	EVENT_QLEN = 256,  /* queued events, covers VU events of many calls */
+};
+
+
+static int publish(struct mqtt *mqtt, const char *topic,
+		   const char *message, size_t len)
+{
+	int ret;
+
+	mtx_lock(&mqtt->lock);
+	ret = mosquitto_publish(mqtt->mosq,
+				NULL,
+				topic,
+				(int)len,
+				message,
+				0,
+				false);
+	mtx_unlock(&mqtt->lock);
+	if (ret != MOSQ_ERR_SUCCESS) {
+		warning("mqtt: failed to publish (%s)\n",
+			mosquitto_strerror(ret));
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+
 /*
- * Relay UA events as publish messages to the Broker
+ * Relay UA events as publish messages to the Broker. Called from the
+ * subscriber thread, the audio jitter buffer values are added to the VU
+ * rx events by the event bus.
  */
-static void event_handler(enum bevent_ev ev, struct bevent *event, void *arg)
+static void event_handler(const struct bevent_json *bj, void *arg)
 {
 	struct mqtt *mqtt = arg;
-	struct odict *od = NULL;
-	struct call *call = bevent_get_call(event);
 	int err;
 
-	err = odict_alloc(&od, 8);
-	if (err)
-		return;
-
-	err = bevent_odict_encode(od, event);
-	if (err)
-		goto out;
-
-	/* send audio jitter buffer values together with VU rx values. */
-	if (ev == BEVENT_VU_RX) {
-		err = event_add_au_jb_stat(od,call);
-		if (err) {
-			info("Could not add audio jb value.\n");
-		}
-	}
-
-	err = mqtt_publish_message(mqtt, mqtt->pubtopic, "%H",
-				   json_encode_odict, od);
+	err = publish(mqtt, mqtt->pubtopic, bj->json, bj->len);
 	if (err) {
 		warning("mqtt: failed to publish message (%m)\n", err);
-		goto out;
 	}
-
- out:
-	mem_deref(od);
 }
 
 
@@ -59,7 +67,6 @@ int mqtt_publish_message(struct mqtt *mqtt, const char *topic,
 {
 	char *message;
 	va_list ap;
-	int ret;
 	int err = 0;
 
 	if (!mqtt || !topic || !fmt)
@@ -72,21 +79,8 @@ int mqtt_publish_message(struct mqtt *mqtt, const char *topic,
 	if (err)
 		return err;
 
-	ret = mosquitto_publish(mqtt->mosq,
-				NULL,
-				topic,
-				(int)str_len(message),
-				message,
-				0,
-				false);
-	if (ret != MOSQ_ERR_SUCCESS) {
-		warning("mqtt: failed to publish (%s)\n",
-			mosquitto_strerror(ret));
-		err = EINVAL;
-		goto out;
-	}
+	err = publish(mqtt, topic, message, str_len(message));
 
- out:
 	mem_deref(message);
 	return err;
 }
@@ -96,15 +90,18 @@ int mqtt_publish_init(struct mqtt *mqtt)
 {
 	int err;
 
-	err = bevent_register(event_handler, mqtt);
+	err = bevent_sub_alloc(&mqtt->sub, BEVENT_SUB_THREAD, EVENT_QLEN,
+			       event_handler, mqtt);
 	if (err)
 		return err;
 
+	bevent_sub_set_opts(mqtt->sub, BEVENT_SUB_OPT_JBSTAT);
+
 	return 0;
 }
 
 
-void mqtt_publish_close(void)
+void mqtt_publish_close(struct mqtt *mqtt)
 {
-	bevent_unregister(&event_handler);
+	mqtt->sub = mem_deref(mqtt->sub);
 }
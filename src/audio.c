@@ -99,6 +99,7 @@ struct autx {
 	int cur_key;                  /**< Currently transmitted event     */
 	enum aufmt src_fmt;           /**< Sample format for audio source  */
 	enum aufmt enc_fmt;           /**< Sample format for encoder       */
+	struct audrift *drift;        /**< Drift compensation (optional)   */
 
 	struct {
 		uint64_t aubuf_overrun;
@@ -108,6 +109,7 @@ struct autx {
 	struct {
 		thrd_t tid;           /**< Audio transmit thread           */
 		RE_ATOMIC bool run;   /**< Audio transmit thread running   */
+		struct txsched_job *job; /**< Shared TX scheduler job      */
 	} thr;
 
 	mtx_t *mtx;
@@ -124,6 +126,7 @@ struct audio {
 	struct audio_recv *aur;       /**< Audio Receiver                  */
 	struct stream *strm;          /**< Generic media stream            */
 	struct telev *telev;          /**< Telephony events                */
+	struct aulat *lat;            /**< Latency trace (optional)        */
 	struct config_audio cfg;      /**< Audio configuration             */
 	bool started;                 /**< Stream is started flag          */
 	bool level_enabled;           /**< Audio level RTP ext. enabled    */
@@ -182,6 +185,8 @@ static void stop_tx(struct autx *tx, struct audio *a)
 		thrd_join(tx->thr.tid, NULL);
 	}
 
+	tx->thr.job = mem_deref(tx->thr.job);
+
 	/* audio source must be stopped first */
 	tx->ausrc = mem_deref(tx->ausrc);
 	tx->aubuf = mem_deref(tx->aubuf);
@@ -204,6 +209,7 @@ static void audio_destructor(void *arg)
 	mem_deref(a->tx.aubuf);
 	mem_deref(a->tx.mb);
 	mem_deref(a->tx.sampv);
+	mem_deref(a->tx.drift);
 	mem_deref(a->tx.module);
 	mem_deref(a->tx.device);
 
@@ -212,6 +218,7 @@ static void audio_destructor(void *arg)
 	mem_deref(a->strm);
 	mem_deref(a->telev);
 	mem_deref(a->aur);
+	mem_deref(a->lat);
 
 	mem_deref(a->tx.mtx);
 }
@@ -294,6 +301,7 @@ static void encode_rtp_send(struct audio *a, struct autx *tx,
 	size_t ext_len = 0;
 	uint32_t ts_delta = 0;
 	bool marker = tx->marker;
+	uint64_t t0 = 0, t1;
 	int err;
 
 	if (!tx->ac || !tx->ac->ench)
@@ -342,6 +350,9 @@ static void encode_rtp_send(struct audio *a, struct autx *tx,
 
 	len = mbuf_get_space(tx->mb);
 
+	if (a->lat)
+		t0 = tmr_jiffies_usec();
+
 	err = tx->ac->ench(tx->enc, &marker, mbuf_buf(tx->mb), &len,
 			   af->fmt, af->sampv, af->sampc);
 
@@ -358,6 +369,12 @@ static void encode_rtp_send(struct audio *a, struct autx *tx,
 		goto out;
 	}
 
+	if (a->lat) {
+		t1 = tmr_jiffies_usec();
+		aulat_add(a->lat, AULAT_TX_ENCODE, t1 - t0);
+		t0 = t1;
+	}
+
 	tx->mb->pos = STREAM_PRESZ;
 	tx->mb->end = STREAM_PRESZ + ext_len + len;
 
@@ -372,6 +389,10 @@ static void encode_rtp_send(struct audio *a, struct autx *tx,
 			mtx_unlock(a->tx.mtx);
 			if (err)
 				goto out;
+
+			if (a->lat)
+				aulat_add(a->lat, AULAT_TX_SEND,
+					  tmr_jiffies_usec() - t0);
 		}
 
 		if (ts_delta) {
@@ -413,6 +434,7 @@ static void poll_aubuf_tx(struct audio *a)
 	struct le *le;
 	uint32_t srate;
 	uint8_t ch;
+	uint64_t t0 = 0;
 	int err = 0;
 
 	mtx_lock(tx->mtx);
@@ -426,10 +448,35 @@ static void poll_aubuf_tx(struct audio *a)
 	srate = tx->ausrc_prm.srate;
 	ch = tx->ausrc_prm.ch;
 
+	/* the frame was buffered while the aubuf filled up */
+	if (a->lat) {
+		uint64_t bpms = (uint64_t)srate * ch * sz / 1000;
+
+		if (bpms)
+			aulat_add(a->lat, AULAT_TX_AUBUF,
+				  aubuf_cur_size(tx->aubuf) * 1000 / bpms);
+	}
+
 	/* timed read from audio-buffer */
 	auframe_init(&af, tx->src_fmt, tx->sampv, sampc, srate, ch);
 	aubuf_read_auframe(tx->aubuf, &af);
 
+	/*
+	 * keep one and a half packet of captured audio ahead of the reader,
+	 * so the aubuf has one packet on average after the read
+	 */
+	if (tx->drift) {
+		uint64_t bps = (uint64_t)srate * ch * sz;
+		uint64_t fill = aubuf_cur_size(tx->aubuf);
+
+		if (bps)
+			audrift_update(tx->drift, fill * 1000000 / bps,
+				       tx->ptime * 1500, tmr_jiffies_usec());
+	}
+
+	if (a->lat)
+		t0 = tmr_jiffies_usec();
+
 	/* Process exactly one audio-frame in list order */
 	for (le = tx->filtl.head; le; le = le->next) {
 		struct aufilt_enc_st *st = le->data;
@@ -437,6 +484,9 @@ static void poll_aubuf_tx(struct audio *a)
 		if (st->af && st->af->ench)
 			err |= st->af->ench(st, &af);
 	}
+
+	if (a->lat)
+		aulat_add(a->lat, AULAT_TX_FILTER, tmr_jiffies_usec() - t0);
 	mtx_unlock(tx->mtx);
 	if (err) {
 		warning("audio: aufilter encode: %m\n", err);
@@ -530,6 +580,7 @@ static void ausrc_read_handler(struct auframe *af, void *arg)
 {
 	struct audio *a = arg;
 	struct autx *tx = &a->tx;
+	struct auframe daf;
 
 	mtx_lock(tx->mtx);
 	enum aufmt fmt = tx->src_fmt;
@@ -548,6 +599,12 @@ static void ausrc_read_handler(struct auframe *af, void *arg)
 	if (muted)
 		auframe_mute(af);
 
+	if (tx->drift) {
+		daf = *af;
+		af  = &daf;
+		(void)audrift_process(tx->drift, af, tmr_jiffies_usec());
+	}
+
 	if (aubuf_cur_size(tx->aubuf) >= tx->aubuf_maxsz) {
 
 		++tx->stats.aubuf_overrun;
@@ -738,6 +795,17 @@ int audio_alloc(struct audio **ap, struct list *streaml,
 	if (err)
 		goto out;
 
+	if (cfg->audio.lattrace) {
+		err = aulat_alloc(&a->lat);
+		if (err)
+			goto out;
+
+		aurecv_set_aulat(a->aur, a->lat);
+		err = stream_set_aulat(a->strm, a->lat);
+		if (err)
+			goto out;
+	}
+
 	if (cfg->avt.rtp_bw.max) {
 		sdp_media_set_lbandwidth(stream_sdpmedia(a->strm),
 					 SDP_BANDWIDTH_AS,
@@ -774,6 +842,12 @@ int audio_alloc(struct audio **ap, struct list *streaml,
 		goto out;
 	}
 
+	if (cfg->audio.txdrift) {
+		err = audrift_alloc(&tx->drift, ptime);
+		if (err)
+			goto out;
+	}
+
 	if (acc && account_autelev_pt(acc))
 		a->cfg.telev_pt = account_autelev_pt(acc);
 
@@ -854,6 +928,47 @@ int audio_enable_level(struct audio *au)
 }
 
 
+/*
+ * Send one packet interval, called exactly once per ptime
+ *
+ * @note This function has REAL-TIME properties
+ */
+static void tx_process(struct audio *a)
+{
+	struct autx *tx = &a->tx;
+
+	if (aubuf_cur_size(tx->aubuf) >= tx->psize) {
+
+		poll_aubuf_tx(a);
+	}
+	else {
+		++tx->stats.aubuf_underrun;
+		mtx_lock(tx->mtx);
+		tx->ts_ext += (tx->ptime * tx->ac->crate / 1000);
+		mtx_unlock(tx->mtx);
+
+		debug("audio: tx aubuf underrun"
+		      " (total %llu)\n", tx->stats.aubuf_underrun);
+	}
+
+	/* Exact timing: send Telephony-Events from here.
+	 * Be aware check_telev sets tx->mtx, so it must released!
+	 */
+	check_telev(a, tx);
+}
+
+
+static void tx_sched_handler(void *arg)
+{
+	struct audio *a = arg;
+
+	if (!re_atomic_rlx(&a->tx.aubuf_started))
+		return;
+
+	tx_process(a);
+}
+
+
 static int tx_thread(void *arg)
 {
 	struct audio *a = arg;
@@ -886,28 +1001,10 @@ static int tx_thread(void *arg)
 			goto loop;
 
 		/* Now is the time to send */
-
-		if (aubuf_cur_size(tx->aubuf) >= tx->psize) {
-
-			poll_aubuf_tx(a);
-		}
-		else {
-			++tx->stats.aubuf_underrun;
-			mtx_lock(tx->mtx);
-			tx->ts_ext += (tx->ptime * tx->ac->crate / 1000);
-			mtx_unlock(tx->mtx);
-
-			debug("audio: thread: tx aubuf underrun"
-			      " (total %llu)\n", tx->stats.aubuf_underrun);
-		}
+		tx_process(a);
 
 		ts += tx->ptime;
 
-		/* Exact timing: send Telephony-Events from here.
-		 * Be aware check_telev sets tx->mtx, so it must released!
-		 */
-		check_telev(a, tx);
-
 loop:
 		mtx_lock(tx->mtx);
 	}
@@ -1109,7 +1206,17 @@ static int start_source(struct autx *tx, struct audio *a, struct list *ausrcl)
 		mtx_unlock(tx->mtx);
 		tx->as = ausrc_find(ausrcl, tx->module);
 
-		if (!re_atomic_rlx(&tx->thr.run)) {
+		if (a->cfg.txmode == AUDIO_TX_POOL) {
+			if (!tx->thr.job) {
+				err = txsched_job_alloc(&tx->thr.job,
+							a->cfg.txpool,
+							tx->ptime,
+							tx_sched_handler, a);
+				if (err)
+					return err;
+			}
+		}
+		else if (!re_atomic_rlx(&tx->thr.run)) {
 			re_atomic_rlx_set(&tx->thr.run, true);
 			err = thread_create_name(&tx->thr.tid,
 						 "Audio TX",
@@ -1363,8 +1470,10 @@ int audio_encoder_set(struct audio *a, const struct aucodec *ac,
 	telev_set_srate(a->telev, ac->crate);
 
 	/* use a codec-specific ptime */
-	if (ac->ptime)
+	if (ac->ptime) {
 		tx->ptime = ac->ptime;
+		txsched_job_set_period(tx->thr.job, tx->ptime);
+	}
 
 	return err;
 }
@@ -1566,6 +1675,7 @@ void audio_sdp_attr_decode(struct audio *a)
 			     a->tx.ptime, ptime_tx);
 
 			tx->ptime = ptime_tx;
+			txsched_job_set_period(tx->thr.job, ptime_tx);
 
 			if (tx->ac) {
 				size_t sz;
@@ -1671,12 +1781,17 @@ int audio_debug(struct re_printf *pf, const struct audio *a)
 				     tx->ausrc_prm.ch),
 			  tx->stats.aubuf_overrun,
 			  tx->stats.aubuf_underrun);
+	if (tx->drift)
+		err |= re_hprintf(pf, "       drift: %d ppm\n",
+				  audrift_ppm(tx->drift));
 	err |= re_hprintf(pf, "       source: %s,%s %s\n",
 			  tx->as ? tx->as->name : "none",
 			  tx->device,
 			  aufmt_name(tx->src_fmt));
 	err |= re_hprintf(pf, "       time = %.3f sec\n",
 			  autx_calc_seconds(tx));
+	if (tx->thr.job)
+		err |= re_hprintf(pf, "       %H", txsched_debug, NULL);
 
 	err |= aurecv_debug(pf, a->aur);
 	err |= re_hprintf(pf,
@@ -1691,6 +1806,40 @@ int audio_debug(struct re_printf *pf, const struct audio *a)
 }
 
 
+/**
+ * Print the per-stage latency trace of the audio pipeline
+ *
+ * @param pf Print handler
+ * @param a  Audio object
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int audio_latency_debug(struct re_printf *pf, const struct audio *a)
+{
+	if (!a)
+		return 0;
+
+	return aulat_debug(pf, a->lat);
+}
+
+
+/**
+ * Encode the per-stage latency trace of the audio pipeline
+ *
+ * @param od Dictionary to encode into
+ * @param a  Audio object
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int audio_latency_encode(struct odict *od, const struct audio *a)
+{
+	if (!a || !a->lat)
+		return 0;
+
+	return aulat_odict_encode(od, a->lat);
+}
+
+
 /**
  * Set the audio source and player device name. This function does not
  * change the state of the audio source/player.
@@ -0,0 +1,285 @@
+/**
+ * @file src/audrift.c  Audio clock drift compensation
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <re_atomic.h>
+#include <rem.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/**
+ * \page AudioDrift Audio clock drift compensation
+ *
+ * The audio source is clocked by the sound card, and the transmitter is
+ * clocked by the system timer (once per ptime). The two clocks drift
+ * apart by up to a few hundred ppm, and without compensation the TX aubuf
+ * slowly fills up (overrun) or runs empty (underrun).
+ *
+ * The reader measures the fill level of the aubuf after every read, and
+ * a PI controller computes a tiny resampling ratio correction which keeps
+ * the smoothed fill level at the target. The writer resamples every
+ * source frame by this ratio with linear interpolation, so the audio
+ * stays continuous instead of losing or padding whole frames.
+ *
+ * The aubuf is written in whole source frames, so its fill level alone
+ * does not show the phase between the two clocks. The time since the
+ * last write is added, which is the audio captured by the source but
+ * not yet written to the aubuf.
+ *
+ * The correction is in ppm, where 1 ppm changes the fill level by 1 us
+ * per second. The integral term converges on the actual clock drift.
+ *
+ * Only S16LE and FLOAT sample formats are resampled, other formats are
+ * passed through unmodified.
+ */
+
+
+enum {
+	DRIFT_PPM_MAX = 1000,  /**< Max. ratio correction [ppm]        */
+	DRIFT_EMA     = 16,    /**< Fill level EMA coefficient         */
+	DRIFT_CH_MAX  = 8,     /**< Max. number of channels            */
+};
+
+#define DRIFT_KP 0.1      /* Proportional gain [ppm/us]            */
+#define DRIFT_KI 0.0025   /* Integral gain [ppm/us/s]              */
+
+
+/** Audio clock drift compensation */
+struct audrift {
+	/* Controller, used by the reader */
+	uint32_t ptime;                /**< Update interval [ms]           */
+	double ema;                    /**< Smoothed fill level [us]       */
+	double integ;                  /**< Integral term [ppm]            */
+	bool ema_set;                  /**< Fill level EMA is set          */
+	RE_ATOMIC int32_t ppm;         /**< Ratio correction [ppm]         */
+	RE_ATOMIC uint64_t t_write;    /**< Time of the last write [us]    */
+
+	/* Resampler, used by the writer */
+	double pos;                    /**< Position of next output sample */
+	double histv[DRIFT_CH_MAX];    /**< Last input sample per channel  */
+	void *buf;                     /**< Output sample buffer           */
+	size_t bufsz;                  /**< Output buffer size [bytes]     */
+};
+
+
+static void destructor(void *arg)
+{
+	struct audrift *ad = arg;
+
+	mem_deref(ad->buf);
+}
+
+
+/**
+ * Allocate an audio clock drift compensation state
+ *
+ * @param adp   Pointer to allocated state
+ * @param ptime Interval of the fill level updates in [ms]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int audrift_alloc(struct audrift **adp, uint32_t ptime)
+{
+	struct audrift *ad;
+
+	if (!adp || !ptime)
+		return EINVAL;
+
+	ad = mem_zalloc(sizeof(*ad), destructor);
+	if (!ad)
+		return ENOMEM;
+
+	ad->ptime = ptime;
+
+	*adp = ad;
+
+	return 0;
+}
+
+
+static double clamp_ppm(double ppm)
+{
+	if (ppm > DRIFT_PPM_MAX)
+		return DRIFT_PPM_MAX;
+	else if (ppm < -DRIFT_PPM_MAX)
+		return -DRIFT_PPM_MAX;
+
+	return ppm;
+}
+
+
+/**
+ * Update the ratio correction from the buffer fill level
+ *
+ * @param ad        Audio clock drift compensation state
+ * @param fill_us   Buffer fill level after a read in [us]
+ * @param target_us Target fill level in [us]
+ * @param now       Current time in [us]
+ *
+ * @note Must be called once per ptime, from the reader thread
+ */
+void audrift_update(struct audrift *ad, uint64_t fill_us, uint64_t target_us,
+		    uint64_t now)
+{
+	uint64_t t_write;
+	double e, ppm;
+
+	if (!ad)
+		return;
+
+	t_write = re_atomic_rlx(&ad->t_write);
+	if (!t_write)
+		return;
+
+	if (now > t_write)
+		fill_us += now - t_write;
+
+	if (!ad->ema_set) {
+		ad->ema     = (double)fill_us;
+		ad->ema_set = true;
+	}
+	else {
+		ad->ema += ((double)fill_us - ad->ema) / DRIFT_EMA;
+	}
+
+	e = ad->ema - (double)target_us;
+
+	ad->integ = clamp_ppm(ad->integ + e * DRIFT_KI * ad->ptime / 1000);
+
+	ppm = clamp_ppm(ad->integ + e * DRIFT_KP);
+
+	re_atomic_rlx_set(&ad->ppm, (int32_t)ppm);
+}
+
+
+static size_t resample_s16(struct audrift *ad, int16_t *y, const int16_t *x,
+			   size_t n, size_t ch, double step)
+{
+	size_t j;
+
+	for (j = 0; ad->pos < (double)n; j++, ad->pos += step) {
+
+		size_t l = (size_t)ad->pos;
+		double f = ad->pos - (double)l;
+
+		for (size_t c = 0; c < ch; c++) {
+			double a = l ? x[(l-1)*ch + c] : ad->histv[c];
+			double b = x[l*ch + c];
+
+			y[j*ch + c] = (int16_t)(a + (b - a) * f);
+		}
+	}
+
+	for (size_t c = 0; c < ch; c++)
+		ad->histv[c] = x[(n-1)*ch + c];
+
+	return j;
+}
+
+
+static size_t resample_float(struct audrift *ad, float *y, const float *x,
+			     size_t n, size_t ch, double step)
+{
+	size_t j;
+
+	for (j = 0; ad->pos < (double)n; j++, ad->pos += step) {
+
+		size_t l = (size_t)ad->pos;
+		double f = ad->pos - (double)l;
+
+		for (size_t c = 0; c < ch; c++) {
+			double a = l ? x[(l-1)*ch + c] : ad->histv[c];
+			double b = x[l*ch + c];
+
+			y[j*ch + c] = (float)(a + (b - a) * f);
+		}
+	}
+
+	for (size_t c = 0; c < ch; c++)
+		ad->histv[c] = x[(n-1)*ch + c];
+
+	return j;
+}
+
+
+/**
+ * Resample one audio frame by the current ratio correction
+ *
+ * The sample buffer of the frame is replaced by an internal buffer,
+ * which is valid until the next call. The output is delayed by one
+ * sample, and has one sample more or less than the input now and then.
+ *
+ * @param ad  Audio clock drift compensation state
+ * @param af  Audio frame
+ * @param now Current time in [us]
+ *
+ * @return 0 if success, otherwise errorcode
+ *
+ * @note Must be called from the writer thread
+ */
+int audrift_process(struct audrift *ad, struct auframe *af, uint64_t now)
+{
+	size_t n, ch, sz, maxc;
+	double step;
+
+	if (!ad || !af)
+		return EINVAL;
+
+	re_atomic_rlx_set(&ad->t_write, now);
+
+	if (af->fmt != AUFMT_S16LE && af->fmt != AUFMT_FLOAT)
+		return 0;
+
+	if (!af->ch || af->ch > DRIFT_CH_MAX || !af->sampv)
+		return 0;
+
+	ch = af->ch;
+	n  = af->sampc / ch;
+	if (!n)
+		return 0;
+
+	sz   = aufmt_sample_size(af->fmt);
+	maxc = (n + n / 500 + 2) * ch;
+
+	if (ad->bufsz < maxc * sz) {
+
+		mem_deref(ad->buf);
+
+		ad->bufsz = maxc * sz;
+		ad->buf   = mem_zalloc(ad->bufsz, NULL);
+		if (!ad->buf) {
+			ad->bufsz = 0;
+			return ENOMEM;
+		}
+	}
+
+	step = 1.0 + re_atomic_rlx(&ad->ppm) / 1e6;
+
+	if (af->fmt == AUFMT_S16LE)
+		n = resample_s16(ad, ad->buf, af->sampv, n, ch, step);
+	else
+		n = resample_float(ad, ad->buf, af->sampv, n, ch, step);
+
+	ad->pos  -= (double)(af->sampc / ch);
+	af->sampv = ad->buf;
+	af->sampc = n * ch;
+
+	return 0;
+}
+
+
+/**
+ * Get the current ratio correction
+ *
+ * @param ad Audio clock drift compensation state
+ *
+ * @return Ratio correction in [ppm], positive if the source is faster
+ */
+int32_t audrift_ppm(const struct audrift *ad)
+{
+	return ad ? re_atomic_rlx(&ad->ppm) : 0;
+}
@@ -0,0 +1,1272 @@
+/**
+ * @file audsp.c  Audio DSP kernels
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <math.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "core.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+
+/**
+ * \page AuDsp Audio DSP kernels
+ *
+ * Sample format conversion (S16, S32 and FLOAT), saturating add, gain and
+ * fade ramps for audio frames.
+ *
+ * Every kernel has a scalar reference implementation, and vectorized
+ * versions for SSE2, AVX2 and NEON. The best instruction set supported by
+ * the CPU is selected at runtime by audsp_init().
+ *
+ * All versions give bit-exact results: floating point operations are done
+ * in the same order in all versions (this file is compiled without FMA
+ * contraction), and the clamp is written like the MAXPS/MINPS instructions.
+ * The sample format conversion from FLOAT clamps first and then rounds to
+ * the nearest integer, like auconv_to_s16() in libre. Gain and fade of S16
+ * samples truncate, like the loops they replaced.
+ */
+
+
+#define S16_SCALE (1.0f / 32768.0f)
+#define S32_SCALE (1.0f / 2147483648.0f)
+#define S32_FMAX  2147483520.0f    /* largest float below 2^31 */
+
+#define LOADU(p)     _mm_loadu_si128((const __m128i *)(const void *)(p))
+#define STOREU(p, v) _mm_storeu_si128((__m128i *)(void *)(p), (v))
+
+
+struct kernels {
+	enum audsp_isa isa;
+	void (*s16_to_float)(float *dst, const int16_t *src, size_t n);
+	void (*float_to_s16)(int16_t *dst, const float *src, size_t n);
+	void (*s16_to_s32)(int32_t *dst, const int16_t *src, size_t n);
+	void (*s32_to_s16)(int16_t *dst, const int32_t *src, size_t n);
+	void (*s32_to_float)(float *dst, const int32_t *src, size_t n);
+	void (*float_to_s32)(int32_t *dst, const float *src, size_t n);
+	void (*add_s16)(int16_t *dst, const int16_t *src, size_t n);
+	void (*add_float)(float *dst, const float *src, size_t n);
+	void (*gain_s16)(int16_t *v, size_t n, float gain);
+	void (*gain_float)(float *v, size_t n, float gain);
+	void (*fade_s16)(int16_t *v, size_t n, float gain, float step,
+			 float lim);
+	void (*fade_float)(float *v, size_t n, float gain, float step,
+			   float lim);
+};
+
+
+/*
+ * Scalar reference kernels
+ */
+
+
+/* same result as MINPS(MAXPS(x, lo), hi) */
+static inline float clampf(float x, float lo, float hi)
+{
+	x = x > lo ? x : lo;
+	return x < hi ? x : hi;
+}
+
+
+static inline float ramp(float gain, float step, float lim, size_t i)
+{
+	float g = gain + (float)i * step;
+
+	if (step < 0)
+		return g > lim ? g : lim;
+	else
+		return g < lim ? g : lim;
+}
+
+
+static void s16_to_float_c(float *dst, const int16_t *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = (float)src[i] * S16_SCALE;
+}
+
+
+static void float_to_s16_c(int16_t *dst, const float *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		float x = clampf(src[i] * 32768.0f, -32768.0f, 32767.0f);
+		dst[i] = (int16_t)lrintf(x);
+	}
+}
+
+
+static void s16_to_s32_c(int32_t *dst, const int16_t *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = (int32_t)src[i] * 65536;
+}
+
+
+static void s32_to_s16_c(int16_t *dst, const int32_t *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = (int16_t)(src[i] >> 16);
+}
+
+
+static void s32_to_float_c(float *dst, const int32_t *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = (float)src[i] * S32_SCALE;
+}
+
+
+static void float_to_s32_c(int32_t *dst, const float *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		float x = clampf(src[i] * 2147483648.0f,
+				 -2147483648.0f, S32_FMAX);
+		dst[i] = (int32_t)lrintf(x);
+	}
+}
+
+
+static void add_s16_c(int16_t *dst, const int16_t *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		int32_t s = (int32_t)dst[i] + src[i];
+
+		if (s > 32767)
+			s = 32767;
+		else if (s < -32768)
+			s = -32768;
+
+		dst[i] = (int16_t)s;
+	}
+}
+
+
+static void add_float_c(float *dst, const float *src, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] += src[i];
+}
+
+
+static void gain_s16_c(int16_t *v, size_t n, float gain)
+{
+	for (size_t i = 0; i < n; i++) {
+		float x = clampf((float)v[i] * gain, -32768.0f, 32767.0f);
+		v[i] = (int16_t)x;
+	}
+}
+
+
+static void gain_float_c(float *v, size_t n, float gain)
+{
+	for (size_t i = 0; i < n; i++)
+		v[i] *= gain;
+}
+
+
+static void fade_s16_tail(int16_t *v, size_t i, size_t n, float gain,
+			  float step, float lim)
+{
+	for (; i < n; i++) {
+		float g = ramp(gain, step, lim, i);
+		float x = clampf((float)v[i] * g, -32768.0f, 32767.0f);
+		v[i] = (int16_t)x;
+	}
+}
+
+
+static void fade_float_tail(float *v, size_t i, size_t n, float gain,
+			    float step, float lim)
+{
+	for (; i < n; i++)
+		v[i] *= ramp(gain, step, lim, i);
+}
+
+
+static void fade_s16_c(int16_t *v, size_t n, float gain, float step,
+		       float lim)
+{
+	fade_s16_tail(v, 0, n, gain, step, lim);
+}
+
+
+static void fade_float_c(float *v, size_t n, float gain, float step,
+			 float lim)
+{
+	fade_float_tail(v, 0, n, gain, step, lim);
+}
+
+
+static const struct kernels kern_c = {
+	AUDSP_SCALAR,
+	s16_to_float_c, float_to_s16_c,
+	s16_to_s32_c, s32_to_s16_c,
+	s32_to_float_c, float_to_s32_c,
+	add_s16_c, add_float_c,
+	gain_s16_c, gain_float_c,
+	fade_s16_c, fade_float_c,
+};
+
+
+/*
+ * SSE2 kernels
+ */
+
+#ifdef HAVE_SSE2
+
+static inline __m128i sse2_s16_lo(__m128i v)
+{
+	return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+
+static inline __m128i sse2_s16_hi(__m128i v)
+{
+	return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+}
+
+
+static inline __m128 sse2_clamp(__m128 x, __m128 lo, __m128 hi)
+{
+	return _mm_min_ps(_mm_max_ps(x, lo), hi);
+}
+
+
+static inline __m128 sse2_limit(__m128 g, __m128 lim, bool down)
+{
+	return down ? _mm_max_ps(g, lim) : _mm_min_ps(g, lim);
+}
+
+
+static void s16_to_float_sse2(float *dst, const int16_t *src, size_t n)
+{
+	const __m128 k = _mm_set1_ps(S16_SCALE);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i v = LOADU(&src[i]);
+
+		_mm_storeu_ps(&dst[i],
+			      _mm_mul_ps(_mm_cvtepi32_ps(sse2_s16_lo(v)), k));
+		_mm_storeu_ps(&dst[i + 4],
+			      _mm_mul_ps(_mm_cvtepi32_ps(sse2_s16_hi(v)), k));
+	}
+
+	s16_to_float_c(&dst[i], &src[i], n - i);
+}
+
+
+static void float_to_s16_sse2(int16_t *dst, const float *src, size_t n)
+{
+	const __m128 k  = _mm_set1_ps(32768.0f);
+	const __m128 lo = _mm_set1_ps(-32768.0f);
+	const __m128 hi = _mm_set1_ps(32767.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(&src[i]), k);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(&src[i + 4]), k);
+
+		a = sse2_clamp(a, lo, hi);
+		b = sse2_clamp(b, lo, hi);
+
+		STOREU(&dst[i], _mm_packs_epi32(_mm_cvtps_epi32(a),
+						_mm_cvtps_epi32(b)));
+	}
+
+	float_to_s16_c(&dst[i], &src[i], n - i);
+}
+
+
+static void s16_to_s32_sse2(int32_t *dst, const int16_t *src, size_t n)
+{
+	const __m128i z = _mm_setzero_si128();
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i v = LOADU(&src[i]);
+
+		STOREU(&dst[i],     _mm_unpacklo_epi16(z, v));
+		STOREU(&dst[i + 4], _mm_unpackhi_epi16(z, v));
+	}
+
+	s16_to_s32_c(&dst[i], &src[i], n - i);
+}
+
+
+static void s32_to_s16_sse2(int16_t *dst, const int32_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i a = _mm_srai_epi32(LOADU(&src[i]), 16);
+		__m128i b = _mm_srai_epi32(LOADU(&src[i + 4]), 16);
+
+		STOREU(&dst[i], _mm_packs_epi32(a, b));
+	}
+
+	s32_to_s16_c(&dst[i], &src[i], n - i);
+}
+
+
+static void s32_to_float_sse2(float *dst, const int32_t *src, size_t n)
+{
+	const __m128 k = _mm_set1_ps(S32_SCALE);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_cvtepi32_ps(LOADU(&src[i]));
+
+		_mm_storeu_ps(&dst[i], _mm_mul_ps(x, k));
+	}
+
+	s32_to_float_c(&dst[i], &src[i], n - i);
+}
+
+
+static void float_to_s32_sse2(int32_t *dst, const float *src, size_t n)
+{
+	const __m128 k  = _mm_set1_ps(2147483648.0f);
+	const __m128 lo = _mm_set1_ps(-2147483648.0f);
+	const __m128 hi = _mm_set1_ps(S32_FMAX);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(&src[i]), k);
+
+		STOREU(&dst[i], _mm_cvtps_epi32(sse2_clamp(x, lo, hi)));
+	}
+
+	float_to_s32_c(&dst[i], &src[i], n - i);
+}
+
+
+static void add_s16_sse2(int16_t *dst, const int16_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8)
+		STOREU(&dst[i], _mm_adds_epi16(LOADU(&dst[i]),
+					       LOADU(&src[i])));
+
+	add_s16_c(&dst[i], &src[i], n - i);
+}
+
+
+static void add_float_sse2(float *dst, const float *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(&dst[i], _mm_add_ps(_mm_loadu_ps(&dst[i]),
+						  _mm_loadu_ps(&src[i])));
+
+	add_float_c(&dst[i], &src[i], n - i);
+}
+
+
+static void gain_s16_sse2(int16_t *v, size_t n, float gain)
+{
+	const __m128 g  = _mm_set1_ps(gain);
+	const __m128 lo = _mm_set1_ps(-32768.0f);
+	const __m128 hi = _mm_set1_ps(32767.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i x = LOADU(&v[i]);
+		__m128 a = _mm_mul_ps(_mm_cvtepi32_ps(sse2_s16_lo(x)), g);
+		__m128 b = _mm_mul_ps(_mm_cvtepi32_ps(sse2_s16_hi(x)), g);
+
+		a = sse2_clamp(a, lo, hi);
+		b = sse2_clamp(b, lo, hi);
+
+		STOREU(&v[i], _mm_packs_epi32(_mm_cvttps_epi32(a),
+					      _mm_cvttps_epi32(b)));
+	}
+
+	gain_s16_c(&v[i], n - i, gain);
+}
+
+
+static void gain_float_sse2(float *v, size_t n, float gain)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(&v[i], _mm_mul_ps(_mm_loadu_ps(&v[i]), g));
+
+	gain_float_c(&v[i], n - i, gain);
+}
+
+
+static void fade_s16_sse2(int16_t *v, size_t n, float gain, float step,
+			  float lim)
+{
+	const __m128 g0   = _mm_set1_ps(gain);
+	const __m128 st   = _mm_set1_ps(step);
+	const __m128 l    = _mm_set1_ps(lim);
+	const __m128 four = _mm_set1_ps(4.0f);
+	const __m128 lo   = _mm_set1_ps(-32768.0f);
+	const __m128 hi   = _mm_set1_ps(32767.0f);
+	const bool down   = step < 0;
+	__m128 idx = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i x = LOADU(&v[i]);
+		__m128 ga, gb, a, b;
+
+		ga  = sse2_limit(_mm_add_ps(g0, _mm_mul_ps(idx, st)), l, down);
+		idx = _mm_add_ps(idx, four);
+		gb  = sse2_limit(_mm_add_ps(g0, _mm_mul_ps(idx, st)), l, down);
+		idx = _mm_add_ps(idx, four);
+
+		a = _mm_mul_ps(_mm_cvtepi32_ps(sse2_s16_lo(x)), ga);
+		b = _mm_mul_ps(_mm_cvtepi32_ps(sse2_s16_hi(x)), gb);
+
+		a = sse2_clamp(a, lo, hi);
+		b = sse2_clamp(b, lo, hi);
+
+		STOREU(&v[i], _mm_packs_epi32(_mm_cvttps_epi32(a),
+					      _mm_cvttps_epi32(b)));
+	}
+
+	fade_s16_tail(v, i, n, gain, step, lim);
+}
+
+
+static void fade_float_sse2(float *v, size_t n, float gain, float step,
+			    float lim)
+{
+	const __m128 g0   = _mm_set1_ps(gain);
+	const __m128 st   = _mm_set1_ps(step);
+	const __m128 l    = _mm_set1_ps(lim);
+	const __m128 four = _mm_set1_ps(4.0f);
+	const bool down   = step < 0;
+	__m128 idx = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 g = _mm_add_ps(g0, _mm_mul_ps(idx, st));
+
+		g   = sse2_limit(g, l, down);
+		idx = _mm_add_ps(idx, four);
+
+		_mm_storeu_ps(&v[i], _mm_mul_ps(_mm_loadu_ps(&v[i]), g));
+	}
+
+	fade_float_tail(v, i, n, gain, step, lim);
+}
+
+
+static const struct kernels kern_sse2 = {
+	AUDSP_SSE2,
+	s16_to_float_sse2, float_to_s16_sse2,
+	s16_to_s32_sse2, s32_to_s16_sse2,
+	s32_to_float_sse2, float_to_s32_sse2,
+	add_s16_sse2, add_float_sse2,
+	gain_s16_sse2, gain_float_sse2,
+	fade_s16_sse2, fade_float_sse2,
+};
+
+#endif /* HAVE_SSE2 */
+
+
+/*
+ * AVX2 kernels, only for the 16-bit kernels where the wider registers
+ * pay off. The other entries use the SSE2 kernels.
+ */
+
+#ifdef HAVE_AVX2
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+#define LOADU256(p) \
+	_mm256_loadu_si256((const __m256i *)(const void *)(p))
+#define STOREU256(p, v) \
+	_mm256_storeu_si256((__m256i *)(void *)(p), (v))
+
+
+/* pack 2x8 int32 to 16 int16 in the original order */
+static inline TARGET_AVX2 __m256i avx2_pack32(__m256i a, __m256i b)
+{
+	return _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+}
+
+
+/* truncate and pack */
+static inline TARGET_AVX2 __m256i avx2_pack(__m256 a, __m256 b)
+{
+	return avx2_pack32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+}
+
+
+static inline TARGET_AVX2 __m256 avx2_s16(const int16_t *p)
+{
+	return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(LOADU(p)));
+}
+
+
+static inline TARGET_AVX2 __m256 avx2_clamp(__m256 x, __m256 lo, __m256 hi)
+{
+	return _mm256_min_ps(_mm256_max_ps(x, lo), hi);
+}
+
+
+static TARGET_AVX2 void s16_to_float_avx2(float *dst, const int16_t *src,
+					  size_t n)
+{
+	const __m256 k = _mm256_set1_ps(S16_SCALE);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_ps(&dst[i], _mm256_mul_ps(avx2_s16(&src[i]), k));
+
+	s16_to_float_c(&dst[i], &src[i], n - i);
+}
+
+
+static TARGET_AVX2 void float_to_s16_avx2(int16_t *dst, const float *src,
+					  size_t n)
+{
+	const __m256 k  = _mm256_set1_ps(32768.0f);
+	const __m256 lo = _mm256_set1_ps(-32768.0f);
+	const __m256 hi = _mm256_set1_ps(32767.0f);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m256 a = _mm256_mul_ps(_mm256_loadu_ps(&src[i]), k);
+		__m256 b = _mm256_mul_ps(_mm256_loadu_ps(&src[i + 8]), k);
+
+		a = avx2_clamp(a, lo, hi);
+		b = avx2_clamp(b, lo, hi);
+
+		STOREU256(&dst[i], avx2_pack32(_mm256_cvtps_epi32(a),
+					       _mm256_cvtps_epi32(b)));
+	}
+
+	float_to_s16_c(&dst[i], &src[i], n - i);
+}
+
+
+static TARGET_AVX2 void add_s16_avx2(int16_t *dst, const int16_t *src,
+				     size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+		STOREU256(&dst[i], _mm256_adds_epi16(LOADU256(&dst[i]),
+						     LOADU256(&src[i])));
+
+	add_s16_c(&dst[i], &src[i], n - i);
+}
+
+
+static TARGET_AVX2 void gain_s16_avx2(int16_t *v, size_t n, float gain)
+{
+	const __m256 g  = _mm256_set1_ps(gain);
+	const __m256 lo = _mm256_set1_ps(-32768.0f);
+	const __m256 hi = _mm256_set1_ps(32767.0f);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m256 a = _mm256_mul_ps(avx2_s16(&v[i]), g);
+		__m256 b = _mm256_mul_ps(avx2_s16(&v[i + 8]), g);
+
+		STOREU256(&v[i], avx2_pack(avx2_clamp(a, lo, hi),
+					   avx2_clamp(b, lo, hi)));
+	}
+
+	gain_s16_c(&v[i], n - i, gain);
+}
+
+
+static TARGET_AVX2 void fade_s16_avx2(int16_t *v, size_t n, float gain,
+				      float step, float lim)
+{
+	const __m256 g0    = _mm256_set1_ps(gain);
+	const __m256 st    = _mm256_set1_ps(step);
+	const __m256 l     = _mm256_set1_ps(lim);
+	const __m256 eight = _mm256_set1_ps(8.0f);
+	const __m256 lo    = _mm256_set1_ps(-32768.0f);
+	const __m256 hi    = _mm256_set1_ps(32767.0f);
+	const bool down    = step < 0;
+	__m256 idx = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f,
+				    4.0f, 5.0f, 6.0f, 7.0f);
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m256 ga, gb, a, b;
+
+		ga  = _mm256_add_ps(g0, _mm256_mul_ps(idx, st));
+		idx = _mm256_add_ps(idx, eight);
+		gb  = _mm256_add_ps(g0, _mm256_mul_ps(idx, st));
+		idx = _mm256_add_ps(idx, eight);
+
+		ga = down ? _mm256_max_ps(ga, l) : _mm256_min_ps(ga, l);
+		gb = down ? _mm256_max_ps(gb, l) : _mm256_min_ps(gb, l);
+
+		a = _mm256_mul_ps(avx2_s16(&v[i]), ga);
+		b = _mm256_mul_ps(avx2_s16(&v[i + 8]), gb);
+
+		STOREU256(&v[i], avx2_pack(avx2_clamp(a, lo, hi),
+					   avx2_clamp(b, lo, hi)));
+	}
+
+	fade_s16_tail(v, i, n, gain, step, lim);
+}
+
+
+static const struct kernels kern_avx2 = {
+	AUDSP_AVX2,
+	s16_to_float_avx2, float_to_s16_avx2,
+	s16_to_s32_sse2, s32_to_s16_sse2,
+	s32_to_float_sse2, float_to_s32_sse2,
+	add_s16_avx2, add_float_sse2,
+	gain_s16_avx2, gain_float_sse2,
+	fade_s16_avx2, fade_float_sse2,
+};
+
+#endif /* HAVE_AVX2 */
+
+
+/*
+ * NEON kernels (AArch64)
+ */
+
+#ifdef HAVE_NEON
+
+static inline float32x4_t neon_clamp(float32x4_t x, float32x4_t lo,
+				     float32x4_t hi)
+{
+	return vminq_f32(vmaxq_f32(x, lo), hi);
+}
+
+
+static inline float32x4_t neon_limit(float32x4_t g, float32x4_t lim,
+				     bool down)
+{
+	return down ? vmaxq_f32(g, lim) : vminq_f32(g, lim);
+}
+
+
+/* truncate and pack */
+static inline int16x8_t neon_pack(float32x4_t a, float32x4_t b)
+{
+	return vcombine_s16(vqmovn_s32(vcvtq_s32_f32(a)),
+			    vqmovn_s32(vcvtq_s32_f32(b)));
+}
+
+
+/* round to nearest and pack */
+static inline int16x8_t neon_pack_rn(float32x4_t a, float32x4_t b)
+{
+	return vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)),
+			    vqmovn_s32(vcvtnq_s32_f32(b)));
+}
+
+
+static void s16_to_float_neon(float *dst, const int16_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t v = vld1q_s16(&src[i]);
+		float32x4_t a = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+		float32x4_t b = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+
+		vst1q_f32(&dst[i],     vmulq_n_f32(a, S16_SCALE));
+		vst1q_f32(&dst[i + 4], vmulq_n_f32(b, S16_SCALE));
+	}
+
+	s16_to_float_c(&dst[i], &src[i], n - i);
+}
+
+
+static void float_to_s16_neon(int16_t *dst, const float *src, size_t n)
+{
+	const float32x4_t lo = vdupq_n_f32(-32768.0f);
+	const float32x4_t hi = vdupq_n_f32(32767.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		float32x4_t a = vmulq_n_f32(vld1q_f32(&src[i]), 32768.0f);
+		float32x4_t b = vmulq_n_f32(vld1q_f32(&src[i + 4]), 32768.0f);
+
+		vst1q_s16(&dst[i], neon_pack_rn(neon_clamp(a, lo, hi),
+						neon_clamp(b, lo, hi)));
+	}
+
+	float_to_s16_c(&dst[i], &src[i], n - i);
+}
+
+
+static void s16_to_s32_neon(int32_t *dst, const int16_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t v = vld1q_s16(&src[i]);
+
+		vst1q_s32(&dst[i],     vshll_n_s16(vget_low_s16(v), 16));
+		vst1q_s32(&dst[i + 4], vshll_n_s16(vget_high_s16(v), 16));
+	}
+
+	s16_to_s32_c(&dst[i], &src[i], n - i);
+}
+
+
+static void s32_to_s16_neon(int16_t *dst, const int32_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		int16x4_t a = vshrn_n_s32(vld1q_s32(&src[i]), 16);
+		int16x4_t b = vshrn_n_s32(vld1q_s32(&src[i + 4]), 16);
+
+		vst1q_s16(&dst[i], vcombine_s16(a, b));
+	}
+
+	s32_to_s16_c(&dst[i], &src[i], n - i);
+}
+
+
+static void s32_to_float_neon(float *dst, const int32_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t x = vcvtq_f32_s32(vld1q_s32(&src[i]));
+
+		vst1q_f32(&dst[i], vmulq_n_f32(x, S32_SCALE));
+	}
+
+	s32_to_float_c(&dst[i], &src[i], n - i);
+}
+
+
+static void float_to_s32_neon(int32_t *dst, const float *src, size_t n)
+{
+	const float32x4_t lo = vdupq_n_f32(-2147483648.0f);
+	const float32x4_t hi = vdupq_n_f32(S32_FMAX);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t x = vmulq_n_f32(vld1q_f32(&src[i]),
+					    2147483648.0f);
+
+		vst1q_s32(&dst[i], vcvtnq_s32_f32(neon_clamp(x, lo, hi)));
+	}
+
+	float_to_s32_c(&dst[i], &src[i], n - i);
+}
+
+
+static void add_s16_neon(int16_t *dst, const int16_t *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8)
+		vst1q_s16(&dst[i], vqaddq_s16(vld1q_s16(&dst[i]),
+					      vld1q_s16(&src[i])));
+
+	add_s16_c(&dst[i], &src[i], n - i);
+}
+
+
+static void add_float_neon(float *dst, const float *src, size_t n)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(&dst[i], vaddq_f32(vld1q_f32(&dst[i]),
+					     vld1q_f32(&src[i])));
+
+	add_float_c(&dst[i], &src[i], n - i);
+}
+
+
+static void gain_s16_neon(int16_t *v, size_t n, float gain)
+{
+	const float32x4_t lo = vdupq_n_f32(-32768.0f);
+	const float32x4_t hi = vdupq_n_f32(32767.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t x = vld1q_s16(&v[i]);
+		float32x4_t a = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+		float32x4_t b = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+
+		a = neon_clamp(vmulq_n_f32(a, gain), lo, hi);
+		b = neon_clamp(vmulq_n_f32(b, gain), lo, hi);
+
+		vst1q_s16(&v[i], neon_pack(a, b));
+	}
+
+	gain_s16_c(&v[i], n - i, gain);
+}
+
+
+static void gain_float_neon(float *v, size_t n, float gain)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4)
+		vst1q_f32(&v[i], vmulq_n_f32(vld1q_f32(&v[i]), gain));
+
+	gain_float_c(&v[i], n - i, gain);
+}
+
+
+static void fade_s16_neon(int16_t *v, size_t n, float gain, float step,
+			  float lim)
+{
+	static const float idx0[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+	const float32x4_t g0   = vdupq_n_f32(gain);
+	const float32x4_t st   = vdupq_n_f32(step);
+	const float32x4_t l    = vdupq_n_f32(lim);
+	const float32x4_t four = vdupq_n_f32(4.0f);
+	const float32x4_t lo   = vdupq_n_f32(-32768.0f);
+	const float32x4_t hi   = vdupq_n_f32(32767.0f);
+	const bool down        = step < 0;
+	float32x4_t idx = vld1q_f32(idx0);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t x = vld1q_s16(&v[i]);
+		float32x4_t ga, gb, a, b;
+
+		ga  = neon_limit(vaddq_f32(g0, vmulq_f32(idx, st)), l, down);
+		idx = vaddq_f32(idx, four);
+		gb  = neon_limit(vaddq_f32(g0, vmulq_f32(idx, st)), l, down);
+		idx = vaddq_f32(idx, four);
+
+		a = vcvtq_f32_s32(vmovl_s16(vget_low_s16(x)));
+		b = vcvtq_f32_s32(vmovl_s16(vget_high_s16(x)));
+
+		a = neon_clamp(vmulq_f32(a, ga), lo, hi);
+		b = neon_clamp(vmulq_f32(b, gb), lo, hi);
+
+		vst1q_s16(&v[i], neon_pack(a, b));
+	}
+
+	fade_s16_tail(v, i, n, gain, step, lim);
+}
+
+
+static void fade_float_neon(float *v, size_t n, float gain, float step,
+			    float lim)
+{
+	static const float idx0[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+	const float32x4_t g0   = vdupq_n_f32(gain);
+	const float32x4_t st   = vdupq_n_f32(step);
+	const float32x4_t l    = vdupq_n_f32(lim);
+	const float32x4_t four = vdupq_n_f32(4.0f);
+	const bool down        = step < 0;
+	float32x4_t idx = vld1q_f32(idx0);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t g = vaddq_f32(g0, vmulq_f32(idx, st));
+
+		g   = neon_limit(g, l, down);
+		idx = vaddq_f32(idx, four);
+
+		vst1q_f32(&v[i], vmulq_f32(vld1q_f32(&v[i]), g));
+	}
+
+	fade_float_tail(v, i, n, gain, step, lim);
+}
+
+
+static const struct kernels kern_neon = {
+	AUDSP_NEON,
+	s16_to_float_neon, float_to_s16_neon,
+	s16_to_s32_neon, s32_to_s16_neon,
+	s32_to_float_neon, float_to_s32_neon,
+	add_s16_neon, add_float_neon,
+	gain_s16_neon, gain_float_neon,
+	fade_s16_neon, fade_float_neon,
+};
+
+#endif /* HAVE_NEON */
+
+
+static const struct kernels *kern = &kern_c;
+
+
+static const struct kernels *isa_kernels(enum audsp_isa isa)
+{
+	switch (isa) {
+
+	case AUDSP_SCALAR:
+		return &kern_c;
+
+#ifdef HAVE_SSE2
+	case AUDSP_SSE2:
+		return &kern_sse2;
+#endif
+
+#ifdef HAVE_AVX2
+	case AUDSP_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? &kern_avx2 : NULL;
+#endif
+
+#ifdef HAVE_NEON
+	case AUDSP_NEON:
+		return &kern_neon;
+#endif
+
+	default:
+		return NULL;
+	}
+}
+
+
+/**
+ * Select the best instruction set for the audio DSP kernels
+ */
+void audsp_init(void)
+{
+	static const enum audsp_isa isav[] = {
+		AUDSP_AVX2, AUDSP_NEON, AUDSP_SSE2, AUDSP_SCALAR
+	};
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(isav); i++) {
+
+		if (0 == audsp_set_isa(isav[i]))
+			break;
+	}
+
+	debug("audsp: using %s kernels\n", audsp_isa_name(kern->isa));
+}
+
+
+/**
+ * Set the instruction set of the audio DSP kernels
+ *
+ * @param isa Instruction set
+ *
+ * @return 0 if success, ENOTSUP if not supported by build or CPU
+ */
+int audsp_set_isa(enum audsp_isa isa)
+{
+	const struct kernels *k = isa_kernels(isa);
+
+	if (!k)
+		return ENOTSUP;
+
+	kern = k;
+
+	return 0;
+}
+
+
+/**
+ * Get the instruction set of the audio DSP kernels
+ *
+ * @return Instruction set in use
+ */
+enum audsp_isa audsp_isa(void)
+{
+	return kern->isa;
+}
+
+
+/**
+ * Get the name of an instruction set
+ *
+ * @param isa Instruction set
+ *
+ * @return Name of the instruction set
+ */
+const char *audsp_isa_name(enum audsp_isa isa)
+{
+	switch (isa) {
+
+	case AUDSP_SCALAR: return "scalar";
+	case AUDSP_SSE2:   return "sse2";
+	case AUDSP_AVX2:   return "avx2";
+	case AUDSP_NEON:   return "neon";
+	default:           return "?";
+	}
+}
+
+
+/**
+ * Convert S16 samples to FLOAT, in the range [-1.0, 1.0)
+ *
+ * @param dst Destination buffer
+ * @param src Source buffer
+ * @param n   Number of samples
+ */
+void audsp_s16_to_float(float *dst, const int16_t *src, size_t n)
+{
+	if (!dst || !src)
+		return;
+
+	kern->s16_to_float(dst, src, n);
+}
+
+
+/**
+ * Convert FLOAT samples to S16, with clipping and rounding
+ *
+ * @param dst Destination buffer
+ * @param src Source buffer
+ * @param n   Number of samples
+ */
+void audsp_float_to_s16(int16_t *dst, const float *src, size_t n)
+{
+	if (!dst || !src)
+		return;
+
+	kern->float_to_s16(dst, src, n);
+}
+
+
+/**
+ * Convert S16 samples to S32
+ *
+ * @param dst Destination buffer
+ * @param src Source buffer
+ * @param n   Number of samples
+ */
+void audsp_s16_to_s32(int32_t *dst, const int16_t *src, size_t n)
+{
+	if (!dst || !src)
+		return;
+
+	kern->s16_to_s32(dst, src, n);
+}
+
+
+/**
+ * Convert S32 samples to S16
+ *
+ * @param dst Destination buffer
+ * @param src Source buffer
+ * @param n   Number of samples
+ */
+void audsp_s32_to_s16(int16_t *dst, const int32_t *src, size_t n)
+{
+	if (!dst || !src)
+		return;
+
+	kern->s32_to_s16(dst, src, n);
+}
+
+
+/**
+ * Convert S32 samples to FLOAT, in the range [-1.0, 1.0]
+ *
+ * @param dst Destination buffer
+ * @param src Source buffer
+ * @param n   Number of samples
+ */
+void audsp_s32_to_float(float *dst, const int32_t *src, size_t n)
+{
+	if (!dst || !src)
+		return;
+
+	kern->s32_to_float(dst, src, n);
+}
+
+
+/**
+ * Convert FLOAT samples to S32, with clipping and rounding
+ *
+ * @param dst Destination buffer
+ * @param src Source buffer
+ * @param n   Number of samples
+ */
+void audsp_float_to_s32(int32_t *dst, const float *src, size_t n)
+{
+	if (!dst || !src)
+		return;
+
+	kern->float_to_s32(dst, src, n);
+}
+
+
+/**
+ * Convert samples between S16LE, S32LE and FLOAT
+ *
+ * @param dst     Destination buffer
+ * @param dst_fmt Destination sample format (enum aufmt)
+ * @param src     Source buffer
+ * @param src_fmt Source sample format (enum aufmt)
+ * @param n       Number of samples
+ *
+ * @return 0 if success, ENOTSUP if not supported, otherwise errorcode
+ */
+int audsp_convert(void *dst, int dst_fmt, const void *src, int src_fmt,
+		  size_t n)
+{
+	if (!dst || !src)
+		return EINVAL;
+
+	switch (src_fmt) {
+
+	case AUFMT_S16LE:
+		if (dst_fmt == AUFMT_FLOAT)
+			kern->s16_to_float(dst, src, n);
+		else if (dst_fmt == AUFMT_S32LE)
+			kern->s16_to_s32(dst, src, n);
+		else if (dst_fmt == AUFMT_S16LE)
+			memmove(dst, src, n * sizeof(int16_t));
+		else
+			return ENOTSUP;
+		break;
+
+	case AUFMT_S32LE:
+		if (dst_fmt == AUFMT_S16LE)
+			kern->s32_to_s16(dst, src, n);
+		else if (dst_fmt == AUFMT_FLOAT)
+			kern->s32_to_float(dst, src, n);
+		else if (dst_fmt == AUFMT_S32LE)
+			memmove(dst, src, n * sizeof(int32_t));
+		else
+			return ENOTSUP;
+		break;
+
+	case AUFMT_FLOAT:
+		if (dst_fmt == AUFMT_S16LE)
+			kern->float_to_s16(dst, src, n);
+		else if (dst_fmt == AUFMT_S32LE)
+			kern->float_to_s32(dst, src, n);
+		else if (dst_fmt == AUFMT_FLOAT)
+			memmove(dst, src, n * sizeof(float));
+		else
+			return ENOTSUP;
+		break;
+
+	default:
+		return ENOTSUP;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Add S16 samples with saturation, dst = dst + src
+ *
+ * @param dst Destination buffer
+ * @param src Source buffer
+ * @param n   Number of samples
+ */
+void audsp_add_s16(int16_t *dst, const int16_t *src, size_t n)
+{
+	if (!dst || !src)
+		return;
+
+	kern->add_s16(dst, src, n);
+}
+
+
+/**
+ * Add FLOAT samples, dst = dst + src
+ *
+ * @param dst Destination buffer
+ * @param src Source buffer
+ * @param n   Number of samples
+ */
+void audsp_add_float(float *dst, const float *src, size_t n)
+{
+	if (!dst || !src)
+		return;
+
+	kern->add_float(dst, src, n);
+}
+
+
+/**
+ * Apply a gain to S16 samples, with clipping
+ *
+ * @param v    Samples
+ * @param n    Number of samples
+ * @param gain Linear gain factor
+ */
+void audsp_gain_s16(int16_t *v, size_t n, float gain)
+{
+	if (!v)
+		return;
+
+	kern->gain_s16(v, n, gain);
+}
+
+
+/**
+ * Apply a gain to FLOAT samples
+ *
+ * @param v    Samples
+ * @param n    Number of samples
+ * @param gain Linear gain factor
+ */
+void audsp_gain_float(float *v, size_t n, float gain)
+{
+	if (!v)
+		return;
+
+	kern->gain_float(v, n, gain);
+}
+
+
+/**
+ * Apply a linear fade ramp to S16 samples, with clipping
+ *
+ * Sample i is multiplied with gain + i * step, limited to lim (upper
+ * limit for a positive step, lower limit for a negative step).
+ *
+ * @param v    Samples
+ * @param n    Number of samples
+ * @param gain Gain of the first sample
+ * @param step Gain increment per sample
+ * @param lim  Gain limit
+ */
+void audsp_fade_s16(int16_t *v, size_t n, float gain, float step, float lim)
+{
+	if (!v)
+		return;
+
+	kern->fade_s16(v, n, gain, step, lim);
+}
+
+
+/**
+ * Apply a linear fade ramp to FLOAT samples
+ *
+ * @param v    Samples
+ * @param n    Number of samples
+ * @param gain Gain of the first sample
+ * @param step Gain increment per sample
+ * @param lim  Gain limit, see audsp_fade_s16()
+ */
+void audsp_fade_float(float *v, size_t n, float gain, float step,
+		      float lim)
+{
+	if (!v)
+		return;
+
+	kern->fade_float(v, n, gain, step, lim);
+}
@@ -0,0 +1,369 @@
+/**
+ * @file src/aulat.c  Audio pipeline latency trace
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <re.h>
+#include <re_atomic.h>
+#include <rem.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/**
+ * \page AudioLatencyTrace Audio pipeline latency trace
+ *
+ * When "audio_lattrace" is enabled, every audio frame is timestamped at
+ * each stage boundary of the transmit and receive pipelines, and the
+ * time spent in each stage is collected in a per-call histogram:
+ *
+ *<pre>
+ * TX:  ausrc --> aubuf --> aufilt --> encode --> send --> RTP
+ * RX:  RTP --> jbuf --> decode --> aufilt --> aubuf --> auplay
+ *</pre>
+ *
+ * Each stage has exactly one writer (the TX or the RX thread), so the
+ * counters are updated with relaxed atomics and can be read from any
+ * thread without locking. The histogram buckets are powers of two in
+ * microseconds, and the percentiles are estimated from the buckets.
+ */
+
+
+enum {
+	AULAT_BUCKETS = 24,  /**< Histogram buckets, up to 2^24 [us] */
+};
+
+
+/** Latency statistics for one pipeline stage */
+struct aulat_stat {
+	RE_ATOMIC uint64_t count;                 /**< Number of frames    */
+	RE_ATOMIC uint64_t sum;                   /**< Total latency [us]  */
+	RE_ATOMIC uint64_t max;                   /**< Max latency [us]    */
+	RE_ATOMIC uint64_t bucketv[AULAT_BUCKETS];/**< Log2 histogram      */
+};
+
+
+/** Audio pipeline latency trace */
+struct aulat {
+	struct aulat_stat statv[AULAT_STAGES];    /**< Per stage stats     */
+};
+
+
+static const char *stage_names[AULAT_STAGES] = {
+	[AULAT_TX_AUBUF]  = "tx_aubuf",
+	[AULAT_TX_FILTER] = "tx_filter",
+	[AULAT_TX_ENCODE] = "tx_encode",
+	[AULAT_TX_SEND]   = "tx_send",
+	[AULAT_RX_JBUF]   = "rx_jbuf",
+	[AULAT_RX_DECODE] = "rx_decode",
+	[AULAT_RX_FILTER] = "rx_filter",
+	[AULAT_RX_AUBUF]  = "rx_aubuf",
+};
+
+
+static unsigned bucket_index(uint64_t usec)
+{
+	unsigned i = 0;
+
+	while (usec > 1 && i < AULAT_BUCKETS - 1) {
+		usec >>= 1;
+		++i;
+	}
+
+	return i;
+}
+
+
+/* Upper bound of a histogram bucket in [us], the last one is open */
+static uint64_t bucket_limit(unsigned i)
+{
+	if (i >= AULAT_BUCKETS - 1)
+		return UINT64_MAX;
+
+	return (uint64_t)2 << i;
+}
+
+
+/**
+ * Allocate an audio latency trace
+ *
+ * @param alp Pointer to allocated latency trace
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aulat_alloc(struct aulat **alp)
+{
+	struct aulat *al;
+
+	if (!alp)
+		return EINVAL;
+
+	al = mem_zalloc(sizeof(*al), NULL);
+	if (!al)
+		return ENOMEM;
+
+	*alp = al;
+
+	return 0;
+}
+
+
+/**
+ * Add the latency of one frame in a pipeline stage
+ *
+ * @param al    Audio latency trace
+ * @param stage Pipeline stage
+ * @param usec  Time spent in the stage in [us]
+ *
+ * @note Each stage must only be written from one thread
+ */
+void aulat_add(struct aulat *al, enum aulat_stage stage, uint64_t usec)
+{
+	struct aulat_stat *st;
+
+	if (!al || stage >= AULAT_STAGES)
+		return;
+
+	st = &al->statv[stage];
+
+	re_atomic_rlx_add(&st->count, 1);
+	re_atomic_rlx_add(&st->sum, usec);
+	re_atomic_rlx_add(&st->bucketv[bucket_index(usec)], 1);
+
+	if (usec > re_atomic_rlx(&st->max))
+		re_atomic_rlx_set(&st->max, usec);
+}
+
+
+/**
+ * Get the number of frames traced in a pipeline stage
+ *
+ * @param al    Audio latency trace
+ * @param stage Pipeline stage
+ *
+ * @return Number of frames
+ */
+uint64_t aulat_count(const struct aulat *al, enum aulat_stage stage)
+{
+	if (!al || stage >= AULAT_STAGES)
+		return 0;
+
+	return re_atomic_rlx(&al->statv[stage].count);
+}
+
+
+/**
+ * Get the average latency of a pipeline stage
+ *
+ * @param al    Audio latency trace
+ * @param stage Pipeline stage
+ *
+ * @return Average latency in [us]
+ */
+uint64_t aulat_mean(const struct aulat *al, enum aulat_stage stage)
+{
+	uint64_t n;
+
+	n = aulat_count(al, stage);
+	if (!n)
+		return 0;
+
+	return re_atomic_rlx(&al->statv[stage].sum) / n;
+}
+
+
+/**
+ * Get the maximum latency of a pipeline stage
+ *
+ * @param al    Audio latency trace
+ * @param stage Pipeline stage
+ *
+ * @return Maximum latency in [us]
+ */
+uint64_t aulat_max(const struct aulat *al, enum aulat_stage stage)
+{
+	if (!al || stage >= AULAT_STAGES)
+		return 0;
+
+	return re_atomic_rlx(&al->statv[stage].max);
+}
+
+
+/**
+ * Estimate a latency percentile of a pipeline stage from the histogram
+ *
+ * @param al    Audio latency trace
+ * @param stage Pipeline stage
+ * @param pct   Percentile (0-100)
+ *
+ * @return Upper bound of the percentile in [us]
+ */
+uint64_t aulat_percentile(const struct aulat *al, enum aulat_stage stage,
+			  unsigned pct)
+{
+	const struct aulat_stat *st;
+	uint64_t n, rank, cum = 0;
+	uint64_t max;
+
+	n = aulat_count(al, stage);
+	if (!n)
+		return 0;
+
+	st   = &al->statv[stage];
+	max  = re_atomic_rlx(&st->max);
+	rank = (n * min(pct, 100u) + 99) / 100;
+	if (!rank)
+		rank = 1;
+
+	for (unsigned i = 0; i < AULAT_BUCKETS; i++) {
+
+		cum += re_atomic_rlx(&st->bucketv[i]);
+		if (cum >= rank)
+			return min(bucket_limit(i), max);
+	}
+
+	return max;
+}
+
+
+/**
+ * Get the name of a pipeline stage
+ *
+ * @param stage Pipeline stage
+ *
+ * @return Name of the stage
+ */
+const char *aulat_stage_name(enum aulat_stage stage)
+{
+	if (stage >= AULAT_STAGES)
+		return "?";
+
+	return stage_names[stage];
+}
+
+
+static int stage_debug(struct re_printf *pf, const struct aulat *al,
+		       enum aulat_stage stage)
+{
+	return re_hprintf(pf, "  %-10s %8llu %9.2f %9.2f %9.2f %9.2f\n",
+			  aulat_stage_name(stage),
+			  aulat_count(al, stage),
+			  aulat_mean(al, stage) / 1000.0,
+			  aulat_percentile(al, stage, 50) / 1000.0,
+			  aulat_percentile(al, stage, 99) / 1000.0,
+			  aulat_max(al, stage) / 1000.0);
+}
+
+
+static uint64_t sum_mean(const struct aulat *al,
+			 enum aulat_stage first, enum aulat_stage last)
+{
+	uint64_t sum = 0;
+
+	for (enum aulat_stage s = first; s <= last; s++)
+		sum += aulat_mean(al, s);
+
+	return sum;
+}
+
+
+/**
+ * Print the audio latency trace
+ *
+ * @param pf Print handler
+ * @param al Audio latency trace
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aulat_debug(struct re_printf *pf, const struct aulat *al)
+{
+	uint64_t tx, rx;
+	int err;
+
+	if (!al)
+		return re_hprintf(pf, "audio latency trace is disabled"
+				  " (audio_lattrace)\n");
+
+	err = re_hprintf(pf, "  %-10s %8s %9s %9s %9s %9s\n",
+			 "stage", "frames", "mean[ms]", "p50[ms]",
+			 "p99[ms]", "max[ms]");
+
+	for (enum aulat_stage s = AULAT_TX_AUBUF; s < AULAT_STAGES; s++)
+		err |= stage_debug(pf, al, s);
+
+	tx = sum_mean(al, AULAT_TX_AUBUF, AULAT_TX_SEND);
+	rx = sum_mean(al, AULAT_RX_JBUF, AULAT_RX_AUBUF);
+
+	err |= re_hprintf(pf, "  mean total: tx %.2f ms, rx %.2f ms\n",
+			  tx / 1000.0, rx / 1000.0);
+
+	return err;
+}
+
+
+static int stage_encode(struct odict *od_parent, const struct aulat *al,
+			enum aulat_stage stage)
+{
+	struct odict *od = NULL;
+	int err;
+
+	err = odict_alloc(&od, 8);
+	if (err)
+		return err;
+
+	err  = odict_entry_add(od, "count", ODICT_INT,
+			       (int64_t)aulat_count(al, stage));
+	err |= odict_entry_add(od, "mean_us", ODICT_INT,
+			       (int64_t)aulat_mean(al, stage));
+	err |= odict_entry_add(od, "p50_us", ODICT_INT,
+			       (int64_t)aulat_percentile(al, stage, 50));
+	err |= odict_entry_add(od, "p99_us", ODICT_INT,
+			       (int64_t)aulat_percentile(al, stage, 99));
+	err |= odict_entry_add(od, "max_us", ODICT_INT,
+			       (int64_t)aulat_max(al, stage));
+	if (err)
+		goto out;
+
+	err = odict_entry_add(od_parent, aulat_stage_name(stage),
+			      ODICT_OBJECT, od);
+
+ out:
+	mem_deref(od);
+
+	return err;
+}
+
+
+/**
+ * Encode the audio latency trace into a dictionary
+ *
+ * @param od_parent Dictionary to encode into
+ * @param al        Audio latency trace
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int aulat_odict_encode(struct odict *od_parent, const struct aulat *al)
+{
+	struct odict *od = NULL;
+	int err;
+
+	if (!od_parent || !al)
+		return EINVAL;
+
+	err = odict_alloc(&od, 16);
+	if (err)
+		return err;
+
+	for (enum aulat_stage s = AULAT_TX_AUBUF; s < AULAT_STAGES; s++) {
+		err = stage_encode(od, al, s);
+		if (err)
+			goto out;
+	}
+
+	err = odict_entry_add(od_parent, "latency", ODICT_OBJECT, od);
+
+ out:
+	mem_deref(od);
+
+	return err;
+}
@@ -26,10 +26,22 @@
        '--------'   '-------'   '--------'   '--------'
 
  \endverbatim
+ *
+ * If "audio_timestretch" is enabled, the decoded and filtered frames are
+ * time-scaled (see autsm.c) before the aubuf, so that the buffered audio
+ * converges smoothly on the target latency.
  */
 
 enum {
 	JITTER_EMA_COEFF   = 128,     /**< Jitter EMA coefficient            */
+	PLC_MAX            =  16,     /**< Max. concealed frames per loss    */
+};
+
+
+/** A concealed frame which may be replaced by a late packet */
+struct plc_mark {
+	uint32_t ts;                  /**< RTP timestamp of the frame        */
+	uint64_t deadline;            /**< Playout time [us], 0 if unused    */
 };
 
 
@@ -54,9 +66,19 @@ struct audio_recv {
 	struct timestamp_recv ts_recv;/**< Receive timestamp state           */
 	uint8_t extmap_aulevel;       /**< ID Range 1-14 inclusive           */
 	int pt;                       /**< Payload type of audio codec       */
+	struct aulat *lat;            /**< Latency trace (optional)          */
+	uint64_t aubuf_us;            /**< Buffered audio after last push    */
+	struct autsm *tsm;            /**< Time-scale modification (opt.)    */
+
+	struct {
+		struct plc_mark markv[PLC_MAX]; /**< Concealed frames        */
+		unsigned idx;         /**< Next mark to be used              */
+	} plc;
 
 	struct {
 		uint64_t n_discard;   /**< Nbr of discarded packets          */
+		uint64_t n_plc;       /**< Nbr of concealed frames           */
+		uint64_t n_replaced;  /**< Nbr of late frames replacing PLC  */
 		RE_ATOMIC uint64_t latency;   /**< Latency in [ms]           */
 		int32_t jitter;       /**< Auframe push jitter [us]          */
 		int32_t dmax;         /**< Max deviation [us]                */
@@ -86,6 +108,8 @@ static void destructor(void *arg)
 	list_flush(&ar->filtl);
 	mem_deref(ar->module);
 	mem_deref(ar->device);
+	mem_deref(ar->lat);
+	mem_deref(ar->tsm);
 }
 
 
@@ -199,38 +223,114 @@ static int aurecv_push_aubuf(struct audio_recv *ar, const struct auframe *af)
 
 	bpms = (uint64_t)ar->srate * ar->ch * aufmt_sample_size(ar->fmt) /
 	       1000;
-	if (bpms)
-		re_atomic_rlx_set(&ar->stats.latency,
-				  aubuf_cur_size(ar->aubuf) / bpms);
+	if (bpms) {
+		size_t cur = aubuf_cur_size(ar->aubuf);
+
+		re_atomic_rlx_set(&ar->stats.latency, cur / bpms);
+		ar->aubuf_us = cur * 1000 / bpms;
+
+		/* the frame waits until the buffered audio is played */
+		if (ar->lat)
+			aulat_add(ar->lat, AULAT_RX_AUBUF, cur * 1000 / bpms);
+	}
 
 	return 0;
 }
 
 
+/*
+ * Speed up playout if the aubuf is above the target latency (the minimum
+ * plus one packet), slow it down if the aubuf runs below the minimum.
+ */
+static int aurecv_timestretch(struct audio_recv *ar, struct auframe *af)
+{
+	uint64_t min_us = ar->cfg->buffer.min * 1000;
+	uint64_t target = min_us + ar->ptime;
+	int64_t delta = 0;
+
+	if (!ar->aubuf)
+		return 0;
+
+	if (ar->aubuf_us > target + ar->ptime || ar->aubuf_us < min_us)
+		delta = (int64_t)ar->aubuf_us - (int64_t)target;
+
+	return autsm_process(ar->tsm, af, delta);
+}
+
+
+/*
+ * Remember a concealed frame until it is played, so that a late packet
+ * with the same RTP timestamp can replace it in the aubuf.
+ */
+static void plc_mark(struct audio_recv *ar, uint32_t ts)
+{
+	struct plc_mark *pm;
+
+	/* the frame will be played when the audio before it is played */
+	if (ar->aubuf_us <= ar->ptime)
+		return;
+
+	pm = &ar->plc.markv[ar->plc.idx++ % PLC_MAX];
+
+	pm->ts       = ts;
+	pm->deadline = tmr_jiffies_usec() + ar->aubuf_us - ar->ptime;
+}
+
+
+static struct plc_mark *plc_find(struct audio_recv *ar, uint32_t ts)
+{
+	for (size_t i = 0; i < RE_ARRAY_SIZE(ar->plc.markv); i++) {
+
+		struct plc_mark *pm = &ar->plc.markv[i];
+
+		if (pm->deadline && pm->ts == ts)
+			return pm;
+	}
+
+	return NULL;
+}
+
+
+/*
+ * Decode one frame and push it to the aubuf
+ *
+ * lostc != 0 conceals a lost frame, using the codec PLC or the decoder
+ * filters. If drop is set, the concealed frame with the same timestamp
+ * is removed from the aubuf and replaced by the decoded frame.
+ */
 static int aurecv_stream_decode(struct audio_recv *ar,
 				const struct rtp_header *hdr,
-				struct mbuf *mb, unsigned lostc)
+				struct mbuf *mb, unsigned lostc, bool drop)
 {
 	struct auframe af;
 	size_t sampc = ar->sampvsz / aufmt_sample_size(ar->fmt);
 	bool marker = hdr->m;
 	int err = 0;
 	const struct aucodec *ac = ar->ac;
+	uint64_t t0 = 0, t1;
 
 	/* No decoder set */
 	if (!ac)
 		return 0;
 
-	/* TODO: PLC */
-	if (lostc && ac->plch) {
+	if (ar->lat)
+		t0 = tmr_jiffies_usec();
 
-		err = ac->plch(ar->dec,
-				   ar->fmt, ar->sampv, &sampc,
-				   mbuf_buf(mb), mbuf_get_left(mb));
-		if (err) {
-			warning("audio_recv: %s codec decode %zu bytes: %m\n",
-				ac->name, mbuf_get_left(mb), err);
-			goto out;
+	if (lostc) {
+
+		if (ac->plch) {
+			err = ac->plch(ar->dec,
+				       ar->fmt, ar->sampv, &sampc,
+				       mbuf_buf(mb), mbuf_get_left(mb));
+			if (err) {
+				warning("audio_recv: %s codec plc: %m\n",
+					ac->name, err);
+				goto out;
+			}
+		}
+		else {
+			/* no PLC in the codec, might be done in filters */
+			sampc = 0;
 		}
 	}
 	else if (mbuf_get_left(mb)) {
@@ -249,6 +349,12 @@ static int aurecv_stream_decode(struct audio_recv *ar,
 		sampc = 0;
 	}
 
+	if (ar->lat) {
+		t1 = tmr_jiffies_usec();
+		aulat_add(ar->lat, AULAT_RX_DECODE, t1 - t0);
+		t0 = t1;
+	}
+
 	auframe_init(&af, ar->fmt, ar->sampv, sampc, ac->srate, ac->ch);
 	af.timestamp = ((uint64_t) hdr->ts) * AUDIO_TIMEBASE / ac->crate;
 
@@ -256,7 +362,25 @@ static int aurecv_stream_decode(struct audio_recv *ar,
 	if (err)
 		goto out;
 
+	if (ar->lat)
+		aulat_add(ar->lat, AULAT_RX_FILTER, tmr_jiffies_usec() - t0);
+
+	if (drop && ar->aubuf)
+		aubuf_drop_auframe(ar->aubuf, &af);
+	else if (ar->tsm && !lostc) {
+		err = aurecv_timestretch(ar, &af);
+		if (err)
+			goto out;
+	}
+
 	err = aurecv_push_aubuf(ar, &af);
+	if (err)
+		goto out;
+
+	if (lostc && af.sampc) {
+		++ar->stats.n_plc;
+		plc_mark(ar, hdr->ts);
+	}
  out:
 	return err;
 }
@@ -270,18 +394,79 @@ void aurecv_reset(struct audio_recv *ar)
 	mtx_lock(ar->mtx);
 	ar->ts_recv.is_set = false;
 	ar->ts_recv.num_wraps = 0;
+	memset(&ar->plc, 0, sizeof(ar->plc));
 	aubuf_flush(ar->aubuf);
 	mtx_unlock(ar->mtx);
 }
 
+
+/*
+ * Conceal lostc frames before the packet in hdr/mb. The timestamps of
+ * the lost frames are interpolated between the last and the current
+ * packet. The current payload is passed to the codec PLC for the last
+ * lost frame, so the codec can use in-band FEC.
+ */
+static void aurecv_conceal(struct audio_recv *ar,
+			   const struct rtp_header *hdr,
+			   struct mbuf *mb, unsigned lostc, uint32_t ts_last)
+{
+	struct rtp_header plc_hdr = *hdr;
+	struct mbuf mb_empty;
+	uint32_t delta, step;
+	unsigned n;
+
+	delta = hdr->ts - ts_last;
+	step  = delta / (lostc + 1);
+	if (!step || (int32_t)delta <= 0)
+		return;
+
+	memset(&mb_empty, 0, sizeof(mb_empty));
+
+	n = min(lostc, (unsigned)PLC_MAX);
+	plc_hdr.m = false;
+
+	for (unsigned i = lostc - n + 1; i <= lostc; i++) {
+
+		plc_hdr.ts = ts_last + i * step;
+
+		(void)aurecv_stream_decode(ar, &plc_hdr,
+					   i == lostc ? mb : &mb_empty,
+					   1, false);
+	}
+}
+
+
+/*
+ * A packet arrived after a newer one. If its frame was concealed and is
+ * still buffered, the concealed frame is replaced. Otherwise the packet
+ * is too late to be played.
+ */
+static void aurecv_late(struct audio_recv *ar, const struct rtp_header *hdr,
+			struct mbuf *mb)
+{
+	struct plc_mark *pm = plc_find(ar, hdr->ts);
+	bool replace = false;
+
+	if (pm) {
+		replace = tmr_jiffies_usec() < pm->deadline;
+		pm->deadline = 0;
+	}
+
+	if (replace && !aurecv_stream_decode(ar, hdr, mb, 0, true))
+		++ar->stats.n_replaced;
+	else
+		++ar->stats.n_discard;
+}
+
+
 /* Handle incoming stream data from the network */
 void aurecv_receive(struct audio_recv *ar, const struct rtp_header *hdr,
 		    struct rtpext *extv, size_t extc,
 		    struct mbuf *mb, unsigned lostc)
 {
 	bool discard = false;
+	uint32_t ts_last;
 	int wrap;
-	(void) lostc;
 
 	if (!mb)
 		return;
@@ -300,10 +485,19 @@ void aurecv_receive(struct audio_recv *ar, const struct rtp_header *hdr,
 		ar->level_set = true;
 	}
 
+	/* Late packet, it may replace a concealed frame */
+	if (ar->ts_recv.is_set &&
+	    (int32_t)(hdr->ts - ar->ts_recv.last) < 0) {
+		aurecv_late(ar, hdr, mb);
+		goto out;
+	}
+
 	/* Save timestamp for incoming RTP packets */
 
-	if (!ar->ts_recv.is_set)
+	if (!ar->ts_recv.is_set) {
 		timestamp_set(&ar->ts_recv, hdr->ts);
+		lostc = 0;
+	}
 
 	wrap = timestamp_wrap(hdr->ts, ar->ts_recv.last);
 
@@ -327,6 +521,7 @@ void aurecv_receive(struct audio_recv *ar, const struct rtp_header *hdr,
 		break;
 	}
 
+	ts_last = ar->ts_recv.last;
 	ar->ts_recv.last = hdr->ts;
 
 	if (discard) {
@@ -334,14 +529,10 @@ void aurecv_receive(struct audio_recv *ar, const struct rtp_header *hdr,
 		goto out;
 	}
 
-	/* TODO:  what if lostc > 1 ?*/
-	/* PLC should generate lostc frames here. Not only one.
-	 * aubuf should replace PLC frames with late arriving real frames.
-	 * It should use timestamp to decide if a frame should be replaced. */
-/*        if (lostc)*/
-/*                (void)aurecv_stream_decode(ar, hdr, mb, lostc, drop);*/
+	if (lostc)
+		aurecv_conceal(ar, hdr, mb, lostc, ts_last);
 
-	(void)aurecv_stream_decode(ar, hdr, mb, 0);
+	(void)aurecv_stream_decode(ar, hdr, mb, 0, false);
 
 out:
 	mtx_unlock(ar->mtx);
@@ -359,6 +550,18 @@ void aurecv_set_extmap(struct audio_recv *ar, uint8_t aulevel)
 }
 
 
+void aurecv_set_aulat(struct audio_recv *ar, struct aulat *al)
+{
+	if (!ar)
+		return;
+
+	mtx_lock(ar->mtx);
+	mem_deref(ar->lat);
+	ar->lat = mem_ref(al);
+	mtx_unlock(ar->mtx);
+}
+
+
 int aurecv_set_module(struct audio_recv *ar, const char *module)
 {
 	if (!ar)
@@ -417,6 +620,11 @@ int aurecv_alloc(struct audio_recv **aupp, const struct config_audio *cfg,
 
 	err  = mutex_alloc(&ar->mtx);
 	err |= mutex_alloc(&ar->aubuf_mtx);
+	if (err)
+		goto out;
+
+	if (cfg->timestretch)
+		err = autsm_alloc(&ar->tsm);
 
 out:
 	if (err)
@@ -435,6 +643,7 @@ void aurecv_flush(struct audio_recv *ar)
 
 	mtx_lock(ar->mtx);
 	aubuf_flush(ar->aubuf);
+	memset(&ar->plc, 0, sizeof(ar->plc));
 
 	/* Reset audio filter chain */
 	list_flush(&ar->filtl);
@@ -750,6 +959,14 @@ int aurecv_debug(struct re_printf *pf, const struct audio_recv *ar)
 #endif
 	err |= mbuf_printf(mb, "       n_discard: %llu\n",
 			   ar->stats.n_discard);
+	err |= mbuf_printf(mb, "       n_plc: %llu (replaced %llu)\n",
+			   ar->stats.n_plc, ar->stats.n_replaced);
+	if (ar->tsm) {
+		err |= mbuf_printf(mb, "       timestretch: compressed %llums,"
+				   " expanded %llums\n",
+				   autsm_compressed(ar->tsm),
+				   autsm_expanded(ar->tsm));
+	}
 	if (ar->level_set) {
 		err |= mbuf_printf(mb, "       level %.3f dBov\n",
 				   ar->level_last);
@@ -0,0 +1,287 @@
+/**
+ * @file src/autsm.c  Audio time-scale modification (WSOLA)
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <re_atomic.h>
+#include <rem.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/**
+ * \page AudioTimeStretch Audio time-scale modification
+ *
+ * The receive pipeline can play out faster or slower than real-time to
+ * move the audio buffer towards its target latency, without dropping
+ * whole frames and without changing the pitch.
+ *
+ * This is done with WSOLA (Waveform Similarity Overlap-Add): the pitch
+ * period T of the frame is searched with a normalized cross-correlation,
+ * and exactly one period is removed (compress) or repeated (expand) by
+ * cross-fading the frame with itself shifted by T:
+ *
+ *<pre>
+ * compress:  x[0..T) x x[T..2T) | x[2T..N)              N - T samples
+ * expand:    x[0..T) | x[T..2T) x x[0..T) | x[T..N)     N + T samples
+ *</pre>
+ *
+ * Frames which are neither periodic nor silent are not modified. The
+ * rate of modification is limited to TSM_RATE percent of the played
+ * audio, so a period is only removed or repeated every few frames.
+ *
+ * Only the S16LE sample format is supported, other formats are passed
+ * through unmodified.
+ */
+
+
+enum {
+	TSM_RATE      = 5,    /**< Max. time-scale change [%]        */
+	TSM_PITCH_MAX = 400,  /**< Highest pitch searched [Hz]       */
+	TSM_PITCH_MIN = 100,  /**< Lowest pitch searched [Hz]        */
+	TSM_SILENCE   = 64,   /**< Silence threshold (RMS)           */
+};
+
+/* Min. normalized cross-correlation, squared: 0.9^2 */
+#define TSM_CORR_MIN2 0.81
+
+
+/** Audio time-scale modification */
+struct autsm {
+	int16_t *buf;                 /**< Output sample buffer            */
+	size_t bufsz;                 /**< Output buffer size [samples]    */
+	size_t credit;                /**< Allowed modification [frames]   */
+	RE_ATOMIC uint64_t compressed_us; /**< Total removed audio [us]    */
+	RE_ATOMIC uint64_t expanded_us;   /**< Total inserted audio [us]   */
+};
+
+
+static void destructor(void *arg)
+{
+	struct autsm *tsm = arg;
+
+	mem_deref(tsm->buf);
+}
+
+
+/**
+ * Allocate an audio time-scale modification state
+ *
+ * @param tsmp Pointer to allocated state
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int autsm_alloc(struct autsm **tsmp)
+{
+	struct autsm *tsm;
+
+	if (!tsmp)
+		return EINVAL;
+
+	tsm = mem_zalloc(sizeof(*tsm), destructor);
+	if (!tsm)
+		return ENOMEM;
+
+	*tsmp = tsm;
+
+	return 0;
+}
+
+
+static bool is_silent(const int16_t *x, size_t n, size_t ch)
+{
+	uint64_t e = 0;
+
+	for (size_t i = 0; i < n; i++)
+		e += (uint64_t)((int32_t)x[i*ch] * x[i*ch]);
+
+	return e < (uint64_t)n * TSM_SILENCE * TSM_SILENCE;
+}
+
+
+/*
+ * Find the pitch period with the best normalized cross-correlation
+ * between x[0..T) and x[T..2T), using the first channel.
+ *
+ * @return Period in [frames], 0 if the signal is not periodic
+ */
+static size_t find_period(const int16_t *x, size_t ch,
+			  size_t pmin, size_t pmax)
+{
+	double best_xy = 0, best_e = 1;
+	size_t best = 0;
+
+	for (size_t t = pmin; t <= pmax; t++) {
+
+		double xy = 0, xx = 0, yy = 0;
+
+		for (size_t i = 0; i < t; i++) {
+			double a = x[i*ch];
+			double b = x[(i+t)*ch];
+
+			xy += a * b;
+			xx += a * a;
+			yy += b * b;
+		}
+
+		if (xy <= 0 || xx * yy <= 0)
+			continue;
+
+		/* corr^2 = xy^2 / (xx * yy), compared without sqrt() */
+		if (xy * xy * best_e > best_xy * best_xy * xx * yy) {
+			best_xy = xy;
+			best_e  = xx * yy;
+			best    = t;
+		}
+	}
+
+	if (!best || best_xy * best_xy < TSM_CORR_MIN2 * best_e)
+		return 0;
+
+	return best;
+}
+
+
+/* Linear cross-fade from a to b, at position i of n */
+static inline int16_t xfade(int16_t a, int16_t b, size_t i, size_t n)
+{
+	int32_t w = (int32_t)i;
+	int32_t l = (int32_t)n;
+
+	return (int16_t)((a * (l - w) + b * w) / l);
+}
+
+
+static void compress(int16_t *y, const int16_t *x, size_t n, size_t ch,
+		     size_t t)
+{
+	for (size_t i = 0; i < t * ch; i++)
+		y[i] = xfade(x[i], x[i + t*ch], i / ch, t);
+
+	memcpy(&y[t*ch], &x[2*t*ch], (n - 2*t) * ch * sizeof(int16_t));
+}
+
+
+static void expand(int16_t *y, const int16_t *x, size_t n, size_t ch,
+		   size_t t)
+{
+	memcpy(y, x, 2 * t * ch * sizeof(int16_t));
+
+	for (size_t i = 0; i < t * ch; i++)
+		y[t*ch + i] = xfade(x[t*ch + i], x[i], i / ch, t);
+
+	memcpy(&y[2*t*ch], &x[t*ch], (n - t) * ch * sizeof(int16_t));
+}
+
+
+/**
+ * Time-scale one audio frame towards the target latency
+ *
+ * If the frame is modified, the sample buffer of the frame is replaced
+ * by an internal buffer, which is valid until the next call.
+ *
+ * @param tsm      Audio time-scale modification state
+ * @param af       Audio frame
+ * @param delta_us Buffered latency minus target latency in [us]. Positive
+ *                 values compress, negative values expand the audio and
+ *                 zero leaves the frame as it is.
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int autsm_process(struct autsm *tsm, struct auframe *af, int64_t delta_us)
+{
+	const int16_t *x;
+	size_t n, ch, pmin, pmax, t;
+	uint64_t us;
+
+	if (!tsm || !af)
+		return EINVAL;
+
+	if (!delta_us) {
+		tsm->credit = 0;
+		return 0;
+	}
+
+	if (af->fmt != AUFMT_S16LE || !af->ch || !af->srate || !af->sampv)
+		return 0;
+
+	ch   = af->ch;
+	n    = af->sampc / ch;
+	pmin = af->srate / TSM_PITCH_MAX;
+	pmax = min(af->srate / TSM_PITCH_MIN, n / 2);
+
+	if (pmax < pmin)
+		return 0;
+
+	tsm->credit = min(tsm->credit + n * TSM_RATE / 100, pmax);
+	if (tsm->credit < pmin)
+		return 0;
+
+	x = af->sampv;
+
+	if (is_silent(x, 2 * tsm->credit, ch))
+		t = tsm->credit;
+	else
+		t = find_period(x, ch, pmin, tsm->credit);
+
+	if (!t)
+		return 0;
+
+	if (tsm->bufsz < (n + t) * ch) {
+
+		mem_deref(tsm->buf);
+
+		tsm->bufsz = (n + pmax) * ch;
+		tsm->buf   = mem_zalloc(tsm->bufsz * sizeof(int16_t), NULL);
+		if (!tsm->buf) {
+			tsm->bufsz = 0;
+			return ENOMEM;
+		}
+	}
+
+	us = (uint64_t)t * 1000000 / af->srate;
+
+	if (delta_us > 0) {
+		compress(tsm->buf, x, n, ch, t);
+		af->sampc = (n - t) * ch;
+		re_atomic_rlx_add(&tsm->compressed_us, us);
+	}
+	else {
+		expand(tsm->buf, x, n, ch, t);
+		af->sampc = (n + t) * ch;
+		re_atomic_rlx_add(&tsm->expanded_us, us);
+	}
+
+	af->sampv   = tsm->buf;
+	tsm->credit -= t;
+
+	return 0;
+}
+
+
+/**
+ * Get the total duration of removed audio
+ *
+ * @param tsm Audio time-scale modification state
+ *
+ * @return Compressed audio in [ms]
+ */
+uint64_t autsm_compressed(const struct autsm *tsm)
+{
+	return tsm ? re_atomic_rlx(&tsm->compressed_us) / 1000 : 0;
+}
+
+
+/**
+ * Get the total duration of inserted audio
+ *
+ * @param tsm Audio time-scale modification state
+ *
+ * @return Expanded audio in [ms]
+ */
+uint64_t autsm_expanded(const struct autsm *tsm)
+{
+	return tsm ? re_atomic_rlx(&tsm->expanded_us) / 1000 : 0;
+}
@@ -109,6 +109,8 @@ int baresip_init(struct config *cfg)
 	list_init(&baresip.vidispl);
 	list_init(&baresip.vidfiltl);
 
+	audsp_init();
+
 	/* Initialise Network */
 	err = net_alloc(&baresip.net, &cfg->net);
 	if (err) {
@@ -11,15 +11,9 @@
 
 enum {
 	EVENT_MAXSZ = 4096,
-};
-
-
-enum bevent_class {
-	BEVENT_CLASS_UA,
-	BEVENT_CLASS_CALL,
-	BEVENT_CLASS_APP,
-	BEVENT_CLASS_SIP,
-	BEVENT_CLASS_UNDEFINED
+	SUB_QLEN    = 256,     /**< Default subscriber queue length   */
+	SUB_BATCH   = 16,      /**< Events per main loop iteration    */
+	SUB_OPTS    = 4,       /**< Number of encoding option sets    */
 };
 
 
@@ -45,7 +39,41 @@ struct ehe {
 };
 
 
+/** Event encoded once and shared by the subscribers (immutable) */
+struct payload {
+	struct bevent_json bj;
+	char *json;
+};
+
+
+/** Event bus subscriber */
+struct bevent_sub {
+	struct le le;
+	enum bevent_sub_mode mode;
+	bevent_json_h *jh;
+	void *arg;
+	uint32_t classmask;
+	uint64_t evmask;
+	uint32_t opts;
+
+	/* bounded queue (ASYNC and THREAD mode) */
+	struct payload **ringv;
+	uint32_t qlen;
+	uint32_t head;
+	uint32_t n;
+	uint64_t dropped;
+	mtx_t *mtx;
+	struct mqueue *mq;         /* main loop wakeup (ASYNC mode)   */
+	bool wake;                 /* wakeup is pending               */
+	cnd_t cnd;
+	bool cnd_init;
+	thrd_t thrd;
+	bool run;
+};
+
+
 static struct list ehel;               /**< Event handlers (struct ehe)     */
+static struct list subl;               /**< Bus subscribers                 */
 
 
 static void bevent_emit_base(struct bevent *event);
@@ -59,7 +87,14 @@ static void ehe_destructor(void *arg)
 }
 
 
-static const char *bevent_class_name(enum bevent_class ec)
+/**
+ * Get the name of an event class
+ *
+ * @param ec Event class
+ *
+ * @return Name of the event class
+ */
+const char *bevent_class_str(enum bevent_class ec)
 {
 	switch (ec) {
 
@@ -365,7 +400,7 @@ int bevent_odict_encode(struct odict *od, const struct bevent *event)
 		return EINVAL;
 
 	err = odict_entry_add(od, "class",
-			      ODICT_STRING, bevent_class_name(event->ec));
+			      ODICT_STRING, bevent_class_str(event->ec));
 
 	if (event->ec == BEVENT_CLASS_SIP) {
 		char *buf;
@@ -405,8 +440,10 @@ int bevent_odict_encode(struct odict *od, const struct bevent *event)
 	if (ev == BEVENT_CALL_RTCP && str_isset(prm)) {
 		struct stream *strm = NULL;
 
-		if (0 == str_casecmp(prm, "audio"))
+		if (0 == str_casecmp(prm, "audio")) {
 			strm = audio_strm(call_audio(call));
+			err |= audio_latency_encode(od, call_audio(call));
+		}
 		else if (0 == str_casecmp(prm, "video"))
 			strm = video_strm(call_video(call));
 
@@ -539,6 +576,400 @@ out:
 }
 
 
+static void payload_destructor(void *arg)
+{
+	struct payload *pl = arg;
+
+	mem_deref(pl->json);
+}
+
+
+static int payload_alloc(struct payload **plp, const struct bevent *event,
+			 uint32_t opts)
+{
+	struct payload *pl;
+	struct odict *od = NULL;
+	int err;
+
+	pl = mem_zalloc(sizeof(*pl), payload_destructor);
+	if (!pl)
+		return ENOMEM;
+
+	err = odict_alloc(&od, 8);
+	if (err)
+		goto out;
+
+	if (opts & BEVENT_SUB_OPT_EVENT) {
+		err = odict_entry_add(od, "event", ODICT_BOOL, true);
+		if (err)
+			goto out;
+	}
+
+	err = bevent_odict_encode(od, event);
+	if (err)
+		goto out;
+
+	if (opts & BEVENT_SUB_OPT_JBSTAT && event->ev == BEVENT_VU_RX)
+		(void)event_add_au_jb_stat(od, bevent_get_call(event));
+
+	err = re_sdprintf(&pl->json, "%H", json_encode_odict, od);
+	if (err)
+		goto out;
+
+	pl->bj.ev   = event->ev;
+	pl->bj.ec   = event->ec;
+	pl->bj.json = pl->json;
+	pl->bj.len  = str_len(pl->json);
+
+ out:
+	mem_deref(od);
+	if (err)
+		mem_deref(pl);
+	else
+		*plp = pl;
+
+	return err;
+}
+
+
+/* must be called with the subscriber mutex locked */
+static struct payload *sub_pop(struct bevent_sub *sub)
+{
+	struct payload *pl;
+
+	if (!sub->n)
+		return NULL;
+
+	pl = sub->ringv[sub->head];
+	sub->ringv[sub->head] = NULL;
+	sub->head = (sub->head + 1) % sub->qlen;
+	--sub->n;
+
+	return pl;
+}
+
+
+static void sub_wakeup(struct bevent_sub *sub)
+{
+	int err;
+
+	err = mqueue_push(sub->mq, 0, NULL);
+	if (err) {
+		warning("bevent: could not wake up subscriber (%m)\n", err);
+
+		mtx_lock(sub->mtx);
+		sub->wake = false;
+		mtx_unlock(sub->mtx);
+	}
+}
+
+
+static void async_handler(int id, void *data, void *arg)
+{
+	struct bevent_sub *sub = arg;
+	(void)id;
+	(void)data;
+
+	for (uint32_t i = 0; i < SUB_BATCH; i++) {
+
+		struct payload *pl;
+
+		mtx_lock(sub->mtx);
+		pl = sub_pop(sub);
+		if (!pl)
+			sub->wake = false;
+		mtx_unlock(sub->mtx);
+
+		if (!pl)
+			return;
+
+		sub->jh(&pl->bj, sub->arg);
+		mem_deref(pl);
+	}
+
+	/* let the main loop run before the next batch */
+	sub_wakeup(sub);
+}
+
+
+static int sub_thread(void *arg)
+{
+	struct bevent_sub *sub = arg;
+
+	mtx_lock(sub->mtx);
+
+	while (sub->run) {
+
+		struct payload *pl = sub_pop(sub);
+		if (!pl) {
+			cnd_wait(&sub->cnd, sub->mtx);
+			continue;
+		}
+
+		mtx_unlock(sub->mtx);
+
+		sub->jh(&pl->bj, sub->arg);
+		mem_deref(pl);
+
+		mtx_lock(sub->mtx);
+	}
+
+	mtx_unlock(sub->mtx);
+
+	return 0;
+}
+
+
+/*
+ * Called from the emitting (main) thread. The queue is shared with the
+ * subscriber thread in THREAD mode. ASYNC subscribers are woken up through
+ * a message queue of the main loop, once per batch.
+ */
+static void sub_enqueue(struct bevent_sub *sub, struct payload *pl)
+{
+	bool wake = false;
+
+	mtx_lock(sub->mtx);
+
+	if (sub->n == sub->qlen) {
+		/* queue is full, drop the oldest event */
+		mem_deref(sub_pop(sub));
+		++sub->dropped;
+	}
+
+	sub->ringv[(sub->head + sub->n) % sub->qlen] = mem_ref(pl);
+	++sub->n;
+
+	if (sub->mode == BEVENT_SUB_THREAD)
+		cnd_signal(&sub->cnd);
+
+	if (sub->mode == BEVENT_SUB_ASYNC && !sub->wake)
+		wake = sub->wake = true;
+
+	mtx_unlock(sub->mtx);
+
+	if (wake)
+		sub_wakeup(sub);
+}
+
+
+static bool sub_match(const struct bevent_sub *sub,
+		      const struct bevent *event)
+{
+	if (event->ev >= 64)
+		return false;
+
+	return (sub->classmask & BEVENT_CLASS_BIT(event->ec)) &&
+	       (sub->evmask & BEVENT_EV_BIT(event->ev));
+}
+
+
+/*
+ * The event is encoded only if a subscriber wants it, and then only once
+ * per set of encoding options. All subscribers with the same options share
+ * the same payload.
+ */
+static void bus_emit(const struct bevent *event)
+{
+	struct payload *plv[SUB_OPTS] = {NULL};
+	struct le *le;
+
+	le = subl.head;
+	while (le) {
+		struct bevent_sub *sub = le->data;
+		le = le->next;
+
+		if (!sub_match(sub, event))
+			continue;
+
+		struct payload **plp = &plv[sub->opts];
+
+		if (!*plp && payload_alloc(plp, event, sub->opts)) {
+			warning("bevent: could not encode %s event\n",
+				bevent_str(event->ev));
+			continue;
+		}
+
+		if (sub->mode == BEVENT_SUB_SYNC)
+			sub->jh(&(*plp)->bj, sub->arg);
+		else
+			sub_enqueue(sub, *plp);
+	}
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(plv); i++)
+		mem_deref(plv[i]);
+}
+
+
+static void sub_destructor(void *arg)
+{
+	struct bevent_sub *sub = arg;
+
+	list_unlink(&sub->le);
+	sub->mq = mem_deref(sub->mq);
+
+	if (sub->run) {
+		mtx_lock(sub->mtx);
+		sub->run = false;
+		cnd_signal(&sub->cnd);
+		mtx_unlock(sub->mtx);
+
+		thrd_join(sub->thrd, NULL);
+	}
+
+	if (sub->cnd_init)
+		cnd_destroy(&sub->cnd);
+
+	while (sub->n)
+		mem_deref(sub_pop(sub));
+
+	mem_deref(sub->ringv);
+	mem_deref(sub->mtx);
+}
+
+
+/**
+ * Subscribe to the event bus. Each event is encoded to JSON once and the
+ * encoded event is shared by all subscribers. The bus gets an event after
+ * all handlers registered with bevent_register(), but not if a handler
+ * called bevent_stop() or closed the call of a call event. BEVENT_SUB_SYNC
+ * subscribers are called in the order of subscription, and never miss an
+ * event. With BEVENT_SUB_ASYNC and BEVENT_SUB_THREAD the events are
+ * queued, and if the queue is full the oldest event is dropped, so a slow
+ * subscriber never blocks the emitter.
+ * The subscription is removed when the subscriber is dereferenced, which
+ * must not be done from its handler. Like the events, subscriptions are
+ * created and removed in the main thread.
+ *
+ * @param subp Pointer to allocated subscriber
+ * @param mode Delivery mode
+ * @param qlen Queue length (0 for default)
+ * @param jh   JSON event handler
+ * @param arg  Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int bevent_sub_alloc(struct bevent_sub **subp, enum bevent_sub_mode mode,
+		     uint32_t qlen, bevent_json_h *jh, void *arg)
+{
+	struct bevent_sub *sub;
+	int err = 0;
+
+	if (!subp || !jh)
+		return EINVAL;
+
+	sub = mem_zalloc(sizeof(*sub), sub_destructor);
+	if (!sub)
+		return ENOMEM;
+
+	sub->mode      = mode;
+	sub->jh        = jh;
+	sub->arg       = arg;
+	sub->classmask = UINT32_MAX;
+	sub->evmask    = UINT64_MAX;
+	sub->qlen      = qlen ? qlen : SUB_QLEN;
+
+	if (mode == BEVENT_SUB_SYNC)
+		goto out;
+
+	sub->ringv = mem_zalloc(sub->qlen * sizeof(*sub->ringv), NULL);
+	if (!sub->ringv) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	err = mutex_alloc(&sub->mtx);
+	if (err)
+		goto out;
+
+	if (mode == BEVENT_SUB_ASYNC) {
+		err = mqueue_alloc(&sub->mq, async_handler, sub);
+		goto out;
+	}
+
+	if (cnd_init(&sub->cnd) != thrd_success) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	sub->cnd_init = true;
+	sub->run = true;
+
+	err = thread_create_name(&sub->thrd, "bevent sub", sub_thread, sub);
+	if (err)
+		sub->run = false;
+
+ out:
+	if (err) {
+		mem_deref(sub);
+	}
+	else {
+		list_append(&subl, &sub->le, sub);
+		*subp = sub;
+	}
+
+	return err;
+}
+
+
+/**
+ * Set the event filter of a bus subscriber. Use BEVENT_CLASS_BIT() and
+ * BEVENT_EV_BIT() to build the masks. By default all events are delivered.
+ *
+ * @param sub       Bus subscriber
+ * @param classmask Bitmask of the event classes to deliver
+ * @param evmask    Bitmask of the event types to deliver
+ */
+void bevent_sub_filter(struct bevent_sub *sub, uint32_t classmask,
+		       uint64_t evmask)
+{
+	if (!sub)
+		return;
+
+	sub->classmask = classmask;
+	sub->evmask    = evmask;
+}
+
+
+/**
+ * Set the encoding options of a bus subscriber, see enum bevent_sub_opt.
+ * By default the event is encoded without options.
+ *
+ * @param sub  Bus subscriber
+ * @param opts Bitmask of encoding options
+ */
+void bevent_sub_set_opts(struct bevent_sub *sub, uint32_t opts)
+{
+	if (!sub)
+		return;
+
+	sub->opts = opts & (SUB_OPTS - 1);
+}
+
+
+/**
+ * Get the number of events dropped for a bus subscriber because its queue
+ * was full
+ *
+ * @param sub Bus subscriber
+ *
+ * @return Number of dropped events
+ */
+uint64_t bevent_sub_dropped(const struct bevent_sub *sub)
+{
+	uint64_t n;
+
+	if (!sub || !sub->mtx)
+		return 0;
+
+	mtx_lock(sub->mtx);
+	n = sub->dropped;
+	mtx_unlock(sub->mtx);
+
+	return n;
+}
+
+
 static bool bevent_is_valid(const struct bevent *event, struct ua *ua)
 {
 	if (!event)
@@ -562,19 +993,30 @@ static bool bevent_is_valid(const struct bevent *event, struct ua *ua)
 static void bevent_emit_base(struct bevent *event)
 {
 	struct ua *ua = bevent_get_ua(event);
+	uint32_t gen = call_gen();
 	struct le *le;
+
 	le = ehel.head;
 	while (le) {
 		struct ehe *ehe = le->data;
 		le = le->next;
 
 		ehe->h(event->ev, event, ehe->arg);
-		if (ua && !bevent_is_valid(event, ua))
-			return;
+
+		/* the call can only be gone if a call was destroyed */
+		if (ua && gen != call_gen()) {
+			if (!bevent_is_valid(event, ua))
+				return;
+
+			gen = call_gen();
+		}
 
 		if (event->stop)
-			return;
+			break;
 	}
+
+	if (subl.head && !event->stop)
+		bus_emit(event);
 }
 
 
@@ -9,21 +9,199 @@
 #include "core.h"
 
 
+/*
+ * The base stream demultiplexes the incoming packets of all streams in
+ * the BUNDLE group. The streams are indexed by remote SSRC and by MID,
+ * in hash tables shared by the group. An unknown SSRC is resolved by
+ * the MID header extension of the packet, or by the remote SSRC of the
+ * streams, and is then added to the index.
+ */
+
+
+enum { INDEX_HASH_SIZE = 16 };
+
+
 static const char uri_mid[] = "urn:ietf:params:rtp-hdrext:sdes:mid";
 
 
+/* Demultiplexing index, shared by all streams of a BUNDLE group */
+struct bundle_index {
+	struct hash *ht_ssrc;       /* Streams by remote SSRC */
+	struct hash *ht_mid;        /* Streams by MID         */
+	mtx_t *mtx;
+	uint32_t n_mid;             /* SSRCs resolved by MID  */
+	uint32_t n_list;            /* SSRCs resolved by list */
+};
+
+
 struct bundle {
 	struct udp_helper *uh;
 	enum bundle_state state;
 	uint8_t extmap_mid;         /* Range 1-14  */
+	struct stream *strm;        /* Owner stream (not referenced) */
+	const struct list *streaml; /* Streams of the session       */
+	struct bundle_index *idx;   /* Index of the BUNDLE group     */
+	struct le le_ssrc;          /* Entry in the SSRC index       */
+	struct le le_mid;           /* Entry in the MID index        */
+	uint32_t ssrc;              /* Indexed remote SSRC           */
+	char *mid;                  /* Indexed MID                   */
 };
 
 
+static void index_destructor(void *data)
+{
+	struct bundle_index *idx = data;
+
+	mem_deref(idx->ht_ssrc);
+	mem_deref(idx->ht_mid);
+	mem_deref(idx->mtx);
+}
+
+
+static int index_alloc(struct bundle_index **idxp)
+{
+	struct bundle_index *idx;
+	int err;
+
+	idx = mem_zalloc(sizeof(*idx), index_destructor);
+	if (!idx)
+		return ENOMEM;
+
+	err  = hash_alloc(&idx->ht_ssrc, INDEX_HASH_SIZE);
+	err |= hash_alloc(&idx->ht_mid, INDEX_HASH_SIZE);
+	err |= mutex_alloc(&idx->mtx);
+	if (err)
+		mem_deref(idx);
+	else
+		*idxp = idx;
+
+	return err;
+}
+
+
+static void index_unlink(struct bundle *bun)
+{
+	if (!bun->idx)
+		return;
+
+	mtx_lock(bun->idx->mtx);
+	hash_unlink(&bun->le_ssrc);
+	hash_unlink(&bun->le_mid);
+	mtx_unlock(bun->idx->mtx);
+}
+
+
+static bool ssrc_cmp_handler(struct le *le, void *arg)
+{
+	const struct bundle *bun = le->data;
+	const uint32_t *ssrc = arg;
+
+	return bun->ssrc == *ssrc;
+}
+
+
+static bool mid_cmp_handler(struct le *le, void *arg)
+{
+	const struct bundle *bun = le->data;
+	const struct pl *mid = arg;
+
+	return 0 == pl_strcmp(mid, bun->mid);
+}
+
+
+/* NOTE: must be called with idx->mtx */
+static void index_set_ssrc(struct bundle *bun, uint32_t ssrc)
+{
+	struct hash *ht = bun->idx->ht_ssrc;
+	struct le *le;
+
+	if (bun->le_ssrc.list && bun->ssrc == ssrc)
+		return;
+
+	/* the SSRC moved from another stream */
+	le = hash_lookup(ht, ssrc, ssrc_cmp_handler, &ssrc);
+	if (le)
+		hash_unlink(le);
+
+	hash_unlink(&bun->le_ssrc);
+
+	bun->ssrc = ssrc;
+	hash_append(ht, ssrc, &bun->le_ssrc, bun);
+}
+
+
+/* NOTE: must be called with idx->mtx */
+static struct bundle *index_lookup_ssrc(struct bundle_index *idx,
+					uint32_t ssrc)
+{
+	struct le *le;
+
+	le = hash_lookup(idx->ht_ssrc, ssrc, ssrc_cmp_handler, &ssrc);
+
+	return le ? le->data : NULL;
+}
+
+
+/* NOTE: must be called with idx->mtx */
+static struct bundle *index_lookup_mid(struct bundle_index *idx,
+				       const struct pl *mid)
+{
+	struct le *le;
+
+	le = hash_lookup(idx->ht_mid, hash_joaat((const uint8_t *)mid->p,
+						 mid->l),
+			 mid_cmp_handler, (void *)mid);
+
+	return le ? le->data : NULL;
+}
+
+
+/* Add the stream to the index of the group, with its MID and SSRC */
+static int index_add(struct bundle *bun, struct bundle_index *idx)
+{
+	const char *mid = stream_mid(bun->strm);
+	uint32_t ssrc;
+	int err = 0;
+
+	if (bun->idx != idx) {
+		index_unlink(bun);
+		mem_deref(bun->idx);
+		bun->idx = mem_ref(idx);
+	}
+
+	mtx_lock(idx->mtx);
+
+	hash_unlink(&bun->le_mid);
+	bun->mid = mem_deref(bun->mid);
+
+	if (str_isset(mid)) {
+		err = str_dup(&bun->mid, mid);
+		if (!err) {
+			hash_append(idx->ht_mid,
+				    hash_joaat((const uint8_t *)mid,
+					       str_len(mid)),
+				    &bun->le_mid, bun);
+		}
+	}
+
+	if (0 == stream_ssrc_rx(bun->strm, &ssrc))
+		index_set_ssrc(bun, ssrc);
+
+	mtx_unlock(idx->mtx);
+
+	return err;
+}
+
+
 static void destructor(void *data)
 {
 	struct bundle *bun = data;
 
+	/* NOTE: unlink before uh, the receiver may still find it */
+	index_unlink(bun);
 	mem_deref(bun->uh);
+	mem_deref(bun->idx);
+	mem_deref(bun->mid);
 }
 
 
@@ -50,11 +228,11 @@ void bundle_set_state(struct bundle *bun, enum bundle_state st)
 }
 
 
-int bundle_alloc(struct bundle **bunp)
+int bundle_alloc(struct bundle **bunp, struct stream *strm)
 {
 	struct bundle *bun;
 
-	if (!bunp)
+	if (!bunp || !strm)
 		return EINVAL;
 
 	info("bundle: alloc\n");
@@ -63,12 +241,60 @@ int bundle_alloc(struct bundle **bunp)
 	if (!bun)
 		return ENOMEM;
 
+	bun->strm = strm;
+
 	*bunp = bun;
 
 	return 0;
 }
 
 
+static struct stream *bundle_find_base(const struct list *streaml)
+{
+	struct le *le;
+
+	for (le = list_head(streaml); le; le = le->next) {
+		struct stream *strm = le->data;
+		struct bundle *bun = stream_bundle(strm);
+
+		if (bun && bun->state == BUNDLE_BASE)
+			return strm;
+	}
+
+	return NULL;
+}
+
+
+/* Index all streams of the group, in the index of the base stream */
+static int index_update(const struct list *streaml)
+{
+	struct stream *base = bundle_find_base(streaml);
+	struct bundle *bun = stream_bundle(base);
+	struct le *le;
+	int err = 0;
+
+	if (!bun)
+		return 0;
+
+	if (!bun->idx) {
+		err = index_alloc(&bun->idx);
+		if (err)
+			return err;
+	}
+
+	for (le = list_head(streaml); le; le = le->next) {
+		struct bundle *b = stream_bundle(le->data);
+
+		if (!b || b->state == BUNDLE_NONE)
+			continue;
+
+		err |= index_add(b, bun->idx);
+	}
+
+	return err;
+}
+
+
 static bool bundle_handler(const char *name, const char *value, void *arg)
 {
 	struct list *streaml = arg;
@@ -139,7 +365,7 @@ int bundle_sdp_decode(struct sdp_session *sdp, struct list *streaml)
 		stream_parse_mid(strm);
 	}
 
-	return 0;
+	return index_update(streaml);
 }
 
 
@@ -286,27 +512,11 @@ static int get_rtcp_ssrc(const struct rtcp_msg *msg, uint32_t *ssrcp)
 }
 
 
-static struct stream *bundle_find_base(const struct list *streaml)
-{
-	struct le *le;
-
-	for (le = list_head(streaml); le; le = le->next) {
-		struct stream *strm = le->data;
-		struct bundle *bun = stream_bundle(strm);
-
-		if (bun && bun->state == BUNDLE_BASE)
-			return strm;
-	}
-
-	return NULL;
-}
-
-
 /* send: used by multiplexed streams */
 static bool udp_helper_send_handler(int *err, struct sa *dst,
 				    struct mbuf *mb, void *arg)
 {
-	const struct list *streaml = arg;
+	const struct bundle *bun = arg;
 	struct stream *strm;
 
 #if 0
@@ -317,7 +527,7 @@ static bool udp_helper_send_handler(int *err, struct sa *dst,
 	}
 #endif
 
-	strm = bundle_find_base(streaml);
+	strm = bundle_find_base(bun->streaml);
 	if (strm) {
 		struct udp_sock *us = rtp_sock(stream_rtp_sock(strm));
 		struct bundle *bun2 = stream_bundle(strm);
@@ -336,11 +546,92 @@ static bool udp_helper_send_handler(int *err, struct sa *dst,
 }
 
 
+/*
+ * Find the stream by the MID header extension of an RTP packet
+ *
+ * NOTE: must be called with bun->idx->mtx
+ */
+static struct bundle *lookup_rtp_mid(const struct bundle *bun,
+				     const struct rtp_header *hdr,
+				     struct mbuf *mb)
+{
+	const size_t pos = mb->pos;
+	const size_t end = mb->end;
+	const size_t len = hdr->x.len * sizeof(uint32_t);
+	struct bundle *bun2 = NULL;
+
+	if (!hdr->ext || hdr->x.type != RTPEXT_TYPE_MAGIC || !len)
+		return NULL;
+
+	if (!bun->extmap_mid || mb->pos < len)
+		return NULL;
+
+	mb->end = mb->pos;
+	mb->pos = mb->pos - len;
+
+	while (mbuf_get_left(mb)) {
+
+		struct rtpext ext;
+		struct pl mid;
+
+		if (rtpext_decode(&ext, mb))
+			break;
+
+		if (ext.id != bun->extmap_mid)
+			continue;
+
+		mid.p = (const char *)ext.data;
+		mid.l = ext.len;
+
+		bun2 = index_lookup_mid(bun->idx, &mid);
+		break;
+	}
+
+	mb->pos = pos;
+	mb->end = end;
+
+	return bun2;
+}
+
+
+/*
+ * Find the stream of an unknown SSRC, and add the SSRC to the index
+ *
+ * NOTE: must be called with bun->idx->mtx
+ */
+static struct bundle *resolve_ssrc(struct bundle *bun, uint32_t ssrc,
+				   const struct rtp_header *hdr,
+				   struct mbuf *mb)
+{
+	struct bundle *bun2 = NULL;
+
+	if (hdr)
+		bun2 = lookup_rtp_mid(bun, hdr, mb);
+	if (bun2) {
+		++bun->idx->n_mid;
+	}
+	else {
+		bun2 = stream_bundle(lookup_remote_ssrc(bun->streaml, ssrc));
+		if (bun2)
+			++bun->idx->n_list;
+	}
+
+	if (bun2 && bun2->idx == bun->idx)
+		index_set_ssrc(bun2, ssrc);
+
+	return bun2;
+}
+
+
 /* recv: used by base stream */
 static bool udp_helper_recv_handler(struct sa *src, struct mbuf *mb, void *arg)
 {
-	const struct list *streaml = arg;
-	struct stream *strm;
+	struct bundle *bun = arg;
+	struct bundle *bun2 = NULL;
+	struct udp_sock *us = NULL;
+	struct udp_helper *uh = NULL;
+	struct rtp_header hdr;
+	bool rtcp = rtp_is_rtcp_packet(mb);
 	size_t pos = mb->pos;
 	uint32_t ssrc;
 	int err;
@@ -353,9 +644,7 @@ static bool udp_helper_recv_handler(struct sa *src, struct mbuf *mb, void *arg)
 	}
 #endif
 
-	if (!rtp_is_rtcp_packet(mb)) {
-
-		struct rtp_header hdr;
+	if (!rtcp) {
 
 		err = rtp_hdr_decode(&hdr, mb);
 		if (err) {
@@ -381,20 +670,44 @@ static bool udp_helper_recv_handler(struct sa *src, struct mbuf *mb, void *arg)
 			return false;
 	}
 
-	strm = lookup_remote_ssrc(streaml, ssrc);
-	if (strm) {
-		struct udp_sock *us = rtp_sock(stream_rtp_sock(strm));
-		struct bundle *bun2 = stream_bundle(strm);
+	/*
+	 * The stream may be closed by another thread once the index is
+	 * unlocked, so its socket and UDP helper are referenced here.
+	 */
+	if (bun->idx) {
+		mtx_lock(bun->idx->mtx);
+
+		bun2 = index_lookup_ssrc(bun->idx, ssrc);
+		if (!bun2)
+			bun2 = resolve_ssrc(bun, ssrc, rtcp ? NULL : &hdr, mb);
+		if (bun2) {
+			us = mem_ref(rtp_sock(stream_rtp_sock(bun2->strm)));
+			uh = mem_ref(bun2->uh);
+		}
+
+		mtx_unlock(bun->idx->mtx);
+	}
+	else {
+		bun2 = stream_bundle(lookup_remote_ssrc(bun->streaml, ssrc));
+		if (bun2) {
+			us = mem_ref(rtp_sock(stream_rtp_sock(bun2->strm)));
+			uh = mem_ref(bun2->uh);
+		}
+	}
 
+	if (bun2) {
 		mb->pos = pos;
 
-		udp_recv_helper(us, src, mb, bun2->uh);
+		udp_recv_helper(us, src, mb, uh);
 	}
 	else {
 		warning("bundle: stream not found (ssrc=%x)\n",
 			ssrc);
 	}
 
+	mem_deref(uh);
+	mem_deref(us);
+
 	return true; /* stop */
 }
 
@@ -415,6 +728,8 @@ int bundle_start_socket(struct bundle *bun, struct udp_sock *us,
 	if (bun->uh)
 		return EALREADY;
 
+	bun->streaml = streaml;
+
 	muxed = bun->state == BUNDLE_MUX;
 	based = bun->state == BUNDLE_BASE;
 
@@ -422,7 +737,7 @@ int bundle_start_socket(struct bundle *bun, struct udp_sock *us,
 	err = udp_register_helper(&bun->uh, us, RTP_TRANSP_LAYER,
 				  muxed ? udp_helper_send_handler : NULL,
 				  based ? udp_helper_recv_handler : NULL,
-				  streaml);
+				  bun);
 	if (err)
 		return err;
 
@@ -436,6 +751,23 @@ enum bundle_state bundle_state(const struct bundle *bun)
 }
 
 
+/**
+ * Update the remote SSRC of a stream in the index of its BUNDLE group
+ *
+ * @param bun  Bundle object of the stream
+ * @param ssrc Remote SSRC
+ */
+void bundle_set_ssrc(struct bundle *bun, uint32_t ssrc)
+{
+	if (!bun || !bun->idx)
+		return;
+
+	mtx_lock(bun->idx->mtx);
+	index_set_ssrc(bun, ssrc);
+	mtx_unlock(bun->idx->mtx);
+}
+
+
 uint8_t bundle_extmap_mid(const struct bundle *bun)
 {
 	return bun ? bun->extmap_mid : 0;
@@ -453,6 +785,17 @@ int bundle_debug(struct re_printf *pf, const struct bundle *bun)
 	err |= re_hprintf(pf, " state:         %s\n",
 			  bundle_state_name(bun->state));
 	err |= re_hprintf(pf, " extmap_mid:    %u\n", bun->extmap_mid);
+	if (bun->idx) {
+		mtx_lock(bun->idx->mtx);
+		err |= re_hprintf(pf, " index mid:     %s\n", bun->mid);
+		if (bun->le_ssrc.list)
+			err |= re_hprintf(pf, " index ssrc:    %08x\n",
+					  bun->ssrc);
+		err |= re_hprintf(pf, " resolved:      %u by mid,"
+				  " %u by ssrc\n",
+				  bun->idx->n_mid, bun->idx->n_list);
+		mtx_unlock(bun->idx->mtx);
+	}
 	err |= re_hprintf(pf, "\n");
 
 	return err;
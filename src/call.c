@@ -48,6 +48,7 @@ struct call {
 	struct sa msg_src;        /**< Peer message source address          */
 	char *diverter_uri;       /**< Diverter SIP Address                 */
 	char *id;                 /**< Cached session call-id               */
+	struct le le_id;          /**< Entry in the Call-ID index           */
 	char *replaces;           /**< Replaces parameter                   */
 	uint16_t supported;       /**< Supported header tags                */
 	struct tmr tmr_inv;       /**< Timer for incoming calls             */
@@ -88,10 +89,54 @@ struct call {
 };
 
 
+/** Index of all calls by Call-ID */
+static struct {
+	struct hash *ht;          /**< Calls by Call-ID                     */
+	uint32_t n;               /**< Number of indexed calls              */
+	uint32_t gen;             /**< Incremented when a call is destroyed */
+} call_index;
+
+
+enum { CALL_INDEX_SIZE = 256 };
+
+
 static int send_invite(struct call *call);
 static int send_dtmf_info(struct call *call, char key);
 
 
+static void call_index_unlink(struct call *call)
+{
+	if (!call->le_id.list)
+		return;
+
+	hash_unlink(&call->le_id);
+
+	/* the index is freed with the last call */
+	if (--call_index.n == 0)
+		call_index.ht = mem_deref(call_index.ht);
+}
+
+
+static int call_index_add(struct call *call)
+{
+	int err;
+
+	call_index_unlink(call);
+
+	if (!call_index.ht) {
+		err = hash_alloc(&call_index.ht, CALL_INDEX_SIZE);
+		if (err)
+			return err;
+	}
+
+	hash_append(call_index.ht, hash_joaat_str(call->id), &call->le_id,
+		    call);
+	++call_index.n;
+
+	return 0;
+}
+
+
 static const char *state_name(enum call_state st)
 {
 	switch (st) {
@@ -342,6 +387,8 @@ static void call_destructor(void *arg)
 
 	call_stream_stop(call);
 	list_unlink(&call->le);
+	call_index_unlink(call);
+	++call_index.gen;
 	tmr_cancel(&call->tmr_dtmf);
 	tmr_cancel(&call->tmr_answ);
 	tmr_cancel(&call->tmr_reinv);
@@ -1039,10 +1086,15 @@ int call_connect(struct call *call, const struct pl *paddr)
 	info("call: connecting to '%r'..\n", paddr);
 
 	call->outgoing = true;
+	call->id = mem_deref(call->id);
 	err = str_x64dup(&call->id, rand_u64());
 	if (err)
 		return err;
 
+	err = call_index_add(call);
+	if (err)
+		return err;
+
 	/* if the peer-address is a full SIP address then we need
 	 * to parse it and extract the SIP uri part.
 	 */
@@ -2322,22 +2374,33 @@ static bool valid_addressfamily(struct call *call, const struct stream *strm)
 }
 
 
+static bool dialog_cmp_handler(const struct call *call, void *arg)
+{
+	return sip_dialog_cmp(sipsess_dialog(call->sess), arg);
+}
+
+
+static bool dialog_cmp_half_handler(const struct call *call, void *arg)
+{
+	return sip_dialog_cmp_half(sipsess_dialog(call->sess), arg);
+}
+
+
 /**
  * Find a call given the value of a Replaces header
  *
- * @param calls   List of calls
+ * @param ua      User-Agent of the call
  * @param hdr     Value of Replaces header
  *
  * @return Call object if found, NULL if not found
  */
-static struct call *call_find_replaces(const struct list *calls,
+static struct call *call_find_replaces(const struct ua *ua,
 				       const struct pl *hdr)
 {
-	struct le *le;
 	struct sip_msg msg = { 0 };
-	struct call *ret = NULL;
+	struct call *call = NULL;
 
-	if (!calls || !pl_isset(hdr))
+	if (!ua || !pl_isset(hdr))
 		return NULL;
 
 	msg.req = true;
@@ -2355,27 +2418,17 @@ static struct call *call_find_replaces(const struct list *calls,
 	(void)re_regex(hdr->p, hdr->l, ";to-tag=[^; ]+", &msg.to.tag);
 	(void)re_regex(hdr->p, hdr->l, ";from-tag=[^; ]+", &msg.from.tag);
 
-	for (le = list_head(calls); le; le = le->next) {
-		struct call *call = le->data;
-
-		if (pl_isset(&msg.from.tag) && pl_isset(&msg.to.tag) &&
-		    sip_dialog_cmp(sipsess_dialog(call->sess), &msg)) {
-			ret = call;
-			break;
-		}
-		else if (pl_isset(&msg.to.tag) &&
-			 sip_dialog_cmp_half(sipsess_dialog(call->sess),
-					     &msg)) {
-			ret = call;
-			break;
-		}
-		else if (0 == pl_strcmp(&msg.callid, call->id)) {
-			ret = call;
-			break;
-		}
-	}
+	/* the full dialog, the half dialog, or any call with the Call-ID */
+	if (pl_isset(&msg.from.tag) && pl_isset(&msg.to.tag))
+		call = call_index_find(&msg.callid, ua, dialog_cmp_handler,
+				       &msg);
+	if (!call && pl_isset(&msg.to.tag))
+		call = call_index_find(&msg.callid, ua,
+				       dialog_cmp_half_handler, &msg);
+	if (!call)
+		call = call_index_find(&msg.callid, ua, NULL, NULL);
 
-	return ret;
+	return call;
 }
 
 
@@ -2450,7 +2503,7 @@ int call_accept(struct call *call, struct sipsess_sock *sess_sock,
 
 	hdr = sip_msg_hdr(msg, SIP_HDR_REPLACES);
 	if (hdr && pl_isset(&hdr->val)) {
-		struct call *rcall = call_find_replaces(ua_calls(call->ua),
+		struct call *rcall = call_find_replaces(call->ua,
 							&hdr->val);
 		if (!rcall) {
 			info("call: Replaces header present, but could not "
@@ -2488,11 +2541,16 @@ int call_accept(struct call *call, struct sipsess_sock *sess_sock,
 		return err;
 	}
 
+	call->id = mem_deref(call->id);
 	err = str_dup(&call->id,
 		      sip_dialog_callid(sipsess_dialog(call->sess)));
 	if (err)
 		return err;
 
+	err = call_index_add(call);
+	if (err)
+		return err;
+
 	set_state(call, CALL_STATE_INCOMING);
 
 	err = sipsess_set_prack_handler(call->sess, prack_handler);
@@ -3238,6 +3296,98 @@ struct call *call_find_linenum(const struct list *calls, uint32_t linenum)
 }
 
 
+struct index_match {
+	const struct pl *id;
+	const struct ua *ua;
+	call_match_h *matchh;
+	void *arg;
+};
+
+
+static bool index_cmp_handler(struct le *le, void *arg)
+{
+	const struct call *call = le->data;
+	const struct index_match *m = arg;
+
+	if (pl_strcmp(m->id, call->id))
+		return false;
+
+	if (m->ua && m->ua != call->ua)
+		return false;
+
+	return !m->matchh || m->matchh(call, m->arg);
+}
+
+
+/**
+ * Get the call generation, which changes every time a call is destroyed
+ *
+ * @return Call generation
+ */
+uint32_t call_gen(void)
+{
+	return call_index.gen;
+}
+
+
+/**
+ * Find a call by call-id in the index of all calls
+ *
+ * @param id      Call-id pointer-length string
+ * @param ua      User-Agent of the call (optional)
+ * @param matchh  Match handler for calls with the call-id (optional)
+ * @param arg     Handler argument
+ *
+ * @return Call object if found, NULL if not found
+ */
+struct call *call_index_find(const struct pl *id, const struct ua *ua,
+			     call_match_h *matchh, void *arg)
+{
+	struct index_match m = {id, ua, matchh, arg};
+	struct le *le;
+
+	if (!call_index.ht || !pl_isset(id))
+		return NULL;
+
+	le = hash_lookup(call_index.ht,
+			 hash_joaat((const uint8_t *)id->p, id->l),
+			 index_cmp_handler, &m);
+
+	return le ? le->data : NULL;
+}
+
+
+/**
+ * Find the newest call by call-id in the index of all calls
+ *
+ * @param id      Call-id pointer-length string
+ * @param ua      User-Agent of the call (optional)
+ * @param matchh  Match handler for calls with the call-id (optional)
+ * @param arg     Handler argument
+ *
+ * @return The last indexed matching call if found, NULL if not found
+ */
+struct call *call_index_find_last(const struct pl *id, const struct ua *ua,
+				  call_match_h *matchh, void *arg)
+{
+	struct index_match m = {id, ua, matchh, arg};
+	struct le *le;
+
+	if (!call_index.ht || !pl_isset(id))
+		return NULL;
+
+	le = list_tail(hash_list(call_index.ht,
+				 hash_joaat((const uint8_t *)id->p, id->l)));
+	for (; le; le = le->prev) {
+
+		if (index_cmp_handler(le, &m))
+			return le->data;
+	}
+
+	return NULL;
+}
+
+
 /**
  * Find a call by call-id
  *
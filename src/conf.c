@@ -321,12 +321,23 @@ enum jbuf_type conf_get_jbuf_type(const struct pl *pl)
 	if (0 == pl_strcasecmp(pl, "off"))      return JBUF_OFF;
 	if (0 == pl_strcasecmp(pl, "fixed"))    return JBUF_FIXED;
 	if (0 == pl_strcasecmp(pl, "adaptive")) return JBUF_ADAPTIVE;
+	if (0 == pl_strcasecmp(pl, "percentile")) return JBUF_PERCENTILE;
 
 	warning("unsupported jitter buffer type (%r)\n", pl);
 	return JBUF_FIXED;
 }
 
 
+enum jbuf_storage conf_get_jbuf_storage(const struct pl *pl)
+{
+	if (0 == pl_strcasecmp(pl, "list")) return JBUF_STORAGE_LIST;
+	if (0 == pl_strcasecmp(pl, "ring")) return JBUF_STORAGE_RING;
+
+	warning("unsupported jitter buffer storage (%r)\n", pl);
+	return JBUF_STORAGE_LIST;
+}
+
+
 bool conf_aubuf_adaptive(const struct pl *pl)
 {
 	if (0 == pl_strcasecmp(pl, "fixed"))    return false;
@@ -47,13 +47,18 @@ static struct config core_config = {
 	.audio = {
 		.audio_path = SHARE_PATH,
 		.level = false,
+		.lattrace = false,
+		.timestretch = false,
+		.txdrift = false,
 		.src_fmt = AUFMT_S16LE,
 		.play_fmt = AUFMT_S16LE,
 		.enc_fmt = AUFMT_S16LE,
 		.dec_fmt = AUFMT_S16LE,
 		.buffer = {20, 160},
 		.silence = -35.0,
-		.telev_pt = 101
+		.telev_pt = 101,
+		.txmode = AUDIO_TX_THREAD,
+		.txpool = 2,
 	},
 
 	/** Video */
@@ -65,6 +70,8 @@ static struct config core_config = {
 		.fps = 30,
 		.fullscreen = true,
 		.enc_fmt = VID_FMT_YUV420P,
+		.txbatch = 0,
+		.txgso = false,
 	},
 
 	/** Audio/Video Transport */
@@ -77,17 +84,23 @@ static struct config core_config = {
 		.audio = {
 			JBUF_FIXED,
 			{100, 200},
-			50
+			50,
+			JBUF_STORAGE_LIST,
+			97
 		},
 		.video = {
 			JBUF_FIXED,
 			{100, 200},
-			250
+			250,
+			JBUF_STORAGE_LIST,
+			97
 		},
 		.rtp_stats = false,
 		.rtp_timeout = 0,
 		.bundle = false,
 		.rxmode = RECEIVE_MODE_MAIN,
+		.rxpool = 2,
+		.rxbatch = 0,
 	},
 
 	/* Network */
@@ -174,6 +187,8 @@ enum rtp_receive_mode resolve_receive_mode(const struct pl *fmt)
 {
 	if (0 == pl_strcasecmp(fmt, "main"))     return RECEIVE_MODE_MAIN;
 	if (0 == pl_strcasecmp(fmt, "thread"))   return RECEIVE_MODE_THREAD;
+	if (0 == re_regex(fmt->p, fmt->l, "^pool[:]*[0-9]*$", NULL, NULL))
+		return RECEIVE_MODE_POOL;
 
 	warning("rtp_rxmode %r is not supported\n", fmt);
 	return RECEIVE_MODE_MAIN;
@@ -187,12 +202,55 @@ const char *rtp_receive_mode_str(enum rtp_receive_mode rxmode)
 		return "main";
 	case RECEIVE_MODE_THREAD:
 		return "thread";
+	case RECEIVE_MODE_POOL:
+		return "pool";
 	default:
 		return "?";
 	}
 }
 
 
+static int decode_audio_txmode(struct config_audio *cfg, const struct pl *pl)
+{
+	struct pl n = PL_INIT;
+
+	if (0 == pl_strcasecmp(pl, "thread")) {
+		cfg->txmode = AUDIO_TX_THREAD;
+		return 0;
+	}
+
+	if (re_regex(pl->p, pl->l, "^pool[:]*[0-9]*$", NULL, &n)) {
+		warning("config: audio_txmode %r is not supported\n", pl);
+		return EINVAL;
+	}
+
+	cfg->txmode = AUDIO_TX_POOL;
+	if (pl_isset(&n) && pl_u32(&n))
+		cfg->txpool = pl_u32(&n);
+
+	return 0;
+}
+
+
+static int audio_txmode_print(struct re_printf *pf,
+			      const struct config_audio *cfg)
+{
+	if (cfg->txmode == AUDIO_TX_POOL)
+		return re_hprintf(pf, "pool:%u", cfg->txpool);
+
+	return re_hprintf(pf, "thread");
+}
+
+
+static int rxmode_print(struct re_printf *pf, const struct config_avt *cfg)
+{
+	if (cfg->rxmode == RECEIVE_MODE_POOL)
+		return re_hprintf(pf, "pool:%u", cfg->rxpool);
+
+	return re_hprintf(pf, "%s", rtp_receive_mode_str(cfg->rxmode));
+}
+
+
 static int conf_get_aufmt(const struct conf *conf, const char *name,
 			  int *fmtp)
 {
@@ -245,6 +303,28 @@ static int conf_get_vidfmt(const struct conf *conf, const char *name,
 }
 
 
+static int conf_get_jbuf_pct(const struct conf *conf, const char *name,
+			     uint32_t *pct)
+{
+	uint32_t v;
+	int err;
+
+	err = conf_get_u32(conf, name, &v);
+	if (err)
+		return err;
+
+	if (!v || v > 100) {
+		warning("config: %s: percentile %u out of range,"
+			" clamped to 1-100\n", name, v);
+		v = v ? 100 : 1;
+	}
+
+	*pct = v;
+
+	return 0;
+}
+
+
 static const char *jbuf_type_str(enum jbuf_type jbtype)
 {
 	switch (jbtype) {
@@ -254,6 +334,21 @@ static const char *jbuf_type_str(enum jbuf_type jbtype)
 		return "fixed";
 	case JBUF_ADAPTIVE:
 		return "adaptive";
+	case JBUF_PERCENTILE:
+		return "percentile";
+	}
+
+	return "?";
+}
+
+
+static const char *jbuf_storage_str(enum jbuf_storage jbstore)
+{
+	switch (jbstore) {
+	case JBUF_STORAGE_LIST:
+		return "list";
+	case JBUF_STORAGE_RING:
+		return "ring";
 	}
 
 	return "?";
@@ -406,6 +501,9 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 	if (0 == conf_get(conf, "filter_registrar", &pl))
 		decode_sip_transports(&cfg->sip.reg_filt, &pl);
 
+	(void)conf_get_u32(conf, "sip_reg_rate", &cfg->sip.reg_rate);
+	(void)conf_get_u32(conf, "sip_reg_spread", &cfg->sip.reg_spread);
+
 	/* Call */
 	(void)conf_get_u32(conf, "call_local_timeout",
 			   &cfg->call.local_timeout);
@@ -441,6 +539,10 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 	(void)conf_get_u32(conf, "auplay_channels", &cfg->audio.channels_play);
 
 	(void)conf_get_bool(conf, "audio_level", &cfg->audio.level);
+	(void)conf_get_bool(conf, "audio_lattrace", &cfg->audio.lattrace);
+	(void)conf_get_bool(conf, "audio_timestretch",
+			    &cfg->audio.timestretch);
+	(void)conf_get_bool(conf, "audio_txdrift", &cfg->audio.txdrift);
 
 	conf_get_aufmt(conf, "ausrc_format", &cfg->audio.src_fmt);
 	conf_get_aufmt(conf, "auplay_format", &cfg->audio.play_fmt);
@@ -455,6 +557,8 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 
 	(void)conf_get_float(conf, "audio_silence", &cfg->audio.silence);
 	(void)conf_get_u32(conf, "audio_telev_pt", &cfg->audio.telev_pt);
+	if (0 == conf_get(conf, "audio_txmode", &pl))
+		(void)decode_audio_txmode(&cfg->audio, &pl);
 
 	/* Video */
 	(void)conf_get_csv(conf, "video_source",
@@ -474,6 +578,8 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 	(void)conf_get_bool(conf, "video_fullscreen", &cfg->video.fullscreen);
 
 	conf_get_vidfmt(conf, "videnc_format", &cfg->video.enc_fmt);
+	(void)conf_get_u32(conf, "video_txbatch", &cfg->video.txbatch);
+	(void)conf_get_bool(conf, "video_txgso", &cfg->video.txgso);
 
 	/* AVT - Audio/Video Transport */
 	if (0 == conf_get_u32(conf, "rtp_tos", &v))
@@ -507,6 +613,12 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 	(void)conf_get_u32(conf, "audio_jitter_buffer_size",
 			   &cfg->avt.audio.jbuf_sz);
 
+	if (0 == conf_get(conf, "audio_jitter_buffer_storage", &pl))
+		cfg->avt.audio.jbstore = conf_get_jbuf_storage(&pl);
+
+	(void)conf_get_jbuf_pct(conf, "audio_jitter_buffer_pct",
+				&cfg->avt.audio.jbuf_pct);
+
 	if (0 == conf_get(conf, "video_jitter_buffer_type", &jbtype))
 		cfg->avt.video.jbtype = conf_get_jbuf_type(&jbtype);
 
@@ -516,13 +628,26 @@ int config_parse_conf(struct config *cfg, const struct conf *conf)
 	(void)conf_get_u32(conf, "video_jitter_buffer_size",
 			   &cfg->avt.video.jbuf_sz);
 
+	if (0 == conf_get(conf, "video_jitter_buffer_storage", &pl))
+		cfg->avt.video.jbstore = conf_get_jbuf_storage(&pl);
+
+	(void)conf_get_jbuf_pct(conf, "video_jitter_buffer_pct",
+				&cfg->avt.video.jbuf_pct);
+
 	(void)conf_get_bool(conf, "rtp_stats", &cfg->avt.rtp_stats);
 	(void)conf_get_u32(conf, "rtp_timeout", &cfg->avt.rtp_timeout);
 
 	(void)conf_get_bool(conf, "avt_bundle", &cfg->avt.bundle);
 	if (0 == conf_get(conf, "rtp_rxmode", &rxmode)) {
+		struct pl n;
+
 		cfg->avt.rxmode = resolve_receive_mode(&rxmode);
+
+		if (cfg->avt.rxmode == RECEIVE_MODE_POOL &&
+		    !re_regex(rxmode.p, rxmode.l, "[0-9]+", &n) && pl_u32(&n))
+			cfg->avt.rxpool = pl_u32(&n);
 	}
+	(void)conf_get_u32(conf, "rtp_rxbatch", &cfg->avt.rxbatch);
 
 	if (err) {
 		warning("config: configure parse error (%m)\n", err);
@@ -579,6 +704,8 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 "sip_tls_resumption\t\t\t%s\n"
 			 "sip_tos\t%u\n"
 			 "filter_registrar\t%H\n"
+			 "sip_reg_rate\t\t%u\n"
+			 "sip_reg_spread\t\t%u\n"
 			 "\n"
 			 "# Call\n"
 			 "call_local_timeout\t%u\n"
@@ -595,6 +722,8 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 tls_resume_mode_str(cfg->sip.tls_resume),
 			 cfg->sip.tos, sip_transports_print_mask,
 			 &cfg->sip.reg_filt,
+			 cfg->sip.reg_rate,
+			 cfg->sip.reg_spread,
 
 			 cfg->call.local_timeout,
 			 cfg->call.max_calls,
@@ -614,6 +743,9 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 "auplay_channels\t\t%u\n"
 			 "ausrc_channels\t\t%u\n"
 			 "audio_level\t\t%s\n"
+			 "audio_lattrace\t\t%s\n"
+			 "audio_timestretch\t%s\n"
+			 "audio_txdrift\t\t%s\n"
 			 "ausrc_format\t\t%s\n"
 			 "auplay_format\t\t%s\n"
 			 "auenc_format\t\t%s\n"
@@ -621,6 +753,7 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 "audio_buffer\t\t%H\t\t# ms\n"
 			 "audio_silence\t\t%.1lf\t\t# in [dB]\n"
 			 "audio_telev_pt\t\t%u\n"
+			 "audio_txmode\t\t%H\n"
 			 "\n",
 			 cfg->audio.audio_path,
 			 cfg->audio.play_mod,  cfg->audio.play_dev,
@@ -629,13 +762,17 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 cfg->audio.srate_play, cfg->audio.srate_src,
 			 cfg->audio.channels_play, cfg->audio.channels_src,
 			 cfg->audio.level ? "yes" : "no",
+			 cfg->audio.lattrace ? "yes" : "no",
+			 cfg->audio.timestretch ? "yes" : "no",
+			 cfg->audio.txdrift ? "yes" : "no",
 			 aufmt_name(cfg->audio.src_fmt),
 			 aufmt_name(cfg->audio.play_fmt),
 			 aufmt_name(cfg->audio.enc_fmt),
 			 aufmt_name(cfg->audio.dec_fmt),
 			 range_print, &cfg->audio.buffer,
 			 cfg->audio.silence,
-			 cfg->audio.telev_pt);
+			 cfg->audio.telev_pt,
+			 audio_txmode_print, &cfg->audio);
 	if (err)
 		return err;
 
@@ -649,13 +786,17 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 "video_fps\t\t%.2f\n"
 			 "video_fullscreen\t%s\n"
 			 "videnc_format\t\t%s\n"
+			 "video_txbatch\t\t%u\n"
+			 "video_txgso\t\t%s\n"
 			 "\n",
 			 cfg->video.src_mod, cfg->video.src_dev,
 			 cfg->video.disp_mod, cfg->video.disp_dev,
 			 cfg->video.width, cfg->video.height,
 			 cfg->video.bitrate, cfg->video.fps,
 			 cfg->video.fullscreen ? "yes" : "no",
-			 vidfmt_name(cfg->video.enc_fmt));
+			 vidfmt_name(cfg->video.enc_fmt),
+			 cfg->video.txbatch,
+			 cfg->video.txgso ? "yes" : "no");
 	if (err)
 		return err;
 
@@ -668,13 +809,18 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 "audio_jitter_buffer_type\t%s\n"
 			 "audio_jitter_buffer_ms\t%H\n"
 			 "audio_jitter_buffer_size\t%u\n"
+			 "audio_jitter_buffer_storage\t%s\n"
+			 "audio_jitter_buffer_pct\t%u\n"
 			 "video_jitter_buffer_type\t%s\n"
 			 "video_jitter_buffer_ms\t%H\n"
 			 "video_jitter_buffer_size\t%u\n"
+			 "video_jitter_buffer_storage\t%s\n"
+			 "video_jitter_buffer_pct\t%u\n"
 			 "rtp_stats\t\t%s\n"
 			 "rtp_timeout\t\t%u # in seconds\n"
 			 "avt_bundle\t\t%s\n"
-			 "rtp_rxmode\t\t\t%s\n"
+			 "rtp_rxmode\t\t\t%H\n"
+			 "rtp_rxbatch\t\t%u\n"
 			 "\n"
 			 "# Network\n"
 			 "net_interface\t\t%s\n"
@@ -688,13 +834,18 @@ int config_print(struct re_printf *pf, const struct config *cfg)
 			 jbuf_type_str(cfg->avt.audio.jbtype),
 			 range_print, &cfg->avt.audio.jbuf_del,
 			 cfg->avt.audio.jbuf_sz,
+			 jbuf_storage_str(cfg->avt.audio.jbstore),
+			 cfg->avt.audio.jbuf_pct,
 			 jbuf_type_str(cfg->avt.video.jbtype),
 			 range_print, &cfg->avt.video.jbuf_del,
 			 cfg->avt.video.jbuf_sz,
+			 jbuf_storage_str(cfg->avt.video.jbstore),
+			 cfg->avt.video.jbuf_pct,
 			 cfg->avt.rtp_stats ? "yes" : "no",
 			 cfg->avt.rtp_timeout,
 			 cfg->avt.bundle ? "yes" : "no",
-			 rtp_receive_mode_str(cfg->avt.rxmode),
+			 rxmode_print, &cfg->avt,
+			 cfg->avt.rxbatch,
 
 			 cfg->net.ifname,
 			 net_af_str(cfg->net.af)
@@ -847,6 +998,9 @@ static int core_config_template(struct re_printf *pf, const struct config *cfg)
 			  "sip_tos\t\t\t160\n"
 			  "#filter_registrar\tudp,tcp,tls,ws,wss\n"
 			  "#sip_cuser_random\tno\n"
+			  "#sip_reg_rate\t\t0\t\t# REGISTERs per second\n"
+			  "#sip_reg_spread\t\t0\t\t# [s] jitter initial"
+			  " REGISTERs\n"
 			  "\n"
 			  ,
 			  have_cafile ? "" : "#",
@@ -876,6 +1030,9 @@ static int core_config_template(struct re_printf *pf, const struct config *cfg)
 			  "#ausrc_channels\t\t0\n"
 			  "#auplay_channels\t0\n"
 			  "audio_level\t\tno\n"
+			  "#audio_lattrace\t\tno\t\t# per-stage latency\n"
+			  "#audio_timestretch\tno\t\t# WSOLA latency control\n"
+			  "#audio_txdrift\t\tno\t\t# TX drift compensation\n"
 			  "ausrc_format\t\ts16\t\t# s16, float, ..\n"
 			  "auplay_format\t\ts16\t\t# s16, float, ..\n"
 			  "auenc_format\t\ts16\t\t# s16, float, ..\n"
@@ -884,6 +1041,7 @@ static int core_config_template(struct re_printf *pf, const struct config *cfg)
 			  "audio_silence\t\t%.1lf\t\t# in [dB]\n"
 			  "audio_telev_pt\t\t%u\t\t"
 			  "# payload type for telephone-event\n"
+			  "#audio_txmode\t\tthread\t\t# thread, pool:N\n"
 			  "\n"
 			  ,
 			  default_audio_path(),
@@ -903,6 +1061,8 @@ static int core_config_template(struct re_printf *pf, const struct config *cfg)
 			  "video_fps\t\t%.2f\n"
 			  "video_fullscreen\tno\n"
 			  "videnc_format\t\t%s\n"
+			  "#video_txbatch\t\t16\t\t# packets per send call\n"
+			  "#video_txgso\t\tno\n"
 			  ,
 			  default_video_device(),
 			  default_video_display(),
@@ -917,19 +1077,24 @@ static int core_config_template(struct re_printf *pf, const struct config *cfg)
 			  "#rtp_ports\t\t10000-20000\n"
 			  "#rtp_bandwidth\t\t512-1024 # [kbit/s]\n"
 			  "audio_jitter_buffer_type\tfixed\t\t# off, fixed,"
-				" adaptive\n"
+				" adaptive, percentile\n"
 			  "audio_jitter_buffer_ms\t%u-%u\t\t"
 				"# Min. - Max. [ms]\n"
 			  "audio_jitter_buffer_size\t50\t\t# [packets]\n"
+			  "#audio_jitter_buffer_storage\tlist\t# list, ring\n"
+			  "#audio_jitter_buffer_pct\t97\t\t# percentile [%%]\n"
 			  "video_jitter_buffer_type\tfixed\t\t# off, fixed,"
-				" adaptive\n"
+				" adaptive, percentile\n"
 			  "video_jitter_buffer_ms\t%u-%u\t\t"
 				"# Min. - Max. [ms]\n"
 			  "video_jitter_buffer_size\t250\t\t# [packets]\n"
+			  "#video_jitter_buffer_storage\tlist\t# list, ring\n"
+			  "#video_jitter_buffer_pct\t97\t\t# percentile [%%]\n"
 			  "rtp_stats\t\tno\n"
 			  "#rtp_timeout\t\t60\n"
 			  "#avt_bundle\t\tno\n"
-			  "#rtp_rxmode\t\tmain\n"
+			  "#rtp_rxmode\t\tmain\t\t# main, thread, pool:N\n"
+			  "#rtp_rxbatch\t\t0\t\t# recvmmsg batch size\n"
 			  "\n# Network\n"
 			  "#dns_server\t\t1.1.1.1:53\n"
 			  "#dns_server\t\t1.0.0.1:53\n"
@@ -1234,6 +1399,10 @@ int config_write_template(const char *file, const struct config *cfg)
 	(void)re_fprintf(f, "#dtls_srtp_use_ec\tprime256v1\n");
 	(void)re_fprintf(f, "\n");
 
+	(void)re_fprintf(f, "# Accounts file parameters\n");
+	(void)re_fprintf(f, "#account_threads\t4\t# decoder threads\n");
+	(void)re_fprintf(f, "\n");
+
 	(void)re_fprintf(f, "\n# UI Modules parameters\n");
 	(void)re_fprintf(f, "cons_listen\t\t0.0.0.0:5555 # cons - "
 				"Console UI UDP/TCP sockets\n");
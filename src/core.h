@@ -104,6 +104,63 @@ struct audio;
 int  audio_send_digit(struct audio *a, char key);
 void audio_sdp_attr_decode(struct audio *a);
 int  audio_enable_level(struct audio *au);
+int  audio_latency_encode(struct odict *od, const struct audio *a);
+
+
+/*
+ * Audio Latency Trace
+ */
+
+enum aulat_stage {
+	AULAT_TX_AUBUF = 0,
+	AULAT_TX_FILTER,
+	AULAT_TX_ENCODE,
+	AULAT_TX_SEND,
+	AULAT_RX_JBUF,
+	AULAT_RX_DECODE,
+	AULAT_RX_FILTER,
+	AULAT_RX_AUBUF,
+
+	AULAT_STAGES
+};
+
+struct aulat;
+
+int  aulat_alloc(struct aulat **alp);
+void aulat_add(struct aulat *al, enum aulat_stage stage, uint64_t usec);
+uint64_t aulat_count(const struct aulat *al, enum aulat_stage stage);
+uint64_t aulat_mean(const struct aulat *al, enum aulat_stage stage);
+uint64_t aulat_max(const struct aulat *al, enum aulat_stage stage);
+uint64_t aulat_percentile(const struct aulat *al, enum aulat_stage stage,
+			  unsigned pct);
+const char *aulat_stage_name(enum aulat_stage stage);
+int  aulat_debug(struct re_printf *pf, const struct aulat *al);
+int  aulat_odict_encode(struct odict *od_parent, const struct aulat *al);
+
+
+/*
+ * Audio Clock Drift Compensation
+ */
+
+struct audrift;
+
+int  audrift_alloc(struct audrift **adp, uint32_t ptime);
+void audrift_update(struct audrift *ad, uint64_t fill_us, uint64_t target_us,
+		    uint64_t now);
+int  audrift_process(struct audrift *ad, struct auframe *af, uint64_t now);
+int32_t audrift_ppm(const struct audrift *ad);
+
+
+/*
+ * Audio Time-Scale Modification
+ */
+
+struct autsm;
+
+int  autsm_alloc(struct autsm **tsmp);
+int  autsm_process(struct autsm *tsm, struct auframe *af, int64_t delta_us);
+uint64_t autsm_compressed(const struct autsm *tsm);
+uint64_t autsm_expanded(const struct autsm *tsm);
 
 
 /*
@@ -126,6 +183,7 @@ int  aurecv_payload_type(const struct audio_recv *ar);
 int  aurecv_filt_append(struct audio_recv *ar, struct aufilt_dec_st *decst);
 void aurecv_flush(struct audio_recv *ar);
 void aurecv_set_extmap(struct audio_recv *ar, uint8_t aulevel);
+void aurecv_set_aulat(struct audio_recv *ar, struct aulat *al);
 int  aurecv_set_module(struct audio_recv *ar, const char *module);
 int  aurecv_set_device(struct audio_recv *ar, const char *device);
 void aurecv_receive(struct audio_recv *ar, const struct rtp_header *hdr,
@@ -184,6 +242,14 @@ const struct sa *call_laddr(const struct call *call);
 int call_streams_alloc(struct call *call);
 int call_modify_nosdp(struct call *call);
 
+typedef bool (call_match_h)(const struct call *call, void *arg);
+
+struct call *call_index_find(const struct pl *id, const struct ua *ua,
+			     call_match_h *matchh, void *arg);
+struct call *call_index_find_last(const struct pl *id, const struct ua *ua,
+				  call_match_h *matchh, void *arg);
+uint32_t call_gen(void);
+
 /*
 * Custom headers
 */
@@ -204,10 +270,10 @@ int      metric_init(struct metric *metric);
 void     metric_reset(struct metric *metric);
 void     metric_add_packet(struct metric *metric, size_t packetsize);
 double   metric_avg_bitrate(const struct metric *metric);
-uint32_t metric_n_packets(struct metric *metric);
-uint32_t metric_n_bytes(struct metric *metric);
-uint32_t metric_n_err(struct metric *metric);
-uint32_t metric_bitrate(struct metric *metric);
+uint64_t metric_n_packets(const struct metric *metric);
+uint64_t metric_n_bytes(const struct metric *metric);
+uint64_t metric_n_err(const struct metric *metric);
+uint32_t metric_bitrate(const struct metric *metric);
 void     metric_inc_err(struct metric *metric);
 
 struct metric *metric_alloc(void);
@@ -239,6 +305,34 @@ int  reg_af(const struct reg *reg);
 const struct sa *reg_laddr(const struct reg *reg);
 const struct sa *reg_paddr(const struct reg *reg);
 void reg_set_custom_hdrs(struct reg *reg, const struct list *hdrs);
+int  reg_sched_debug(struct re_printf *pf);
+void reg_sched_stats(uint64_t *sent, uint64_t *wait_sum,
+		     uint32_t *depth_max);
+
+/*
+ * RTP Receive Batch
+ */
+
+struct rxbatch;
+
+int rxbatch_alloc(struct rxbatch **rbp, struct udp_sock *us, uint32_t n);
+int rxbatch_debug(struct re_printf *pf, struct rxbatch *rb);
+void rxbatch_stats(uint64_t *calls, uint64_t *pkts);
+
+
+/*
+ * RTP Receive Pool
+ */
+
+struct rxpool_member;
+
+typedef void (rxpool_h)(void *arg);
+
+int rxpool_attach(struct rxpool_member **mp, uint32_t thrdc,
+		  rxpool_h *attachh, rxpool_h *detachh, void *arg);
+int rxpool_debug(struct re_printf *pf, void *unused);
+void rxpool_stats(uint64_t *attached, uint64_t *detached);
+
 
 /*
  * RTP Stats
@@ -271,7 +365,7 @@ enum bundle_state {
 
 struct bundle;
 
-int  bundle_alloc(struct bundle **bunp);
+int  bundle_alloc(struct bundle **bunp, struct stream *strm);
 void bundle_handle_extmap(struct bundle *bun, struct sdp_media *sdp);
 int  bundle_start_socket(struct bundle *bun, struct udp_sock *us,
 			 struct list *streaml);
@@ -280,12 +374,25 @@ uint8_t bundle_extmap_mid(const struct bundle *bun);
 int bundle_set_extmap(struct bundle *bun, struct sdp_media *sdp,
 		      uint8_t extmap_mid);
 void bundle_set_state(struct bundle *bun, enum bundle_state st);
+void bundle_set_ssrc(struct bundle *bun, uint32_t ssrc);
 int  bundle_debug(struct re_printf *pf, const struct bundle *bun);
 
 
 const char *bundle_state_name(enum bundle_state st);
 
 
+/*
+ * Single-Producer/Single-Consumer Queue
+ */
+
+struct spscq;
+
+int    spscq_alloc(struct spscq **qp, size_t sz, size_t itemsz);
+int    spscq_push(struct spscq *q, const void *item);
+int    spscq_pop(struct spscq *q, void *item);
+size_t spscq_count(struct spscq *q);
+
+
 /*
  * Stream
  */
@@ -332,6 +439,8 @@ struct rtp_sock *stream_rtp_sock(const struct stream *strm);
 const struct sa *stream_raddr(const struct stream *strm);
 const char *stream_mid(const struct stream *strm);
 uint8_t stream_generate_extmap_id(struct stream *strm);
+struct metric *stream_metric_tx(const struct stream *strm);
+struct metric *stream_metric_rx(const struct stream *strm);
 
 /* Send */
 void stream_update_encoder(struct stream *s, int pt_enc);
@@ -341,9 +450,15 @@ int  stream_send(struct stream *s, bool ext, bool marker, int pt, uint32_t ts,
 int  stream_resend(struct stream *s, uint16_t seq, bool ext, bool marker,
 		  int pt, uint32_t ts, struct mbuf *mb);
 
+/* Transmit batch */
+int  stream_enable_txbatch(struct stream *strm, uint32_t n, bool gso);
+void stream_hold_txbatch(struct stream *strm);
+void stream_flush_txbatch(struct stream *strm);
+
 /* Receive */
 void stream_flush(struct stream *s);
 int  stream_ssrc_rx(const struct stream *strm, uint32_t *ssrc);
+int  stream_set_aulat(struct stream *strm, struct aulat *al);
 
 
 struct bundle *stream_bundle(const struct stream *strm);
@@ -357,6 +472,35 @@ void stream_mnat_connected(struct stream *strm, const struct sa *raddr1,
 			   const struct sa *raddr2);
 
 
+/*
+ * Transmit Batch
+ */
+
+struct txbatch;
+
+int  txbatch_alloc(struct txbatch **tbp, struct udp_sock *us, uint32_t n,
+		   bool gso);
+void txbatch_hold(struct txbatch *tb);
+void txbatch_flush(struct txbatch *tb);
+int  txbatch_debug(struct re_printf *pf, struct txbatch *tb);
+void txbatch_stats(uint64_t *calls, uint64_t *pkts);
+
+
+/*
+ * Transmit scheduler
+ */
+
+struct txsched_job;
+
+typedef void (txsched_h)(void *arg);
+
+int  txsched_job_alloc(struct txsched_job **jobp, uint32_t thrdc,
+		       uint32_t period, txsched_h *h, void *arg);
+void txsched_job_set_period(struct txsched_job *job, uint32_t period);
+int  txsched_debug(struct re_printf *pf, void *unused);
+void txsched_stats(uint64_t *runs, uint64_t *late);
+
+
 /*
  * User-Agent
  */
@@ -404,6 +548,13 @@ bool uag_delayed_close(void);
 sip_msg_h *uag_subh(void);
 int uag_raise(struct ua *ua, struct le *le);
 
+struct uag_entry;
+
+int  uag_index_add(struct uag_entry **entp, struct ua *ua);
+void uag_index_update(struct uag_entry *ent);
+void uag_index_raise(struct uag_entry *ent);
+bool uag_user_exists(const struct pl *user);
+
 void u32mask_enable(uint32_t *mask, uint8_t bit, bool enable);
 bool u32mask_enabled(uint32_t mask, uint8_t bit);
 
@@ -512,14 +663,17 @@ void rtprecv_set_ssrc(struct rtp_receiver *rx, uint32_t ssrc);
 uint64_t rtprecv_ts_last(struct rtp_receiver *rx);
 void rtprecv_set_ts_last(struct rtp_receiver *rx, uint64_t ts_last);
 void rtprecv_flush(struct rtp_receiver *rx);
+void rtprecv_close(struct rtp_receiver *rx);
 void rtprecv_enable(struct rtp_receiver *rx, bool enable);
 int  rtprecv_get_ssrc(struct rtp_receiver *rx, uint32_t *ssrc);
 void rtprecv_enable_mux(struct rtp_receiver *rx, bool enable);
 int  rtprecv_debug(struct re_printf *pf, const struct rtp_receiver *rx);
 int  rtprecv_start_thread(struct rtp_receiver *rx);
+int  rtprecv_start_pool(struct rtp_receiver *rx, uint32_t thrdc);
 void rtprecv_mnat_connected_handler(const struct sa *raddr1,
 				    const struct sa *raddr2, void *arg);
 int  rtprecv_start_rtcp(struct rtp_receiver *rx, const char *cname,
 			const struct sa *peer, bool pinhole);
 bool rtprecv_running(const struct rtp_receiver *rx);
 void rtprecv_set_srate(struct rtp_receiver *rx, uint32_t srate);
+int  rtprecv_set_aulat(struct rtp_receiver *rx, struct aulat *al);
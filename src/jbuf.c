@@ -21,7 +21,7 @@
 #include <re_dbg.h>
 
 
-#ifndef RELEASE
+#ifndef JBUF_STAT
 #define JBUF_STAT 1  /**< Jitter buffer statistics */
 #endif
 
@@ -41,7 +41,12 @@
 enum {
 	JBUF_LATE_TRESHOLD = 3,
 	JBUF_MAX_DRIFT	   = 20,       /* [ms] */
-	JBUF_DRIFT_WINDOW  = 10 * 1000 /* [ms] */
+	JBUF_DRIFT_WINDOW  = 10 * 1000, /* [ms] */
+	JBUF_RING_MAX      = 32768,    /* [packets] */
+	JBUF_PCT_WINDOW    = 256,      /* [frames] delay histogram window */
+	JBUF_PCT_BUCKETS   = 256,      /* Delay histogram buckets         */
+	JBUF_PCT_BUCKET_MS = 2,        /* [ms] Delay histogram resolution */
+	JBUF_PCT_DEFAULT   = 97,       /* [%] Default delay percentile    */
 };
 
 /** Defines a packet frame */
@@ -50,6 +55,7 @@ struct packet {
 	uint32_t playout_time;  /**< Playout time              */
 	struct rtp_header hdr;  /**< RTP Header                */
 	void *mem;              /**< Reference counted pointer */
+	bool used;              /**< Ring slot is in use       */
 };
 
 
@@ -64,6 +70,13 @@ struct jbuf {
 	struct rtp_sock *gnack_rtp; /**< Generic NACK RTP Socket             */
 	struct list pooll;   /**< List of free packets in pool               */
 	struct list packetl; /**< List of buffered packets                   */
+	struct {
+		struct packet *v; /**< Packet slots indexed by seq % sz      */
+		uint32_t sz;      /**< Number of slots (power of two)        */
+		uint16_t head;    /**< Sequence number of oldest packet      */
+		uint16_t tail;    /**< Sequence number of newest packet      */
+	} ring;              /**< Ring storage (JBUF_STORAGE_RING)           */
+	enum jbuf_storage storage; /**< Packet storage mode                */
 	uint32_t n;          /**< [# packets] Current # of packets in buffer */
 	uint32_t mind;       /**< Minimum time in [ms] to delay              */
 	uint32_t maxd;       /**< Maximum time in [ms] to delay              */
@@ -83,6 +96,13 @@ struct jbuf {
 		uint64_t skewt;		 /**< Last skew window time          */
 		int32_t max_skew_ms;	 /**< Max. skew in [ms]              */
 	} p;                 /**< Playout specific values                    */
+	struct {
+		uint16_t histv[JBUF_PCT_BUCKETS]; /**< Delay histogram       */
+		uint8_t winv[JBUF_PCT_WINDOW];    /**< Bucket of each frame  */
+		uint32_t n;      /**< Number of frames in the window         */
+		uint32_t idx;    /**< Next window slot                       */
+		uint32_t pct;    /**< Target percentile [%]                  */
+	} pct;               /**< Delay histogram (JBUF_PERCENTILE)          */
 	jbuf_next_play_h *next_play_h;   /**< Next playout function          */
 	bool running;        /**< Jitter buffer is running                   */
 
@@ -111,6 +131,20 @@ static uint64_t next_play(const struct jbuf *jb)
 }
 
 
+static void overflow_warning(struct jbuf *jb, const struct packet *f0)
+{
+#if JBUF_STAT
+	STAT_INC(n_overflow);
+	DEBUG_WARNING("drop 1 old frame seq=%u (total dropped %u)\n",
+		      f0->hdr.seq, jb->stat.n_overflow);
+#else
+	DEBUG_WARNING("drop 1 old frame seq=%u\n", f0->hdr.seq);
+#endif
+
+	RE_TRACE_ID_INSTANT("jbuf", "overflow", jb->id);
+}
+
+
 /**
  * Get a frame from the pool
  */
@@ -131,15 +165,7 @@ static void packet_alloc(struct jbuf *jb, struct packet **f)
 		le = jb->packetl.head;
 		f0 = le->data;
 
-#if JBUF_STAT
-		STAT_INC(n_overflow);
-		DEBUG_WARNING("drop 1 old frame seq=%u (total dropped %u)\n",
-			   f0->hdr.seq, jb->stat.n_overflow);
-#else
-		DEBUG_WARNING("drop 1 old frame seq=%u\n", f0->hdr.seq);
-#endif
-
-		RE_TRACE_ID_INSTANT("jbuf", "overflow", jb->id);
+		overflow_warning(jb, f0);
 		f0->mem = mem_deref(f0->mem);
 		list_unlink(le);
 	}
@@ -148,16 +174,103 @@ static void packet_alloc(struct jbuf *jb, struct packet **f)
 }
 
 
+/** Get the ring slot of a sequence number */
+static inline struct packet *ring_slot(const struct jbuf *jb, uint16_t seq)
+{
+	return &jb->ring.v[seq & (jb->ring.sz - 1)];
+}
+
+
 /**
  * Release a packet, put it back in the pool
  */
 static void packet_deref(struct jbuf *jb, struct packet *f)
 {
 	f->mem = mem_deref(f->mem);
-	list_unlink(&f->le);
-	list_append(&jb->pooll, &f->le, f);
 	--jb->n;
 	STAT_DEC(c_packets);
+
+	if (jb->storage == JBUF_STORAGE_RING) {
+		f->used = false;
+
+		/* Move head to the oldest buffered packet */
+		while (jb->n && !ring_slot(jb, jb->ring.head)->used)
+			++jb->ring.head;
+
+		/* Move tail to the newest buffered packet */
+		while (jb->n && !ring_slot(jb, jb->ring.tail)->used)
+			--jb->ring.tail;
+
+		return;
+	}
+
+	list_unlink(&f->le);
+	list_append(&jb->pooll, &f->le, f);
+}
+
+
+/** Get the oldest packet */
+static struct packet *packet_head(const struct jbuf *jb)
+{
+	if (jb->storage == JBUF_STORAGE_RING)
+		return jb->n ? ring_slot(jb, jb->ring.head) : NULL;
+
+	return jb->packetl.head ? jb->packetl.head->data : NULL;
+}
+
+
+/** Get the next buffered packet after p */
+static struct packet *packet_next(const struct jbuf *jb,
+				  const struct packet *p)
+{
+	if (jb->storage == JBUF_STORAGE_RING) {
+		uint16_t seq = p->hdr.seq;
+
+		while (seq != jb->ring.tail) {
+			struct packet *f = ring_slot(jb, ++seq);
+			if (f->used)
+				return f;
+		}
+
+		return NULL;
+	}
+
+	return p->le.next ? p->le.next->data : NULL;
+}
+
+
+/** Get the previous buffered packet before p */
+static struct packet *packet_prev(const struct jbuf *jb,
+				  const struct packet *p)
+{
+	if (jb->storage == JBUF_STORAGE_RING) {
+		uint16_t seq = p->hdr.seq;
+
+		while (seq != jb->ring.head) {
+			struct packet *f = ring_slot(jb, --seq);
+			if (f->used)
+				return f;
+		}
+
+		return NULL;
+	}
+
+	return p->le.prev ? p->le.prev->data : NULL;
+}
+
+
+static int pool_alloc(struct jbuf *jb)
+{
+	for (uint32_t i = 0; i < jb->maxsz; i++) {
+		struct packet *f = mem_zalloc(sizeof(*f), NULL);
+		if (!f)
+			return ENOMEM;
+
+		list_append(&jb->pooll, &f->le, f);
+		DEBUG_INFO("alloc: adding to pool list %u\n", i);
+	}
+
+	return 0;
 }
 
 
@@ -169,6 +282,7 @@ static void jbuf_destructor(void *data)
 
 	/* Free all packets in the pool list */
 	list_flush(&jb->pooll);
+	mem_deref(jb->ring.v);
 	mem_deref(jb->lock);
 	mem_deref(jb->id);
 }
@@ -187,7 +301,6 @@ static void jbuf_destructor(void *data)
 int jbuf_alloc(struct jbuf **jbp, uint32_t mind, uint32_t maxd, uint32_t maxsz)
 {
 	struct jbuf *jb;
-	uint32_t i;
 	int err = 0;
 
 	if (!jbp)
@@ -208,6 +321,8 @@ int jbuf_alloc(struct jbuf **jbp, uint32_t mind, uint32_t maxd, uint32_t maxsz)
 	list_init(&jb->packetl);
 
 	jb->jbtype	= JBUF_FIXED;
+	jb->storage	= JBUF_STORAGE_LIST;
+	jb->pct.pct	= JBUF_PCT_DEFAULT;
 	jb->mind	= mind;
 	jb->maxd	= maxd;
 	jb->maxsz	= maxsz;
@@ -222,16 +337,7 @@ int jbuf_alloc(struct jbuf **jbp, uint32_t mind, uint32_t maxd, uint32_t maxsz)
 	mem_destructor(jb, jbuf_destructor);
 
 	/* Allocate all packets now */
-	for (i = 0; i < jb->maxsz; i++) {
-		struct packet *f = mem_zalloc(sizeof(*f), NULL);
-		if (!f) {
-			err = ENOMEM;
-			break;
-		}
-
-		list_append(&jb->pooll, &f->le, f);
-		DEBUG_INFO("alloc: adding to pool list %u\n", i);
-	}
+	err = pool_alloc(jb);
 
 out:
 	if (err)
@@ -296,6 +402,99 @@ int jbuf_set_type(struct jbuf *jb, enum jbuf_type jbtype)
 }
 
 
+/**
+ * Set the delay percentile for the percentile jitter buffer type.
+ *
+ * The playout delay is chosen so that this percentage of the recent
+ * frames arrive in time. The remaining frames are late, so 100 minus
+ * the percentile is the loss target.
+ *
+ * @param jb   The jitter buffer.
+ * @param pct  Delay percentile (1-100)
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int jbuf_set_percentile(struct jbuf *jb, uint32_t pct)
+{
+	if (!jb || !pct || pct > 100)
+		return EINVAL;
+
+	mtx_lock(jb->lock);
+	jb->pct.pct = pct;
+	mtx_unlock(jb->lock);
+
+	return 0;
+}
+
+
+/**
+ * Set jitter buffer packet storage.
+ *
+ * The ring storage keeps all packets in one contiguous array indexed by
+ * sequence number, which gives O(1) insert, duplicate and loss detection.
+ * The storage can only be changed while the jitter buffer is empty.
+ *
+ * @param jb       The jitter buffer.
+ * @param storage  The packet storage mode.
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int jbuf_set_storage(struct jbuf *jb, enum jbuf_storage storage)
+{
+	int err = 0;
+
+	if (!jb)
+		return EINVAL;
+
+	mtx_lock(jb->lock);
+
+	if (storage == jb->storage)
+		goto out;
+
+	if (jb->n) {
+		err = EBUSY;
+		goto out;
+	}
+
+	if (storage == JBUF_STORAGE_RING) {
+		uint32_t sz = 2;
+
+		if (jb->maxsz > JBUF_RING_MAX) {
+			err = EINVAL;
+			goto out;
+		}
+
+		while (sz < jb->maxsz)
+			sz <<= 1;
+
+		jb->ring.v = mem_zalloc(sz * sizeof(*jb->ring.v), NULL);
+		if (!jb->ring.v) {
+			err = ENOMEM;
+			goto out;
+		}
+
+		jb->ring.sz = sz;
+		list_flush(&jb->pooll);
+	}
+	else {
+		err = pool_alloc(jb);
+		if (err) {
+			list_flush(&jb->pooll);
+			goto out;
+		}
+
+		jb->ring.v  = mem_deref(jb->ring.v);
+		jb->ring.sz = 0;
+	}
+
+	jb->storage = storage;
+
+out:
+	mtx_unlock(jb->lock);
+	return err;
+}
+
+
 /**
  * Set rtp socket for RTCP Generic NACK handling
  *
@@ -425,6 +624,65 @@ static inline uint32_t offset(struct packet *p)
 }
 
 
+/*
+ * Percentile based delay (like NetEQ): The delay of each frame relative
+ * to the fastest frame is put into a histogram over a sliding window.
+ * The playout delay is the configured percentile of the histogram, so
+ * it grows with the first late frames and shrinks as soon as the delay
+ * spikes have left the window.
+ */
+static uint32_t adjust_due_to_percentile(struct jbuf *jb, struct packet *p)
+{
+	uint32_t d_ms = delay_ms(offset(p) - jb->p.offset, jb->srate);
+	uint32_t b = min(d_ms / JBUF_PCT_BUCKET_MS, JBUF_PCT_BUCKETS - 1);
+	uint32_t slot = jb->pct.idx++ % JBUF_PCT_WINDOW;
+	uint32_t rank, cum = 0;
+	uint32_t i;
+
+	/* Replace the oldest frame in the window */
+	if (jb->pct.n == JBUF_PCT_WINDOW)
+		--jb->pct.histv[jb->pct.winv[slot]];
+	else
+		++jb->pct.n;
+
+	jb->pct.winv[slot] = (uint8_t)b;
+	++jb->pct.histv[b];
+
+	rank = (jb->pct.n * jb->pct.pct + 99) / 100;
+
+	for (i = 0; i < JBUF_PCT_BUCKETS - 1; i++) {
+		cum += jb->pct.histv[i];
+		if (cum >= rank)
+			break;
+	}
+
+	uint32_t target_ms = (i + 1) * JBUF_PCT_BUCKET_MS;
+
+	RE_TRACE_ID_INSTANT_I("jbuf", "pct_delay", target_ms, jb->id);
+
+	return target_ms * (jb->srate / 1000);
+}
+
+
+/* Percentage of the frames in the window with a delay below delay_ms */
+static uint32_t percentile_covered(const struct jbuf *jb, uint32_t d_ms)
+{
+	uint32_t cum = 0;
+
+	if (!jb->pct.n)
+		return 0;
+
+	for (uint32_t i = 0; i < JBUF_PCT_BUCKETS; i++) {
+		if ((i + 1) * JBUF_PCT_BUCKET_MS > d_ms)
+			break;
+
+		cum += jb->pct.histv[i];
+	}
+
+	return 100 * cum / jb->pct.n;
+}
+
+
 static uint32_t calc_playout_time(struct jbuf *jb, struct packet *p)
 {
 	/* Fragmented frames (like video) have equal playout_time.
@@ -432,12 +690,9 @@ static uint32_t calc_playout_time(struct jbuf *jb, struct packet *p)
 	 * should be fine too, since its based on same sender hdr.ts.
 	 * This is also needed to prevent jitter miscalculations
 	 */
-	if (p->le.prev) {
-		struct packet *prevp = p->le.prev->data;
-		if (prevp->hdr.ts == p->hdr.ts) {
-			return prevp->playout_time;
-		}
-	}
+	struct packet *prevp = packet_prev(jb, p);
+	if (prevp && prevp->hdr.ts == p->hdr.ts)
+		return prevp->playout_time;
 
 	/* Compensating relative clock offset between sender and receiver */
 	if (!jb->p.offset)
@@ -453,6 +708,9 @@ static uint32_t calc_playout_time(struct jbuf *jb, struct packet *p)
 		/* Jitter compensation */
 		jitter_offset = adjust_due_to_jitter(jb, p);
 	}
+	else if (jb->jbtype == JBUF_PERCENTILE) {
+		jitter_offset = adjust_due_to_percentile(jb, p);
+	}
 
 	/* Check min/max latency requirements */
 	uint32_t min_lat = (jb->srate / 1000) * jb->mind;
@@ -466,6 +724,12 @@ static uint32_t calc_playout_time(struct jbuf *jb, struct packet *p)
 	RE_TRACE_ID_INSTANT_I("jbuf", "play_delay",
 			      delay_ms(jitter_offset, jb->srate), jb->id);
 	STAT_SET(c_delay, delay_ms(jitter_offset, jb->srate));
+#if JBUF_STAT
+	if (jb->jbtype == JBUF_PERCENTILE) {
+		STAT_SET(c_delay_pct,
+			 percentile_covered(jb, jb->stat.c_delay));
+	}
+#endif
 
 	return play_time_base + jitter_offset;
 }
@@ -492,70 +756,22 @@ static inline void send_gnack(struct jbuf *jb, uint16_t pid, int16_t blp_pkts)
 
 
 /**
- * Put one packet into the jitter buffer
- *
- * @param jb   Jitter buffer
- * @param hdr  RTP Header
- * @param mem  Memory pointer - will be referenced
- *
- * @return 0 if success, otherwise errorcode
+ * Insert a packet into the sorted packet list
  */
-int jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem)
+static int insert_list(struct jbuf *jb, uint16_t seq, struct packet **fp)
 {
 	struct packet *f;
 	struct le *le, *tail;
-	uint16_t seq;
-	int err = 0;
-
-	if (!jb || !hdr)
-		return EINVAL;
-
-	if (!hdr->ts_arrive) {
-		DEBUG_WARNING("invalid ts_arrive header!\n");
-		return EINVAL;
-	}
-
-	seq = hdr->seq;
-
-	if (jb->ssrc && jb->ssrc != hdr->ssrc) {
-		DEBUG_INFO("ssrc changed %u %u\n", jb->ssrc, hdr->ssrc);
-		jbuf_flush(jb);
-	}
-
-	mtx_lock(jb->lock);
-
-	if (!jb->srate) {
-		DEBUG_WARNING("no clock srate set!\n");
-		err = EINVAL;
-		goto out;
-	}
-
-	jb->ssrc = hdr->ssrc;
-
-	if (jb->running) {
-		/* Packet arrived too late by sequence to be put into buffer */
-		if (jb->seq_get && rtp_seq_less(seq, jb->seq_get + 1)) {
-			STAT_INC(n_late_lost);
-			jb->p.late_pkts++;
-
-			DEBUG_INFO("packet too late: seq=%u "
-				   "(seq_put=%u seq_get=%u)\n",
-				   seq, jb->seq_put, jb->seq_get);
-			err = ETIMEDOUT;
-			goto out;
-		}
-	}
-
-	STAT_INC(n_put);
 
 	packet_alloc(jb, &f);
+	*fp = f;
 
 	tail = jb->packetl.tail;
 
 	/* If buffer is empty -> append to tail */
 	if (!tail) {
 		list_append(&jb->packetl, &f->le, f);
-		goto success;
+		return 0;
 	}
 
 	uint16_t last_seq = ((struct packet *)tail->data)->hdr.seq;
@@ -568,7 +784,7 @@ int jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem)
 			send_gnack(jb, last_seq + 1, seq_diff - 2);
 
 		list_append(&jb->packetl, &f->le, f);
-		goto success;
+		return 0;
 	}
 
 	/* Out-of-sequence, find right position */
@@ -589,8 +805,7 @@ int jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem)
 			RE_TRACE_ID_INSTANT("jbuf", "duplicate", jb->id);
 			list_insert_after(&jb->packetl, le, &f->le, f);
 			packet_deref(jb, f);
-			err = EALREADY;
-			goto out;
+			return EALREADY;
 		}
 
 		/* sequence number less than current seq, continue */
@@ -606,7 +821,154 @@ int jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem)
 	STAT_INC(n_oos);
 	RE_TRACE_ID_INSTANT("jbuf", "out-of-sequence", jb->id);
 
-success:
+	return 0;
+}
+
+
+/**
+ * Insert a packet into the ring slot of its sequence number
+ */
+static int insert_ring(struct jbuf *jb, uint16_t seq, struct packet **fp)
+{
+	struct packet *f;
+
+	if (!jb->n) {
+		jb->ring.head = seq;
+		jb->ring.tail = seq;
+		goto insert;
+	}
+
+	/* Frame is later than tail -> new tail */
+	if (rtp_seq_less(jb->ring.tail, seq)) {
+		const int16_t seq_diff = seq - jb->ring.tail;
+
+		if (jb->gnack_rtp && seq_diff > 1)
+			send_gnack(jb, jb->ring.tail + 1, seq_diff - 2);
+
+		/* Drop old frames which are full or outside the window */
+		while (jb->n && (jb->n >= jb->maxsz ||
+				 (uint16_t)(seq - jb->ring.head) >=
+				 jb->ring.sz)) {
+			f = ring_slot(jb, jb->ring.head);
+			overflow_warning(jb, f);
+			packet_deref(jb, f);
+		}
+
+		if (!jb->n)
+			jb->ring.head = seq;
+
+		jb->ring.tail = seq;
+		goto insert;
+	}
+
+	/* Out-of-sequence */
+	f = ring_slot(jb, seq);
+	if (f->used && f->hdr.seq == seq) {
+		DEBUG_INFO("duplicate: seq=%u\n", seq);
+		STAT_INC(n_dups);
+		RE_TRACE_ID_INSTANT("jbuf", "duplicate", jb->id);
+		return EALREADY;
+	}
+
+	if ((uint16_t)(jb->ring.tail - seq) >= jb->ring.sz) {
+		DEBUG_INFO("put: out-of-sequence outside window (seq=%u)\n",
+			   seq);
+		STAT_INC(n_late_lost);
+		jb->p.late_pkts++;
+		return ETIMEDOUT;
+	}
+
+	if (jb->n >= jb->maxsz) {
+		struct packet *f0 = ring_slot(jb, jb->ring.head);
+
+		overflow_warning(jb, f0);
+		packet_deref(jb, f0);
+	}
+
+	if (!jb->n || rtp_seq_less(seq, jb->ring.head))
+		jb->ring.head = seq;
+
+	if (!jb->n)
+		jb->ring.tail = seq;
+
+	STAT_INC(n_oos);
+	RE_TRACE_ID_INSTANT("jbuf", "out-of-sequence", jb->id);
+
+ insert:
+	f = ring_slot(jb, seq);
+	f->used = true;
+	++jb->n;
+	STAT_INC(c_packets);
+
+	*fp = f;
+
+	return 0;
+}
+
+
+/**
+ * Put one packet into the jitter buffer
+ *
+ * @param jb   Jitter buffer
+ * @param hdr  RTP Header
+ * @param mem  Memory pointer - will be referenced
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int jbuf_put(struct jbuf *jb, const struct rtp_header *hdr, void *mem)
+{
+	struct packet *f;
+	uint16_t seq;
+	int err = 0;
+
+	if (!jb || !hdr)
+		return EINVAL;
+
+	if (!hdr->ts_arrive) {
+		DEBUG_WARNING("invalid ts_arrive header!\n");
+		return EINVAL;
+	}
+
+	seq = hdr->seq;
+
+	if (jb->ssrc && jb->ssrc != hdr->ssrc) {
+		DEBUG_INFO("ssrc changed %u %u\n", jb->ssrc, hdr->ssrc);
+		jbuf_flush(jb);
+	}
+
+	mtx_lock(jb->lock);
+
+	if (!jb->srate) {
+		DEBUG_WARNING("no clock srate set!\n");
+		err = EINVAL;
+		goto out;
+	}
+
+	jb->ssrc = hdr->ssrc;
+
+	if (jb->running) {
+		/* Packet arrived too late by sequence to be put into buffer */
+		if (jb->seq_get && rtp_seq_less(seq, jb->seq_get + 1)) {
+			STAT_INC(n_late_lost);
+			jb->p.late_pkts++;
+
+			DEBUG_INFO("packet too late: seq=%u "
+				   "(seq_put=%u seq_get=%u)\n",
+				   seq, jb->seq_put, jb->seq_get);
+			err = ETIMEDOUT;
+			goto out;
+		}
+	}
+
+	STAT_INC(n_put);
+
+	if (jb->storage == JBUF_STORAGE_RING)
+		err = insert_ring(jb, seq, &f);
+	else
+		err = insert_list(jb, seq, &f);
+	if (err)
+		goto out;
+
 	/* Update last sequence */
 	jb->running = true;
 	jb->seq_put = seq;
@@ -685,13 +1047,12 @@ int jbuf_get(struct jbuf *jb, struct rtp_header *hdr, void **mem)
 
 	RE_TRACE_ID_INSTANT_I("jbuf", "get", jb->n, jb->id);
 
-	if (!jb->packetl.head) {
+	f = packet_head(jb);
+	if (!f) {
 		err = ENOENT;
 		goto out;
 	}
 
-	f = jb->packetl.head->data;
-
 	uint32_t next_playout = (uint32_t)jb->next_play_h(jb);
 
 	/* Check playout time */
@@ -723,8 +1084,7 @@ int jbuf_get(struct jbuf *jb, struct rtp_header *hdr, void **mem)
 	/* Update sequence number for 'get' */
 	jb->seq_get = f->hdr.seq;
 
-	if (f->le.next)
-		nextp = f->le.next->data;
+	nextp = packet_next(jb, f);
 
 	packet_deref(jb, f);
 
@@ -759,7 +1119,8 @@ int jbuf_drain(struct jbuf *jb, struct rtp_header *hdr, void **mem)
 
 	mtx_lock(jb->lock);
 
-	if (jb->n <= 0 || !jb->packetl.head) {
+	f = packet_head(jb);
+	if (jb->n <= 0 || !f) {
 		err = ENOENT;
 		goto out;
 	}
@@ -768,8 +1129,6 @@ int jbuf_drain(struct jbuf *jb, struct rtp_header *hdr, void **mem)
 	   is present and have a seq no. of seq[i] + 1.
 	   If not, we should consider that packet lost. */
 
-	f = jb->packetl.head->data;
-
 	/* Update sequence number for 'get' */
 	jb->seq_get = f->hdr.seq;
 
@@ -791,7 +1150,7 @@ out:
  */
 void jbuf_flush(struct jbuf *jb)
 {
-	struct le *le;
+	struct packet *f;
 #if JBUF_STAT
 	uint32_t n_flush;
 #endif
@@ -800,16 +1159,15 @@ void jbuf_flush(struct jbuf *jb)
 		return;
 
 	mtx_lock(jb->lock);
-	if (jb->packetl.head) {
+	if (jb->n) {
 		DEBUG_INFO("flush: %u frames\n", jb->n);
 	}
 
 	/* put all buffered frames back in free list */
-	for (le = jb->packetl.head; le; le = jb->packetl.head) {
-		DEBUG_INFO(" flush frame: seq=%u\n",
-			   ((struct packet *)(le->data))->hdr.seq);
+	while ((f = packet_head(jb))) {
+		DEBUG_INFO(" flush frame: seq=%u\n", f->hdr.seq);
 
-		packet_deref(jb, le->data);
+		packet_deref(jb, f);
 	}
 
 	jb->n       = 0;
@@ -818,6 +1176,9 @@ void jbuf_flush(struct jbuf *jb)
 
 	/* Reset playout */
 	memset(&jb->p, 0, sizeof(jb->p));
+	memset(jb->pct.histv, 0, sizeof(jb->pct.histv));
+	jb->pct.n   = 0;
+	jb->pct.idx = 0;
 
 #if JBUF_STAT
 	n_flush = STAT_INC(n_flush);
@@ -871,13 +1232,12 @@ int32_t jbuf_next_play(const struct jbuf *jb)
 
 	mtx_lock(jb->lock);
 
-	if (!jb->packetl.head) {
+	struct packet *p = packet_head(jb);
+	if (!p) {
 		ret = -ENOENT;
 		goto out;
 	}
 
-	struct packet *p = jb->packetl.head->data;
-
 	/* Wrong sequence order (late/reorder), next play would be to high */
 	if (p->hdr.seq != (uint16_t)(jb->seq_get + 1)) {
 		ret = -EPROTO;
@@ -966,10 +1326,15 @@ int jbuf_debug(struct re_printf *pf, const struct jbuf *jb)
 	err |= mbuf_printf(mb, "--- jitter buffer debug---\n");
 
 	mtx_lock(jb->lock);
-	err |= mbuf_printf(mb, " running=%d", jb->running);
+	err |= mbuf_printf(mb, " running=%d storage=%s", jb->running,
+			  jb->storage == JBUF_STORAGE_RING ? "ring" : "list");
 	err |= mbuf_printf(mb, " min=%ums cur=%u max=%ums [packets]\n",
 			  jb->mind, jb->n, jb->maxd);
 	err |= mbuf_printf(mb, " seq_put=%u\n", jb->seq_put);
+	if (jb->jbtype == JBUF_PERCENTILE) {
+		err |= mbuf_printf(mb, " percentile=%u%% window=%u\n",
+				   jb->pct.pct, jb->pct.n);
+	}
 
 #if JBUF_STAT
 	err |= mbuf_printf(mb, " Stat: put=%u", jb->stat.n_put);
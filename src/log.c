@@ -4,22 +4,103 @@
  * Copyright (C) 2010 Alfred E. Heggestad
  */
 
+#include <string.h>
 #include <re.h>
+#include <re_atomic.h>
 #include <baresip.h>
 
 
+/**
+ * \page AsyncLog Asynchronous logging
+ *
+ * In asynchronous mode the log functions only format the message and push
+ * the record into a lock-free ring buffer owned by the calling thread.
+ * A writer thread drains the ring buffers and writes the records to
+ * stdout and to the registered log handlers, so a slow terminal or syslog
+ * does not block real-time threads.
+ *
+ * Each ring buffer is a single-producer/single-consumer queue of variable
+ * length records. Records carry a global sequence number, so the writer
+ * can output the records of all threads in the order they were logged.
+ * If a ring buffer is full, the record is dropped and counted.
+ *
+ * The ring buffers are allocated up front, within the memory budget, and
+ * a thread claims a free one when it logs for the first time. The writer
+ * releases the ring buffer of an exited thread when it is drained. Threads
+ * that log when all ring buffers are in use fall back to synchronous
+ * logging.
+ *
+ * The writer thread holds no lock that a logging thread can wait for,
+ * except the lock of the log handler list, which is only taken by threads
+ * that log synchronously and when handlers are registered.
+ */
+
+
+enum {
+	LOG_REC_ALIGN = 16,
+	LOG_REC_WRAP  = 0,           /* record length of wrap marker */
+	LOG_POLL_MS   = 5,
+	CACHE_LINE    = 64,
+};
+
+
+/** Header of a log record in the ring buffer */
+struct logrec {
+	uint32_t len;                 /**< Message length incl. NUL         */
+	uint32_t level;               /**< Log level                        */
+	uint64_t seq;                 /**< Global sequence number           */
+};
+
+
+/** Lock-free ring buffer with log records from one thread */
+struct logring {
+	RE_ATOMIC size_t head;        /**< Read index (writer thread)       */
+	uint8_t pad1[CACHE_LINE];     /**< Keep indices on separate lines   */
+	RE_ATOMIC size_t tail;        /**< Write index (owner thread)       */
+	uint8_t pad2[CACHE_LINE];     /**< Keep indices on separate lines   */
+	RE_ATOMIC bool used;          /**< Claimed by a thread              */
+	RE_ATOMIC bool orphan;        /**< Owner thread has exited          */
+	uint8_t *buf;                 /**< Record storage                   */
+	size_t sz;                    /**< Size of storage (power of two)   */
+};
+
+
+/** Thread-local state for asynchronous logging */
+struct logtls {
+	struct logring *ring;         /**< Ring buffer, NULL if synchronous */
+	uint32_t gen;                 /**< Generation of the ring buffer    */
+};
+
+
 static struct {
 	struct list logl;
 	enum log_level level;
 	bool enable_stdout;
 	bool timestamps;
 	bool color;
+	struct {
+		RE_ATOMIC bool run;   /**< Asynchronous logging is active   */
+		RE_ATOMIC uint32_t gen; /**< Incremented on each stop       */
+		RE_ATOMIC uint64_t seq; /**< Record sequence number         */
+		RE_ATOMIC uint64_t n_drop; /**< Dropped records             */
+		RE_ATOMIC uint64_t n_sync; /**< Records logged synchronously */
+		struct logring *ringv; /**< All ring buffers                */
+		size_t ringc;         /**< Number of ring buffers           */
+		mtx_t *claim;         /**< Serializes claiming ring buffers */
+		mtx_t hlock;          /**< Protects logl while running     */
+		thrd_t thrd;          /**< Writer thread                    */
+		tss_t tss;            /**< Thread-local state key           */
+		bool tss_init;        /**< Thread-local key is created      */
+		size_t ringsz;        /**< Size of each ring buffer         */
+		size_t budget;        /**< Max. memory for all ring buffers */
+	} async;
 } lg = {
 	LIST_INIT,
 	LEVEL_INFO,
 	true,
 	false,
-	true
+	true,
+	{0}
 };
 
 
@@ -30,10 +111,18 @@ static struct {
  */
 void log_register_handler(struct log *log)
 {
+	bool run = re_atomic_acq(&lg.async.run);
+
 	if (!log)
 		return;
 
+	if (run)
+		mtx_lock(&lg.async.hlock);
+
 	list_append(&lg.logl, &log->le, log);
+
+	if (run)
+		mtx_unlock(&lg.async.hlock);
 }
 
 
@@ -44,10 +133,19 @@ void log_register_handler(struct log *log)
  */
 void log_unregister_handler(struct log *log)
 {
+	bool run = re_atomic_acq(&lg.async.run);
+
 	if (!log)
 		return;
 
+	/* waits for the writer thread, if it is calling the handler */
+	if (run)
+		mtx_lock(&lg.async.hlock);
+
 	list_unlink(&log->le);
+
+	if (run)
+		mtx_unlock(&lg.async.hlock);
 }
 
 
@@ -147,6 +245,429 @@ void log_enable_color(bool enable)
 }
 
 
+static void log_output(enum log_level level, const char *buf)
+{
+	bool run = re_atomic_acq(&lg.async.run);
+	struct le *le;
+
+	if (lg.enable_stdout) {
+
+		bool color = level == LEVEL_WARN || level == LEVEL_ERROR;
+
+		color = color && lg.color;
+		if (color)
+			(void)re_fprintf(stdout, "\x1b[31m"); /* Red */
+
+		(void)re_fprintf(stdout, "%s", buf);
+
+		if (color)
+			(void)re_fprintf(stdout, "\x1b[;m");
+	}
+
+	/* recursive, a handler may log from the writer thread */
+	if (run)
+		mtx_lock(&lg.async.hlock);
+
+	le = lg.logl.head;
+
+	while (le) {
+
+		struct log *log = le->data;
+		le = le->next;
+
+		if (log->h)
+			log->h(level, buf);
+	}
+
+	if (run)
+		mtx_unlock(&lg.async.hlock);
+}
+
+
+static size_t rec_size(size_t len)
+{
+	size_t sz = sizeof(struct logrec) + len;
+
+	return (sz + LOG_REC_ALIGN - 1) & ~(size_t)(LOG_REC_ALIGN - 1);
+}
+
+
+/*
+ * Push a record to the ring buffer (owner thread only)
+ */
+static int ring_push(struct logring *ring, enum log_level level,
+		     const char *msg, size_t len)
+{
+	struct logrec rec;
+	size_t tail, off, contig, need, skip;
+
+	/* truncate very long messages */
+	if (rec_size(len + 1) > ring->sz / 4)
+		len = ring->sz / 4 - sizeof(rec) - LOG_REC_ALIGN;
+
+	need   = rec_size(len + 1);
+	tail   = re_atomic_rlx(&ring->tail);
+	off    = tail & (ring->sz - 1);
+	contig = ring->sz - off;
+	skip   = contig < need ? contig : 0;
+
+	if (ring->sz - (tail - re_atomic_acq(&ring->head)) < need + skip)
+		return ENOSPC;
+
+	if (skip) {
+		rec.len = LOG_REC_WRAP;
+		memcpy(&ring->buf[off], &rec, sizeof(rec));
+		tail += skip;
+		off = 0;
+	}
+
+	rec.len   = (uint32_t)len + 1;
+	rec.level = level;
+	rec.seq   = re_atomic_rlx_add(&lg.async.seq, 1);
+
+	memcpy(&ring->buf[off], &rec, sizeof(rec));
+	memcpy(&ring->buf[off + sizeof(rec)], msg, len);
+	ring->buf[off + sizeof(rec) + len] = '\0';
+
+	re_atomic_rls_set(&ring->tail, tail + need);
+
+	return 0;
+}
+
+
+/*
+ * Get the oldest record of the ring buffer (writer thread only)
+ */
+static const struct logrec *ring_peek(struct logring *ring)
+{
+	for (;;) {
+		size_t head = re_atomic_rlx(&ring->head);
+		const struct logrec *rec;
+		size_t off;
+
+		if (head == re_atomic_acq(&ring->tail))
+			return NULL;
+
+		off = head & (ring->sz - 1);
+		rec = (void *)&ring->buf[off];
+
+		if (rec->len != LOG_REC_WRAP)
+			return rec;
+
+		re_atomic_rls_set(&ring->head, head + ring->sz - off);
+	}
+}
+
+
+static void ring_pop(struct logring *ring, const struct logrec *rec)
+{
+	size_t head = re_atomic_rlx(&ring->head);
+
+	re_atomic_rls_set(&ring->head, head + rec_size(rec->len));
+}
+
+
+/*
+ * Write all queued records in sequence order (writer thread only)
+ */
+static void async_drain(void)
+{
+	for (;;) {
+		struct logring *ring = NULL;
+		const struct logrec *rec = NULL;
+
+		for (size_t i = 0; i < lg.async.ringc; i++) {
+			struct logring *r = &lg.async.ringv[i];
+			const struct logrec *rr;
+
+			if (!re_atomic_acq(&r->used))
+				continue;
+
+			rr = ring_peek(r);
+			if (rr && (!rec || rr->seq < rec->seq)) {
+				ring = r;
+				rec  = rr;
+			}
+		}
+
+		if (!rec)
+			break;
+
+		log_output((enum log_level)rec->level,
+			   (const char *)(rec + 1));
+		ring_pop(ring, rec);
+	}
+
+	/* release the ring buffers of exited threads */
+	for (size_t i = 0; i < lg.async.ringc; i++) {
+		struct logring *ring = &lg.async.ringv[i];
+
+		if (!re_atomic_acq(&ring->orphan) || ring_peek(ring))
+			continue;
+
+		re_atomic_rlx_set(&ring->orphan, false);
+		re_atomic_rls_set(&ring->used, false);
+	}
+}
+
+
+static int writer_thread(void *arg)
+{
+	struct logtls *tls;
+	(void)arg;
+
+	/* messages from log handlers are written synchronously */
+	tls = mem_zalloc(sizeof(*tls), NULL);
+	if (tls) {
+		tls->gen = re_atomic_acq(&lg.async.gen);
+		if (tss_set(lg.async.tss, tls) != thrd_success)
+			mem_deref(tls);
+	}
+
+	while (re_atomic_acq(&lg.async.run)) {
+		async_drain();
+		sys_msleep(LOG_POLL_MS);
+	}
+
+	return 0;
+}
+
+
+static void tls_destructor(void *arg)
+{
+	struct logtls *tls = arg;
+
+	if (tls->ring && tls->gen == re_atomic_acq(&lg.async.gen))
+		re_atomic_rls_set(&tls->ring->orphan, true);
+
+	mem_deref(tls);
+}
+
+
+/*
+ * Get the ring buffer of the calling thread, claim one on first use
+ */
+static struct logring *async_ring(void)
+{
+	struct logtls *tls = tss_get(lg.async.tss);
+	uint32_t gen = re_atomic_acq(&lg.async.gen);
+
+	if (tls && tls->gen == gen)
+		return tls->ring;
+
+	if (!tls) {
+		tls = mem_zalloc(sizeof(*tls), NULL);
+		if (!tls)
+			return NULL;
+
+		if (tss_set(lg.async.tss, tls) != thrd_success) {
+			mem_deref(tls);
+			return NULL;
+		}
+	}
+
+	tls->gen  = gen;
+	tls->ring = NULL;
+
+	/* claim a free ring buffer, nothing is allocated here */
+	mtx_lock(lg.async.claim);
+
+	for (size_t i = 0; i < lg.async.ringc; i++) {
+		struct logring *ring = &lg.async.ringv[i];
+
+		if (re_atomic_acq(&ring->used))
+			continue;
+
+		re_atomic_rls_set(&ring->used, true);
+		tls->ring = ring;
+		break;
+	}
+
+	mtx_unlock(lg.async.claim);
+
+	return tls->ring;
+}
+
+
+static void async_log(enum log_level level, const char *buf, size_t len)
+{
+	struct logring *ring = async_ring();
+
+	if (!ring) {
+		re_atomic_rlx_add(&lg.async.n_sync, 1);
+		log_output(level, buf);
+		return;
+	}
+
+	if (ring_push(ring, level, buf, len))
+		re_atomic_rlx_add(&lg.async.n_drop, 1);
+}
+
+
+static void rings_free(void)
+{
+	for (size_t i = 0; lg.async.ringv && i < lg.async.ringc; i++)
+		mem_deref(lg.async.ringv[i].buf);
+
+	lg.async.ringv = mem_deref(lg.async.ringv);
+	lg.async.ringc = 0;
+}
+
+
+/**
+ * Start asynchronous logging. Log messages are queued in a per-thread
+ * lock-free ring buffer and written by a dedicated writer thread.
+ *
+ * @param ringsz Size of the ring buffer of each thread in [bytes]
+ * @param budget Max. memory for all ring buffers in [bytes]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int log_async_start(size_t ringsz, size_t budget)
+{
+	size_t n = 1024;
+	int err;
+
+	if (!ringsz || ringsz > budget)
+		return EINVAL;
+
+	if (re_atomic_acq(&lg.async.run))
+		return EALREADY;
+
+	while (n < ringsz)
+		n <<= 1;
+
+	if (!lg.async.tss_init) {
+		if (tss_create(&lg.async.tss, tls_destructor) != thrd_success)
+			return ENOMEM;
+
+		lg.async.tss_init = true;
+	}
+
+	if (mtx_init(&lg.async.hlock, mtx_plain | mtx_recursive)
+	    != thrd_success)
+		return ENOMEM;
+
+	lg.async.ringsz = n;
+	lg.async.budget = budget;
+	lg.async.ringc  = max(budget / n, (size_t)1);
+
+	err = mutex_alloc(&lg.async.claim);
+	if (err)
+		goto out;
+
+	lg.async.ringv = mem_zalloc(lg.async.ringc * sizeof(*lg.async.ringv),
+				    NULL);
+	if (!lg.async.ringv) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	for (size_t i = 0; i < lg.async.ringc; i++) {
+		struct logring *ring = &lg.async.ringv[i];
+
+		ring->sz  = n;
+		ring->buf = mem_alloc(n, NULL);
+		if (!ring->buf) {
+			err = ENOMEM;
+			goto out;
+		}
+	}
+
+	re_atomic_rls_set(&lg.async.run, true);
+
+	err = thread_create_name(&lg.async.thrd, "log writer",
+				 writer_thread, NULL);
+	if (err)
+		re_atomic_rls_set(&lg.async.run, false);
+
+ out:
+	if (err) {
+		rings_free();
+		lg.async.claim = mem_deref(lg.async.claim);
+		mtx_destroy(&lg.async.hlock);
+	}
+
+	return err;
+}
+
+
+/**
+ * Stop asynchronous logging. All queued messages are written before this
+ * function returns. Must not be called while other threads are logging.
+ */
+void log_async_stop(void)
+{
+	struct logtls *tls;
+
+	if (!re_atomic_acq(&lg.async.run))
+		return;
+
+	re_atomic_rls_set(&lg.async.run, false);
+	thrd_join(lg.async.thrd, NULL);
+
+	async_drain();
+
+	re_atomic_rlx_add(&lg.async.gen, 1);
+
+	rings_free();
+	lg.async.claim = mem_deref(lg.async.claim);
+	mtx_destroy(&lg.async.hlock);
+
+	/* the calling thread does not exit before the leak check */
+	tls = tss_get(lg.async.tss);
+	if (tls) {
+		tss_set(lg.async.tss, NULL);
+		mem_deref(tls);
+	}
+}
+
+
+/**
+ * Get the number of log messages that were dropped because a ring buffer
+ * was full
+ *
+ * @return Number of dropped log messages
+ */
+uint64_t log_async_dropped(void)
+{
+	return re_atomic_rlx(&lg.async.n_drop);
+}
+
+
+/**
+ * Print the asynchronous logging status
+ *
+ * @param pf     Print function
+ * @param unused Unused parameter
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int log_async_debug(struct re_printf *pf, void *unused)
+{
+	bool run = re_atomic_acq(&lg.async.run);
+	uint32_t rings = 0;
+	size_t mem = 0;
+	(void)unused;
+
+	if (run) {
+		for (size_t i = 0; i < lg.async.ringc; i++) {
+			if (re_atomic_rlx(&lg.async.ringv[i].used))
+				++rings;
+		}
+
+		mem = lg.async.ringc * lg.async.ringsz;
+	}
+
+	return re_hprintf(pf, "log: async=%s rings=%u/%zu memory=%zu/%zu"
+			  " dropped=%llu sync=%llu\n",
+			  run ? "yes" : "no", rings, lg.async.ringc,
+			  mem, lg.async.budget,
+			  re_atomic_rlx(&lg.async.n_drop),
+			  re_atomic_rlx(&lg.async.n_sync));
+}
+
+
 /**
  * Print a message to the logging system
  *
@@ -161,7 +682,6 @@ static void vlog(bool safe, enum log_level level, const char *fmt,
 	char *p = buf;
 	size_t s = sizeof(buf);
 	int n;
-	struct le *le;
 
 	if (level < lg.level)
 		return;
@@ -175,39 +695,20 @@ static void vlog(bool safe, enum log_level level, const char *fmt,
 		s -= n;
 	}
 
-	if (safe) {
-		if (re_vsnprintf_s(p, s, fmt, ap) < 0)
-			return;
-	}
-	else {
-		if (re_vsnprintf(p, s, fmt, ap) < 0)
-			return;
-	}
-
-	if (lg.enable_stdout) {
-
-		bool color = level == LEVEL_WARN || level == LEVEL_ERROR;
+	if (safe)
+		n = re_vsnprintf_s(p, s, fmt, ap);
+	else
+		n = re_vsnprintf(p, s, fmt, ap);
 
-		color = color && lg.color;
-		if (color)
-			(void)re_fprintf(stdout, "\x1b[31m"); /* Red */
-
-		(void)re_fprintf(stdout, "%s", buf);
+	if (n < 0)
+		return;
 
-		if (color)
-			(void)re_fprintf(stdout, "\x1b[;m");
+	if (re_atomic_acq(&lg.async.run)) {
+		async_log(level, buf, strlen(buf));
+		return;
 	}
 
-	le = lg.logl.head;
-
-	while (le) {
-
-		struct log *log = le->data;
-		le = le->next;
-
-		if (log->h)
-			log->h(level, buf);
-	}
+	log_output(level, buf);
 }
 
 
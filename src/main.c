@@ -17,7 +17,11 @@
 #define DEBUG_LEVEL 0
 #include <re_dbg.h>
 
-enum { ASYNC_WORKERS = 4 };
+enum {
+	ASYNC_WORKERS = 4,
+	LOG_RINGSZ    = 64 * 1024,
+	LOG_BUDGET    = 4 * 1024 * 1024,
+};
 
 static void signal_handler(int sig)
 {
@@ -77,6 +81,7 @@ static void usage(void)
 			 "\t-v               Verbose debug\n"
 			 "\t-T               Enable timestamps log\n"
 			 "\t-c               Disable colored log\n"
+			 "\t-A               Asynchronous logging\n"
 			 );
 }
 #endif
@@ -94,6 +99,7 @@ int main(int argc, char *argv[])
 	const char *modv[16];
 	struct tmr tmr_quit;
 	bool sip_trace = false;
+	bool async_log = false;
 	size_t execmdc = 0;
 	size_t modc = 0;
 	size_t i;
@@ -129,7 +135,7 @@ int main(int argc, char *argv[])
 
 #ifdef HAVE_GETOPT
 	for (;;) {
-		const int c = getopt(argc, argv, "46a:de:f:p:hu:n:vst:m:Tc");
+		const int c = getopt(argc, argv, "46a:de:f:p:hu:n:vst:m:TcA");
 		if (0 > c)
 			break;
 
@@ -215,6 +221,10 @@ int main(int argc, char *argv[])
 			dbg_flags &= ~DBG_ANSI;
 			break;
 
+		case 'A':
+			async_log = true;
+			break;
+
 		default:
 			break;
 		}
@@ -225,6 +235,13 @@ int main(int argc, char *argv[])
 #endif
 
 	dbg_init(dbg_level, dbg_flags);
+
+	if (async_log) {
+		err = log_async_start(LOG_RINGSZ, LOG_BUDGET);
+		if (err)
+			warning("main: async logging failed (%m)\n", err);
+	}
+
 	err = conf_configure();
 	if (err) {
 		warning("main: configure failed: %m\n", err);
@@ -343,6 +360,8 @@ int main(int argc, char *argv[])
 
 	baresip_close();
 
+	log_async_stop();
+
 	/* NOTE: modules must be unloaded after all application
 	 *       activity has stopped.
 	 */
@@ -4,86 +4,126 @@
  * Copyright (C) 2010 Alfred E. Heggestad
  */
 #include <re.h>
+#include <re_atomic.h>
 #include <baresip.h>
 #include "core.h"
 
-/*
- * Metric
+
+/**
+ * \page Metric Metrics for media transmit/receive
+ *
+ * The packet counters are 64-bit atomic counters, which are updated with
+ * relaxed memory order from the sending and receiving threads. No locks
+ * are taken on the packet path.
+ *
+ * All metrics are kept in one global registry. A single timer in the main
+ * thread walks the registry and calculates the current bitrate of each
+ * metric. The registry lock is only taken when a metric is added or
+ * removed, and by the bitrate timer.
+ *
+ * metric_print_openmetrics() exports the UA, call and stream metrics in
+ * the OpenMetrics text format.
  */
 
+
 struct metric {
 	/* internal stuff: */
-	struct tmr tmr;
-	mtx_t lock;
-	uint64_t ts_start;
-	bool started;
+	struct le le;
+	RE_ATOMIC uint64_t ts_start;
 
 	/* counters: */
-	uint32_t n_packets;
-	uint32_t n_bytes;
-	uint32_t n_err;
+	RE_ATOMIC uint64_t n_packets;
+	RE_ATOMIC uint64_t n_bytes;
+	RE_ATOMIC uint64_t n_err;
 
-	/* bitrate calculation */
-	uint32_t cur_bitrate;
+	/* bitrate calculation, updated by the registry timer */
+	RE_ATOMIC uint32_t cur_bitrate;
 	uint64_t ts_last;
-	uint32_t n_bytes_last;
+	uint64_t n_bytes_last;
 };
 
+
 enum {TMR_INTERVAL = 3};
-static void tmr_handler(void *arg)
+
+
+static struct {
+	struct list metricl;
+	mtx_t mtx;          /**< Allocated once, lives for the process */
+	int err;
+	struct tmr tmr;
+} reg;
+
+static once_flag reg_once = ONCE_FLAG_INIT;
+
+
+static void reg_init(void)
 {
-	struct metric *metric = arg;
-	const uint64_t now = tmr_jiffies();
-	uint32_t diff;
+	if (mtx_init(&reg.mtx, mtx_plain) != thrd_success)
+		reg.err = ENOMEM;
+}
 
-	tmr_start(&metric->tmr, TMR_INTERVAL * 1000, tmr_handler, metric);
 
-	mtx_lock(&metric->lock);
+static void update_bitrate(struct metric *metric, uint64_t now)
+{
+	uint64_t bytes;
 
-	if (!metric->started)
-		goto out;
+	if (!re_atomic_rlx(&metric->ts_start))
+		return;
 
 	if (now <= metric->ts_last)
-		goto out;
+		return;
+
+	bytes = re_atomic_rlx(&metric->n_bytes);
 
 	if (metric->ts_last) {
-		uint32_t bytes = metric->n_bytes - metric->n_bytes_last;
-		diff = (uint32_t)(now - metric->ts_last);
-		metric->cur_bitrate = 1000 * 8 * bytes / diff;
+		uint64_t diff = now - metric->ts_last;
+
+		re_atomic_rlx_set(&metric->cur_bitrate, (uint32_t)
+				  (1000 * 8 * (bytes - metric->n_bytes_last) /
+				   diff));
 	}
 
 	/* Update counters */
 	metric->ts_last = now;
-	metric->n_bytes_last = metric->n_bytes;
-
-out:
-	mtx_unlock(&metric->lock);
+	metric->n_bytes_last = bytes;
 }
 
 
-static void metric_start(struct metric *metric)
+static void tmr_handler(void *arg)
 {
-	if (metric->started)
-		return;
+	const uint64_t now = tmr_jiffies();
+	struct le *le;
+	(void)arg;
+
+	mtx_lock(&reg.mtx);
+
+	LIST_FOREACH(&reg.metricl, le)
+		update_bitrate(le->data, now);
 
-	metric->ts_start = tmr_jiffies();
+	if (!list_isempty(&reg.metricl))
+		tmr_start(&reg.tmr, TMR_INTERVAL * 1000, tmr_handler, NULL);
 
-	metric->started = true;
+	mtx_unlock(&reg.mtx);
 }
 
 
 int metric_init(struct metric *metric)
 {
-	int err;
-
 	if (!metric)
 		return EINVAL;
 
-	err = mtx_init(&metric->lock, mtx_plain) != thrd_success;
-	if (err)
-		return ENOMEM;
+	call_once(&reg_once, reg_init);
+	if (reg.err)
+		return reg.err;
+
+	mtx_lock(&reg.mtx);
+
+	list_append(&reg.metricl, &metric->le, metric);
 
-	tmr_start(&metric->tmr, 100, tmr_handler, metric);
+	if (!tmr_isrunning(&reg.tmr))
+		tmr_start(&reg.tmr, 100, tmr_handler, NULL);
+
+	mtx_unlock(&reg.mtx);
 
 	return 0;
 }
@@ -94,8 +134,20 @@ void metric_reset(struct metric *metric)
 	if (!metric)
 		return;
 
-	tmr_cancel(&metric->tmr);
-	mtx_destroy(&metric->lock);
+	call_once(&reg_once, reg_init);
+	if (reg.err)
+		return;
+
+	mtx_lock(&reg.mtx);
+
+	if (metric->le.list) {
+		list_unlink(&metric->le);
+
+		if (list_isempty(&reg.metricl))
+			tmr_cancel(&reg.tmr);
+	}
+
+	mtx_unlock(&reg.mtx);
 }
 
 
@@ -122,89 +174,299 @@ void metric_add_packet(struct metric *metric, size_t packetsize)
 	if (!metric)
 		return;
 
-	mtx_lock(&metric->lock);
-
-	if (!metric->started)
-		metric_start(metric);
+	if (!re_atomic_rlx(&metric->ts_start))
+		re_atomic_rlx_set(&metric->ts_start, tmr_jiffies());
 
-	metric->n_bytes += (uint32_t)packetsize;
-	metric->n_packets++;
-
-	mtx_unlock(&metric->lock);
+	re_atomic_rlx_add(&metric->n_bytes, packetsize);
+	re_atomic_rlx_add(&metric->n_packets, 1);
 }
 
 
 double metric_avg_bitrate(const struct metric *metric)
 {
+	uint64_t ts_start;
+	uint64_t n_bytes;
 	int diff;
 
-	if (!metric || !metric->ts_start)
+	if (!metric)
 		return 0;
 
-	diff = (int)(tmr_jiffies() - metric->ts_start);
+	ts_start = re_atomic_rlx(&metric->ts_start);
+	if (!ts_start)
+		return 0;
 
-	return 1000.0 * 8 * (double)metric->n_bytes / (double)diff;
+	n_bytes = re_atomic_rlx(&metric->n_bytes);
+	diff = (int)(tmr_jiffies() - ts_start);
+
+	return 1000.0 * 8 * (double)n_bytes / (double)diff;
 }
 
 
-uint32_t metric_n_packets(struct metric *metric)
+uint64_t metric_n_packets(const struct metric *metric)
 {
-	uint32_t n;
-	if (!metric)
-		return 0;
+	return metric ? re_atomic_rlx(&metric->n_packets) : 0;
+}
 
-	mtx_lock(&metric->lock);
-	n = metric->n_packets;
-	mtx_unlock(&metric->lock);
-	return n;
+
+uint64_t metric_n_bytes(const struct metric *metric)
+{
+	return metric ? re_atomic_rlx(&metric->n_bytes) : 0;
 }
 
 
-uint32_t metric_n_bytes(struct metric *metric)
+uint64_t metric_n_err(const struct metric *metric)
 {
-	uint32_t n;
-	if (!metric)
-		return 0;
+	return metric ? re_atomic_rlx(&metric->n_err) : 0;
+}
+
 
-	mtx_lock(&metric->lock);
-	n = metric->n_bytes;
-	mtx_unlock(&metric->lock);
-	return n;
+uint32_t metric_bitrate(const struct metric *metric)
+{
+	return metric ? re_atomic_rlx(&metric->cur_bitrate) : 0;
 }
 
 
-uint32_t metric_n_err(struct metric *metric)
+void     metric_inc_err(struct metric *metric)
 {
-	uint32_t n;
 	if (!metric)
-		return 0;
+		return;
 
-	mtx_lock(&metric->lock);
-	n = metric->n_err;
-	mtx_unlock(&metric->lock);
-	return n;
+	re_atomic_rlx_add(&metric->n_err, 1);
 }
 
 
-uint32_t metric_bitrate(struct metric *metric)
+/*
+ * OpenMetrics export
+ */
+
+
+/** Value of one metric sample for a stream */
+typedef uint64_t (stream_value_h)(const struct stream *strm, bool tx);
+
+
+/** One metric family of the OpenMetrics export */
+struct family {
+	const char *name;        /**< Metric family name                  */
+	const char *type;        /**< Metric type (counter or gauge)      */
+	const char *help;        /**< Description                         */
+	stream_value_h *valueh;  /**< Value handler                       */
+	bool tx;                 /**< Include transmit direction          */
+};
+
+
+static int label_print(struct re_printf *pf, const char *str)
 {
-	uint32_t n;
-	if (!metric)
+	int err = 0;
+
+	if (!str)
 		return 0;
 
-	mtx_lock(&metric->lock);
-	n = metric->cur_bitrate;
-	mtx_unlock(&metric->lock);
-	return n;
+	for (; *str && !err; str++) {
+
+		switch (*str) {
+
+		case '\\': err = re_hprintf(pf, "\\\\"); break;
+		case '"':  err = re_hprintf(pf, "\\\""); break;
+		case '\n': err = re_hprintf(pf, "\\n");  break;
+		default:   err = pf->vph(str, 1, pf->arg); break;
+		}
+	}
+
+	return err;
 }
 
 
-void     metric_inc_err(struct metric *metric)
+static uint64_t value_packets(const struct stream *strm, bool tx)
 {
-	if (!metric)
-		return;
+	return metric_n_packets(tx ? stream_metric_tx(strm)
+				   : stream_metric_rx(strm));
+}
+
+
+static uint64_t value_bytes(const struct stream *strm, bool tx)
+{
+	return metric_n_bytes(tx ? stream_metric_tx(strm)
+				 : stream_metric_rx(strm));
+}
+
+
+static uint64_t value_errors(const struct stream *strm, bool tx)
+{
+	return metric_n_err(tx ? stream_metric_tx(strm)
+			       : stream_metric_rx(strm));
+}
+
+
+static uint64_t value_bitrate(const struct stream *strm, bool tx)
+{
+	return metric_bitrate(tx ? stream_metric_tx(strm)
+				 : stream_metric_rx(strm));
+}
+
+
+#define JBUF_VALUE(field)						\
+	static uint64_t value_jbuf_ ## field(const struct stream *strm, \
+					     bool tx)			\
+	{								\
+		struct jbuf_stat stat;					\
+		(void)tx;						\
+		if (stream_jbuf_stats(strm, &stat))			\
+			return 0;					\
+		return stat.field;					\
+	}
+
+JBUF_VALUE(n_put)
+JBUF_VALUE(n_get)
+JBUF_VALUE(n_oos)
+JBUF_VALUE(n_dups)
+JBUF_VALUE(n_late)
+JBUF_VALUE(n_lost)
+JBUF_VALUE(n_overflow)
+JBUF_VALUE(n_flush)
+JBUF_VALUE(c_delay)
+JBUF_VALUE(c_packets)
+JBUF_VALUE(c_jitter)
+JBUF_VALUE(c_delay_pct)
+
+
+static const struct family familyv[] = {
+	{"baresip_rtp_packets", "counter", "Number of RTP packets",
+	 value_packets, true},
+	{"baresip_rtp_bytes", "counter", "Number of RTP bytes",
+	 value_bytes, true},
+	{"baresip_rtp_errors", "counter", "Number of RTP errors",
+	 value_errors, true},
+	{"baresip_rtp_bitrate_bps", "gauge", "Current RTP bitrate",
+	 value_bitrate, true},
+	{"baresip_jbuf_put", "counter", "Frames put into jitter buffer",
+	 value_jbuf_n_put, false},
+	{"baresip_jbuf_get", "counter", "Frames got from jitter buffer",
+	 value_jbuf_n_get, false},
+	{"baresip_jbuf_oos", "counter", "Out-of-sequence frames",
+	 value_jbuf_n_oos, false},
+	{"baresip_jbuf_dups", "counter", "Duplicate frames",
+	 value_jbuf_n_dups, false},
+	{"baresip_jbuf_late", "counter", "Frames arriving too late",
+	 value_jbuf_n_late, false},
+	{"baresip_jbuf_lost", "counter", "Lost frames",
+	 value_jbuf_n_lost, false},
+	{"baresip_jbuf_overflow", "counter", "Jitter buffer overflows",
+	 value_jbuf_n_overflow, false},
+	{"baresip_jbuf_flush", "counter", "Jitter buffer flushes",
+	 value_jbuf_n_flush, false},
+	{"baresip_jbuf_delay_ms", "gauge", "Current jitter buffer delay",
+	 value_jbuf_c_delay, false},
+	{"baresip_jbuf_packets", "gauge", "Current jitter buffer packets",
+	 value_jbuf_c_packets, false},
+	{"baresip_jbuf_jitter_ms", "gauge", "Current jitter",
+	 value_jbuf_c_jitter, false},
+	{"baresip_jbuf_delay_percentile", "gauge",
+	 "Percentage of frames within the jitter buffer delay",
+	 value_jbuf_c_delay_pct, false},
+};
+
+
+static int family_print(struct re_printf *pf, const struct family *fam)
+{
+	bool counter = 0 == str_cmp(fam->type, "counter");
+	struct le *leu, *lec, *les;
+	int err;
+
+	err = re_hprintf(pf, "# TYPE %s %s\n# HELP %s %s.\n",
+			 fam->name, fam->type, fam->name, fam->help);
+
+	LIST_FOREACH(uag_list(), leu) {
+		const struct ua *ua = leu->data;
+		const char *aor = account_aor(ua_account(ua));
+
+		LIST_FOREACH(ua_calls(ua), lec) {
+			const struct call *call = lec->data;
+
+			LIST_FOREACH(call_streaml(call), les) {
+				const struct stream *strm = les->data;
+
+				for (int tx = fam->tx; tx >= 0 && !err; tx--) {
+
+					err = re_hprintf(pf, "%s%s{ua=\"%H\","
+							 "call=\"%H\","
+							 "media=\"%s\","
+							 "dir=\"%s\"} %llu\n",
+							 fam->name,
+							 counter ? "_total"
+								 : "",
+							 label_print, aor,
+							 label_print,
+							 call_id(call),
+							 stream_name(strm),
+							 tx ? "tx" : "rx",
+							 fam->valueh(strm,
+								     tx));
+				}
+			}
+		}
+	}
+
+	return err;
+}
+
+
+/**
+ * Print the UA, call and stream metrics in the OpenMetrics text format
+ *
+ * @param pf     Print function
+ * @param unused Unused parameter
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int metric_print_openmetrics(struct re_printf *pf, void *unused)
+{
+	struct le *leu, *lec;
+	int err;
+	(void)unused;
+
+	err = re_hprintf(pf, "# TYPE baresip_ua_registered gauge\n"
+			 "# HELP baresip_ua_registered"
+			 " User-Agent is registered.\n");
+	LIST_FOREACH(uag_list(), leu) {
+		const struct ua *ua = leu->data;
+
+		err |= re_hprintf(pf, "baresip_ua_registered{ua=\"%H\"} %d\n",
+				  label_print, account_aor(ua_account(ua)),
+				  ua_isregistered(ua));
+	}
+
+	err |= re_hprintf(pf, "# TYPE baresip_ua_calls gauge\n"
+			  "# HELP baresip_ua_calls Number of calls.\n");
+	LIST_FOREACH(uag_list(), leu) {
+		const struct ua *ua = leu->data;
+
+		err |= re_hprintf(pf, "baresip_ua_calls{ua=\"%H\"} %u\n",
+				  label_print, account_aor(ua_account(ua)),
+				  list_count(ua_calls(ua)));
+	}
+
+	err |= re_hprintf(pf, "# TYPE baresip_call_duration_seconds gauge\n"
+			  "# HELP baresip_call_duration_seconds"
+			  " Call duration.\n");
+	LIST_FOREACH(uag_list(), leu) {
+		const struct ua *ua = leu->data;
+
+		LIST_FOREACH(ua_calls(ua), lec) {
+			const struct call *call = lec->data;
+
+			err |= re_hprintf(pf, "baresip_call_duration_seconds"
+					  "{ua=\"%H\",call=\"%H\"} %u\n",
+					  label_print,
+					  account_aor(ua_account(ua)),
+					  label_print, call_id(call),
+					  call_duration(call));
+		}
+	}
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(familyv) && !err; i++)
+		err = family_print(pf, &familyv[i]);
+
+	err |= re_hprintf(pf, "# EOF\n");
 
-	mtx_lock(&metric->lock);
-	++metric->n_err;
-	mtx_unlock(&metric->lock);
+	return err;
 }
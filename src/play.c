@@ -5,13 +5,17 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <re.h>
 #include <rem.h>
 #include <baresip.h>
 #include "core.h"
 
 
-enum {PTIME = 40};
+enum {
+	PTIME = 40,
+	PCM_CACHE_MAX = 8 * 1024 * 1024,  /**< Max. size of PCM cache [B]  */
+};
 
 /** Audio file player */
 struct play {
@@ -19,6 +23,8 @@ struct play {
 	struct play **playp;
 	mtx_t lock;
 	struct mbuf *mb;
+	size_t start;
+	size_t pos;
 	struct auplay_st *auplay;
 	char *mod;
 	char *dev;
@@ -45,10 +51,27 @@ struct play {
 
 struct player {
 	struct list playl;
+	struct list pcml;
+	size_t pcm_size;
 	char play_path[FS_PATH_MAX];
 };
 
 
+/**
+ * Decoded audio file, shared by all players of the same file.
+ * The samples are stored as native-endian 16-bit PCM.
+ */
+struct play_pcm {
+	struct le le;
+	char *path;              /**< Full path of audio file         */
+	time_t mtime;            /**< Modification time of file       */
+	off_t fsize;             /**< Size of file                    */
+	struct mbuf *mb;         /**< Decoded samples                 */
+	uint32_t srate;          /**< Sampling rate                   */
+	uint8_t ch;              /**< Number of channels              */
+};
+
+
 static int start_ausrc(struct play *play);
 static int start_auplay(struct play *play);
 
@@ -133,20 +156,22 @@ static void write_handler(struct auframe *af, void *arg)
 	if (play->eof)
 		goto silence;
 
+	/* NOTE: the tone buffer may be shared, do not touch play->mb->pos */
 	while (pos < sz) {
-		left = mbuf_get_left(play->mb);
+		left = play->mb->end - play->pos;
 		count = (left > sz - pos) ? sz - pos : left;
 
-		(void)mbuf_read_mem(play->mb, (uint8_t *)af->sampv + pos,
-				    count);
+		memcpy((uint8_t *)af->sampv + pos, play->mb->buf + play->pos,
+		       count);
 
+		play->pos += count;
 		pos += count;
 
 		if (pos < sz) {
 			if (!check_restart(play))
 				goto silence;
 
-			play->mb->pos = 0;
+			play->pos = play->start;
 		}
 	}
 
@@ -199,8 +224,9 @@ static int aufile_load(struct mbuf *mb, const char *filename,
 
 	while (!err) {
 		uint8_t buf[4096];
-		size_t i, n;
-		int16_t *p = (void *)buf;
+		int16_t sampv[4096];
+		const int16_t *p = (void *)buf;
+		size_t i, n, sampc = 0;
 
 		n = sizeof(buf);
 
@@ -212,31 +238,30 @@ static int aufile_load(struct mbuf *mb, const char *filename,
 
 		case AUFMT_S16LE:
 			/* convert from Little-Endian to Native-Endian */
-			for (i=0; i<n/2; i++) {
-				int16_t s = sys_ltohs(*p++);
-				err |= mbuf_write_u16(mb, s);
-			}
-
+			sampc = n / 2;
+			for (i=0; i<sampc; i++)
+				sampv[i] = sys_ltohs(p[i]);
 			break;
 
 		case AUFMT_PCMA:
-			for (i=0; i<n; i++) {
-				err |= mbuf_write_u16(mb,
-						      g711_alaw2pcm(buf[i]));
-			}
+			sampc = n;
+			for (i=0; i<sampc; i++)
+				sampv[i] = g711_alaw2pcm(buf[i]);
 			break;
 
 		case AUFMT_PCMU:
-			for (i=0; i<n; i++) {
-				err |= mbuf_write_u16(mb,
-						      g711_ulaw2pcm(buf[i]));
-			}
+			sampc = n;
+			for (i=0; i<sampc; i++)
+				sampv[i] = g711_ulaw2pcm(buf[i]);
 			break;
 
 		default:
 			err = ENOSYS;
-			break;
+			continue;
 		}
+
+		err = mbuf_write_mem(mb, (uint8_t *)sampv,
+				     sampc * sizeof(int16_t));
 	}
 
 	mem_deref(af);
@@ -256,6 +281,113 @@ static int aufile_load(struct mbuf *mb, const char *filename,
 }
 
 
+static void pcm_destructor(void *arg)
+{
+	struct play_pcm *pcm = arg;
+
+	list_unlink(&pcm->le);
+	mem_deref(pcm->path);
+	mem_deref(pcm->mb);
+}
+
+
+static void pcm_remove(struct player *player, struct play_pcm *pcm)
+{
+	player->pcm_size -= pcm->mb->size;
+	mem_deref(pcm);
+}
+
+
+static bool pcm_path_cmp(struct le *le, void *arg)
+{
+	const struct play_pcm *pcm = le->data;
+
+	return 0 == str_cmp(pcm->path, arg);
+}
+
+
+/*
+ * Get the decoded samples of an audio file. The PCM cache is used if the
+ * file has not been modified since it was loaded. Otherwise the file is
+ * loaded and added to the cache, if there is enough space left.
+ */
+static int pcm_get(struct play_pcm **pcmp, struct player *player,
+		   const char *path)
+{
+	struct play_pcm *pcm;
+	struct stat st;
+	bool cache;
+	int err;
+
+	cache = 0 == stat(path, &st);
+
+	pcm = list_ledata(list_apply(&player->pcml, true, pcm_path_cmp,
+				     (void *)path));
+	if (pcm) {
+		if (cache && pcm->mtime == st.st_mtime &&
+		    pcm->fsize == st.st_size) {
+			*pcmp = mem_ref(pcm);
+			return 0;
+		}
+
+		debug("play: %s modified, reloading\n", path);
+		pcm_remove(player, pcm);
+	}
+
+	pcm = mem_zalloc(sizeof(*pcm), pcm_destructor);
+	if (!pcm)
+		return ENOMEM;
+
+	err = str_dup(&pcm->path, path);
+	if (err)
+		goto out;
+
+	pcm->mb = mbuf_alloc(cache ? (size_t)st.st_size * 2 : 1024);
+	if (!pcm->mb) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	err = aufile_load(pcm->mb, path, &pcm->srate, &pcm->ch);
+	if (err)
+		goto out;
+
+	mbuf_trim(pcm->mb);
+
+	if (cache && player->pcm_size + pcm->mb->size <= PCM_CACHE_MAX) {
+		pcm->mtime = st.st_mtime;
+		pcm->fsize = st.st_size;
+		player->pcm_size += pcm->mb->size;
+		list_append(&player->pcml, &pcm->le, pcm);
+		mem_ref(pcm);
+	}
+
+ out:
+	if (err)
+		mem_deref(pcm);
+	else
+		*pcmp = pcm;
+
+	return err;
+}
+
+
+static int play_path(char **pathp, const struct player *player,
+		     const char *file)
+{
+	/* absolute path? */
+	if (file[0] == '/' ||
+	    !re_regex(file, strlen(file), "https://") ||
+	    !re_regex(file, strlen(file), "http://") ||
+	    !re_regex(file, strlen(file), "file://")) {
+
+		return re_sdprintf(pathp, "%s", file);
+	}
+
+	return re_sdprintf(pathp, "%s/%s", player->play_path, file);
+}
+
+
 /**
  * Play a tone from a PCM buffer
  *
@@ -291,6 +423,8 @@ int play_tone(struct play **playp, struct player *player,
 	tmr_init(&play->tmr);
 	play->repeat = repeat ? repeat : 1;
 	play->mb     = mem_ref(tone);
+	play->start  = tone->pos;
+	play->pos    = tone->pos;
 
 	err = mtx_init(&play->lock, mtx_plain) != thrd_success;
 	if (err) {
@@ -537,14 +671,12 @@ int play_file(struct play **playp, struct player *player,
 	      const char *play_mod, const char *play_dev)
 {
 	const struct ausrc *ausrc;
-	struct mbuf *mb = NULL;
+	struct play_pcm *pcm = NULL;
 	char *file = NULL;
 	char *path = NULL;
 	char *srcn = NULL;
 	struct pl opt;
 	int delay = 0;
-	uint32_t srate = 0;
-	uint8_t ch = 0;
 	struct play *play = NULL;
 	int err;
 
@@ -559,17 +691,7 @@ int play_file(struct play **playp, struct player *player,
 
 	parse_play_settings(file, &repeat, &delay);
 
-	/* absolute path? */
-	if (file[0] == '/' ||
-	    !re_regex(file, strlen(file), "https://") ||
-	    !re_regex(file, strlen(file), "http://") ||
-	    !re_regex(file, strlen(file), "file://")) {
-
-		err = re_sdprintf(&path, "%s", file);
-	}
-	else
-		err = re_sdprintf(&path, "%s/%s", player->play_path, file);
-
+	err = play_path(&path, player, file);
 	if (err)
 		goto out;
 
@@ -589,21 +711,15 @@ int play_file(struct play **playp, struct player *player,
 		}
 	}
 
-	mb = mbuf_alloc(1024);
-	if (!mb) {
-		err = ENOMEM;
-		goto out;
-	}
-
-	err = aufile_load(mb, path, &srate, &ch);
+	err = pcm_get(&pcm, player, path);
 	if (err)
 		goto out;
 
-	err = play_tone(&play, player, mb, srate,
-	                ch, repeat, play_mod, play_dev);
+	err = play_tone(&play, player, pcm->mb, pcm->srate,
+	                pcm->ch, repeat, play_mod, play_dev);
 
  out:
-	mem_deref(mb);
+	mem_deref(pcm);
 
 	mem_deref(file);
 	mem_deref(path);
@@ -646,6 +762,7 @@ static void player_destructor(void *data)
 	struct player *player = data;
 
 	list_flush(&player->playl);
+	list_flush(&player->pcml);
 }
 
 
@@ -668,6 +785,7 @@ int play_init(struct player **playerp)
 		return ENOMEM;
 
 	list_init(&player->playl);
+	list_init(&player->pcml);
 
 	str_ncpy(player->play_path, conf_config()->audio.audio_path,
 			sizeof(player->play_path));
@@ -691,3 +809,54 @@ void play_set_path(struct player *player, const char *path)
 
 	str_ncpy(player->play_path, path, sizeof(player->play_path));
 }
+
+
+/**
+ * Load an audio file into the PCM cache of the player, so that later
+ * calls to play_file() do not have to read and convert the file
+ *
+ * @param player   Audio-file player
+ * @param filename Name of WAV file, relative to the audio path
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int play_preload(struct player *player, const char *filename)
+{
+	struct play_pcm *pcm = NULL;
+	char *file = NULL;
+	char *path = NULL;
+	struct pl opt;
+	int repeat = 0;
+	int err;
+
+	if (!player || !str_isset(filename))
+		return EINVAL;
+
+	/* files are played by the file_ausrc module, nothing to cache */
+	if (!conf_get(conf_cur(), "file_ausrc", &opt))
+		return 0;
+
+	err = str_dup(&file, filename);
+	if (err)
+		return err;
+
+	parse_play_settings(file, &repeat, NULL);
+
+	err = play_path(&path, player, file);
+	if (err)
+		goto out;
+
+	if (!fs_isfile(path)) {
+		err = ENOENT;
+		goto out;
+	}
+
+	err = pcm_get(&pcm, player, path);
+
+ out:
+	mem_deref(pcm);
+	mem_deref(path);
+	mem_deref(file);
+
+	return err;
+}
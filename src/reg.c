@@ -8,6 +8,12 @@
 #include "core.h"
 
 
+enum {
+	RWAIT_JITTER_MIN = 75,       /**< Lowest refresh wait, spread [%]  */
+	RWAIT_JITTER_MAX = 90,       /**< Highest refresh wait, spread [%] */
+};
+
+
 /** Register client */
 struct reg {
 	struct le le;                /**< Linked list element                */
@@ -23,14 +29,56 @@ struct reg {
 	int af;                      /**< Cached address family for SIP conn */
 
 	struct list custom_hdrs;     /**< List of custom headers if any      */
+
+	/* scheduler: */
+	struct le le_q;              /**< Scheduler queue element            */
+	uint64_t ts_queued;          /**< Time when queued [ms]              */
+	uint64_t ts_due;             /**< Earliest time to send [ms]         */
+	uint64_t ts_sent;            /**< Time of last REGISTER [ms]         */
 };
 
 
+/**
+ * Registration scheduler. Caps the initial REGISTER requests of all
+ * register clients to sip_reg_rate per second, and spreads them randomly
+ * over sip_reg_spread seconds. Clients of User-Agents with active calls
+ * are sent first.
+ */
+static struct {
+	struct list hiq;             /**< Queue of UAs with active calls     */
+	struct list q;               /**< Queue ordered by due time          */
+	struct tmr tmr;              /**< Send timer                         */
+	uint64_t ts;                 /**< Time of last credit update [ms]    */
+	uint64_t credit;             /**< Send credit [1/1000 REGISTER]      */
+	uint32_t depth;              /**< Current queue depth                */
+	uint32_t depth_max;          /**< Maximum queue depth                */
+	uint64_t n_sent;             /**< REGISTERs sent from the queue      */
+	uint64_t wait_sum;           /**< Sum of the queue waits [ms]        */
+	uint64_t wait_max;           /**< Maximum queue wait [ms]            */
+	uint64_t n_resp;             /**< Number of measured responses       */
+	uint64_t resp_sum;           /**< Sum of the response times [ms]     */
+	uint64_t resp_max;           /**< Maximum response time [ms]         */
+} sched;
+
+
+static void sched_dequeue(struct reg *reg)
+{
+	if (!reg->le_q.list)
+		return;
+
+	list_unlink(&reg->le_q);
+
+	if (--sched.depth == 0)
+		tmr_cancel(&sched.tmr);
+}
+
+
 static void destructor(void *arg)
 {
 	struct reg *reg = arg;
 
 	list_unlink(&reg->le);
+	sched_dequeue(reg);
 	mem_deref(reg->sipreg);
 	mem_deref(reg->srv);
 
@@ -112,6 +160,15 @@ static void register_handler(int err, const struct sip_msg *msg, void *arg)
 	enum bevent_ev evfail = reg->regint ?
 		BEVENT_REGISTER_FAIL : BEVENT_FALLBACK_FAIL;
 
+	if (reg->ts_sent) {
+		uint64_t resp = tmr_jiffies() - reg->ts_sent;
+
+		++sched.n_resp;
+		sched.resp_sum += resp;
+		sched.resp_max  = max(sched.resp_max, resp);
+		reg->ts_sent = 0;
+	}
+
 	if (err) {
 		if (reg->regint)
 			warning("reg: %s (prio %u): Register: %m\n",
@@ -178,6 +235,119 @@ static void register_handler(int err, const struct sip_msg *msg, void *arg)
 }
 
 
+static int reg_send(struct reg *reg)
+{
+	uint64_t now = tmr_jiffies();
+	int err;
+
+	err = sipreg_send(reg->sipreg);
+	if (!err)
+		reg->ts_sent = now;
+
+	return err;
+}
+
+
+static void sched_handler(void *arg)
+{
+	const struct config_sip *cfg = &conf_config()->sip;
+	uint64_t now = tmr_jiffies();
+	uint64_t wait = 0;
+	(void)arg;
+
+	if (cfg->reg_rate) {
+		uint64_t cap = (cfg->reg_rate / 10 + 1) * 1000;
+
+		sched.credit += (now - sched.ts) * cfg->reg_rate;
+		sched.credit  = min(sched.credit, cap);
+	}
+
+	sched.ts = now;
+
+	for (;;) {
+		struct le *le = list_head(&sched.hiq);
+		struct reg *reg;
+		uint64_t qwait;
+		int err;
+
+		if (!le) {
+			le = list_head(&sched.q);
+			if (!le)
+				return;
+
+			reg = le->data;
+			if (reg->ts_due > now) {
+				wait = reg->ts_due - now;
+				break;
+			}
+		}
+
+		reg = le->data;
+
+		if (cfg->reg_rate) {
+			if (sched.credit < 1000) {
+				wait = (1000 - sched.credit +
+					cfg->reg_rate - 1) / cfg->reg_rate;
+				break;
+			}
+
+			sched.credit -= 1000;
+		}
+
+		sched_dequeue(reg);
+
+		qwait = now - reg->ts_queued;
+		++sched.n_sent;
+		sched.wait_sum += qwait;
+		sched.wait_max  = max(sched.wait_max, qwait);
+
+		err = reg_send(reg);
+		if (err)
+			register_handler(err, NULL, reg);
+	}
+
+	tmr_start(&sched.tmr, wait, sched_handler, NULL);
+}
+
+
+static void sched_enqueue(struct reg *reg, uint32_t spread)
+{
+	uint64_t now = tmr_jiffies();
+
+	reg->ts_queued = now;
+	reg->ts_due    = now;
+
+	if (!list_isempty(ua_calls(reg->ua))) {
+		list_append(&sched.hiq, &reg->le_q, reg);
+	}
+	else {
+		struct le *le;
+
+		if (spread)
+			reg->ts_due += rand_u32() % (spread * 1000);
+
+		/* sorted by due time, most inserts are near the tail */
+		for (le = sched.q.tail; le; le = le->prev) {
+			const struct reg *r = le->data;
+
+			if (r->ts_due <= reg->ts_due)
+				break;
+		}
+
+		if (le)
+			list_insert_after(&sched.q, le, &reg->le_q, reg);
+		else
+			list_prepend(&sched.q, &reg->le_q, reg);
+	}
+
+	++sched.depth;
+	sched.depth_max = max(sched.depth_max, sched.depth);
+
+	if (!tmr_isrunning(&sched.tmr))
+		tmr_start(&sched.tmr, 0, sched_handler, NULL);
+}
+
+
 int reg_add(struct list *lst, struct ua *ua, int regid)
 {
 	struct reg *reg;
@@ -228,6 +398,7 @@ void reg_set_custom_hdrs(struct reg *reg, const struct list *hdrs)
 int reg_register(struct reg *reg, const char *reg_uri, const char *params,
 		 uint32_t regint, const char *outbound)
 {
+	const struct config_sip *cfg = &conf_config()->sip;
 	struct account *acc;
 	const char *routev[1];
 	int err;
@@ -236,6 +407,8 @@ int reg_register(struct reg *reg, const char *reg_uri, const char *params,
 	if (!reg || !reg_uri)
 		return EINVAL;
 
+	sched_dequeue(reg);
+
 	reg->scode = 0;
 	reg->regint = regint;
 	routev[0] = outbound;
@@ -261,6 +434,10 @@ int reg_register(struct reg *reg, const char *reg_uri, const char *params,
 
 	if (acc && acc->rwait)
 		err = sipreg_set_rwait(reg->sipreg, acc->rwait);
+	else if (cfg->reg_spread)
+		err = sipreg_set_rwait(reg->sipreg, RWAIT_JITTER_MIN +
+				       rand_u32() % (RWAIT_JITTER_MAX -
+						     RWAIT_JITTER_MIN + 1));
 
 	if (acc && account_fbregint(acc))
 		err = sipreg_set_fbregint(reg->sipreg, account_fbregint(acc));
@@ -276,7 +453,12 @@ int reg_register(struct reg *reg, const char *reg_uri, const char *params,
 		return err;
 	}
 
-	return sipreg_send(reg->sipreg);
+	if (!cfg->reg_rate && !cfg->reg_spread)
+		return reg_send(reg);
+
+	sched_enqueue(reg, cfg->reg_spread);
+
+	return 0;
 }
 
 
@@ -285,6 +467,7 @@ void reg_unregister(struct reg *reg)
 	if (!reg)
 		return;
 
+	sched_dequeue(reg);
 	sipreg_unregister(reg->sipreg);
 }
 
@@ -294,6 +477,7 @@ void reg_stop(struct reg *reg)
 	if (!reg)
 		return;
 
+	sched_dequeue(reg);
 	reg->sipreg = mem_deref(reg->sipreg);
 	reg->scode = 0;
 }
@@ -409,6 +593,57 @@ int reg_status(struct re_printf *pf, const struct reg *reg)
 }
 
 
+/**
+ * Print the registration scheduler status
+ *
+ * @param pf Print function
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int reg_sched_debug(struct re_printf *pf)
+{
+	const struct config_sip *cfg = &conf_config()->sip;
+	int err = 0;
+
+	err |= re_hprintf(pf, "\nRegistration scheduler:\n");
+	err |= re_hprintf(pf, " rate:      %u/s (0=unlimited)\n",
+			  cfg->reg_rate);
+	err |= re_hprintf(pf, " spread:    %us\n", cfg->reg_spread);
+	err |= re_hprintf(pf, " queue:     %u (max %u)\n",
+			  sched.depth, sched.depth_max);
+	err |= re_hprintf(pf, " sent:      %llu (wait avg %llums,"
+			  " max %llums)\n", sched.n_sent,
+			  sched.n_sent ? sched.wait_sum / sched.n_sent : 0,
+			  sched.wait_max);
+	err |= re_hprintf(pf, " responses: %llu (avg %llums,"
+			  " max %llums)\n", sched.n_resp,
+			  sched.n_resp ? sched.resp_sum / sched.n_resp : 0,
+			  sched.resp_max);
+
+	return err;
+}
+
+
+/**
+ * Get the totals of the registration scheduler
+ *
+ * @param sent      Number of REGISTERs sent from the queue (optional)
+ * @param wait_sum  Sum of the queue waits in [ms] (optional)
+ * @param depth_max Maximum queue depth (optional)
+ */
+void reg_sched_stats(uint64_t *sent, uint64_t *wait_sum, uint32_t *depth_max)
+{
+	if (sent)
+		*sent = sched.n_sent;
+
+	if (wait_sum)
+		*wait_sum = sched.wait_sum;
+
+	if (depth_max)
+		*depth_max = sched.depth_max;
+}
+
+
 int reg_af(const struct reg *reg)
 {
 	if (!reg)
@@ -23,21 +23,32 @@ struct rtp_receiver {
 	char *name;                    /**< Media name                       */
 	struct metric *metric;         /**< Metrics for receiving            */
 	struct jbuf *jbuf;             /**< Jitter Buffer for incoming RTP   */
-	bool enabled;                  /**< True if enabled                  */
-	uint64_t ts_last;              /**< Timestamp of last recv RTP pkt   */
-	uint32_t ssrc;                 /**< Incoming synchronization source  */
 	bool ssrc_set;                 /**< Incoming SSRC is set             */
-	bool ssrc_changed;             /**< SSRC changed since last poll     */
-	uint32_t pseq;                 /**< Sequence number for incoming RTP */
-	bool pseq_set;                 /**< True if sequence number is set   */
-	bool rtp_estab;                /**< True if RTP stream established   */
-	RE_ATOMIC bool run;            /**< True if RX thread is running     */
 	bool start_rtcp;               /**< Start RTCP flag                  */
 	char *cname;                   /**< Canonical Name for RTCP send     */
 	struct sa rtcp_peer;           /**< RTCP address of Peer             */
 	bool pinhole;                  /**< Open RTCP NAT pinhole flag       */
 	mtx_t *mtx;                    /**< Mutex protects above fields      */
 
+	/* Lock-free data */
+	RE_ATOMIC bool enabled;        /**< True if enabled                  */
+	RE_ATOMIC uint64_t ts_last;    /**< Timestamp of last recv RTP pkt   */
+	RE_ATOMIC uint32_t ssrc;       /**< Incoming SSRC (written w/ mtx)   */
+	RE_ATOMIC bool ssrc_changed;   /**< SSRC changed since last poll     */
+	RE_ATOMIC bool run;            /**< True if RX thread is running     */
+	RE_ATOMIC bool work_pending;   /**< Main thread is notified of work  */
+	bool closed;                   /**< RX side is stopped (main thread) */
+	struct spscq *workq;           /**< Work from RX to main thread      */
+
+	/* Data only used by the receiving thread */
+	uint32_t pseq;                 /**< Sequence number for incoming RTP */
+	bool pseq_set;                 /**< True if sequence number is set   */
+	bool rtp_estab;                /**< True if RTP stream established   */
+	int pt;                        /**< Previous payload type            */
+	int pt_tel;                    /**< Payload type for tel event       */
+	struct tmr tmr_decode;         /**< Decode Timer                     */
+	struct rxbatch *batch;         /**< Batched RTP receive (optional)   */
+
 	/* Unprotected data */
 	struct stream *strm;           /**< Stream                           */
 	struct rtp_sock *rtp;          /**< RTP Socket                       */
@@ -47,11 +58,18 @@ struct rtp_receiver {
 	void *arg;                     /**< Stream argument                  */
 	void *sessarg;                 /**< Session argument                 */
 	thrd_t thr;                    /**< RX thread                        */
+	struct rxpool_member *pool;    /**< RX pool membership (optional)    */
 	struct tmr tmr;                /**< Timer for stopping RX thread     */
-	int pt;                        /**< Previous payload type            */
-	int pt_tel;                    /**< Payload type for tel event       */
 	uint32_t srate;                /**< Receiver Samplerate              */
-	struct tmr tmr_decode;         /**< Decode Timer                     */
+	uint32_t rxbatch;              /**< Max. datagrams per receive call  */
+	struct aulat *lat;             /**< Latency trace (optional)         */
+	uint64_t *arrivev;             /**< Arrival times indexed by seq     */
+};
+
+
+enum {
+	WORKQ_SZ  = 64,  /**< Number of preallocated work items per receiver */
+	ARRIVE_SZ = 256, /**< Arrival time slots for latency trace (pow2)    */
 };
 
 
@@ -59,113 +77,182 @@ enum work_type {
 	WORK_RTCP,
 	WORK_RTPESTAB,
 	WORK_PTCHANGED,
-	WORK_MNATCONNH,
 };
 
 
+/* Work item, copied by value into the preallocated work queue */
 struct work {
 	enum work_type type;
-	struct rtp_receiver *rx;
 	union {
 		struct rtcp_msg *rtcp;
 		struct {
 			uint8_t pt;
 			struct mbuf *mb;
 		} pt;
-		struct {
-			struct sa raddr1;
-			struct sa raddr2;
-		} mnat;
 	} u;
 };
 
+
+/* The mnat handler may be called from any thread, so it is not queued */
+struct mnat_work {
+	struct rtp_receiver *rx;
+	struct sa raddr1;
+	struct sa raddr2;
+};
+
 static bool rtprecv_consume_ssrc_change(struct rtp_receiver *rx,
                     uint32_t *ssrc);
 
 
 static void async_work_main(int err, void *arg);
-static void work_destructor(void *arg);
+static void async_mnat_main(int err, void *arg);
+
+
+static void work_release(struct work *w)
+{
+	switch (w->type) {
+		case WORK_RTCP:
+			mem_deref(w->u.rtcp);
+			break;
+		case WORK_PTCHANGED:
+			mem_deref(w->u.pt.mb);
+			break;
+		default:
+			break;
+	}
+}
+
+
+/*
+ * functions that run in RX thread (if "rxmode thread" or "rxmode pool" is
+ * configured)
+ */
 
 
 /*
- * functions that run in RX thread (if "rxmode thread" is configured)
+ * Queue work for the main thread. The work queue is preallocated, so this
+ * does not allocate memory. The main thread is only notified if it is not
+ * already going to drain the queue.
  */
+static int pass_work(struct rtp_receiver *rx, struct work *w)
+{
+	int err;
+
+	err = spscq_push(rx->workq, w);
+	if (err) {
+		warning("rtprecv: %s: dropping work %d (%m)\n",
+			rx->name, w->type, err);
+		work_release(w);
+		return err;
+	}
+
+	if (re_atomic_seq(&rx->work_pending))
+		return 0;
+
+	re_atomic_seq_set(&rx->work_pending, true);
+	err = re_thread_async_main_id((intptr_t)rx, NULL, async_work_main, rx);
+	if (err) {
+		warning("rtprecv: %s: could not notify main thread (%m)\n",
+			rx->name, err);
+		re_atomic_seq_set(&rx->work_pending, false);
+	}
+
+	return 0;
+}
 
 
 static void pass_rtcp_work(struct rtp_receiver *rx, struct rtcp_msg *msg)
 {
-	struct work *w;
+	struct work w = {.type = WORK_RTCP};
 
 	if (!re_atomic_rlx(&rx->run)) {
 		stream_process_rtcp(rx->strm, msg);
 		return;
 	}
 
-	w = mem_zalloc(sizeof(*w), work_destructor);
-	if (!w)
-		return;
-
-	w->type    = WORK_RTCP;
-	w->rx      = rx;
-	w->u.rtcp  = mem_ref(msg);
-	re_thread_async_main_id((intptr_t)rx, NULL, async_work_main, w);
+	w.u.rtcp = mem_ref(msg);
+	(void)pass_work(rx, &w);
 }
 
 
 static int pass_pt_work(struct rtp_receiver *rx, uint8_t pt, struct mbuf *mb)
 {
-	struct work *w;
+	struct work w = {.type = WORK_PTCHANGED};
 
 	if (!re_atomic_rlx(&rx->run))
 		return rx->pth(pt, mb, rx->arg);
 
-	w = mem_zalloc(sizeof(*w), work_destructor);
-	if (!w)
+	w.u.pt.pt = pt;
+	w.u.pt.mb = mbuf_dup(mb);
+	if (!w.u.pt.mb)
 		return ENOMEM;
 
-	w->type    = WORK_PTCHANGED;
-	w->rx      = rx;
-	w->u.pt.pt = pt;
-	w->u.pt.mb = mbuf_dup(mb);
-
-	return re_thread_async_main_id((intptr_t)rx, NULL, async_work_main, w);
+	return pass_work(rx, &w);
 }
 
 
 static void pass_rtpestab_work(struct rtp_receiver *rx)
 {
-	struct work *w;
+	struct work w = {.type = WORK_RTPESTAB};
 
 	if (!re_atomic_rlx(&rx->run)) {
 		rx->rtpestabh(rx->strm, rx->sessarg);
 		return;
 	}
 
-	w = mem_zalloc(sizeof(*w), work_destructor);
-	w->type = WORK_RTPESTAB;
-	w->rx   = rx;
-
-	re_thread_async_main_id((intptr_t)rx, NULL, async_work_main, w);
+	(void)pass_work(rx, &w);
 }
 
 
 static void pass_mnat_work(struct rtp_receiver *rx, const struct sa *raddr1,
 			   const struct sa *raddr2)
 {
-	struct work *w;
+	struct mnat_work *w;
 
 	if (!re_atomic_rlx(&rx->run)) {
 		stream_mnat_connected(rx->strm, raddr1, raddr2);
 		return;
 	}
 
-	w = mem_zalloc(sizeof(*w), work_destructor);
-	w->type = WORK_MNATCONNH;
-	w->rx   = rx;
-	sa_cpy(&w->u.mnat.raddr1, raddr1);
-	sa_cpy(&w->u.mnat.raddr2, raddr2);
+	w = mem_zalloc(sizeof(*w), NULL);
+	if (!w)
+		return;
 
-	re_thread_async_main_id((intptr_t)rx, NULL, async_work_main, w);
+	w->rx = rx;
+	sa_cpy(&w->raddr1, raddr1);
+	sa_cpy(&w->raddr2, raddr2);
+
+	re_thread_async_main_id((intptr_t)rx, NULL, async_mnat_main, w);
+}
+
+
+/*
+ * Attach the RTP socket to the event loop of the current thread, with
+ * batched receive if configured and supported
+ */
+static int attach_rtp_sock(struct rtp_receiver *rx)
+{
+	int err;
+
+	if (rx->rxbatch) {
+		err = rxbatch_alloc(&rx->batch, rtp_sock(rx->rtp),
+				    rx->rxbatch);
+		if (!err)
+			return 0;
+
+		warning("rtp_receiver: batched receive disabled (%m)\n",
+			err);
+		rx->rxbatch = 0;
+	}
+
+	return udp_thread_attach(rtp_sock(rx->rtp));
+}
+
+
+static void detach_rtp_sock(struct rtp_receiver *rx)
+{
+	rx->batch = mem_deref(rx->batch);
+	udp_thread_detach(rtp_sock(rx->rtp));
 }
 
 
@@ -199,7 +286,7 @@ static void rtprecv_periodic(void *arg)
 	}
 	else {
 		tmr_cancel(&rx->tmr_decode);
-		udp_thread_detach(rtp_sock(rx->rtp));
+		detach_rtp_sock(rx);
 		udp_thread_detach(rtcp_sock(rx->rtp));
 		re_cancel();
 	}
@@ -217,7 +304,7 @@ static int rtprecv_thread(void *arg)
 	info("rtp_receiver: RTP RX thread started\n");
 	tmr_start(&rx->tmr, 10, rtprecv_periodic, rx);
 
-	err = udp_thread_attach(rtp_sock(rx->rtp));
+	err = attach_rtp_sock(rx);
 	if (err) {
 		warning("rtp_receiver: could not attach to RTP socket (%m)\n",
 			err);
@@ -239,6 +326,35 @@ static int rtprecv_thread(void *arg)
 }
 
 
+/* called from the RX pool loop thread */
+static void rxpool_attach_handler(void *arg)
+{
+	struct rtp_receiver *rx = arg;
+	int err;
+
+	tmr_start(&rx->tmr, 10, rtprecv_periodic, rx);
+
+	err  = attach_rtp_sock(rx);
+	err |= udp_thread_attach(rtcp_sock(rx->rtp));
+	if (err) {
+		warning("rtp_receiver: could not attach to RX pool (%m)\n",
+			err);
+	}
+}
+
+
+/* called from the RX pool loop thread */
+static void rxpool_detach_handler(void *arg)
+{
+	struct rtp_receiver *rx = arg;
+
+	tmr_cancel(&rx->tmr);
+	tmr_cancel(&rx->tmr_decode);
+	detach_rtp_sock(rx);
+	udp_thread_detach(rtcp_sock(rx->rtp));
+}
+
+
 static int lostcalc(struct rtp_receiver *rx, uint16_t seq)
 {
 	const uint16_t delta = seq - rx->pseq;
@@ -336,14 +452,15 @@ static void rtprecv_resync(struct rtp_receiver *rx,
 	jbuf_flush(rx->jbuf);
 
 	mtx_lock(rx->mtx);
-	rx->ssrc = hdr->ssrc;
+	re_atomic_rls_set(&rx->ssrc, hdr->ssrc);
 	rx->ssrc_set = true;
+	mtx_unlock(rx->mtx);
+
 	rx->pseq = (uint16_t)(hdr->seq - 1);
 	rx->pseq_set = true;
 	rx->pt = -1;
 	rx->pt_tel = -1;
-	rx->ssrc_changed = true;
-	mtx_unlock(rx->mtx);
+	re_atomic_rls_set(&rx->ssrc_changed, true);
 }
 
 
@@ -374,6 +491,16 @@ static void decode_frames(struct rtp_receiver *rx)
 
 		lostc = lostcalc(rx, hdr.seq);
 
+		if (rx->arrivev) {
+			uint64_t *t = &rx->arrivev[hdr.seq & (ARRIVE_SZ-1)];
+
+			if (*t) {
+				aulat_add(rx->lat, AULAT_RX_JBUF,
+					  tmr_jiffies_usec() - *t);
+				*t = 0;
+			}
+		}
+
 		handle_rtp(rx, &hdr, mb, lostc > 0 ? lostc : 0);
 		mem_deref(mb);
 	} while (--n);
@@ -421,25 +548,27 @@ void rtprecv_decode(const struct sa *src, const struct rtp_header *hdr,
 		return;
 
 	MAGIC_CHECK(rx);
-	mtx_lock(rx->mtx);
-	if (!rx->enabled) {
-		mtx_unlock(rx->mtx);
+
+	/* NOTE: the steady-state path does not take rx->mtx */
+	if (!re_atomic_acq(&rx->enabled))
 		return;
-	}
 
 	if (rtp_pt_is_rtcp(hdr->pt)) {
 		debug("rtprecv: drop incoming RTCP packet on RTP port"
 		     " (pt=%u)\n", hdr->pt);
-		mtx_unlock(rx->mtx);
 		return;
 	}
 
-	rx->ts_last = tmr_jiffies();
+	re_atomic_rlx_set(&rx->ts_last, tmr_jiffies());
 
 	metric_add_packet(rx->metric, mbuf_get_left(mb));
 
 	if (!rx->rtp_estab) {
-		if (rx->rtpestabh) {
+		mtx_lock(rx->mtx);
+		bool estab = rx->rtpestabh != NULL;
+		mtx_unlock(rx->mtx);
+
+		if (estab) {
 			debug("rtprecv: incoming rtp for '%s' established, "
 			      "receiving from %J\n", rx->name, src);
 			rx->rtp_estab = true;
@@ -448,10 +577,13 @@ void rtprecv_decode(const struct sa *src, const struct rtp_header *hdr,
 		tmr_start(&rx->tmr_decode, 0, decode_tmr, rx);
 	}
 
-	ssrc0 = rx->ssrc;
+	ssrc0 = re_atomic_acq(&rx->ssrc);
 	if (!rx->pseq_set) {
-		rx->ssrc = hdr->ssrc;
+		mtx_lock(rx->mtx);
+		re_atomic_rls_set(&rx->ssrc, hdr->ssrc);
 		rx->ssrc_set = true;
+		mtx_unlock(rx->mtx);
+
 		rx->pseq = hdr->seq - 1;
 		rx->pseq_set = true;
 	}
@@ -464,7 +596,6 @@ void rtprecv_decode(const struct sa *src, const struct rtp_header *hdr,
 
 		ssrc_changed = true;
 	}
-	mtx_unlock(rx->mtx);
 
 	if (ssrc_changed)
 		rtprecv_resync(rx, hdr);
@@ -479,9 +610,17 @@ void rtprecv_decode(const struct sa *src, const struct rtp_header *hdr,
 	}
 
 	if (rx->jbuf) {
+		if (rx->arrivev)
+			rx->arrivev[hdr->seq & (ARRIVE_SZ-1)] =
+				tmr_jiffies_usec();
+
 		/* Put frame in Jitter Buffer */
 		err = jbuf_put(rx->jbuf, hdr, mb);
-		if (err) {
+		if (err == ETIMEDOUT && stream_type(rx->strm) == MEDIA_AUDIO) {
+			/* late audio may still replace a concealed frame */
+			handle_rtp(rx, hdr, mb, 0);
+		}
+		else if (err) {
 			info("rtprecv: %s: dropping %zu bytes from %J"
 			     " [seq=%u, ts=%u] (%m)\n",
 			     rx->name, mb->end,
@@ -502,14 +641,10 @@ void rtprecv_handle_rtcp(const struct sa *src, struct rtcp_msg *msg,
 	(void)src;
 
 	MAGIC_CHECK(rx);
-	mtx_lock(rx->mtx);
-	if (!rx->enabled) {
-		mtx_unlock(rx->mtx);
+	if (!re_atomic_acq(&rx->enabled))
 		return;
-	}
 
-	rx->ts_last = tmr_jiffies();
-	mtx_unlock(rx->mtx);
+	re_atomic_rlx_set(&rx->ts_last, tmr_jiffies());
 
 	pass_rtcp_work(rx, msg);
 }
@@ -570,15 +705,16 @@ void rtprecv_set_ssrc(struct rtp_receiver *rx, uint32_t ssrc)
 
 	mtx_lock(rx->mtx);
 	if (rx->ssrc_set) {
-		if (ssrc != rx->ssrc) {
+		uint32_t ssrc0 = re_atomic_rlx(&rx->ssrc);
+		if (ssrc != ssrc0) {
 			debug("rtprecv: receive: SSRC changed: %x -> %x\n",
-			     rx->ssrc, ssrc);
-			rx->ssrc = ssrc;
+			     ssrc0, ssrc);
+			re_atomic_rls_set(&rx->ssrc, ssrc);
 		}
 	}
 	else {
 		debug("rtprecv: receive: setting SSRC: %x\n", ssrc);
-		rx->ssrc = ssrc;
+		re_atomic_rls_set(&rx->ssrc, ssrc);
 		rx->ssrc_set = true;
 	}
 	mtx_unlock(rx->mtx);
@@ -590,13 +726,7 @@ uint64_t rtprecv_ts_last(struct rtp_receiver *rx)
 	if (!rx)
 		return 0;
 
-	uint64_t ts_last;
-
-	mtx_lock(rx->mtx);
-	ts_last = rx->ts_last;
-	mtx_unlock(rx->mtx);
-
-	return ts_last;
+	return re_atomic_rlx(&rx->ts_last);
 }
 
 
@@ -605,9 +735,7 @@ void rtprecv_set_ts_last(struct rtp_receiver *rx, uint64_t ts_last)
 	if (!rx)
 		return;
 
-	mtx_lock(rx->mtx);
-	rx->ts_last = ts_last;
-	mtx_unlock(rx->mtx);
+	re_atomic_rlx_set(&rx->ts_last, ts_last);
 }
 
 
@@ -625,9 +753,7 @@ void rtprecv_enable(struct rtp_receiver *rx, bool enable)
 	if (!rx)
 		return;
 
-	mtx_lock(rx->mtx);
-	rx->enabled = enable;
-	mtx_unlock(rx->mtx);
+	re_atomic_rls_set(&rx->enabled, enable);
 }
 
 
@@ -640,7 +766,7 @@ int rtprecv_get_ssrc(struct rtp_receiver *rx, uint32_t *ssrc)
 
 	mtx_lock(rx->mtx);
 	if (rx->ssrc_set) {
-		*ssrc = rx->ssrc;
+		*ssrc = re_atomic_rlx(&rx->ssrc);
 		err = 0;
 	}
 	else
@@ -659,15 +785,19 @@ static bool rtprecv_consume_ssrc_change(struct rtp_receiver *rx,
 	if (!rx)
 		return false;
 
+	/* fast path, called for every packet */
+	if (!ssrc && !re_atomic_acq(&rx->ssrc_changed))
+		return false;
+
 	mtx_lock(rx->mtx);
-	if (rx->ssrc_changed) {
-		rx->ssrc_changed = false;
+	if (re_atomic_rlx(&rx->ssrc_changed)) {
+		re_atomic_rlx_set(&rx->ssrc_changed, false);
 		if (rx->ssrc_set && ssrc)
-			*ssrc = rx->ssrc;
+			*ssrc = re_atomic_rlx(&rx->ssrc);
 		changed = true;
 	}
 	else if (ssrc && rx->ssrc_set) {
-		*ssrc = rx->ssrc;
+		*ssrc = re_atomic_rlx(&rx->ssrc);
 	}
 	mtx_unlock(rx->mtx);
 
@@ -707,22 +837,42 @@ int rtprecv_debug(struct re_printf *pf, const struct rtp_receiver *rx)
 	if (!rx)
 		return 0;
 
-	mtx_lock(rx->mtx);
-	enabled = rx->enabled;
-	mtx_unlock(rx->mtx);
+	enabled = re_atomic_acq(&rx->enabled);
 
 	err  = re_hprintf(pf, " rx.enabled: %s\n", enabled ? "yes" : "no");
+	err |= re_hprintf(pf, " rx.workq:   %zu\n",
+			  spscq_count(rx->workq));
+	if (rx->pool)
+		err |= re_hprintf(pf, " rx.%H", rxpool_debug, NULL);
+	if (rx->batch)
+		err |= re_hprintf(pf, " rx.%H", rxbatch_debug, rx->batch);
 	err |= jbuf_debug(pf, rx->jbuf);
 
 	return err;
 }
 
 
-static void destructor(void *arg)
+/**
+ * Stop the RX side of the receiver. Detaches the sockets, stops the RX
+ * thread or pool membership and releases pending work for the main thread.
+ * Must be called before the RTP socket of the stream is freed.
+ *
+ * @param rx RTP Receiver
+ */
+void rtprecv_close(struct rtp_receiver *rx)
 {
-	struct rtp_receiver *rx = arg;
+	if (!rx || rx->closed)
+		return;
 
-	if (re_atomic_rlx(&rx->run)) {
+	rx->closed = true;
+
+	if (rx->pool) {
+		rtprecv_enable(rx, false);
+		rx->pool = mem_deref(rx->pool);
+		re_atomic_rlx_set(&rx->run, false);
+		re_thread_async_main_cancel((intptr_t)rx);
+	}
+	else if (re_atomic_rlx(&rx->run)) {
 		rtprecv_enable(rx, false);
 		re_atomic_rlx_set(&rx->run, false);
 		thrd_join(rx->thr, NULL);
@@ -735,6 +885,24 @@ static void destructor(void *arg)
 
 	tmr_cancel(&rx->tmr_decode);
 
+	if (rx->workq) {
+		struct work w;
+
+		while (!spscq_pop(rx->workq, &w))
+			work_release(&w);
+	}
+}
+
+
+static void destructor(void *arg)
+{
+	struct rtp_receiver *rx = arg;
+
+	rtprecv_close(rx);
+
+	mem_deref(rx->workq);
+	mem_deref(rx->arrivev);
+	mem_deref(rx->lat);
 	mem_deref(rx->metric);
 	mem_deref(rx->name);
 	mem_deref(rx->mtx);
@@ -768,6 +936,7 @@ int rtprecv_alloc(struct rtp_receiver **rxp,
 	rx->pseq   = -1;
 	rx->pt     = -1;
 	rx->pt_tel = -1;
+	rx->rxbatch = cfg->rxbatch;
 
 	err  = str_dup(&rx->name, name);
 	err |= mutex_alloc(&rx->mtx);
@@ -786,6 +955,17 @@ int rtprecv_alloc(struct rtp_receiver **rxp,
 		err = jbuf_set_type(rx->jbuf, cfg->audio.jbtype);
 		if (err)
 			goto out;
+
+		err = jbuf_set_storage(rx->jbuf, cfg->audio.jbstore);
+		if (err)
+			goto out;
+
+		if (cfg->audio.jbtype == JBUF_PERCENTILE) {
+			err = jbuf_set_percentile(rx->jbuf,
+						  cfg->audio.jbuf_pct);
+			if (err)
+				goto out;
+		}
 	}
 
 	/* Video Jitter buffer */
@@ -800,6 +980,17 @@ int rtprecv_alloc(struct rtp_receiver **rxp,
 		err = jbuf_set_type(rx->jbuf, cfg->video.jbtype);
 		if (err)
 			goto out;
+
+		err = jbuf_set_storage(rx->jbuf, cfg->video.jbstore);
+		if (err)
+			goto out;
+
+		if (cfg->video.jbtype == JBUF_PERCENTILE) {
+			err = jbuf_set_percentile(rx->jbuf,
+						  cfg->video.jbuf_pct);
+			if (err)
+				goto out;
+		}
 	}
 
 	struct pl *id = pl_alloc_str(name);
@@ -835,6 +1026,12 @@ int rtprecv_start_thread(struct rtp_receiver *rx)
 	if (re_atomic_rlx(&rx->run))
 		return 0;
 
+	if (!rx->workq) {
+		err = spscq_alloc(&rx->workq, WORKQ_SZ, sizeof(struct work));
+		if (err)
+			return err;
+	}
+
 	udp_thread_detach(rtp_sock(rx->rtp));
 	udp_thread_detach(rtcp_sock(rx->rtp));
 	re_atomic_rlx_set(&rx->run, true);
@@ -851,6 +1048,48 @@ int rtprecv_start_thread(struct rtp_receiver *rx)
 }
 
 
+/**
+ * Move the RTP receiver to the shared RX pool
+ *
+ * Instead of a dedicated RX thread, the RTP and RTCP sockets are attached
+ * to the least loaded event loop of a pool with thrdc loops
+ *
+ * @param rx    The rtp_receiver
+ * @param thrdc Number of event loops in the pool
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rtprecv_start_pool(struct rtp_receiver *rx, uint32_t thrdc)
+{
+	int err;
+
+	if (!rx)
+		return EINVAL;
+
+	if (re_atomic_rlx(&rx->run))
+		return 0;
+
+	if (!rx->workq) {
+		err = spscq_alloc(&rx->workq, WORKQ_SZ, sizeof(struct work));
+		if (err)
+			return err;
+	}
+
+	udp_thread_detach(rtp_sock(rx->rtp));
+	udp_thread_detach(rtcp_sock(rx->rtp));
+	re_atomic_rlx_set(&rx->run, true);
+	err = rxpool_attach(&rx->pool, thrdc, rxpool_attach_handler,
+			    rxpool_detach_handler, rx);
+	if (err) {
+		re_atomic_rlx_set(&rx->run, false);
+		udp_thread_attach(rtp_sock(rx->rtp));
+		udp_thread_attach(rtcp_sock(rx->rtp));
+	}
+
+	return err;
+}
+
+
 bool rtprecv_running(const struct rtp_receiver *rx)
 {
 	if (!rx)
@@ -883,47 +1122,50 @@ struct metric *rtprecv_metric(struct rtp_receiver *rx)
 }
 
 
-static void work_destructor(void *arg)
+/*
+ * Drain the work queue. The handlers may close the stream, which closes the
+ * receiver and releases the remaining work. The reference only keeps the
+ * memory of rx valid until the closed flag is checked.
+ */
+static void async_work_main(int err, void *arg)
 {
-	struct work *w = arg;
+	struct rtp_receiver *rx = arg;
+	struct work w;
+	(void)err;
 
-	switch (w->type) {
-		case WORK_RTCP:
-			mem_deref(w->u.rtcp);
-			break;
-		case WORK_PTCHANGED:
-			mem_deref(w->u.pt.mb);
-			break;
-		default:
-			break;
+	re_atomic_seq_set(&rx->work_pending, false);
+
+	mem_ref(rx);
+
+	while (!rx->closed && !spscq_pop(rx->workq, &w)) {
+
+		switch (w.type) {
+			case WORK_RTCP:
+				stream_process_rtcp(rx->strm, w.u.rtcp);
+				break;
+			case WORK_PTCHANGED:
+				rx->pth(w.u.pt.pt, w.u.pt.mb, rx->arg);
+				break;
+			case WORK_RTPESTAB:
+				rx->rtpestabh(rx->strm, rx->sessarg);
+				break;
+			default:
+				break;
+		}
+
+		work_release(&w);
 	}
+
+	mem_deref(rx);
 }
 
 
-static void async_work_main(int err, void *arg)
+static void async_mnat_main(int err, void *arg)
 {
-	struct work *w = arg;
-	struct rtp_receiver *rx = w->rx;
+	struct mnat_work *w = arg;
 	(void)err;
 
-	switch (w->type) {
-		case WORK_RTCP:
-			stream_process_rtcp(rx->strm, w->u.rtcp);
-			break;
-		case WORK_PTCHANGED:
-			rx->pth(w->u.pt.pt, w->u.pt.mb, rx->arg);
-			break;
-		case WORK_RTPESTAB:
-			rx->rtpestabh(rx->strm, rx->sessarg);
-			break;
-		case WORK_MNATCONNH:
-			stream_mnat_connected(rx->strm,
-					      &w->u.mnat.raddr1,
-					      &w->u.mnat.raddr2);
-			break;
-		default:
-			break;
-	}
+	stream_mnat_connected(w->rx->strm, &w->raddr1, &w->raddr2);
 
 	mem_deref(w);
 }
@@ -937,3 +1179,32 @@ void rtprecv_set_srate(struct rtp_receiver *rx, uint32_t srate)
 	rx->srate = srate;
 	jbuf_set_srate(rx->jbuf, srate);
 }
+
+
+/**
+ * Enable latency tracing of the jitter buffer
+ *
+ * @param rx RTP Receiver
+ * @param al Audio latency trace
+ *
+ * @return 0 if success, otherwise errorcode
+ *
+ * @note Must be called before the receiver is started
+ */
+int rtprecv_set_aulat(struct rtp_receiver *rx, struct aulat *al)
+{
+	if (!rx || !al)
+		return EINVAL;
+
+	if (!rx->arrivev) {
+		rx->arrivev = mem_zalloc(ARRIVE_SZ * sizeof(*rx->arrivev),
+					 NULL);
+		if (!rx->arrivev)
+			return ENOMEM;
+	}
+
+	mem_deref(rx->lat);
+	rx->lat = mem_ref(al);
+
+	return 0;
+}
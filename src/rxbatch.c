@@ -0,0 +1,249 @@
+/**
+ * @file rxbatch.c  Batched UDP receive for RTP sockets
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#ifdef LINUX
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+#include <string.h>
+#include <re.h>
+#include <re_atomic.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/**
+ * \page RxBatch Batched UDP receive
+ *
+ * Instead of letting libre read one datagram per wakeup, the socket is
+ * polled by the receive batch, which reads up to N datagrams per system
+ * call with recvmmsg() into a set of preallocated mbufs.
+ *
+ * Every datagram is then injected into the normal receive path of the UDP
+ * socket with udp_recv_packet(), so the UDP helpers (BUNDLE, SRTP, DTLS,
+ * ICE/TURN) and the receive handler are called exactly as before.
+ *
+ * An mbuf that is still referenced after the receive path (e.g. it was put
+ * into the jitter buffer) is handed over and replaced by a new one on the
+ * next read; all other mbufs are reused.
+ */
+
+
+enum {
+	RXBATCH_MAX = 64,
+	RXBATCH_BUFSZ = 2048,
+};
+
+
+struct rxbatch {
+	struct re_fhs *fhs;           /**< File descriptor handler          */
+	struct udp_sock *us;          /**< UDP socket                       */
+	re_sock_t fd;                 /**< Socket file descriptor           */
+	uint32_t n;                   /**< Max. datagrams per read          */
+	struct mbuf **mbv;            /**< Receive buffers                  */
+	struct sa *srcv;              /**< Source addresses                 */
+#ifdef LINUX
+	struct mmsghdr *msgv;         /**< Message headers                  */
+	struct iovec *iov;            /**< I/O vectors                      */
+#endif
+	RE_ATOMIC uint64_t n_calls;   /**< Number of recvmmsg() calls       */
+	RE_ATOMIC uint64_t n_pkts;    /**< Number of received datagrams     */
+};
+
+
+/** Totals of all receive batches */
+static struct {
+	RE_ATOMIC uint64_t n_calls;
+	RE_ATOMIC uint64_t n_pkts;
+} total;
+
+
+#ifdef LINUX
+static void destructor(void *arg)
+{
+	struct rxbatch *rb = arg;
+
+	rb->fhs = fd_close(rb->fhs);
+
+	for (uint32_t i = 0; rb->mbv && i < rb->n; i++)
+		mem_deref(rb->mbv[i]);
+
+	mem_deref(rb->mbv);
+	mem_deref(rb->srcv);
+	mem_deref(rb->msgv);
+	mem_deref(rb->iov);
+}
+
+
+static int prepare(struct rxbatch *rb)
+{
+	for (uint32_t i = 0; i < rb->n; i++) {
+		struct mbuf *mb = rb->mbv[i];
+		struct mmsghdr *msg = &rb->msgv[i];
+
+		if (!mb) {
+			mb = mbuf_alloc(RXBATCH_BUFSZ);
+			if (!mb)
+				return ENOMEM;
+
+			rb->mbv[i] = mb;
+		}
+
+		mb->pos = 0;
+		mb->end = 0;
+
+		rb->iov[i].iov_base = mb->buf;
+		rb->iov[i].iov_len  = mb->size;
+
+		memset(msg, 0, sizeof(*msg));
+		msg->msg_hdr.msg_name    = &rb->srcv[i].u;
+		msg->msg_hdr.msg_namelen = sizeof(rb->srcv[i].u);
+		msg->msg_hdr.msg_iov     = &rb->iov[i];
+		msg->msg_hdr.msg_iovlen  = 1;
+	}
+
+	return 0;
+}
+
+
+static void read_handler(int flags, void *arg)
+{
+	struct rxbatch *rb = arg;
+	int n;
+
+	if (!(flags & FD_READ))
+		return;
+
+	if (prepare(rb))
+		return;
+
+	n = recvmmsg(rb->fd, rb->msgv, rb->n, MSG_DONTWAIT, NULL);
+	if (n <= 0)
+		return;
+
+	re_atomic_rlx_set(&rb->n_calls, re_atomic_rlx(&rb->n_calls) + 1);
+	re_atomic_rlx_set(&rb->n_pkts, re_atomic_rlx(&rb->n_pkts) + n);
+	re_atomic_rlx_add(&total.n_calls, 1);
+	re_atomic_rlx_add(&total.n_pkts, n);
+
+	for (int i = 0; i < n; i++) {
+		struct mbuf *mb = rb->mbv[i];
+		struct sa *src = &rb->srcv[i];
+
+		mb->end  = rb->msgv[i].msg_len;
+		src->len = rb->msgv[i].msg_hdr.msg_namelen;
+
+		udp_recv_packet(rb->us, src, mb);
+
+		/* the mbuf was kept by the receive path, hand it over */
+		if (mem_nrefs(mb) > 1)
+			rb->mbv[i] = mem_deref(mb);
+	}
+}
+#endif
+
+
+/**
+ * Start batched receive on a UDP socket
+ *
+ * Must be called from the thread whose event loop shall poll the socket.
+ * The socket must not be attached to the event loop of any thread.
+ *
+ * @param rbp Pointer to allocated receive batch
+ * @param us  UDP socket
+ * @param n   Max. number of datagrams per system call
+ *
+ * @return 0 if success, ENOSYS if not supported, otherwise errorcode
+ *
+ * @note The receive batch must be destroyed from the same thread
+ */
+int rxbatch_alloc(struct rxbatch **rbp, struct udp_sock *us, uint32_t n)
+{
+#ifdef LINUX
+	struct rxbatch *rb;
+	int err;
+
+	if (!rbp || !us || !n)
+		return EINVAL;
+
+	rb = mem_zalloc(sizeof(*rb), destructor);
+	if (!rb)
+		return ENOMEM;
+
+	rb->us = us;
+	rb->fd = udp_sock_fd(us, AF_UNSPEC);
+	rb->n  = min(n, RXBATCH_MAX);
+
+	rb->mbv  = mem_zalloc(rb->n * sizeof(*rb->mbv), NULL);
+	rb->srcv = mem_zalloc(rb->n * sizeof(*rb->srcv), NULL);
+	rb->msgv = mem_zalloc(rb->n * sizeof(*rb->msgv), NULL);
+	rb->iov  = mem_zalloc(rb->n * sizeof(*rb->iov), NULL);
+	if (!rb->mbv || !rb->srcv || !rb->msgv || !rb->iov) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	err = prepare(rb);
+	if (err)
+		goto out;
+
+	err = fd_listen(&rb->fhs, rb->fd, FD_READ, read_handler, rb);
+
+ out:
+	if (err)
+		mem_deref(rb);
+	else
+		*rbp = rb;
+
+	return err;
+#else
+	(void)rbp;
+	(void)us;
+	(void)n;
+
+	return ENOSYS;
+#endif
+}
+
+
+/**
+ * Print the receive batch statistics
+ *
+ * @param pf Print function
+ * @param rb Receive batch
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rxbatch_debug(struct re_printf *pf, struct rxbatch *rb)
+{
+	uint64_t calls, pkts;
+
+	if (!rb)
+		return 0;
+
+	calls = re_atomic_rlx(&rb->n_calls);
+	pkts  = re_atomic_rlx(&rb->n_pkts);
+
+	return re_hprintf(pf, "rxbatch: n=%u calls=%llu packets=%llu"
+			  " (%.1f per call)\n",
+			  rb->n, calls, pkts,
+			  calls ? (double)pkts / (double)calls : .0);
+}
+
+
+/**
+ * Get the totals of all receive batches
+ *
+ * @param calls Number of recvmmsg() calls (optional)
+ * @param pkts  Number of received datagrams (optional)
+ */
+void rxbatch_stats(uint64_t *calls, uint64_t *pkts)
+{
+	if (calls)
+		*calls = re_atomic_rlx(&total.n_calls);
+
+	if (pkts)
+		*pkts = re_atomic_rlx(&total.n_pkts);
+}
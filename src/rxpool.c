@@ -0,0 +1,401 @@
+/**
+ * @file rxpool.c  Shared pool of RTP receive event loops
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#ifdef LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+#include <re.h>
+#include <re_atomic.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/**
+ * \page RxPool RTP Receive Pool
+ *
+ * The receive pool runs a fixed number of event loops, each in its own
+ * thread (pinned to one CPU core on Linux). The RTP and RTCP sockets of
+ * many receivers are attached to these loops, so the number of threads is
+ * bounded by the pool size and not by the number of streams.
+ *
+ * A new member is placed on the loop with the lowest number of attached
+ * members. The attach and detach handlers of a member are called from the
+ * loop thread, which is where the sockets and timers must be attached.
+ */
+
+
+enum {
+	RXPOOL_ATTACH,
+	RXPOOL_DETACH,
+	RXPOOL_STOP,
+};
+
+
+struct rxloop {
+	struct rxpool *pool;          /**< Parent pool                      */
+	thrd_t thr;                   /**< Event loop thread                */
+	struct mqueue *mq;            /**< Message queue to the loop        */
+	uint32_t id;                  /**< Loop index                       */
+	uint32_t load;                /**< Number of members                */
+	bool ready;                   /**< Loop has started                 */
+	int err;                      /**< Startup error                    */
+};
+
+
+struct rxpool {
+	struct rxloop *loopv;         /**< Event loops                      */
+	uint32_t loopc;               /**< Number of running event loops    */
+	mtx_t *mtx;                   /**< Protects load and member states  */
+	cnd_t cnd;                    /**< Signals loop start and detach    */
+};
+
+
+struct rxpool_member {
+	struct rxloop *loop;          /**< Loop of this member              */
+	bool attached;                /**< Attach handler was called        */
+	bool detached;                /**< Detach handler was called        */
+	rxpool_h *attachh;            /**< Attach handler                   */
+	rxpool_h *detachh;            /**< Detach handler                   */
+	void *arg;                    /**< Handler argument                 */
+};
+
+
+static struct rxpool *rxpool;
+
+static struct {
+	RE_ATOMIC uint64_t n_attach;
+	RE_ATOMIC uint64_t n_detach;
+} total;
+
+
+static void mqueue_handler(int id, void *data, void *arg)
+{
+	struct rxloop *loop = arg;
+	struct rxpool_member *m = data;
+
+	switch (id) {
+
+	case RXPOOL_ATTACH:
+		m->attachh(m->arg);
+		re_atomic_rlx_add(&total.n_attach, 1);
+
+		mtx_lock(loop->pool->mtx);
+		m->attached = true;
+		mtx_unlock(loop->pool->mtx);
+		break;
+
+	case RXPOOL_DETACH:
+		if (m->attached) {
+			m->detachh(m->arg);
+			re_atomic_rlx_add(&total.n_detach, 1);
+		}
+
+		mtx_lock(loop->pool->mtx);
+		m->detached = true;
+		cnd_broadcast(&loop->pool->cnd);
+		mtx_unlock(loop->pool->mtx);
+		break;
+
+	case RXPOOL_STOP:
+		re_cancel();
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+static void set_affinity(uint32_t id)
+{
+#ifdef LINUX
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	cpu_set_t set;
+	int err;
+
+	if (ncpu <= 1)
+		return;
+
+	CPU_ZERO(&set);
+	CPU_SET(id % (uint32_t)ncpu, &set);
+
+	err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (err)
+		warning("rxpool: could not pin loop %u (%m)\n", id, err);
+#else
+	(void)id;
+#endif
+}
+
+
+static int loop_thread(void *arg)
+{
+	struct rxloop *loop = arg;
+	struct rxpool *pool = loop->pool;
+	int err;
+
+	err = re_thread_init();
+	if (err)
+		goto out;
+
+	set_affinity(loop->id);
+
+	err = mqueue_alloc(&loop->mq, mqueue_handler, loop);
+
+ out:
+	mtx_lock(pool->mtx);
+	loop->ready = true;
+	loop->err   = err;
+	cnd_broadcast(&pool->cnd);
+	mtx_unlock(pool->mtx);
+
+	if (err)
+		return err;
+
+	err = re_main(NULL);
+
+	loop->mq = mem_deref(loop->mq);
+	re_thread_close();
+
+	return err;
+}
+
+
+static void rxpool_destructor(void *arg)
+{
+	struct rxpool *pool = arg;
+
+	for (uint32_t i = 0; i < pool->loopc; i++) {
+		struct rxloop *loop = &pool->loopv[i];
+
+		if (loop->mq)
+			mqueue_push(loop->mq, RXPOOL_STOP, NULL);
+
+		thrd_join(loop->thr, NULL);
+	}
+
+	cnd_destroy(&pool->cnd);
+
+	mem_deref(pool->loopv);
+	mem_deref(pool->mtx);
+
+	if (rxpool == pool)
+		rxpool = NULL;
+}
+
+
+static int rxpool_alloc(struct rxpool **poolp, uint32_t thrdc)
+{
+	struct rxpool *pool;
+	int err;
+
+	if (!poolp || !thrdc)
+		return EINVAL;
+
+	pool = mem_zalloc(sizeof(*pool), NULL);
+	if (!pool)
+		return ENOMEM;
+
+	err = mutex_alloc(&pool->mtx);
+	if (err)
+		goto out;
+
+	if (cnd_init(&pool->cnd) != thrd_success) {
+		mem_deref(pool->mtx);
+		err = ENOMEM;
+		goto out;
+	}
+
+	mem_destructor(pool, rxpool_destructor);
+
+	pool->loopv = mem_zalloc(thrdc * sizeof(*pool->loopv), NULL);
+	if (!pool->loopv) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	for (; pool->loopc < thrdc; pool->loopc++) {
+		struct rxloop *loop = &pool->loopv[pool->loopc];
+
+		loop->pool = pool;
+		loop->id   = pool->loopc;
+
+		err = thread_create_name(&loop->thr, "RX pool",
+					 loop_thread, loop);
+		if (err)
+			goto out;
+
+		mtx_lock(pool->mtx);
+		while (!loop->ready)
+			cnd_wait(&pool->cnd, pool->mtx);
+		err = loop->err;
+		mtx_unlock(pool->mtx);
+
+		if (err) {
+			thrd_join(loop->thr, NULL);
+			goto out;
+		}
+	}
+
+	info("rxpool: started %u event loops\n", pool->loopc);
+
+ out:
+	if (err)
+		mem_deref(pool);
+	else
+		*poolp = pool;
+
+	return err;
+}
+
+
+static void member_destructor(void *arg)
+{
+	struct rxpool_member *m = arg;
+	struct rxpool *pool = m->loop->pool;
+	int err;
+
+	err = mqueue_push(m->loop->mq, RXPOOL_DETACH, m);
+
+	mtx_lock(pool->mtx);
+	if (!err) {
+		while (!m->detached)
+			cnd_wait(&pool->cnd, pool->mtx);
+	}
+	--m->loop->load;
+	mtx_unlock(pool->mtx);
+
+	mem_deref(pool);
+}
+
+
+/**
+ * Attach a member to the shared RTP receive pool
+ *
+ * The pool is created with thrdc event loops when the first member is
+ * attached, and stopped when the last member is destroyed. The member is
+ * placed on the least loaded loop, and the attach handler is called from
+ * that loop thread.
+ *
+ * @param mp      Pointer to allocated pool member
+ * @param thrdc   Number of event loops
+ * @param attachh Attach handler, called from the loop thread
+ * @param detachh Detach handler, called from the loop thread
+ * @param arg     Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ *
+ * @note The member must be destroyed from a non-pool thread. Destroying it
+ *       blocks until the detach handler has returned.
+ */
+int rxpool_attach(struct rxpool_member **mp, uint32_t thrdc,
+		  rxpool_h *attachh, rxpool_h *detachh, void *arg)
+{
+	struct rxpool_member *m;
+	struct rxpool *pool;
+	struct rxloop *loop;
+	int err;
+
+	if (!mp || !attachh || !detachh)
+		return EINVAL;
+
+	m = mem_zalloc(sizeof(*m), NULL);
+	if (!m)
+		return ENOMEM;
+
+	if (rxpool) {
+		pool = mem_ref(rxpool);
+	}
+	else {
+		err = rxpool_alloc(&pool, thrdc);
+		if (err) {
+			mem_deref(m);
+			return err;
+		}
+
+		rxpool = pool;
+	}
+
+	mtx_lock(pool->mtx);
+	loop = &pool->loopv[0];
+	for (uint32_t i = 1; i < pool->loopc; i++) {
+		if (pool->loopv[i].load < loop->load)
+			loop = &pool->loopv[i];
+	}
+	++loop->load;
+	mtx_unlock(pool->mtx);
+
+	m->loop    = loop;
+	m->attachh = attachh;
+	m->detachh = detachh;
+	m->arg     = arg;
+
+	err = mqueue_push(loop->mq, RXPOOL_ATTACH, m);
+	if (err) {
+		mtx_lock(pool->mtx);
+		--loop->load;
+		mtx_unlock(pool->mtx);
+
+		mem_deref(pool);
+		mem_deref(m);
+		return err;
+	}
+
+	mem_destructor(m, member_destructor);
+
+	*mp = m;
+
+	return 0;
+}
+
+
+/**
+ * Print the RTP receive pool status
+ *
+ * @param pf     Print function
+ * @param unused Unused parameter
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int rxpool_debug(struct re_printf *pf, void *unused)
+{
+	struct rxpool *pool = rxpool;
+	int err;
+	(void)unused;
+
+	if (!pool)
+		return re_hprintf(pf, "rxpool: not running\n");
+
+	err = re_hprintf(pf, "rxpool: loops=%u load=[", pool->loopc);
+
+	mtx_lock(pool->mtx);
+	for (uint32_t i = 0; i < pool->loopc; i++) {
+		err |= re_hprintf(pf, "%s%u", i ? " " : "",
+				  pool->loopv[i].load);
+	}
+	mtx_unlock(pool->mtx);
+
+	err |= re_hprintf(pf, "]\n");
+
+	return err;
+}
+
+
+/**
+ * Get the totals of the RTP receive pool
+ *
+ * @param attached Number of members attached on a loop thread (optional)
+ * @param detached Number of members detached on a loop thread (optional)
+ */
+void rxpool_stats(uint64_t *attached, uint64_t *detached)
+{
+	if (attached)
+		*attached = re_atomic_rlx(&total.n_attach);
+
+	if (detached)
+		*detached = re_atomic_rlx(&total.n_detach);
+}
@@ -0,0 +1,162 @@
+/**
+ * @file spscq.c  Lock-free single-producer/single-consumer queue
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <re_atomic.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/**
+ * \page SpscQueue Single-Producer/Single-Consumer Queue
+ *
+ * A bounded queue of fixed-size items, used to pass data from exactly one
+ * producer thread to exactly one consumer thread without locking.
+ *
+ * All slots are allocated up front, so push and pop never allocate memory.
+ * Items are copied in and out of the slots. The head index is only written
+ * by the consumer and the tail index is only written by the producer; both
+ * indices run freely and are masked with the (power of two) queue size.
+ *
+ * Publishing and observing the tail index is sequentially consistent. This
+ * allows a producer to check a "consumer is idle" flag after a push, and
+ * a consumer to clear that flag before draining, without losing a wakeup.
+ */
+
+
+enum {
+	CACHE_LINE = 64,
+};
+
+
+struct spscq {
+	RE_ATOMIC size_t head;        /**< Read index (consumer)            */
+	uint8_t pad1[CACHE_LINE];     /**< Keep indices on separate lines   */
+	RE_ATOMIC size_t tail;        /**< Write index (producer)           */
+	uint8_t pad2[CACHE_LINE];     /**< Keep indices on separate lines   */
+	uint8_t *v;                   /**< Preallocated item slots          */
+	size_t sz;                    /**< Number of slots (power of two)   */
+	size_t itemsz;                /**< Size of one item in [bytes]      */
+};
+
+
+static void destructor(void *arg)
+{
+	struct spscq *q = arg;
+
+	mem_deref(q->v);
+}
+
+
+/**
+ * Allocate a lock-free single-producer/single-consumer queue
+ *
+ * @param qp     Pointer to allocated queue
+ * @param sz     Minimum number of items (rounded up to a power of two)
+ * @param itemsz Size of one item in [bytes]
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int spscq_alloc(struct spscq **qp, size_t sz, size_t itemsz)
+{
+	struct spscq *q;
+	size_t n = 1;
+
+	if (!qp || !sz || !itemsz)
+		return EINVAL;
+
+	while (n < sz)
+		n <<= 1;
+
+	q = mem_zalloc(sizeof(*q), destructor);
+	if (!q)
+		return ENOMEM;
+
+	q->v = mem_zalloc(n * itemsz, NULL);
+	if (!q->v) {
+		mem_deref(q);
+		return ENOMEM;
+	}
+
+	q->sz     = n;
+	q->itemsz = itemsz;
+
+	*qp = q;
+
+	return 0;
+}
+
+
+/**
+ * Push an item to the queue (producer thread only)
+ *
+ * @param q    SPSC queue
+ * @param item Item to copy into the queue
+ *
+ * @return 0 if success, ENOSPC if full, otherwise errorcode
+ */
+int spscq_push(struct spscq *q, const void *item)
+{
+	size_t tail;
+
+	if (!q || !item)
+		return EINVAL;
+
+	tail = re_atomic_rlx(&q->tail);
+
+	if (tail - re_atomic_acq(&q->head) >= q->sz)
+		return ENOSPC;
+
+	memcpy(&q->v[(tail & (q->sz - 1)) * q->itemsz], item, q->itemsz);
+
+	re_atomic_seq_set(&q->tail, tail + 1);
+
+	return 0;
+}
+
+
+/**
+ * Pop an item from the queue (consumer thread only)
+ *
+ * @param q    SPSC queue
+ * @param item Buffer where the item is copied to
+ *
+ * @return 0 if success, ENOENT if empty, otherwise errorcode
+ */
+int spscq_pop(struct spscq *q, void *item)
+{
+	size_t head;
+
+	if (!q || !item)
+		return EINVAL;
+
+	head = re_atomic_rlx(&q->head);
+
+	if (head == re_atomic_seq(&q->tail))
+		return ENOENT;
+
+	memcpy(item, &q->v[(head & (q->sz - 1)) * q->itemsz], q->itemsz);
+
+	re_atomic_rls_set(&q->head, head + 1);
+
+	return 0;
+}
+
+
+/**
+ * Get the number of items in the queue
+ *
+ * @param q SPSC queue
+ *
+ * @return Number of queued items
+ */
+size_t spscq_count(struct spscq *q)
+{
+	if (!q)
+		return 0;
+
+	return re_atomic_acq(&q->tail) - re_atomic_acq(&q->head);
+}
@@ -30,6 +30,7 @@ struct sender {
 	struct sa raddr_rtcp;  /**< Remote RTCP address             */
 	int pt_enc;            /**< Payload type for encoding       */
 	RE_ATOMIC bool enabled;/**< True if enabled                 */
+	struct txbatch *batch; /**< Optional transmit batch         */
 	mtx_t *lock;
 };
 
@@ -93,17 +94,17 @@ struct stream {
 
 static void print_rtp_stats(const struct stream *s)
 {
-	uint32_t tx_n_packets = metric_n_packets(s->tx.metric);
-	uint32_t rx_n_packets = metric_n_packets(rtprecv_metric(s->rx));
+	uint64_t tx_n_packets = metric_n_packets(s->tx.metric);
+	uint64_t rx_n_packets = metric_n_packets(rtprecv_metric(s->rx));
 	bool started = tx_n_packets > 0 || rx_n_packets > 0;
 
 	if (!started)
 		return;
 
 	info("\n%-9s       Transmit:     Receive:\n"
-	     "packets:        %7u      %7u\n"
+	     "packets:        %7llu      %7llu\n"
 	     "avg. bitrate:   %7.1f      %7.1f  (kbit/s)\n"
-	     "errors:         %7d      %7d\n"
+	     "errors:         %7llu      %7llu\n"
 	     ,
 	     sdp_media_name(s->sdp),
 	     tx_n_packets, rx_n_packets,
@@ -138,6 +139,7 @@ static void stream_destructor(void *arg)
 	tmr_cancel(&s->rxm.tmr_rtp);
 	tmr_cancel(&s->rxm.tmr_rec);
 	tmr_cancel(&s->tmr_natph);
+	rtprecv_close(s->rx);  /* NOTE: close before rtp */
 	mem_deref(s->rx);
 	list_unlink(&s->le);
 	mem_deref(s->sdp);
@@ -145,6 +147,7 @@ static void stream_destructor(void *arg)
 	mem_deref(s->mencs);
 	mem_deref(s->mns);
 	mem_deref(s->bundle);  /* NOTE: deref before rtp */
+	mem_deref(s->tx.batch);  /* NOTE: deref before rtp */
 	mem_deref(s->rtp);
 	mem_deref(s->cname);
 	mem_deref(s->peer);
@@ -228,7 +231,11 @@ int stream_enable_tx(struct stream *strm, bool enable)
 static void stream_start_receiver(void *arg)
 {
 	struct stream *s = arg;
-	rtprecv_start_thread(s->rx);
+
+	if (s->cfg.rxmode == RECEIVE_MODE_POOL)
+		rtprecv_start_pool(s->rx, s->cfg.rxpool);
+	else
+		rtprecv_start_thread(s->rx);
 }
 
 
@@ -259,12 +266,13 @@ int stream_enable_rx(struct stream *strm, bool enable)
 	debug("stream: enable %s RTP receiver\n", media_name(strm->type));
 	rtprecv_enable(strm->rx, true);
 
-	if (strm->rtp && strm->cfg.rxmode == RECEIVE_MODE_THREAD &&
+	if (strm->rtp && strm->cfg.rxmode != RECEIVE_MODE_MAIN &&
 	    strm->type == MEDIA_AUDIO && !rtprecv_running(strm->rx)) {
 		if (stream_bundle(strm)) {
-			warning("stream: rtp_rxmode thread was disabled "
+			warning("stream: rtp_rxmode %s was disabled "
 				"because it is not supported in combination "
-				"with avt_bundle\n");
+				"with avt_bundle\n",
+				rtp_receive_mode_str(strm->cfg.rxmode));
 		}
 		else {
 			strm->rxm.use_rxthread = true;
@@ -676,7 +684,7 @@ int stream_bundle_init(struct stream *strm, bool offerer)
 	if (!strm)
 		return EINVAL;
 
-	err = bundle_alloc(&strm->bundle);
+	err = bundle_alloc(&strm->bundle, strm);
 	if (err)
 		return err;
 
@@ -797,6 +805,61 @@ int stream_resend(struct stream *s, uint16_t seq, bool ext, bool marker,
 }
 
 
+/**
+ * Enable batched transmit of RTP packets
+ *
+ * RTP packets sent with stream_send() by the thread that holds the batch,
+ * see stream_hold_txbatch(), are queued until that thread calls
+ * stream_flush_txbatch(). Packets from other threads are sent directly.
+ * Must be called before the first packet is sent.
+ *
+ * @param strm Stream object
+ * @param n    Max. number of packets per system call
+ * @param gso  True to use UDP Generic Segmentation Offload if possible
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int stream_enable_txbatch(struct stream *strm, uint32_t n, bool gso)
+{
+	if (!strm || !n)
+		return EINVAL;
+
+	if (strm->tx.batch)
+		return 0;
+
+	return txbatch_alloc(&strm->tx.batch, rtp_sock(strm->rtp), n, gso);
+}
+
+
+/**
+ * Hold the transmit batch, RTP packets sent from the calling thread are
+ * queued until it calls stream_flush_txbatch()
+ *
+ * @param strm Stream object
+ */
+void stream_hold_txbatch(struct stream *strm)
+{
+	if (!strm)
+		return;
+
+	txbatch_hold(strm->tx.batch);
+}
+
+
+/**
+ * Send all RTP packets queued by the transmit batch
+ *
+ * @param strm Stream object
+ */
+void stream_flush_txbatch(struct stream *strm)
+{
+	if (!strm)
+		return;
+
+	txbatch_flush(strm->tx.batch);
+}
+
+
 static void disable_mnat(struct stream *s)
 {
 	info("stream: disable MNAT (%s)\n", media_name(s->type));
@@ -843,8 +906,12 @@ static void stream_remote_set(struct stream *s)
 	if (rssrc) {
 		struct pl num;
 
-		if (0 == re_regex(rssrc, str_len(rssrc), "[0-9]+", &num))
-			rtprecv_set_ssrc(s->rx, pl_u32(&num));
+		if (0 == re_regex(rssrc, str_len(rssrc), "[0-9]+", &num)) {
+			const uint32_t ssrc = pl_u32(&num);
+
+			rtprecv_set_ssrc(s->rx, ssrc);
+			bundle_set_ssrc(s->bundle, ssrc);
+		}
 	}
 
 	/* RFC 5761 */
@@ -1170,7 +1237,9 @@ int stream_jbuf_stats(const struct stream *strm, struct jbuf_stat *stat)
  */
 uint32_t stream_metric_get_tx_n_packets(const struct stream *strm)
 {
-	return strm ? metric_n_packets(strm->tx.metric) : 0;
+	uint64_t n = metric_n_packets(stream_metric_tx(strm));
+
+	return (uint32_t)n;
 }
 
 
@@ -1183,7 +1252,9 @@ uint32_t stream_metric_get_tx_n_packets(const struct stream *strm)
  */
 uint32_t stream_metric_get_tx_n_bytes(const struct stream *strm)
 {
-	return strm ? metric_n_bytes(strm->tx.metric) : 0;
+	uint64_t n = metric_n_bytes(stream_metric_tx(strm));
+
+	return (uint32_t)n;
 }
 
 
@@ -1196,7 +1267,9 @@ uint32_t stream_metric_get_tx_n_bytes(const struct stream *strm)
  */
 uint32_t stream_metric_get_tx_n_err(const struct stream *strm)
 {
-	return strm ? metric_n_err(strm->tx.metric) : 0;
+	uint64_t n = metric_n_err(stream_metric_tx(strm));
+
+	return (uint32_t)n;
 }
 
 
@@ -1235,7 +1308,9 @@ double stream_metric_get_tx_avg_bitrate(const struct stream *strm)
  */
 uint32_t stream_metric_get_rx_n_packets(const struct stream *strm)
 {
-	return strm ? metric_n_packets(rtprecv_metric(strm->rx)) : 0;
+	uint64_t n = metric_n_packets(stream_metric_rx(strm));
+
+	return (uint32_t)n;
 }
 
 
@@ -1248,7 +1323,9 @@ uint32_t stream_metric_get_rx_n_packets(const struct stream *strm)
  */
 uint32_t stream_metric_get_rx_n_bytes(const struct stream *strm)
 {
-	return strm ? metric_n_bytes(rtprecv_metric(strm->rx)) : 0;
+	uint64_t n = metric_n_bytes(stream_metric_rx(strm));
+
+	return (uint32_t)n;
 }
 
 
@@ -1261,7 +1338,9 @@ uint32_t stream_metric_get_rx_n_bytes(const struct stream *strm)
  */
 uint32_t stream_metric_get_rx_n_err(const struct stream *strm)
 {
-	return strm ? metric_n_err(rtprecv_metric(strm->rx)) : 0;
+	uint64_t n = metric_n_err(stream_metric_rx(strm));
+
+	return (uint32_t)n;
 }
 
 
@@ -1291,6 +1370,18 @@ double stream_metric_get_rx_avg_bitrate(const struct stream *strm)
 }
 
 
+struct metric *stream_metric_tx(const struct stream *strm)
+{
+	return strm ? strm->tx.metric : NULL;
+}
+
+
+struct metric *stream_metric_rx(const struct stream *strm)
+{
+	return strm ? rtprecv_metric(strm->rx) : NULL;
+}
+
+
 bool stream_is_ready(const struct stream *strm)
 {
 	if (!strm)
@@ -1613,6 +1704,23 @@ int stream_ssrc_rx(const struct stream *strm, uint32_t *ssrc)
 }
 
 
+/**
+ * Enable latency tracing of the incoming RTP stream
+ *
+ * @param strm Stream object
+ * @param al   Audio latency trace
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int stream_set_aulat(struct stream *strm, struct aulat *al)
+{
+	if (!strm)
+		return EINVAL;
+
+	return rtprecv_set_aulat(strm->rx, al);
+}
+
+
 void stream_mnat_attr(struct stream *strm, const char *name, const char *value)
 {
 	if (!strm)
@@ -1688,6 +1796,7 @@ int stream_debug(struct re_printf *pf, const struct stream *s)
 
 	err |= mbuf_printf(mb, " tx.enabled: %s\n",
 			   re_atomic_rlx(&s->tx.enabled) ? "yes" : "no");
+	err |= txbatch_debug(&pfmb, s->tx.batch);
 	err |= rtprecv_debug(&pfmb, s->rx);
 	err |= rtp_debug(&pfmb, s->rtp);
 
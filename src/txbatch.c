@@ -0,0 +1,415 @@
+/**
+ * @file txbatch.c  Batched UDP transmit for RTP sockets
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#ifdef LINUX
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#endif
+#include <string.h>
+#include <re.h>
+#include <re_atomic.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/**
+ * \page TxBatch Batched UDP transmit
+ *
+ * The transmit batch is a UDP helper on the lowest layer of an RTP socket,
+ * so it sees every packet after SRTP, BUNDLE and TURN/ICE have done their
+ * work, just before it would be written to the network.
+ *
+ * While the batch is held by the sending thread, packets from that thread
+ * are copied to preallocated buffers instead of being sent. Then
+ * txbatch_flush() writes all of them with one sendmmsg() call, or with one
+ * UDP_SEGMENT (GSO) send when all packets go to the same destination and
+ * have the same size (the last one may be shorter). Packets from other
+ * threads are sent directly.
+ */
+
+
+enum {
+	TXBATCH_LAYER = -100,      /* below all other helpers */
+	TXBATCH_MAX   = 64,
+	TXBATCH_BUFSZ = 1500,
+	GSO_MAX_BYTES = 65000,
+};
+
+
+struct txpkt {
+	struct mbuf *mb;              /**< Packet, after all helpers        */
+	struct sa dst;                /**< Destination address              */
+};
+
+
+struct txbatch {
+	struct udp_helper *uh;        /**< UDP helper                       */
+	re_sock_t fd;                 /**< Socket file descriptor           */
+	RE_ATOMIC bool held;          /**< Batch is held by owner thread    */
+	thrd_t owner;                 /**< Thread that holds the batch      */
+	struct txpkt *pktv;           /**< Queued packets                   */
+	uint32_t pktc;                /**< Number of queued packets         */
+	uint32_t n;                   /**< Max. number of queued packets    */
+	bool gso;                     /**< Use UDP GSO if possible          */
+	uint8_t *gsobuf;              /**< Buffer for GSO super-packets     */
+#ifdef LINUX
+	struct mmsghdr *msgv;         /**< Message headers                  */
+	struct iovec *iov;            /**< I/O vectors                      */
+#endif
+	RE_ATOMIC uint64_t n_calls;   /**< Number of system calls           */
+	RE_ATOMIC uint64_t n_pkts;    /**< Number of sent packets           */
+	RE_ATOMIC uint64_t n_gso;     /**< Number of GSO sends              */
+};
+
+
+/** Totals of all transmit batches */
+static struct {
+	RE_ATOMIC uint64_t n_calls;
+	RE_ATOMIC uint64_t n_pkts;
+} total;
+
+
+#ifdef LINUX
+static void flush_pkts(struct txbatch *tb);
+
+
+static void destructor(void *arg)
+{
+	struct txbatch *tb = arg;
+
+	tb->uh = mem_deref(tb->uh);
+
+	for (uint32_t i = 0; tb->pktv && i < tb->n; i++)
+		mem_deref(tb->pktv[i].mb);
+
+	mem_deref(tb->pktv);
+	mem_deref(tb->gsobuf);
+	mem_deref(tb->msgv);
+	mem_deref(tb->iov);
+}
+
+
+static bool send_handler(int *err, struct sa *dst, struct mbuf *mb,
+			 void *arg)
+{
+	struct txbatch *tb = arg;
+	struct txpkt *pkt;
+
+	if (!re_atomic_acq(&tb->held))
+		return false;
+
+	if (!thrd_equal(tb->owner, thrd_current()))
+		return false;
+
+	if (tb->pktc >= tb->n)
+		flush_pkts(tb);
+
+	pkt = &tb->pktv[tb->pktc];
+
+	mbuf_rewind(pkt->mb);
+	*err = mbuf_write_mem(pkt->mb, mbuf_buf(mb), mbuf_get_left(mb));
+	if (*err)
+		return true;
+
+	pkt->mb->pos = 0;
+	sa_cpy(&pkt->dst, dst);
+	++tb->pktc;
+
+	return true;
+}
+
+
+static bool gso_possible(const struct txbatch *tb)
+{
+	size_t sz, total = 0;
+
+	if (!tb->gso || tb->pktc < 2)
+		return false;
+
+	sz = mbuf_get_left(tb->pktv[0].mb);
+
+	for (uint32_t i = 0; i < tb->pktc; i++) {
+		const struct txpkt *pkt = &tb->pktv[i];
+		size_t len = mbuf_get_left(pkt->mb);
+
+		if (!sa_cmp(&pkt->dst, &tb->pktv[0].dst, SA_ALL))
+			return false;
+
+		/* only the last segment may be shorter */
+		if (len > sz || (len < sz && i != tb->pktc - 1))
+			return false;
+
+		total += len;
+	}
+
+	return total <= GSO_MAX_BYTES;
+}
+
+
+static int send_gso(struct txbatch *tb)
+{
+#ifdef UDP_SEGMENT
+	char ctrl[CMSG_SPACE(sizeof(uint16_t))] = {0};
+	struct msghdr msg = {0};
+	struct cmsghdr *cm;
+	struct iovec iov;
+	size_t len = 0;
+
+	for (uint32_t i = 0; i < tb->pktc; i++) {
+		struct mbuf *mb = tb->pktv[i].mb;
+
+		memcpy(&tb->gsobuf[len], mbuf_buf(mb), mbuf_get_left(mb));
+		len += mbuf_get_left(mb);
+	}
+
+	iov.iov_base = tb->gsobuf;
+	iov.iov_len  = len;
+
+	msg.msg_name       = &tb->pktv[0].dst.u;
+	msg.msg_namelen    = tb->pktv[0].dst.len;
+	msg.msg_iov        = &iov;
+	msg.msg_iovlen     = 1;
+	msg.msg_control    = ctrl;
+	msg.msg_controllen = sizeof(ctrl);
+
+	cm = CMSG_FIRSTHDR(&msg);
+	cm->cmsg_level = SOL_UDP;
+	cm->cmsg_type  = UDP_SEGMENT;
+	cm->cmsg_len   = CMSG_LEN(sizeof(uint16_t));
+	*(uint16_t *)(void *)CMSG_DATA(cm) =
+		(uint16_t)mbuf_get_left(tb->pktv[0].mb);
+
+	if (sendmsg(tb->fd, &msg, 0) < 0)
+		return errno;
+
+	re_atomic_rlx_set(&tb->n_gso, re_atomic_rlx(&tb->n_gso) + 1);
+
+	return 0;
+#else
+	(void)tb;
+
+	return ENOTSUP;
+#endif
+}
+
+
+static int send_mmsg(struct txbatch *tb)
+{
+	uint32_t i, sent = 0;
+
+	for (i = 0; i < tb->pktc; i++) {
+		struct txpkt *pkt = &tb->pktv[i];
+		struct mmsghdr *msg = &tb->msgv[i];
+
+		tb->iov[i].iov_base = mbuf_buf(pkt->mb);
+		tb->iov[i].iov_len  = mbuf_get_left(pkt->mb);
+
+		memset(msg, 0, sizeof(*msg));
+		msg->msg_hdr.msg_name    = &pkt->dst.u;
+		msg->msg_hdr.msg_namelen = pkt->dst.len;
+		msg->msg_hdr.msg_iov     = &tb->iov[i];
+		msg->msg_hdr.msg_iovlen  = 1;
+	}
+
+	while (sent < tb->pktc) {
+		int n = sendmmsg(tb->fd, &tb->msgv[sent], tb->pktc - sent, 0);
+		if (n <= 0)
+			return errno;
+
+		re_atomic_rlx_set(&tb->n_calls,
+				  re_atomic_rlx(&tb->n_calls) + 1);
+		sent += n;
+	}
+
+	return 0;
+}
+
+
+static void flush_pkts(struct txbatch *tb)
+{
+	uint64_t calls = re_atomic_rlx(&tb->n_calls);
+	int err;
+
+	if (!tb->pktc)
+		return;
+
+	if (gso_possible(tb)) {
+		err = send_gso(tb);
+		if (!err) {
+			re_atomic_rlx_set(&tb->n_calls,
+					  re_atomic_rlx(&tb->n_calls) + 1);
+			goto out;
+		}
+
+		warning("txbatch: UDP GSO failed, disabled (%m)\n", err);
+		tb->gso = false;
+	}
+
+	err = send_mmsg(tb);
+	if (err)
+		warning("txbatch: sendmmsg failed (%m)\n", err);
+
+ out:
+	re_atomic_rlx_set(&tb->n_pkts,
+			  re_atomic_rlx(&tb->n_pkts) + tb->pktc);
+	re_atomic_rlx_add(&total.n_calls, re_atomic_rlx(&tb->n_calls) - calls);
+	re_atomic_rlx_add(&total.n_pkts, tb->pktc);
+
+	tb->pktc = 0;
+}
+#endif
+
+
+/**
+ * Add a transmit batch to a UDP socket
+ *
+ * @param tbp Pointer to allocated transmit batch
+ * @param us  UDP socket
+ * @param n   Max. number of packets per system call
+ * @param gso True to use UDP Generic Segmentation Offload if possible
+ *
+ * @return 0 if success, ENOSYS if not supported, otherwise errorcode
+ */
+int txbatch_alloc(struct txbatch **tbp, struct udp_sock *us, uint32_t n,
+		  bool gso)
+{
+#ifdef LINUX
+	struct txbatch *tb;
+	int err;
+
+	if (!tbp || !us || !n)
+		return EINVAL;
+
+	tb = mem_zalloc(sizeof(*tb), destructor);
+	if (!tb)
+		return ENOMEM;
+
+	tb->fd  = udp_sock_fd(us, AF_UNSPEC);
+	tb->n   = min(n, TXBATCH_MAX);
+	tb->gso = gso;
+
+	tb->pktv = mem_zalloc(tb->n * sizeof(*tb->pktv), NULL);
+	tb->msgv = mem_zalloc(tb->n * sizeof(*tb->msgv), NULL);
+	tb->iov  = mem_zalloc(tb->n * sizeof(*tb->iov), NULL);
+	if (!tb->pktv || !tb->msgv || !tb->iov) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	for (uint32_t i = 0; i < tb->n; i++) {
+		tb->pktv[i].mb = mbuf_alloc(TXBATCH_BUFSZ);
+		if (!tb->pktv[i].mb) {
+			err = ENOMEM;
+			goto out;
+		}
+	}
+
+	if (gso) {
+		tb->gsobuf = mem_alloc(GSO_MAX_BYTES, NULL);
+		if (!tb->gsobuf) {
+			err = ENOMEM;
+			goto out;
+		}
+	}
+
+	err = udp_register_helper(&tb->uh, us, TXBATCH_LAYER,
+				  send_handler, NULL, tb);
+
+ out:
+	if (err)
+		mem_deref(tb);
+	else
+		*tbp = tb;
+
+	return err;
+#else
+	(void)tbp;
+	(void)us;
+	(void)n;
+	(void)gso;
+
+	return ENOSYS;
+#endif
+}
+
+
+/**
+ * Hold the transmit batch, packets sent from the calling thread are queued
+ * until txbatch_flush() is called from the same thread
+ *
+ * @param tb Transmit batch
+ */
+void txbatch_hold(struct txbatch *tb)
+{
+	if (!tb || re_atomic_rlx(&tb->held))
+		return;
+
+	tb->owner = thrd_current();
+	re_atomic_rls_set(&tb->held, true);
+}
+
+
+/**
+ * Send all queued packets and release the transmit batch
+ *
+ * @param tb Transmit batch
+ */
+void txbatch_flush(struct txbatch *tb)
+{
+	if (!tb || !re_atomic_rlx(&tb->held))
+		return;
+
+	if (!thrd_equal(tb->owner, thrd_current()))
+		return;
+
+	re_atomic_rls_set(&tb->held, false);
+
+#ifdef LINUX
+	flush_pkts(tb);
+#endif
+}
+
+
+/**
+ * Print the transmit batch statistics
+ *
+ * @param pf Print function
+ * @param tb Transmit batch
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int txbatch_debug(struct re_printf *pf, struct txbatch *tb)
+{
+	uint64_t calls, pkts;
+
+	if (!tb)
+		return 0;
+
+	calls = re_atomic_rlx(&tb->n_calls);
+	pkts  = re_atomic_rlx(&tb->n_pkts);
+
+	return re_hprintf(pf, "txbatch: n=%u gso=%s calls=%llu packets=%llu"
+			  " gso_sends=%llu\n",
+			  tb->n, tb->gso ? "yes" : "no", calls, pkts,
+			  re_atomic_rlx(&tb->n_gso));
+}
+
+
+/**
+ * Get the totals of all transmit batches
+ *
+ * @param calls Number of system calls (optional)
+ * @param pkts  Number of packets sent by the batches (optional)
+ */
+void txbatch_stats(uint64_t *calls, uint64_t *pkts)
+{
+	if (calls)
+		*calls = re_atomic_rlx(&total.n_calls);
+
+	if (pkts)
+		*pkts = re_atomic_rlx(&total.n_pkts);
+}
@@ -0,0 +1,444 @@
+/**
+ * @file txsched.c  Shared real-time transmit scheduler
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <time.h>
+#include <re.h>
+#include <re_atomic.h>
+#include <baresip.h>
+#include "core.h"
+
+
+/**
+ * \page TxScheduler Transmit Scheduler
+ *
+ * The transmit scheduler drives periodic real-time jobs (e.g. the audio
+ * encoder of each call) from a fixed-size pool of worker threads.
+ *
+ * All jobs are kept in one min-heap keyed on the deadline of the next
+ * transmission. A worker sleeps until the earliest deadline is due, pops
+ * the job, runs the handler without holding the lock and re-inserts the
+ * job with the deadline advanced by one period. The number of threads is
+ * therefore independent of the number of calls.
+ */
+
+
+enum {
+	HEAP_GROW = 16,
+};
+
+
+struct txsched {
+	struct txsched_job **heap;    /**< Min-heap ordered by deadline     */
+	size_t heapc;                 /**< Number of jobs in heap           */
+	size_t heapsz;                /**< Allocated heap size              */
+	thrd_t *thrdv;                /**< Worker threads                   */
+	uint32_t thrdc;               /**< Number of worker threads         */
+	RE_ATOMIC bool run;           /**< Workers are running              */
+	mtx_t *mtx;                   /**< Protects heap and job states     */
+	cnd_t cnd;                    /**< Signals heap changes             */
+	cnd_t done;                   /**< Signals end of a handler call    */
+	uint64_t late;                /**< Number of late jobs (> period)   */
+	uint64_t runs;                /**< Number of handler calls          */
+};
+
+
+struct txsched_job {
+	struct txsched *ts;           /**< Scheduler                        */
+	uint64_t deadline;            /**< Next deadline in [us]            */
+	uint64_t period;              /**< Period in [us]                   */
+	size_t idx;                   /**< Heap index (if queued)           */
+	bool queued;                  /**< Job is in the heap               */
+	bool busy;                    /**< Handler is running               */
+	bool active;                  /**< Job is alive                     */
+	txsched_h *h;                 /**< Job handler                      */
+	void *arg;                    /**< Handler argument                 */
+};
+
+
+static struct txsched *txsched;
+
+
+/** Totals of all schedulers, also after they were stopped */
+static struct {
+	RE_ATOMIC uint64_t runs;
+	RE_ATOMIC uint64_t late;
+} total;
+
+
+static void heap_swap(struct txsched *ts, size_t a, size_t b)
+{
+	struct txsched_job *job = ts->heap[a];
+
+	ts->heap[a] = ts->heap[b];
+	ts->heap[b] = job;
+
+	ts->heap[a]->idx = a;
+	ts->heap[b]->idx = b;
+}
+
+
+static void heap_up(struct txsched *ts, size_t i)
+{
+	while (i > 0) {
+		size_t p = (i - 1) / 2;
+
+		if (ts->heap[p]->deadline <= ts->heap[i]->deadline)
+			break;
+
+		heap_swap(ts, i, p);
+		i = p;
+	}
+}
+
+
+static void heap_down(struct txsched *ts, size_t i)
+{
+	for (;;) {
+		size_t l = 2 * i + 1;
+		size_t r = l + 1;
+		size_t m = i;
+
+		if (l < ts->heapc &&
+		    ts->heap[l]->deadline < ts->heap[m]->deadline)
+			m = l;
+		if (r < ts->heapc &&
+		    ts->heap[r]->deadline < ts->heap[m]->deadline)
+			m = r;
+
+		if (m == i)
+			break;
+
+		heap_swap(ts, i, m);
+		i = m;
+	}
+}
+
+
+static int heap_push(struct txsched *ts, struct txsched_job *job)
+{
+	if (ts->heapc == ts->heapsz) {
+		size_t sz = ts->heapsz + HEAP_GROW;
+		struct txsched_job **heap;
+
+		heap = mem_reallocarray(ts->heap, sz, sizeof(*heap), NULL);
+		if (!heap)
+			return ENOMEM;
+
+		ts->heap   = heap;
+		ts->heapsz = sz;
+	}
+
+	job->idx    = ts->heapc++;
+	job->queued = true;
+	ts->heap[job->idx] = job;
+	heap_up(ts, job->idx);
+
+	return 0;
+}
+
+
+static void heap_remove(struct txsched *ts, struct txsched_job *job)
+{
+	size_t i = job->idx;
+
+	if (!job->queued)
+		return;
+
+	job->queued = false;
+
+	if (i != --ts->heapc) {
+		heap_swap(ts, i, ts->heapc);
+		heap_down(ts, i);
+		heap_up(ts, i);
+	}
+}
+
+
+static int worker_thread(void *arg)
+{
+	struct txsched *ts = arg;
+
+	mtx_lock(ts->mtx);
+	while (re_atomic_rlx(&ts->run)) {
+		struct txsched_job *job;
+		uint64_t now;
+
+		if (!ts->heapc) {
+			cnd_wait(&ts->cnd, ts->mtx);
+			continue;
+		}
+
+		job = ts->heap[0];
+		now = tmr_jiffies_usec();
+
+		if (job->deadline > now) {
+			uint64_t abs = tmr_jiffies_rt_usec() +
+				job->deadline - now;
+			struct timespec tp = {
+				.tv_sec  = (time_t)(abs / 1000000),
+				.tv_nsec = (long)(abs % 1000000) * 1000
+			};
+
+			cnd_timedwait(&ts->cnd, ts->mtx, &tp);
+			continue;
+		}
+
+		heap_remove(ts, job);
+		job->busy = true;
+
+		if (now - job->deadline > job->period) {
+			++ts->late;
+			re_atomic_rlx_add(&total.late, 1);
+		}
+		++ts->runs;
+		re_atomic_rlx_add(&total.runs, 1);
+		mtx_unlock(ts->mtx);
+
+		job->h(job->arg);
+
+		mtx_lock(ts->mtx);
+		job->busy = false;
+
+		if (job->active) {
+			job->deadline += job->period;
+			if (heap_push(ts, job))
+				job->active = false;
+		}
+
+		cnd_broadcast(&ts->done);
+	}
+	mtx_unlock(ts->mtx);
+
+	return 0;
+}
+
+
+static void txsched_destructor(void *arg)
+{
+	struct txsched *ts = arg;
+
+	if (re_atomic_rlx(&ts->run)) {
+		mtx_lock(ts->mtx);
+		re_atomic_rlx_set(&ts->run, false);
+		cnd_broadcast(&ts->cnd);
+		mtx_unlock(ts->mtx);
+
+		for (uint32_t i = 0; i < ts->thrdc; i++)
+			thrd_join(ts->thrdv[i], NULL);
+	}
+
+	cnd_destroy(&ts->cnd);
+	cnd_destroy(&ts->done);
+
+	mem_deref(ts->thrdv);
+	mem_deref(ts->heap);
+	mem_deref(ts->mtx);
+
+	if (txsched == ts)
+		txsched = NULL;
+}
+
+
+static int txsched_alloc(struct txsched **tsp, uint32_t thrdc)
+{
+	struct txsched *ts;
+	int err;
+
+	if (!tsp || !thrdc)
+		return EINVAL;
+
+	ts = mem_zalloc(sizeof(*ts), NULL);
+	if (!ts)
+		return ENOMEM;
+
+	err = mutex_alloc(&ts->mtx);
+	if (err)
+		goto out;
+
+	if (cnd_init(&ts->cnd) != thrd_success) {
+		mem_deref(ts->mtx);
+		err = ENOMEM;
+		goto out;
+	}
+
+	if (cnd_init(&ts->done) != thrd_success) {
+		cnd_destroy(&ts->cnd);
+		mem_deref(ts->mtx);
+		err = ENOMEM;
+		goto out;
+	}
+
+	mem_destructor(ts, txsched_destructor);
+
+	ts->thrdv = mem_zalloc(thrdc * sizeof(*ts->thrdv), NULL);
+	if (!ts->thrdv) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	re_atomic_rlx_set(&ts->run, true);
+
+	for (; ts->thrdc < thrdc; ts->thrdc++) {
+		err = thread_create_name(&ts->thrdv[ts->thrdc],
+					 "Audio TX pool", worker_thread, ts);
+		if (err)
+			goto out;
+	}
+
+	info("txsched: started %u worker threads\n", ts->thrdc);
+
+ out:
+	if (err)
+		mem_deref(ts);
+	else
+		*tsp = ts;
+
+	return err;
+}
+
+
+static void job_destructor(void *arg)
+{
+	struct txsched_job *job = arg;
+	struct txsched *ts = job->ts;
+
+	mtx_lock(ts->mtx);
+	job->active = false;
+	heap_remove(ts, job);
+
+	while (job->busy)
+		cnd_wait(&ts->done, ts->mtx);
+	mtx_unlock(ts->mtx);
+
+	mem_deref(ts);
+}
+
+
+/**
+ * Add a periodic job to the shared transmit scheduler
+ *
+ * The scheduler is created with thrdc worker threads when the first job is
+ * added, and stopped when the last job is destroyed. The handler is called
+ * from one of the worker threads once every period.
+ *
+ * @param jobp   Pointer to allocated job
+ * @param thrdc  Number of worker threads
+ * @param period Period in [ms]
+ * @param h      Job handler
+ * @param arg    Handler argument
+ *
+ * @return 0 if success, otherwise errorcode
+ *
+ * @note The job must be destroyed from a non-worker thread
+ */
+int txsched_job_alloc(struct txsched_job **jobp, uint32_t thrdc,
+		      uint32_t period, txsched_h *h, void *arg)
+{
+	struct txsched_job *job;
+	int err;
+
+	if (!jobp || !period || !h)
+		return EINVAL;
+
+	job = mem_zalloc(sizeof(*job), NULL);
+	if (!job)
+		return ENOMEM;
+
+	if (txsched) {
+		job->ts = mem_ref(txsched);
+	}
+	else {
+		err = txsched_alloc(&job->ts, thrdc);
+		if (err) {
+			mem_deref(job);
+			return err;
+		}
+
+		txsched = job->ts;
+	}
+
+	job->period   = period * 1000;
+	job->deadline = tmr_jiffies_usec() + job->period;
+	job->active   = true;
+	job->h        = h;
+	job->arg      = arg;
+
+	mtx_lock(job->ts->mtx);
+	err = heap_push(job->ts, job);
+	cnd_signal(&job->ts->cnd);
+	mtx_unlock(job->ts->mtx);
+
+	if (err) {
+		mem_deref(job->ts);
+		mem_deref(job);
+		return err;
+	}
+
+	mem_destructor(job, job_destructor);
+
+	*jobp = job;
+
+	return 0;
+}
+
+
+/**
+ * Change the period of a transmit scheduler job
+ *
+ * @param job    Transmit scheduler job
+ * @param period New period in [ms]
+ */
+void txsched_job_set_period(struct txsched_job *job, uint32_t period)
+{
+	if (!job || !period)
+		return;
+
+	mtx_lock(job->ts->mtx);
+	job->period = period * 1000;
+	mtx_unlock(job->ts->mtx);
+}
+
+
+/**
+ * Print the transmit scheduler status
+ *
+ * @param pf     Print function
+ * @param unused Unused parameter
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int txsched_debug(struct re_printf *pf, void *unused)
+{
+	struct txsched *ts = txsched;
+	int err;
+	(void)unused;
+
+	if (!ts)
+		return re_hprintf(pf, "txsched: not running\n");
+
+	mtx_lock(ts->mtx);
+	err = re_hprintf(pf, "txsched: workers=%u jobs=%zu runs=%llu"
+			 " late=%llu\n",
+			 ts->thrdc, ts->heapc, ts->runs, ts->late);
+	mtx_unlock(ts->mtx);
+
+	return err;
+}
+
+
+/**
+ * Get the totals of all transmit schedulers
+ *
+ * @param runs Number of handler calls (optional)
+ * @param late Number of late jobs (optional)
+ */
+void txsched_stats(uint64_t *runs, uint64_t *late)
+{
+	if (runs)
+		*runs = re_atomic_rlx(&total.runs);
+
+	if (late)
+		*late = re_atomic_rlx(&total.late);
+}
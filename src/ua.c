@@ -18,6 +18,7 @@
 struct ua {
 	MAGIC_DECL                   /**< Magic number for struct ua         */
 	struct le le;                /**< Linked list element                */
+	struct uag_entry *uidx;      /**< Entry in the UA-group index        */
 	struct account *acc;         /**< Account Parameters                 */
 	struct list regl;            /**< List of Register clients           */
 	struct list calls;           /**< List of active calls (struct call) */
@@ -44,6 +45,7 @@ static void ua_destructor(void *arg)
 	struct le *le;
 
 	list_unlink(&ua->le);
+	mem_deref(ua->uidx);
 
 	if (!list_isempty(&ua->regl))
 		bevent_ua_emit(BEVENT_UNREGISTERING, ua, NULL);
@@ -115,27 +117,41 @@ void ua_remove_extension(struct ua *ua, const char *extension)
 }
 
 
-static int create_register_clients(struct ua *ua)
+static int add_extensions(struct ua *ua)
 {
-	int err = 0;
-
-	/* Register clients */
 	if (uag_cfg() && str_isset(uag_cfg()->uuid))
 		ua_add_extension(ua, "gruu");
 
 	if (0 == str_casecmp(ua->acc->sipnat, "outbound")) {
 
-		size_t i;
-
 		ua_add_extension(ua, "path");
 		ua_add_extension(ua, "outbound");
 
 		if (!str_isset(uag_cfg()->uuid)) {
 
 			warning("ua: outbound requires valid UUID!\n");
-			err = ENOSYS;
-			goto out;
+			return ENOSYS;
 		}
+	}
+
+	ua_add_extension(ua, "replaces");
+	ua_add_extension(ua, "norefersub");
+
+	if (ua->acc->rel100_mode)
+		ua_add_extension(ua, "100rel");
+
+	return 0;
+}
+
+
+/* Register clients are created on the first (fallback) registration */
+static int create_register_clients(struct ua *ua)
+{
+	int err = 0;
+
+	if (0 == str_casecmp(ua->acc->sipnat, "outbound")) {
+
+		size_t i;
 
 		for (i=0; i<RE_ARRAY_SIZE(ua->acc->outboundv); i++) {
 
@@ -150,13 +166,6 @@ static int create_register_clients(struct ua *ua)
 		err = reg_add(&ua->regl, ua, 0);
 	}
 
-	ua_add_extension(ua, "replaces");
-	ua_add_extension(ua, "norefersub");
-
-	if (ua->acc->rel100_mode)
-		ua_add_extension(ua, "100rel");
-
- out:
 	return err;
 }
 
@@ -213,8 +222,11 @@ static int start_register(struct ua *ua, bool fallback)
 		}
 	}
 
-	if (list_isempty(&ua->regl))
-		create_register_clients(ua);
+	if (list_isempty(&ua->regl)) {
+		err = create_register_clients(ua);
+		if (err)
+			goto out;
+	}
 
 	if (!fallback && !list_isempty(&ua->regl))
 		bevent_ua_emit(BEVENT_REGISTERING, ua, NULL);
@@ -403,6 +415,7 @@ unsigned ua_destroy(struct ua *ua)
 		return 0;
 
 	list_unlink(&ua->le);
+	ua->uidx = mem_deref(ua->uidx);
 
 	/* send the shutdown event */
 	bevent_ua_emit(BEVENT_SHUTDOWN, ua, NULL);
@@ -483,19 +496,19 @@ struct call *ua_find_active_call(struct ua *ua)
 }
 
 
+static bool sess_match_handler(const struct call *call, void *arg)
+{
+	return call_sess_cmp(call, arg);
+}
+
+
 struct call *ua_find_call_msg(struct ua *ua, const struct sip_msg *msg)
 {
 	if (!ua || !msg)
 		return NULL;
 
-	struct le *le = NULL;
-	for (le = list_tail(&ua->calls); le; le = le->prev) {
-		struct call *call = le->data;
-		if (call_sess_cmp(call, msg))
-			break;
-	}
-
-	return le ? le->data : NULL;
+	return call_index_find_last(&msg->callid, ua, sess_match_handler,
+				    (void *)msg);
 }
 
 
@@ -1168,15 +1181,6 @@ static const char *autoans_header_name(enum answer_method met)
 }
 
 
-static bool user_cmp_handler(struct le *le, void *arg)
-{
-	struct ua *ua = le->data;
-	struct pl *user = arg;
-
-	return pl_cmp(&ua->acc->luri.user, user) == 0;
-}
-
-
 static int ua_cuser_gen(struct ua *ua)
 {
 	bool suffix = false;
@@ -1184,8 +1188,7 @@ static int ua_cuser_gen(struct ua *ua)
 
 	conf_get_bool(conf_cur(), "sip_cuser_random", &suffix);
 
-	suffix |= list_apply(uag_list(), true, user_cmp_handler,
-			     &ua->acc->luri.user) != NULL;
+	suffix |= uag_user_exists(&ua->acc->luri.user);
 	if (suffix) {
 		char buf[16];
 		rand_str(buf, sizeof(buf));
@@ -1201,25 +1204,13 @@ static int ua_cuser_gen(struct ua *ua)
 }
 
 
-/**
- * Allocate a SIP User-Agent
- *
- * @param uap   Pointer to allocated User-Agent object
- * @param aor   SIP Address-of-Record (AOR)
- *
- * @return 0 if success, otherwise errorcode
- */
-int ua_alloc(struct ua **uap, const char *aor)
+static int ua_alloc_acc(struct ua **uap, struct account *acc)
 {
 	struct ua *ua;
 	struct uri *luri;
-	char *buf = NULL;
 	char *host = NULL;
 	int err;
 
-	if (!aor)
-		return EINVAL;
-
 	ua = mem_zalloc(sizeof(*ua), ua_destructor);
 	if (!ua)
 		return ENOMEM;
@@ -1228,17 +1219,7 @@ int ua_alloc(struct ua **uap, const char *aor)
 
 	list_init(&ua->calls);
 
-	/* Decode SIP address */
-	if (uag_eprm()) {
-		err = re_sdprintf(&buf, "%s;%s", aor, uag_eprm());
-		if (err)
-			goto out;
-		aor = buf;
-	}
-
-	err = account_alloc(&ua->acc, aor);
-	if (err)
-		goto out;
+	ua->acc = mem_ref(acc);
 
 	err = ua_cuser_gen(ua);
 	if (err)
@@ -1269,7 +1250,7 @@ int ua_alloc(struct ua **uap, const char *aor)
 			warning("ua: SIP/TLS add client "
 				"certificate %s failed: %m\n",
 				ua->acc->cert, err);
-			return err;
+			goto out;
 		}
 
 		luri = account_luri(ua->acc);
@@ -1288,7 +1269,11 @@ int ua_alloc(struct ua **uap, const char *aor)
 		}
 	}
 
-	err = create_register_clients(ua);
+	err = add_extensions(ua);
+	if (err)
+		goto out;
+
+	err = uag_index_add(&ua->uidx, ua);
 	if (err)
 		goto out;
 
@@ -1297,7 +1282,6 @@ int ua_alloc(struct ua **uap, const char *aor)
 
  out:
 	mem_deref(host);
-	mem_deref(buf);
 	if (err)
 		mem_deref(ua);
 	else if (uap)
@@ -1307,6 +1291,67 @@ int ua_alloc(struct ua **uap, const char *aor)
 }
 
 
+/**
+ * Allocate a SIP User-Agent
+ *
+ * @param uap   Pointer to allocated User-Agent object
+ * @param aor   SIP Address-of-Record (AOR)
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int ua_alloc(struct ua **uap, const char *aor)
+{
+	struct account *acc = NULL;
+	char *buf = NULL;
+	int err;
+
+	if (!aor)
+		return EINVAL;
+
+	/* Decode SIP address */
+	if (uag_eprm()) {
+		err = re_sdprintf(&buf, "%s;%s", aor, uag_eprm());
+		if (err)
+			return err;
+		aor = buf;
+	}
+
+	err = account_alloc(&acc, aor);
+	if (err)
+		goto out;
+
+	err = ua_alloc_acc(uap, acc);
+
+ out:
+	mem_deref(acc);
+	mem_deref(buf);
+
+	return err;
+}
+
+
+/**
+ * Allocate a SIP User-Agent for an account that is already decoded.
+ * The account may be allocated in another thread with account_alloc().
+ *
+ * @param uap   Pointer to allocated User-Agent object
+ * @param acc   SIP account, the User-Agent takes a reference
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int ua_alloc_account(struct ua **uap, struct account *acc)
+{
+	if (!acc)
+		return EINVAL;
+
+	/* extra UA parameters are decoded together with the address */
+	if (uag_eprm())
+		return ua_alloc(uap, acc->buf);
+
+	return ua_alloc_acc(uap, acc);
+}
+
+
 /**
  * Update a User-agent object, reset register clients
  *
@@ -1323,7 +1368,9 @@ int ua_update_account(struct ua *ua)
 	ua->extensionc = 0;
 	list_flush(&ua->regl);
 
-	return create_register_clients(ua);
+	uag_index_update(ua->uidx);
+
+	return add_extensions(ua);
 }
 
 
@@ -1985,6 +2032,7 @@ void ua_pub_gruu_set(struct ua *ua, const struct pl *pval)
 
 	ua->pub_gruu = mem_deref(ua->pub_gruu);
 	(void)pl_strdup(&ua->pub_gruu, pval);
+	uag_index_update(ua->uidx);
 }
 
 
@@ -2097,6 +2145,7 @@ void ua_set_catchall(struct ua *ua, bool enabled)
 		return;
 
 	account_set_catchall(ua_account(ua), enabled);
+	uag_index_update(ua->uidx);
 }
 
 
@@ -2293,6 +2342,8 @@ int ua_raise(struct ua *ua)
 	if (!ua)
 		return EINVAL;
 
+	uag_index_raise(ua->uidx);
+
 	return uag_raise(ua, &ua->le);
 }
 
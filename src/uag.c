@@ -9,10 +9,46 @@
 #include <baresip.h>
 #include "core.h"
 
+enum {
+	UAG_INDEX_SIZE = 1024,
+};
+
+
+/** Keys of the User-Agent index */
+enum uag_key {
+	UAG_KEY_CUSER = 0,   /**< Contact user, or Public GRUU if set  */
+	UAG_KEY_LCUSER,      /**< Local contact user                   */
+	UAG_KEY_USER,        /**< User part of the local SIP URI       */
+	UAG_KEY_HOST,        /**< Host part of the local SIP URI       */
+	UAG_KEY_AOR,         /**< Address-of-Record                    */
+	UAG_KEY_CATCHALL,    /**< Catch-all accounts (single bucket)   */
+
+	UAG_KEY_N
+};
+
+
+/** Index entry of one User-Agent, owned by the User-Agent */
+struct uag_entry {
+	struct le lev[UAG_KEY_N];  /**< Hash elements, one per key       */
+	struct ua *ua;             /**< User-Agent (not referenced)      */
+	int64_t ord;               /**< Position in the list of UAs      */
+};
+
+
 /* One instance */
 
 static struct uag uag = {.ual = LIST_INIT};
 
+static struct {
+	struct hash *htv[UAG_KEY_N];
+	uint32_t n;
+	int64_t first;
+	int64_t last;
+} uag_index;
+
+
+typedef bool (uag_match_h)(struct ua *ua, void *arg);
+
 
 /* This function is called when all SIP transactions are done */
 static void exit_handler(void *arg)
@@ -122,22 +158,7 @@ int uag_hold_others(struct call *call)
  */
 struct call *uag_call_find_pl(const struct pl *id)
 {
-	struct le *le = NULL;
-	struct ua *ua = NULL;
-	struct call *call = NULL;
-
-	if (!pl_isset(id))
-		return NULL;
-
-	for (le = list_head(&uag.ual); le; le = le->next) {
-		ua = le->data;
-
-		call = call_find_id_pl(ua_calls(ua), id);
-		if (call)
-			break;
-	}
-
-	return call;
+	return call_index_find(id, NULL, NULL, NULL);
 }
 
 
@@ -150,22 +171,11 @@ struct call *uag_call_find_pl(const struct pl *id)
  */
 struct call *uag_call_find(const char *id)
 {
-	struct le *le = NULL;
-	struct ua *ua = NULL;
-	struct call *call = NULL;
-
-	if (!str_isset(id))
-		return NULL;
-
-	for (le = list_head(&uag.ual); le; le = le->next) {
-		ua = le->data;
+	struct pl pl;
 
-		call = call_find_id(ua_calls(ua), id);
-		if (call)
-			break;
-	}
+	pl_set_str(&pl, id);
 
-	return call;
+	return call_index_find(&pl, NULL, NULL, NULL);
 }
 
 
@@ -877,38 +887,262 @@ static bool uri_match_af(const struct uri *accu, const struct uri *peeru)
 }
 
 
+static void index_flush(void)
+{
+	size_t i;
+
+	for (i = 0; i < UAG_KEY_N; i++)
+		uag_index.htv[i] = mem_deref(uag_index.htv[i]);
+
+	uag_index.first = 0;
+	uag_index.last  = 0;
+}
+
+
+static void entry_destructor(void *arg)
+{
+	struct uag_entry *ent = arg;
+	size_t i;
+
+	for (i = 0; i < UAG_KEY_N; i++)
+		hash_unlink(&ent->lev[i]);
+
+	if (--uag_index.n == 0)
+		index_flush();
+}
+
+
+static void entry_key(struct pl *key, const struct ua *ua, enum uag_key k)
+{
+	const struct account *acc = ua_account(ua);
+
+	switch (k) {
+
+	case UAG_KEY_CUSER:
+		pl_set_str(key, ua_cuser(ua));
+		break;
+
+	case UAG_KEY_LCUSER:
+		pl_set_str(key, ua_local_cuser(ua));
+		break;
+
+	case UAG_KEY_USER:
+		*key = acc ? acc->luri.user : pl_null;
+		break;
+
+	case UAG_KEY_HOST:
+		*key = acc ? acc->luri.host : pl_null;
+		break;
+
+	case UAG_KEY_AOR:
+		pl_set_str(key, account_aor(acc));
+		break;
+
+	default:
+		*key = pl_null;
+		break;
+	}
+}
+
+
+static uint32_t key_hash(enum uag_key k, const struct pl *val)
+{
+	if (k == UAG_KEY_CATCHALL)
+		return 0;
+
+	return hash_joaat_ci(val->p, val->l);
+}
+
+
+/* same comparison as the linear list search did for each key */
+static bool key_match(struct ua *ua, enum uag_key k, const struct pl *val)
+{
+	struct pl key;
+
+	if (k == UAG_KEY_CATCHALL)
+		return ua_catchall(ua);
+
+	entry_key(&key, ua, k);
+
+	switch (k) {
+
+	case UAG_KEY_HOST:
+	case UAG_KEY_AOR:
+		return 0 == pl_cmp(val, &key);
+
+	default:
+		return 0 == pl_casecmp(val, &key);
+	}
+}
+
+
+/*
+ * Insert an entry into its hash bucket. The buckets are kept sorted by
+ * list order, so the first match of a lookup is the first User-Agent.
+ * New entries are ordered last, and are appended without a walk.
+ */
+static void bucket_insert(struct hash *ht, uint32_t key, struct le *ile,
+			  struct uag_entry *ent)
+{
+	struct list *bucket = hash_list(ht, key);
+	struct le *le;
+
+	for (le = list_tail(bucket); le; le = le->prev) {
+		const struct uag_entry *e = le->data;
+
+		if (e->ord < ent->ord) {
+			list_insert_after(bucket, le, ile, ent);
+			return;
+		}
+	}
+
+	list_prepend(bucket, ile, ent);
+}
+
+
 /**
- * Find the correct UA from the contact user
+ * Add a User-Agent to the index of the UA-group. The new entry is ordered
+ * after all existing entries, like a User-Agent appended to the list.
  *
- * @param cuser Contact username
+ * @param entp Pointer to allocated index entry
+ * @param ua   User-Agent
  *
- * @return Matching UA if found, NULL if not found
+ * @return 0 if success, otherwise errorcode
  */
-struct ua *uag_find(const struct pl *cuser)
+int uag_index_add(struct uag_entry **entp, struct ua *ua)
 {
-	struct le *le;
+	struct uag_entry *ent;
+	size_t i;
+	int err = 0;
 
-	for (le = uag.ual.head; le; le = le->next) {
-		struct ua *ua = le->data;
+	if (!entp || !ua)
+		return EINVAL;
 
-		if (0 == pl_strcasecmp(cuser, ua_cuser(ua)))
-			return ua;
+	if (!uag_index.n) {
+		for (i = 0; i < UAG_KEY_N && !err; i++)
+			err = hash_alloc(&uag_index.htv[i], UAG_INDEX_SIZE);
+
+		if (err) {
+			index_flush();
+			return err;
+		}
 	}
 
-	/* Try also matching by AOR, for better interop */
-	for (le = uag.ual.head; le; le = le->next) {
-		struct ua *ua = le->data;
-		struct account *acc = ua_account(ua);
+	ent = mem_zalloc(sizeof(*ent), entry_destructor);
+	if (!ent) {
+		if (!uag_index.n)
+			index_flush();
+		return ENOMEM;
+	}
 
-		if (0 == pl_casecmp(cuser, &acc->luri.user))
-			return ua;
+	++uag_index.n;
+
+	ent->ua  = ua;
+	ent->ord = ++uag_index.last;
+
+	uag_index_update(ent);
+
+	*entp = ent;
+
+	return 0;
+}
+
+
+/**
+ * Re-key an index entry after the contact user, the account or the
+ * catch-all flag of its User-Agent has changed
+ *
+ * @param ent Index entry
+ */
+void uag_index_update(struct uag_entry *ent)
+{
+	size_t i;
+
+	if (!ent)
+		return;
+
+	for (i = 0; i < UAG_KEY_N; i++) {
+		enum uag_key k = (enum uag_key)i;
+		struct pl key;
+
+		hash_unlink(&ent->lev[i]);
+
+		if (k == UAG_KEY_CATCHALL && !ua_catchall(ent->ua))
+			continue;
+
+		entry_key(&key, ent->ua, k);
+		bucket_insert(uag_index.htv[i], key_hash(k, &key),
+			      &ent->lev[i], ent);
 	}
+}
+
+
+/**
+ * Order an index entry before all other entries, like a User-Agent
+ * moved to the head of the list
+ *
+ * @param ent Index entry
+ */
+void uag_index_raise(struct uag_entry *ent)
+{
+	size_t i;
+
+	if (!ent)
+		return;
+
+	ent->ord = --uag_index.first;
+
+	for (i = 0; i < UAG_KEY_N; i++) {
+		struct list *bucket = ent->lev[i].list;
+
+		if (!bucket)
+			continue;
+
+		list_unlink(&ent->lev[i]);
+		list_prepend(bucket, &ent->lev[i], ent);
+	}
+}
+
+
+/*
+ * Find the first User-Agent, in list order, that has the given key and
+ * is accepted by the match handler
+ */
+static struct ua *index_find(enum uag_key k, const struct pl *val,
+			     uag_match_h *matchh, void *arg)
+{
+	struct le *le;
+
+	if (!uag_index.htv[k] || !val)
+		return NULL;
+
+	/* the bucket is sorted by list order */
+	le = list_head(hash_list(uag_index.htv[k], key_hash(k, val)));
+	for (; le; le = le->next) {
+		struct uag_entry *ent = le->data;
+
+		if (!key_match(ent->ua, k, val))
+			continue;
+
+		if (matchh && !matchh(ent->ua, arg))
+			continue;
+
+		return ent->ua;
+	}
+
+	return NULL;
+}
+
+
+/* Find the first User-Agent in the list accepted by the match handler */
+static struct ua *ual_find(uag_match_h *matchh, void *arg)
+{
+	struct le *le;
 
-	/* Last resort, try any catchall UAs */
 	for (le = uag.ual.head; le; le = le->next) {
 		struct ua *ua = le->data;
 
-		if (ua_catchall(ua))
+		if (matchh(ua, arg))
 			return ua;
 	}
 
@@ -916,6 +1150,98 @@ struct ua *uag_find(const struct pl *cuser)
 }
 
 
+static bool reg_handler(struct ua *ua, void *arg)
+{
+	const struct account *acc = ua_account(ua);
+	(void)arg;
+
+	return acc && acc->regint;
+}
+
+
+static bool registered_handler(struct ua *ua, void *arg)
+{
+	return reg_handler(ua, arg) && ua_isregistered(ua);
+}
+
+
+static bool p2p_msg_handler(struct ua *ua, void *arg)
+{
+	const struct sip_msg *msg = arg;
+	struct account *acc = ua_account(ua);
+
+	if (!acc || acc->regint)
+		return false;
+
+	if (!uri_match_transport(&acc->luri, NULL, msg->tp))
+		return false;
+
+	return uri_match_af(&acc->luri, &msg->uri);
+}
+
+
+static bool p2p_uri_handler(struct ua *ua, void *arg)
+{
+	const struct uri *uri = arg;
+	struct account *acc = ua_account(ua);
+
+	if (!acc || acc->regint)
+		return false;
+
+	if (!uri_match_transport(&acc->luri, uri, SIP_TRANSP_NONE))
+		return false;
+
+	return uri_match_af(&acc->luri, uri);
+}
+
+
+static bool user_handler(struct ua *ua, void *arg)
+{
+	const struct pl *user = arg;
+
+	return 0 == pl_cmp(&ua_account(ua)->luri.user, user);
+}
+
+
+/**
+ * Check if a User-Agent with the given local URI user exists
+ *
+ * @param user User part of the local SIP URI (case-sensitive)
+ *
+ * @return True if found, otherwise false
+ */
+bool uag_user_exists(const struct pl *user)
+{
+	return NULL != index_find(UAG_KEY_USER, user, user_handler,
+				  (void *)user);
+}
+
+
+/**
+ * Find the correct UA from the contact user
+ *
+ * @param cuser Contact username
+ *
+ * @return Matching UA if found, NULL if not found
+ */
+struct ua *uag_find(const struct pl *cuser)
+{
+	struct ua *ua;
+
+	ua = index_find(UAG_KEY_CUSER, cuser, NULL, NULL);
+	if (ua)
+		return ua;
+
+	/* Try also matching by AOR, for better interop */
+	ua = index_find(UAG_KEY_USER, cuser, NULL, NULL);
+	if (ua)
+		return ua;
+
+	/* Last resort, try any catchall UAs */
+	return index_find(UAG_KEY_CATCHALL, &pl_null, NULL, NULL);
+}
+
+
 /**
  * Find the correct UA from SIP message
  *
@@ -925,9 +1251,9 @@ struct ua *uag_find(const struct pl *cuser)
  */
 struct ua *uag_find_msg(const struct sip_msg *msg)
 {
-	struct le *le;
 	const struct pl *cuser;
-	struct ua *uaf = NULL;  /* fallback ua */
+	struct ua *ua;
+	struct ua *uaf;  /* fallback ua */
 
 	if (!msg)
 		return NULL;
@@ -935,46 +1261,25 @@ struct ua *uag_find_msg(const struct sip_msg *msg)
 	cuser = &msg->uri.user;
 
 	/* match for registered accounts */
-	for (le = uag.ual.head; le; le = le->next) {
-		struct ua *ua = le->data;
-		struct account *acc = ua_account(ua);
-
-		if (!acc || !acc->regint)
-			continue;
-
-		if (0 == pl_strcasecmp(cuser, ua_local_cuser(ua))) {
-			debug("%H: selected for %r\n", ua_printf, ua, cuser);
-			return ua;
-		}
-
-		if (!uaf && ua_catchall(ua) && ua_isregistered(ua))
-			uaf = ua;
+	ua = index_find(UAG_KEY_LCUSER, cuser, reg_handler, NULL);
+	if (ua) {
+		debug("%H: selected for %r\n", ua_printf, ua, cuser);
+		return ua;
 	}
 
 	/* match for peer-to-peer calls (only un-registered accounts) */
-	for (le = uag.ual.head; le; le = le->next) {
-		struct ua *ua = le->data;
-		struct account *acc = ua_account(ua);
-
-		if (!acc || acc->regint)
-			continue;
-
-		if (!uri_match_transport(&acc->luri, NULL, msg->tp))
-			continue;
-
-		if (!uri_match_af(&acc->luri, &msg->uri))
-			continue;
-
-		if (0 == pl_casecmp(cuser, &acc->luri.user)) {
-			debug("%H: account match for %r\n", ua_printf, ua,
-			      cuser);
-			return ua;
-		}
-
-		if (!uaf && ua_catchall(ua))
-			uaf = ua;
+	ua = index_find(UAG_KEY_USER, cuser, p2p_msg_handler, (void *)msg);
+	if (ua) {
+		debug("%H: account match for %r\n", ua_printf, ua, cuser);
+		return ua;
 	}
 
+	uaf = index_find(UAG_KEY_CATCHALL, &pl_null, registered_handler,
+			 NULL);
+	if (!uaf)
+		uaf = index_find(UAG_KEY_CATCHALL, &pl_null, p2p_msg_handler,
+				 (void *)msg);
+
 	if (uaf)
 		debug("%H: selected fallback\n", ua_printf, uaf);
 
@@ -991,19 +1296,14 @@ struct ua *uag_find_msg(const struct sip_msg *msg)
  */
 struct ua *uag_find_aor(const char *aor)
 {
-	struct le *le;
+	struct pl pl;
 
-	for (le = uag.ual.head; le; le = le->next) {
-		struct ua *ua = le->data;
-		struct account *acc = ua_account(ua);
+	if (!str_isset(aor))
+		return list_ledata(list_head(&uag.ual));
 
-		if (str_isset(aor) && str_cmp(acc->aor, aor))
-			continue;
+	pl_set_str(&pl, aor);
 
-		return ua;
-	}
-
-	return NULL;
+	return index_find(UAG_KEY_AOR, &pl, NULL, NULL);
 }
 
 
@@ -1070,7 +1370,6 @@ struct ua *uag_find_requri_pl(const struct pl *requri)
 {
 	struct pl pl;
 	struct uri *uri;
-	struct le *le;
 	struct ua *ret = NULL;
 	struct sip_addr addr;
 	char *uric;
@@ -1095,47 +1394,18 @@ struct ua *uag_find_requri_pl(const struct pl *requri)
 	}
 
 	uri = &addr.uri;
-	for (le = uag.ual.head; le; le = le->next) {
-		struct ua *ua = le->data;
-		struct account *acc = ua_account(ua);
 
-		/* not registered */
-		if (acc->regint && !ua_isregistered(ua))
-			continue;
+	/* prefer a registered UA */
+	if (uri_only_user(uri))
+		ret = ual_find(registered_handler, NULL);
+	else if (uri_user_and_host(uri))
+		ret = index_find(UAG_KEY_HOST, &uri->host, registered_handler,
+				 NULL);
 
-		if (uri_only_user(uri)) {
-			if (acc->regint) {
-				ret = ua;
-				break;
-			}
-		}
-
-		if (uri_user_and_host(uri) && acc->regint) {
-			if (0 != pl_cmp(&uri->host, &acc->luri.host)) {
-				continue;
-			}
-			else {
-				ret = ua;
-				break;
-			}
-		}
-
-		/* Now we select a local account for peer-to-peer calls.
-		 * uri = user@IP | user@domain | IP. */
-		if (!acc->regint) {
-			if (!uri_match_transport(&acc->luri, uri,
-						 SIP_TRANSP_NONE))
-				continue;
-
-			if (!uri_match_af(&acc->luri, uri))
-				continue;
-
-			/* Remember local account.
-			 * But we prefer registered UA. */
-			if (!ret)
-				ret = ua;
-		}
-	}
+	/* Now we select a local account for peer-to-peer calls.
+	 * uri = user@IP | user@domain | IP. */
+	if (!ret)
+		ret = ual_find(p2p_uri_handler, uri);
 
 	if (ret) {
 		info("%H: selected for request\n", ua_printf, ret);
@@ -1198,6 +1468,19 @@ int uag_raise(struct ua *ua, struct le *le)
 }
 
 
+/**
+ * Print the status of the registration scheduler
+ *
+ * @param pf Print function
+ *
+ * @return 0 if success, otherwise errorcode
+ */
+int uag_reg_sched_debug(struct re_printf *pf)
+{
+	return reg_sched_debug(pf);
+}
+
+
 /**
  * Set the handler to receive incoming SIP SUBSCRIBE messages
  *
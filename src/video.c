@@ -30,6 +30,7 @@ enum {
 	PICUP_INTERVAL	= 500,		       /**< FIR/PLI interval         */
 	NACK_BLPSZ	= 16,		       /**< NACK bitmask size        */
 	NACK_QUEUE_TIME	= 500,		       /**< in [ms]                  */
+	NACK_RING_SZ	= 1024,		       /**< NACK ring, power of two  */
 	PKT_SIZE	= 1280,		       /**< max. Packet size in bytes*/
 };
 
@@ -89,7 +90,9 @@ struct vtx {
 	struct vidframe *frame;            /**< Source frame              */
 	mtx_t *lock_tx;                    /**< Protect the sendq         */
 	struct list sendq;                 /**< Tx-Queue (struct vidqent) */
-	struct list sendqnb;               /**< Tx-Queue NACK wait buffer */
+	struct vidqent *nackv[NACK_RING_SZ]; /**< Sent packets for NACK */
+	uint32_t nackn;                    /**< Packets in the NACK ring */
+	bool nack_copy;                    /**< Keep a copy for NACK      */
 	unsigned skipc;                    /**< Number of frames skipped  */
 	struct list filtl;                 /**< Filters in encoding order */
 	enum vidfmt fmt;                   /**< Outgoing pixel format     */
@@ -180,6 +183,7 @@ struct vidqent {
 	uint32_t ts;
 	uint64_t jfs_nack;
 	uint16_t seq;
+	size_t end;
 	struct mbuf *mb;
 };
 
@@ -273,6 +277,70 @@ static int vidqent_alloc(struct vidqent **qentp, struct stream *strm,
 }
 
 
+/*
+ * The NACK ring keeps the last sent packets, indexed by the lower bits
+ * of the RTP sequence number. A newer packet replaces the slot, so a
+ * NACK lookup is a single array access. Must be called with lock_tx.
+ */
+static void nack_flush(struct vtx *vtx)
+{
+	for (size_t i = 0; i < RE_ARRAY_SIZE(vtx->nackv); i++)
+		vtx->nackv[i] = mem_deref(vtx->nackv[i]);
+
+	vtx->nackn = 0;
+}
+
+
+static void nack_store(struct vtx *vtx, struct vidqent *qent, uint64_t jfs)
+{
+	struct vidqent **slot = &vtx->nackv[qent->seq & (NACK_RING_SZ - 1)];
+	uint32_t n;
+
+	if (*slot)
+		mem_deref(*slot);
+	else
+		++vtx->nackn;
+
+	*slot = qent;
+
+	/* the following slots hold the oldest packets, release expired.
+	 * Taken packets leave gaps, so skip empty slots. */
+	n = vtx->nackn - 1;
+	for (size_t i = 1; i < NACK_RING_SZ && n; i++) {
+
+		slot = &vtx->nackv[(qent->seq + i) & (NACK_RING_SZ - 1)];
+		if (!*slot)
+			continue;
+
+		if (jfs <= (*slot)->jfs_nack)
+			break;
+
+		*slot = mem_deref(*slot);
+		--vtx->nackn;
+		--n;
+	}
+}
+
+
+static struct vidqent *nack_take(struct vtx *vtx, uint16_t seq,
+				 uint64_t jfs)
+{
+	struct vidqent **slot = &vtx->nackv[seq & (NACK_RING_SZ - 1)];
+	struct vidqent *qent = *slot;
+
+	if (!qent || qent->seq != seq)
+		return NULL;
+
+	*slot = NULL;
+	--vtx->nackn;
+
+	if (jfs > qent->jfs_nack)
+		return mem_deref(qent);
+
+	return qent;
+}
+
+
 static void video_destructor(void *arg)
 {
 	struct video *v = arg;
@@ -289,7 +357,7 @@ static void video_destructor(void *arg)
 	}
 	mtx_lock(vtx->lock_tx);
 	list_flush(&vtx->sendq);
-	list_flush(&vtx->sendqnb);
+	nack_flush(vtx);
 	mtx_unlock(vtx->lock_tx);
 	mem_deref(vtx->lock_tx);
 
@@ -537,9 +605,17 @@ static int vtx_thread(void *arg)
 	struct vidqent *qent = NULL;
 	struct mbuf *mbd;
 	size_t sent = 0;
+	bool batched = false;
 
 	while (re_atomic_rlx(&vtx->run)) {
 		mtx_lock(vtx->lock_tx);
+		if (!vtx->sendq.head && batched) {
+			/* send the batch before waiting for more packets */
+			mtx_unlock(vtx->lock_tx);
+			stream_flush_txbatch(vtx->video->strm);
+			batched = false;
+			continue;
+		}
 		if (!vtx->sendq.head) {
 			cnd_wait(&vtx->wait, vtx->lock_tx);
 			qent = NULL;
@@ -558,6 +634,10 @@ static int vtx_thread(void *arg)
 				start_jfs = jfs + delay;
 				sent	  = 0;
 			}
+			if (batched) {
+				stream_flush_txbatch(vtx->video->strm);
+				batched = false;
+			}
 			sys_usleep((unsigned int)delay);
 		}
 		else {
@@ -570,35 +650,40 @@ static int vtx_thread(void *arg)
 		sent += mbuf_get_left(qent->mb) * 8;
 		target_jfs = start_jfs + sent * 1000000 / bitrate;
 
-		mbd = mbuf_dup(qent->mb);
+		/*
+		 * The send path writes the RTP header in front of the
+		 * payload, so the packet can be resent from the same mbuf.
+		 * Media encryption transforms the payload in-place, then a
+		 * plain copy is needed.
+		 */
+		qent->end = qent->mb->end;
+		mbd = vtx->nack_copy ? mbuf_dup(qent->mb) : NULL;
 
+		stream_hold_txbatch(vtx->video->strm);
 		stream_send(vtx->video->strm, qent->ext, qent->marker,
 			    qent->pt, qent->ts, qent->mb);
+		batched = !qent->marker;
+
+		/* end of frame */
+		if (qent->marker)
+			stream_flush_txbatch(vtx->video->strm);
 
-		mem_deref(qent->mb);
+		if (mbd) {
+			mem_deref(qent->mb);
+			qent->mb = mbd;
+		}
 
 		qent->jfs_nack = jfs + NACK_QUEUE_TIME * 1000;
 		qent->seq = rtp_sess_seq(stream_rtp_sock(vtx->video->strm));
-		qent->mb  = mbd;
 
 		mtx_lock(vtx->lock_tx);
-		list_move(&qent->le, &vtx->sendqnb);
-
-		/* Delayed NACK queue cleanup */
-		struct le *le = vtx->sendqnb.head;
-		while (le) {
-			qent = le->data;
-
-			le = le->next;
-
-			if (jfs > qent->jfs_nack)
-				mem_deref(qent);
-			else
-				break; /* Assuming list is sorted by time */
-		}
+		list_unlink(&qent->le);
+		nack_store(vtx, qent, jfs);
 		mtx_unlock(vtx->lock_tx);
 	}
 
+	stream_flush_txbatch(vtx->video->strm);
+
 	return 0;
 }
 
@@ -911,7 +996,8 @@ static void rtcp_nack_handler(struct vtx *vtx, struct rtcp_msg *msg)
 	uint16_t nack_pid;
 	uint16_t nack_blp;
 	uint16_t pids[NACK_BLPSZ + 1] = {0};
-	struct le *le;
+	size_t pidc = 1;
+	uint64_t jfs = tmr_jiffies_usec();
 
 	if (!msg || msg->hdr.count != RTCP_RTPFB_GNACK ||
 	    !msg->r.fb.fci.gnackv)
@@ -921,37 +1007,27 @@ static void rtcp_nack_handler(struct vtx *vtx, struct rtcp_msg *msg)
 	nack_blp = msg->r.fb.fci.gnackv->blp;
 	pids[0]	 = nack_pid;
 
-	if (nack_blp) {
-		for (int i = 1; i < NACK_BLPSZ + 1; i++) {
-			if (nack_blp & (1 << (i - 1))) {
-				pids[i] = nack_pid + i;
-			}
-		}
+	for (int i = 1; i < NACK_BLPSZ + 1; i++) {
+		if (nack_blp & (1 << (i - 1)))
+			pids[pidc++] = nack_pid + i;
 	}
 
 	mtx_lock(vtx->lock_tx);
-	LIST_FOREACH(&vtx->sendqnb, le) {
-		struct vidqent *qent = le->data;
-
-		if (qent->seq == nack_pid)
-			break;
-	}
-
-	for (int i = 0; i < NACK_BLPSZ + 1 && le; i++) {
-		struct vidqent *qent = le->data;
-
-		le = le->next;
-		if (qent->seq != pids[i])
+	for (size_t i = 0; i < pidc; i++) {
+		struct vidqent *qent = nack_take(vtx, pids[i], jfs);
+		if (!qent)
 			continue;
 
 		debug("NACK resend rtp seq: %u\n", pids[i]);
+
+		qent->mb->pos = RTP_PRESZ;
+		qent->mb->end = qent->end;
 		stream_resend(vtx->video->strm, qent->seq, qent->ext,
 			      qent->marker, qent->pt, qent->ts, qent->mb);
 
 		/* sent only once */
 		mem_deref(qent);
 	}
-
 	mtx_unlock(vtx->lock_tx);
 }
 
@@ -1106,6 +1182,9 @@ int video_alloc(struct video **vp, struct list *streaml,
 	if (err)
 		goto out;
 
+	/* media encryption is done in-place */
+	v->vtx.nack_copy = menc != NULL;
+
 	if (acc && acc->vidsrc_mod) {
 		str_ncpy(v->vtx.module, acc->vidsrc_mod,
 			sizeof(v->vtx.module));
@@ -1406,6 +1485,15 @@ int video_start_source(struct video *v)
 	}
 
 	if (!re_atomic_rlx(&vtx->run)) {
+		if (v->cfg.txbatch) {
+			err = stream_enable_txbatch(v->strm, v->cfg.txbatch,
+						    v->cfg.txgso);
+			if (err) {
+				warning("video: could not enable transmit"
+					" batch (%m)\n", err);
+			}
+		}
+
 		re_atomic_rlx_set(&vtx->run, true);
 		thread_create_name(&vtx->thrd, "Video TX", vtx_thread, vtx);
 	}
@@ -1489,7 +1577,7 @@ static void video_stop_source(struct video *v)
 
 	mtx_lock(v->vtx.lock_tx);
 	list_flush(&v->vtx.sendq);
-	list_flush(&v->vtx.sendqnb);
+	nack_flush(&v->vtx);
 	mtx_unlock(v->vtx.lock_tx);
 }
 
@@ -0,0 +1,126 @@
+/**
+ * @file test/audrift.c  Audio clock drift compensation Testcode
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "../src/core.h"  /* NOTE: temp */
+#include "test.h"
+
+
+enum {
+	SRATE = 8000,
+	PTIME = 20,
+	NSAMP = SRATE * PTIME / 1000,
+};
+
+
+/*
+ * Simulate an audio source which is 300 ppm faster than the transmitter,
+ * for 10 minutes. The fill level of the buffer is in [samples].
+ */
+static int drift_simulate(struct audrift *ad, int32_t *fill_max)
+{
+	const double t_src = PTIME / (1 + 300e-6);
+	int16_t sampv[NSAMP];
+	struct auframe af;
+	double t_next = 0;
+	int32_t fill = 0;
+	int err = 0;
+
+	memset(sampv, 0, sizeof(sampv));
+	*fill_max = 0;
+
+	for (int i = 0; i < 10 * 60 * 1000 / PTIME; i++) {
+
+		const double now = (double)i * PTIME;
+
+		/* source writes */
+		while (t_next <= now) {
+
+			uint64_t t = (uint64_t)(t_next * 1000);
+
+			auframe_init(&af, AUFMT_S16LE, sampv, NSAMP, SRATE, 1);
+
+			err = audrift_process(ad, &af, t);
+			TEST_ERR(err);
+
+			fill   += (int32_t)af.sampc;
+			t_next += t_src;
+		}
+
+		/* transmitter reads */
+		ASSERT_TRUE(fill >= NSAMP);
+		fill -= NSAMP;
+
+		audrift_update(ad, (uint64_t)fill * 1000000 / SRATE,
+			       PTIME * 1500, (uint64_t)(now * 1000));
+
+		/* converged after 2 minutes */
+		if (i > 2 * 60 * 1000 / PTIME)
+			*fill_max = max(*fill_max, fill);
+	}
+
+ out:
+	return err;
+}
+
+
+int test_audrift(void)
+{
+	struct audrift *ad = NULL;
+	int16_t sampv[NSAMP];
+	float fsampv[NSAMP];
+	struct auframe af;
+	int32_t fill_max;
+	int err;
+
+	err = audrift_alloc(&ad, PTIME);
+	TEST_ERR(err);
+
+	/* no correction, the output is delayed by one sample */
+	for (int i = 0; i < NSAMP; i++)
+		sampv[i] = (int16_t)(i + 1);
+
+	auframe_init(&af, AUFMT_S16LE, sampv, NSAMP, SRATE, 1);
+	err = audrift_process(ad, &af, 0);
+	TEST_ERR(err);
+
+	ASSERT_EQ(NSAMP, (int)af.sampc);
+	ASSERT_EQ(0, ((int16_t *)af.sampv)[0]);
+	ASSERT_EQ(1, ((int16_t *)af.sampv)[1]);
+	ASSERT_EQ(NSAMP - 1, ((int16_t *)af.sampv)[NSAMP - 1]);
+
+	/* no underrun, and about one packet in the buffer */
+	err = drift_simulate(ad, &fill_max);
+	TEST_ERR(err);
+
+	ASSERT_TRUE(fill_max < 2 * NSAMP);
+	ASSERT_TRUE(audrift_ppm(ad) > 250 && audrift_ppm(ad) < 350);
+
+	mem_deref(ad);
+	err = audrift_alloc(&ad, PTIME);
+	TEST_ERR(err);
+
+	/* other sample formats are passed through */
+	memset(sampv, 0, sizeof(sampv));
+	auframe_init(&af, AUFMT_S32LE, sampv, NSAMP / 2, SRATE, 1);
+	err = audrift_process(ad, &af, 0);
+	TEST_ERR(err);
+	ASSERT_TRUE(af.sampv == sampv);
+
+	memset(fsampv, 0, sizeof(fsampv));
+	auframe_init(&af, AUFMT_FLOAT, fsampv, NSAMP, SRATE, 1);
+	err = audrift_process(ad, &af, 0);
+	TEST_ERR(err);
+	ASSERT_TRUE(af.sampv != fsampv);
+	ASSERT_EQ(NSAMP, (int)af.sampc);
+
+ out:
+	mem_deref(ad);
+
+	return err;
+}
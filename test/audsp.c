@@ -0,0 +1,245 @@
+/**
+ * @file test/audsp.c  Audio DSP kernels Testcode
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <math.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "test.h"
+
+
+enum { N = 1031 };
+
+
+struct input {
+	int16_t s16[N];
+	int16_t s16b[N];
+	int32_t s32[N];
+	float f[N];
+	float fb[N];
+};
+
+
+struct output {
+	int16_t s16[8][N];
+	int32_t s32[2][N];
+	float f[6][N];
+};
+
+
+static void init_input(struct input *in)
+{
+	for (size_t i = 0; i < N; i++) {
+		in->s16[i]  = (int16_t)rand_u16();
+		in->s16b[i] = (int16_t)rand_u16();
+		in->s32[i]  = (int32_t)rand_u32();
+		in->f[i]    = (float)(int16_t)rand_u16() / 20000.0f;
+		in->fb[i]   = (float)(int16_t)rand_u16() / 20000.0f;
+	}
+
+	/* edge cases */
+	in->s16[0] = 32767;
+	in->s16[1] = -32768;
+	in->s16b[0] = 32767;
+	in->s16b[1] = -32768;
+	in->s32[0] = INT32_MAX;
+	in->s32[1] = INT32_MIN;
+	in->f[0] = 1.0f;
+	in->f[1] = -1.0f;
+	in->f[2] = INFINITY;
+	in->f[3] = -INFINITY;
+}
+
+
+static void run_kernels(struct output *o, const struct input *in, size_t n)
+{
+	memset(o, 0, sizeof(*o));
+
+	audsp_s16_to_float(o->f[0], in->s16, n);
+	audsp_float_to_s16(o->s16[0], in->f, n);
+	audsp_s16_to_s32(o->s32[0], in->s16, n);
+	audsp_s32_to_s16(o->s16[1], in->s32, n);
+	audsp_s32_to_float(o->f[1], in->s32, n);
+	audsp_float_to_s32(o->s32[1], in->f, n);
+
+	memcpy(o->s16[2], in->s16, n * sizeof(int16_t));
+	audsp_add_s16(o->s16[2], in->s16b, n);
+
+	memcpy(o->f[2], in->f, n * sizeof(float));
+	audsp_add_float(o->f[2], in->fb, n);
+
+	memcpy(o->s16[3], in->s16, n * sizeof(int16_t));
+	audsp_gain_s16(o->s16[3], n, 0.7f);
+
+	memcpy(o->s16[4], in->s16, n * sizeof(int16_t));
+	audsp_gain_s16(o->s16[4], n, 3.3f);
+
+	memcpy(o->f[3], in->f, n * sizeof(float));
+	audsp_gain_float(o->f[3], n, 0.3f);
+
+	memcpy(o->s16[5], in->s16, n * sizeof(int16_t));
+	audsp_fade_s16(o->s16[5], n, 0.1f, 0.003f, 1.0f);
+
+	memcpy(o->s16[6], in->s16, n * sizeof(int16_t));
+	audsp_fade_s16(o->s16[6], n, 1.0f, -0.002f, 0.2f);
+
+	memcpy(o->s16[7], in->s16, n * sizeof(int16_t));
+	audsp_fade_s16(o->s16[7], n, 1.5f, 0.01f, 4.0f);
+
+	memcpy(o->f[4], in->f, n * sizeof(float));
+	audsp_fade_float(o->f[4], n, 0.1f, 0.003f, 1.0f);
+
+	memcpy(o->f[5], in->f, n * sizeof(float));
+	audsp_fade_float(o->f[5], n, 1.0f, -0.002f, 0.2f);
+}
+
+
+static int test_isa(enum audsp_isa isa, const struct input *in,
+		    struct output *ref, struct output *out)
+{
+	static const size_t lenv[] = {
+		0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 31, 32, 33, 160, 959, N
+	};
+	int err = 0;
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(lenv); i++) {
+
+		err = audsp_set_isa(AUDSP_SCALAR);
+		TEST_ERR(err);
+
+		run_kernels(ref, in, lenv[i]);
+
+		err = audsp_set_isa(isa);
+		TEST_ERR(err);
+
+		run_kernels(out, in, lenv[i]);
+
+		TEST_MEMCMP(ref, sizeof(*ref), out, sizeof(*out));
+	}
+
+ out:
+	if (err) {
+		warning("audsp: %s kernels differ from scalar\n",
+			audsp_isa_name(isa));
+	}
+
+	return err;
+}
+
+
+/* the conversion must give the same samples as the libre conversion */
+static int test_libre(enum audsp_isa isa, const struct input *in,
+		      struct output *ref, struct output *out)
+{
+	int err = 0;
+
+	memset(ref, 0, sizeof(*ref));
+	memset(out, 0, sizeof(*out));
+
+	auconv_to_s16(ref->s16[0], AUFMT_FLOAT, (void *)in->f, N);
+	audsp_float_to_s16(out->s16[0], in->f, N);
+
+	auconv_from_s16(AUFMT_FLOAT, ref->f[0], in->s16, N);
+	audsp_s16_to_float(out->f[0], in->s16, N);
+
+	TEST_MEMCMP(ref, sizeof(*ref), out, sizeof(*out));
+
+ out:
+	if (err) {
+		warning("audsp: %s conversion differs from libre\n",
+			audsp_isa_name(isa));
+	}
+
+	return err;
+}
+
+
+int test_audsp(void)
+{
+	static const enum audsp_isa isav[] = {
+		AUDSP_SSE2, AUDSP_AVX2, AUDSP_NEON
+	};
+	enum audsp_isa isa = audsp_isa();
+	struct output *ref, *out;
+	struct input *in;
+	int16_t s16[4];
+	float f[4];
+	int err = 0;
+
+	in  = mem_zalloc(sizeof(*in), NULL);
+	ref = mem_zalloc(sizeof(*ref), NULL);
+	out = mem_zalloc(sizeof(*out), NULL);
+	if (!in || !ref || !out) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	/* scalar reference */
+	err = audsp_set_isa(AUDSP_SCALAR);
+	TEST_ERR(err);
+
+	s16[0] = 16384;
+	s16[1] = -32768;
+	audsp_s16_to_float(f, s16, 2);
+	ASSERT_DOUBLE_EQ(0.5, f[0], 1e-9);
+	ASSERT_DOUBLE_EQ(-1.0, f[1], 1e-9);
+
+	f[0] = 1.5f;
+	f[1] = -1.5f;
+	f[2] = 0.25f;
+	f[3] = -0.7f / 32768.0f;
+	audsp_float_to_s16(s16, f, 4);
+	ASSERT_EQ(32767, s16[0]);
+	ASSERT_EQ(-32768, s16[1]);
+	ASSERT_EQ(8192, s16[2]);
+	ASSERT_EQ(-1, s16[3]);
+
+	s16[0] = 30000;
+	s16[1] = -30000;
+	s16[2] = 100;
+	audsp_add_s16(s16, s16, 3);
+	ASSERT_EQ(32767, s16[0]);
+	ASSERT_EQ(-32768, s16[1]);
+	ASSERT_EQ(200, s16[2]);
+
+	s16[0] = 1000;
+	s16[1] = 1000;
+	s16[2] = 1000;
+	audsp_fade_s16(s16, 3, 0.5f, 0.25f, 0.875f);
+	ASSERT_EQ(500, s16[0]);
+	ASSERT_EQ(750, s16[1]);
+	ASSERT_EQ(875, s16[2]);
+
+	init_input(in);
+
+	err = test_libre(AUDSP_SCALAR, in, ref, out);
+	TEST_ERR(err);
+
+	/* all SIMD kernels must be bit-exact with the scalar kernels */
+	for (size_t i = 0; i < RE_ARRAY_SIZE(isav); i++) {
+
+		if (audsp_set_isa(isav[i]))
+			continue;
+
+		err = test_isa(isav[i], in, ref, out);
+		TEST_ERR(err);
+
+		err = audsp_set_isa(isav[i]);
+		TEST_ERR(err);
+
+		err = test_libre(isav[i], in, ref, out);
+		TEST_ERR(err);
+	}
+
+ out:
+	audsp_set_isa(isa);
+
+	mem_deref(in);
+	mem_deref(ref);
+	mem_deref(out);
+
+	return err;
+}
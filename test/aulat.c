@@ -0,0 +1,70 @@
+/**
+ * @file test/aulat.c  Audio latency trace Testcode
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <baresip.h>
+#include "../src/core.h"  /* NOTE: temp */
+#include "test.h"
+
+
+int test_aulat(void)
+{
+	struct aulat *al = NULL;
+	struct odict *od = NULL;
+	struct odict *lat, *stage;
+	uint64_t num;
+	int err;
+
+	err = aulat_alloc(&al);
+	TEST_ERR(err);
+
+	/* 98 frames of 100us, one of 5ms and one of 20ms */
+	for (int i = 0; i < 98; i++)
+		aulat_add(al, AULAT_RX_DECODE, 100);
+
+	aulat_add(al, AULAT_RX_DECODE, 5000);
+	aulat_add(al, AULAT_RX_DECODE, 20000);
+
+	ASSERT_EQ(100, (int)aulat_count(al, AULAT_RX_DECODE));
+	ASSERT_EQ(348, (int)aulat_mean(al, AULAT_RX_DECODE));
+	ASSERT_EQ(20000, (int)aulat_max(al, AULAT_RX_DECODE));
+
+	/* percentiles are the upper bound of a log2 bucket */
+	ASSERT_EQ(128, (int)aulat_percentile(al, AULAT_RX_DECODE, 50));
+	ASSERT_EQ(8192, (int)aulat_percentile(al, AULAT_RX_DECODE, 99));
+	ASSERT_EQ(20000, (int)aulat_percentile(al, AULAT_RX_DECODE, 100));
+
+	/* untouched stage */
+	ASSERT_EQ(0, (int)aulat_count(al, AULAT_TX_SEND));
+	ASSERT_EQ(0, (int)aulat_percentile(al, AULAT_TX_SEND, 50));
+
+	/* very large values end up in the last bucket */
+	aulat_add(al, AULAT_TX_AUBUF, 0);
+	aulat_add(al, AULAT_TX_AUBUF, 1ULL << 40);
+	ASSERT_EQ(2, (int)aulat_percentile(al, AULAT_TX_AUBUF, 50));
+	ASSERT_TRUE(aulat_percentile(al, AULAT_TX_AUBUF, 100) == 1ULL << 40);
+
+	err = odict_alloc(&od, 8);
+	TEST_ERR(err);
+
+	err = aulat_odict_encode(od, al);
+	TEST_ERR(err);
+
+	ASSERT_TRUE(odict_get_object(od, &lat, "latency"));
+	ASSERT_TRUE(odict_get_object(lat, &stage, "rx_decode"));
+
+	ASSERT_TRUE(odict_get_number(stage, &num, "count"));
+	ASSERT_EQ(100, (int)num);
+
+	ASSERT_TRUE(odict_get_number(stage, &num, "p99_us"));
+	ASSERT_EQ(8192, (int)num);
+
+ out:
+	mem_deref(od);
+	mem_deref(al);
+
+	return err;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file test/aureceiver.c  Audio receiver Testcode
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "../src/core.h"  /* NOTE: temp */
+#include "test.h"
+
+
+enum {
+	SRATE = 8000,
+	PTIME = 20,
+	NSAMP = SRATE * PTIME / 1000,
+};
+
+
+static unsigned plc_count;
+
+
+static int decode(struct audec_state *ads, int fmt, void *sampv,
+		  size_t *sampc, bool marker, const uint8_t *buf, size_t len)
+{
+	(void)ads;
+	(void)fmt;
+	(void)marker;
+
+	if (*sampc < len / 2)
+		return ENOMEM;
+
+	memcpy(sampv, buf, len);
+	*sampc = len / 2;
+
+	return 0;
+}
+
+
+static int plc(struct audec_state *ads, int fmt, void *sampv, size_t *sampc,
+	       const uint8_t *buf, size_t len)
+{
+	(void)ads;
+	(void)fmt;
+	(void)buf;
+	(void)len;
+
+	++plc_count;
+
+	memset(sampv, 0, NSAMP * 2);
+	*sampc = NSAMP;
+
+	return 0;
+}
+
+
+static struct aucodec ac_plc = {
+	.name  = "plctest",
+	.srate = SRATE,
+	.crate = SRATE,
+	.ch    = 1,
+	.pch   = 1,
+	.dech  = decode,
+	.plch  = plc,
+};
+
+
+static void receive(struct audio_recv *ar, struct mbuf *mb,
+		    uint16_t seq, unsigned lostc)
+{
+	struct rtp_header hdr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.pt  = 0;
+	hdr.seq = seq;
+	hdr.ts  = seq * NSAMP;
+
+	mb->pos = 0;
+	aurecv_receive(ar, &hdr, NULL, 0, mb, lostc);
+}
+
+
+int test_aurecv_plc(void)
+{
+	struct config_audio cfg;
+	struct audio_recv *ar = NULL;
+	struct mbuf *mb;
+	char *dbg = NULL;
+	int err;
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.dec_fmt    = AUFMT_S16LE;
+	cfg.play_fmt   = AUFMT_S16LE;
+	cfg.buffer.min = 20;
+	cfg.buffer.max = 500;
+
+	plc_count = 0;
+
+	mb = mbuf_alloc(NSAMP * 2);
+	if (!mb)
+		return ENOMEM;
+
+	err = mbuf_fill(mb, 0x55, NSAMP * 2);
+	TEST_ERR(err);
+
+	err = aurecv_alloc(&ar, &cfg, NSAMP * 4, PTIME);
+	TEST_ERR(err);
+
+	err = aurecv_decoder_set(ar, &ac_plc, 0, NULL);
+	TEST_ERR(err);
+
+	receive(ar, mb, 0, 0);
+	receive(ar, mb, 1, 0);
+	receive(ar, mb, 2, 0);
+
+	/* packets 3, 4 and 5 are lost, one frame each is concealed */
+	receive(ar, mb, 6, 3);
+	ASSERT_EQ(3, (int)plc_count);
+
+	/* late packet 4 replaces its concealed frame */
+	receive(ar, mb, 4, 0);
+
+	/* already replaced, and never concealed */
+	receive(ar, mb, 4, 0);
+	receive(ar, mb, 1, 0);
+
+	/* long loss bursts are only concealed up to a limit */
+	plc_count = 0;
+	receive(ar, mb, 107, 100);
+	ASSERT_EQ(16, (int)plc_count);
+
+	err = re_sdprintf(&dbg, "%H", aurecv_debug, ar);
+	TEST_ERR(err);
+
+	ASSERT_TRUE(NULL != strstr(dbg, "replaced 1)"));
+	ASSERT_TRUE(NULL != strstr(dbg, "n_discard: 2\n"));
+
+ out:
+	mem_deref(dbg);
+	mem_deref(ar);
+	mem_deref(mb);
+
+	return err;
+}
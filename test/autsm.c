@@ -0,0 +1,145 @@
+/**
+ * @file test/autsm.c  Audio time-scale modification Testcode
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "../src/core.h"  /* NOTE: temp */
+#include "test.h"
+
+
+enum {
+	SRATE  = 8000,
+	NSAMP  = 160,
+	FRAMES = 50,
+	FREQ   = 200,
+};
+
+
+static const double PI = 3.14159265358979323846264338328;
+
+
+static void sine(int16_t *sampv, size_t n, size_t *pos)
+{
+	for (size_t i = 0; i < n; i++, (*pos)++) {
+		double t = (double)*pos / SRATE;
+
+		sampv[i] = (int16_t)(8000 * sin(2 * PI * FREQ * t));
+	}
+}
+
+
+/* Stretch a sine wave, and check that the output has no discontinuity */
+static int stretch_sine(struct autsm *tsm, int64_t delta_us, size_t *outc)
+{
+	int16_t sampv[NSAMP];
+	struct auframe af;
+	size_t pos = 0;
+	int16_t last = 0;
+	int err = 0;
+
+	*outc = 0;
+
+	for (int i = 0; i < FRAMES; i++) {
+
+		const int16_t *y;
+
+		sine(sampv, NSAMP, &pos);
+		auframe_init(&af, AUFMT_S16LE, sampv, NSAMP, SRATE, 1);
+
+		err = autsm_process(tsm, &af, delta_us);
+		TEST_ERR(err);
+
+		y = af.sampv;
+
+		for (size_t j = 0; j < af.sampc; j++) {
+
+			/* max. slope of the sine is 2*pi*200/8000*8000 */
+			if (*outc + j)
+				ASSERT_TRUE(abs(y[j] - last) < 1600);
+
+			last = y[j];
+		}
+
+		*outc += af.sampc;
+	}
+
+ out:
+	return err;
+}
+
+
+int test_autsm(void)
+{
+	struct autsm *tsm = NULL;
+	int16_t sampv[NSAMP];
+	float fsampv[NSAMP];
+	struct auframe af;
+	size_t outc;
+	uint32_t seed = 1;
+	int err;
+
+	err = autsm_alloc(&tsm);
+	TEST_ERR(err);
+
+	/* compress, up to 5% plus one pitch period */
+	err = stretch_sine(tsm, 100000, &outc);
+	TEST_ERR(err);
+
+	ASSERT_TRUE(outc < FRAMES * NSAMP);
+	ASSERT_TRUE(FRAMES * NSAMP - outc <= FRAMES * NSAMP / 20 + 80);
+	ASSERT_EQ((int)(FRAMES * NSAMP - outc) / 8,
+		  (int)autsm_compressed(tsm));
+	ASSERT_EQ(0, (int)autsm_expanded(tsm));
+
+	/* expand */
+	err = stretch_sine(tsm, -100000, &outc);
+	TEST_ERR(err);
+
+	ASSERT_TRUE(outc > FRAMES * NSAMP);
+	ASSERT_TRUE(outc - FRAMES * NSAMP <= FRAMES * NSAMP / 20 + 80);
+	ASSERT_EQ((int)(outc - FRAMES * NSAMP) / 8, (int)autsm_expanded(tsm));
+
+	/* on target, nothing to do */
+	err = stretch_sine(tsm, 0, &outc);
+	TEST_ERR(err);
+	ASSERT_EQ(FRAMES * NSAMP, (int)outc);
+
+	/* noise is not periodic and is never modified */
+	for (int i = 0; i < FRAMES; i++) {
+
+		for (size_t j = 0; j < NSAMP; j++) {
+			seed = seed * 1103515245 + 12345;
+			sampv[j] = (int16_t)(seed >> 16);
+		}
+
+		auframe_init(&af, AUFMT_S16LE, sampv, NSAMP, SRATE, 1);
+
+		err = autsm_process(tsm, &af, 100000);
+		TEST_ERR(err);
+		ASSERT_TRUE(af.sampv == sampv);
+		ASSERT_EQ(NSAMP, (int)af.sampc);
+	}
+
+	/* other sample formats are passed through */
+	memset(fsampv, 0, sizeof(fsampv));
+	for (int i = 0; i < FRAMES; i++) {
+
+		auframe_init(&af, AUFMT_FLOAT, fsampv, NSAMP, SRATE, 1);
+
+		err = autsm_process(tsm, &af, 100000);
+		TEST_ERR(err);
+		ASSERT_TRUE(af.sampv == fsampv);
+		ASSERT_EQ(NSAMP, (int)af.sampc);
+	}
+
+ out:
+	mem_deref(tsm);
+
+	return err;
+}
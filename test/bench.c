@@ -0,0 +1,686 @@
+/**
+ * @file test/bench.c  Multi-call load generator and benchmark
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#ifdef HAVE_GETOPT
+#include <getopt.h>
+#endif
+#ifndef WIN32
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "../src/core.h"  /* NOTE: temp */
+#include "test.h"
+
+
+/**
+ * \page Bench baresip-bench
+ *
+ * Headless load generator: N pairs of user agents call each other over
+ * loopback in one process, and the resource usage is measured while all
+ * calls are established.
+ *
+ *<pre>
+ *   A<i>: ausine ---> encode ---> RTP ---> decode ---> aubridge
+ *                                                         |
+ *   A<i>: mock-auplay <--- decode <--- RTP <--- encode <--'   :B<i>
+ *</pre>
+ *
+ * B<i> echoes the received audio back to A<i> with an aubridge device,
+ * so both directions of every call run the full audio pipeline.
+ *
+ * Reported are the CPU time and resident memory per call, the number of
+ * threads, RTP packets per second, and percentiles (over all directions)
+ * of the RTCP interarrival jitter and the mean audio pipeline latency.
+ */
+
+
+enum {
+	DEFAULT_CALLS    = 10,
+	DEFAULT_DURATION = 10,     /* [s]  */
+	DEFAULT_PTIME    = 20,     /* [ms] */
+	SETUP_TIMEOUT    = 30000,  /* [ms] */
+	ASYNC_WORKERS    = 4,
+};
+
+
+struct pair {
+	struct ua *a;
+	struct ua *b;
+};
+
+
+struct snapshot {
+	uint64_t t;        /* Wall clock [us]       */
+	uint64_t cpu;      /* User + system [us]    */
+	uint64_t rss;      /* Resident size [bytes] */
+	uint64_t packets;  /* RTP packets tx + rx   */
+};
+
+
+static struct bench {
+	struct pair *pairv;
+	unsigned n;
+	unsigned duration;
+	uint32_t ptime;
+	bool json;
+
+	unsigned n_estab;
+	uint64_t n_auframe;
+	bool running;
+	struct tmr tmr;
+	int err;
+
+	struct snapshot base;
+	struct snapshot u0;
+	struct snapshot u1;
+	unsigned threads;
+	double *jitv;
+	double *latv;
+	size_t nsamp;
+} bench;
+
+
+static uint64_t cpu_usec(void)
+{
+#ifndef WIN32
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru))
+		return 0;
+
+	return (uint64_t)ru.ru_utime.tv_sec * 1000000 + ru.ru_utime.tv_usec +
+	       (uint64_t)ru.ru_stime.tv_sec * 1000000 + ru.ru_stime.tv_usec;
+#else
+	return 0;
+#endif
+}
+
+
+static uint64_t rss_bytes(void)
+{
+#ifdef LINUX
+	unsigned long size, resident;
+	long pagesz = sysconf(_SC_PAGESIZE);
+	uint64_t rss = 0;
+	FILE *f;
+
+	f = fopen("/proc/self/statm", "r");
+	if (!f)
+		return 0;
+
+	if (2 == fscanf(f, "%lu %lu", &size, &resident) && pagesz > 0)
+		rss = (uint64_t)resident * (uint64_t)pagesz;
+
+	(void)fclose(f);
+
+	return rss;
+#else
+	return 0;
+#endif
+}
+
+
+static unsigned thread_count(void)
+{
+#ifdef LINUX
+	char line[128];
+	unsigned n = 0;
+	FILE *f;
+
+	f = fopen("/proc/self/status", "r");
+	if (!f)
+		return 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (1 == sscanf(line, "Threads: %u", &n))
+			break;
+	}
+
+	(void)fclose(f);
+
+	return n;
+#else
+	return 0;
+#endif
+}
+
+
+static struct stream *ua_audio_strm(const struct ua *ua)
+{
+	return audio_strm(call_audio(ua_call(ua)));
+}
+
+
+static uint64_t packet_count(void)
+{
+	uint64_t n = 0;
+
+	for (unsigned i = 0; i < bench.n; i++) {
+
+		const struct stream *sa = ua_audio_strm(bench.pairv[i].a);
+		const struct stream *sb = ua_audio_strm(bench.pairv[i].b);
+
+		n += stream_metric_get_tx_n_packets(sa);
+		n += stream_metric_get_rx_n_packets(sa);
+		n += stream_metric_get_tx_n_packets(sb);
+		n += stream_metric_get_rx_n_packets(sb);
+	}
+
+	return n;
+}
+
+
+static void snapshot_get(struct snapshot *u)
+{
+	u->t       = tmr_jiffies_usec();
+	u->cpu     = cpu_usec();
+	u->rss     = rss_bytes();
+	u->packets = bench.running ? packet_count() : 0;
+}
+
+
+/* Sum of the mean latency of some audio pipeline stages in [us] */
+static uint64_t pipeline_mean(const struct audio *au,
+			      enum aulat_stage first, enum aulat_stage last)
+{
+	struct odict *od = NULL, *lat, *stage;
+	uint64_t sum = 0, num;
+
+	if (odict_alloc(&od, 8))
+		return 0;
+
+	if (audio_latency_encode(od, au))
+		goto out;
+
+	if (!odict_get_object(od, &lat, "latency"))
+		goto out;
+
+	for (enum aulat_stage s = first; s <= last; s++) {
+
+		if (!odict_get_object(lat, &stage, aulat_stage_name(s)))
+			continue;
+
+		if (odict_get_number(stage, &num, "mean_us"))
+			sum += num;
+	}
+
+ out:
+	mem_deref(od);
+
+	return sum;
+}
+
+
+/* One direction of a call, from the sender to the receiver */
+static void direction_sample(const struct ua *tx, const struct ua *rx)
+{
+	const struct audio *atx = call_audio(ua_call(tx));
+	const struct audio *arx = call_audio(ua_call(rx));
+	const struct rtcp_stats *rtcp;
+	uint64_t lat;
+
+	rtcp = stream_rtcp_stats(audio_strm(arx));
+
+	lat  = pipeline_mean(atx, AULAT_TX_AUBUF, AULAT_TX_SEND);
+	lat += pipeline_mean(arx, AULAT_RX_JBUF, AULAT_RX_AUBUF);
+
+	bench.jitv[bench.nsamp] = rtcp ? rtcp->rx.jit / 1000.0 : 0;
+	bench.latv[bench.nsamp] = lat / 1000.0;
+	++bench.nsamp;
+}
+
+
+static void measure_end(void *arg)
+{
+	(void)arg;
+
+	snapshot_get(&bench.u1);
+	bench.threads = thread_count();
+
+	for (unsigned i = 0; i < bench.n; i++) {
+		direction_sample(bench.pairv[i].a, bench.pairv[i].b);
+		direction_sample(bench.pairv[i].b, bench.pairv[i].a);
+	}
+
+	re_cancel();
+}
+
+
+static void setup_timeout(void *arg)
+{
+	(void)arg;
+
+	warning("bench: only %u of %u calls established\n",
+		bench.n_estab / 2, bench.n);
+
+	bench.err = ETIMEDOUT;
+	re_cancel();
+}
+
+
+static void event_handler(enum bevent_ev ev, struct bevent *event, void *arg)
+{
+	struct call *call = bevent_get_call(event);
+	struct ua *ua     = bevent_get_ua(event);
+	const struct sip_msg *msg = bevent_get_msg(event);
+	int err;
+	(void)arg;
+
+	if (!ua)
+		ua = uag_find_msg(msg);
+
+	switch (ev) {
+
+	case BEVENT_SIPSESS_CONN:
+		err = ua_accept(ua, msg);
+		if (err) {
+			warning("bench: could not accept call (%m)\n", err);
+			break;
+		}
+
+		bevent_stop(event);
+		break;
+
+	case BEVENT_CALL_INCOMING:
+		err = ua_answer(ua, call, VIDMODE_OFF);
+		if (err)
+			warning("bench: could not answer call (%m)\n", err);
+		break;
+
+	case BEVENT_CALL_ESTABLISHED:
+		if (++bench.n_estab < 2 * bench.n)
+			break;
+
+		info("bench: %u calls established\n", bench.n);
+
+		bench.running = true;
+		snapshot_get(&bench.u0);
+		tmr_start(&bench.tmr, bench.duration * 1000,
+			  measure_end, NULL);
+		break;
+
+	case BEVENT_CALL_CLOSED:
+		warning("bench: call closed (%s)\n",
+			bevent_get_text(event));
+
+		bench.err = ECONNRESET;
+		re_cancel();
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+static void sample_handler(struct auframe *af, const char *dev, void *arg)
+{
+	(void)af;
+	(void)dev;
+	(void)arg;
+
+	++bench.n_auframe;
+}
+
+
+static int cmp_double(const void *a, const void *b)
+{
+	const double *da = a;
+	const double *db = b;
+
+	return (*da > *db) - (*da < *db);
+}
+
+
+static double percentile(const double *v, size_t n, unsigned pct)
+{
+	if (!n)
+		return 0;
+
+	return v[(n - 1) * pct / 100];
+}
+
+
+static int report_text(double cpu, double rss, double pps)
+{
+	const size_t n = bench.nsamp;
+	int err;
+
+	err  = re_printf("\nbaresip-bench: %u calls, %u s, ptime %u ms,"
+			 " rx %s\n",
+			 bench.n, bench.duration, bench.ptime,
+			 rtp_receive_mode_str(conf_config()->avt.rxmode));
+	err |= re_printf("  cpu:       %.2f %% per call (%.2f %% total)\n",
+			 cpu / bench.n, cpu);
+	err |= re_printf("  rss:       %.1f KiB per call\n",
+			 rss / bench.n / 1024);
+	err |= re_printf("  threads:   %u\n", bench.threads);
+	err |= re_printf("  packets:   %.0f /s\n", pps);
+	err |= re_printf("  auplay:    %llu frames\n", bench.n_auframe);
+	err |= re_printf("  jitter:    p50 %.2f ms, p95 %.2f ms,"
+			 " p99 %.2f ms\n",
+			 percentile(bench.jitv, n, 50),
+			 percentile(bench.jitv, n, 95),
+			 percentile(bench.jitv, n, 99));
+	err |= re_printf("  latency:   p50 %.2f ms, p95 %.2f ms, p99 %.2f ms"
+			 " (audio pipeline)\n",
+			 percentile(bench.latv, n, 50),
+			 percentile(bench.latv, n, 95),
+			 percentile(bench.latv, n, 99));
+
+	return err;
+}
+
+
+static int report_json(double cpu, double rss, double pps)
+{
+	struct odict *od = NULL;
+	const size_t n = bench.nsamp;
+	int err;
+
+	err = odict_alloc(&od, 16);
+	if (err)
+		return err;
+
+	err  = odict_entry_add(od, "calls", ODICT_INT, (int64_t)bench.n);
+	err |= odict_entry_add(od, "duration", ODICT_INT,
+			       (int64_t)bench.duration);
+	err |= odict_entry_add(od, "ptime", ODICT_INT, (int64_t)bench.ptime);
+	err |= odict_entry_add(od, "cpu_per_call", ODICT_DOUBLE,
+			       cpu / bench.n);
+	err |= odict_entry_add(od, "rss_per_call", ODICT_INT,
+			       (int64_t)(rss / bench.n));
+	err |= odict_entry_add(od, "threads", ODICT_INT,
+			       (int64_t)bench.threads);
+	err |= odict_entry_add(od, "packets_per_sec", ODICT_DOUBLE, pps);
+	err |= odict_entry_add(od, "jitter_p50_ms", ODICT_DOUBLE,
+			       percentile(bench.jitv, n, 50));
+	err |= odict_entry_add(od, "jitter_p99_ms", ODICT_DOUBLE,
+			       percentile(bench.jitv, n, 99));
+	err |= odict_entry_add(od, "latency_p50_ms", ODICT_DOUBLE,
+			       percentile(bench.latv, n, 50));
+	err |= odict_entry_add(od, "latency_p99_ms", ODICT_DOUBLE,
+			       percentile(bench.latv, n, 99));
+	if (err)
+		goto out;
+
+	err = re_printf("%H\n", json_encode_odict, od);
+
+ out:
+	mem_deref(od);
+
+	return err;
+}
+
+
+static int report(void)
+{
+	double secs = (bench.u1.t - bench.u0.t) / 1e6;
+	double cpu, rss, pps;
+
+	if (secs <= 0)
+		return EINVAL;
+
+	qsort(bench.jitv, bench.nsamp, sizeof(double), cmp_double);
+	qsort(bench.latv, bench.nsamp, sizeof(double), cmp_double);
+
+	cpu = 100.0 * (bench.u1.cpu - bench.u0.cpu) / 1e6 / secs;
+	rss = bench.u1.rss > bench.base.rss ?
+		(double)(bench.u1.rss - bench.base.rss) : 0;
+	pps = (bench.u1.packets - bench.u0.packets) / secs;
+
+	if (bench.json)
+		return report_json(cpu, rss, pps);
+	else
+		return report_text(cpu, rss, pps);
+}
+
+
+static int pairs_alloc(const struct sa *laddr)
+{
+	char aor[256];
+	int err = 0;
+
+	bench.pairv = mem_zalloc(bench.n * sizeof(*bench.pairv), NULL);
+	bench.jitv  = mem_zalloc(2 * bench.n * sizeof(double), NULL);
+	bench.latv  = mem_zalloc(2 * bench.n * sizeof(double), NULL);
+	if (!bench.pairv || !bench.jitv || !bench.latv)
+		return ENOMEM;
+
+	for (unsigned i = 0; i < bench.n; i++) {
+
+		struct pair *p = &bench.pairv[i];
+
+		re_snprintf(aor, sizeof(aor),
+			    "A%u <sip:a%u@127.0.0.1>;regint=0;ptime=%u"
+			    ";audio_source=ausine,440"
+			    ";audio_player=mock-auplay,a%u",
+			    i, i, bench.ptime, i);
+		err = ua_alloc(&p->a, aor);
+		if (err)
+			return err;
+
+		re_snprintf(aor, sizeof(aor),
+			    "B%u <sip:b%u@127.0.0.1>;regint=0;ptime=%u"
+			    ";audio_source=aubridge,b%u"
+			    ";audio_player=aubridge,b%u",
+			    i, i, bench.ptime, i, i);
+		err = ua_alloc(&p->b, aor);
+		if (err)
+			return err;
+	}
+
+	for (unsigned i = 0; i < bench.n; i++) {
+
+		re_snprintf(aor, sizeof(aor), "sip:b%u@%J", i, laddr);
+
+		err = ua_connect(bench.pairv[i].a, NULL, NULL, aor,
+				 VIDMODE_OFF);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+
+static void pairs_close(void)
+{
+	if (!bench.pairv)
+		return;
+
+	for (unsigned i = 0; i < bench.n; i++) {
+		mem_deref(bench.pairv[i].a);
+		mem_deref(bench.pairv[i].b);
+	}
+
+	bench.pairv = mem_deref(bench.pairv);
+}
+
+
+static void usage(void)
+{
+	(void)re_fprintf(stderr,
+			 "Usage: baresip-bench [options]\n"
+			 "options:\n"
+			 "\t-n <calls>       Number of calls (default %u)\n"
+			 "\t-t <seconds>     Duration in [s] (default %u)\n"
+			 "\t-p <ptime>       Ptime in [ms] (default %u)\n"
+			 "\t-r <rxmode>      RTP RX processing mode "
+			 "[main, thread, pool]\n"
+			 "\t-j               JSON output\n"
+			 "\t-v               Verbose output (INFO level)\n",
+			 DEFAULT_CALLS, DEFAULT_DURATION, DEFAULT_PTIME);
+}
+
+
+static const char *modconfig =
+	"ausrc_format    s16\n"
+	"audio_lattrace  yes\n"
+	"rtp_stats       yes\n";
+
+
+int main(int argc, char *argv[])
+{
+	struct config *config;
+	struct auplay *auplay = NULL;
+	struct pl rxmode = PL_INIT;
+	struct sa sa, dst, laddr;
+	int err;
+
+	bench.n        = DEFAULT_CALLS;
+	bench.duration = DEFAULT_DURATION;
+	bench.ptime    = DEFAULT_PTIME;
+
+	err = libre_init();
+	if (err)
+		return err;
+
+	log_enable_info(false);
+	re_thread_async_init(ASYNC_WORKERS);
+
+#ifdef HAVE_GETOPT
+	for (;;) {
+		const int c = getopt(argc, argv, "hjvn:t:p:r:");
+		if (0 > c)
+			break;
+
+		switch (c) {
+
+		case 'j':
+			bench.json = true;
+			break;
+
+		case 'n':
+			bench.n = atoi(optarg);
+			break;
+
+		case 't':
+			bench.duration = atoi(optarg);
+			break;
+
+		case 'p':
+			bench.ptime = atoi(optarg);
+			break;
+
+		case 'r':
+			pl_set_str(&rxmode, optarg);
+			break;
+
+		case 'v':
+			log_enable_info(true);
+			break;
+
+		case '?':
+		case 'h':
+		default:
+			usage();
+			return -2;
+		}
+	}
+#else
+	(void)argc;
+	(void)argv;
+#endif
+
+	if (!bench.n || !bench.duration || !bench.ptime) {
+		usage();
+		return -2;
+	}
+
+	err = conf_configure_buf((uint8_t *)modconfig, str_len(modconfig));
+	if (err) {
+		warning("bench: configure failed: %m\n", err);
+		goto out;
+	}
+
+	config = conf_config();
+	if (pl_isset(&rxmode))
+		config->avt.rxmode = resolve_receive_mode(&rxmode);
+
+	err = baresip_init(config);
+	err |= sa_set_str(&sa, "127.0.0.1", 0);
+	err |= net_add_address(baresip_network(), &sa);
+	if (err)
+		goto out;
+
+	/* note: run SIP-traffic on localhost */
+	str_ncpy(config->sip.local, "0.0.0.0:0", sizeof(config->sip.local));
+
+	err = ua_init("baresip-bench", true, false, false);
+	if (err)
+		goto out;
+
+	err  = module_load(".", "g711");
+	err |= module_load(".", "ausine");
+	err |= module_load(".", "aubridge");
+	if (err)
+		goto out;
+
+	err = mock_auplay_register(&auplay, baresip_auplayl(),
+				   sample_handler, NULL);
+	if (err)
+		goto out;
+
+	err = bevent_register(event_handler, NULL);
+	if (err)
+		goto out;
+
+	err  = sa_set_str(&dst, "127.0.0.1", 5060);
+	err |= sip_transp_laddr(uag_sip(), &laddr, SIP_TRANSP_UDP, &dst);
+	if (err)
+		goto out;
+
+	snapshot_get(&bench.base);
+
+	err = pairs_alloc(&laddr);
+	if (err)
+		goto out;
+
+	tmr_start(&bench.tmr, SETUP_TIMEOUT, setup_timeout, NULL);
+
+	err = re_main(NULL);
+	if (err)
+		goto out;
+
+	err = bench.err;
+	if (err)
+		goto out;
+
+	err = report();
+
+ out:
+	if (err)
+		warning("bench: failed (%m)\n", err);
+
+	tmr_cancel(&bench.tmr);
+	bevent_unregister(event_handler);
+
+	pairs_close();
+	mem_deref(bench.jitv);
+	mem_deref(bench.latv);
+
+	ua_stop_all(true);
+	ua_close();
+
+	mem_deref(auplay);
+	module_unload("aubridge");
+	module_unload("ausine");
+	module_unload("g711");
+
+	conf_close();
+	baresip_close();
+
+	re_thread_async_close();
+	libre_close();
+
+	return err;
+}
@@ -149,3 +149,158 @@ out:
 	mem_deref(f.ua);
 	return err;
 }
+
+
+struct bus_fixture {
+	unsigned n_handler;
+	unsigned n_app;
+	unsigned n_async;
+	RE_ATOMIC unsigned n_thread;
+	enum bevent_ev last_ev;
+	bool stop;
+	int err;
+};
+
+
+static void bus_sync_handler(const struct bevent_json *bj, void *arg)
+{
+	struct bus_fixture *f = arg;
+
+	if (bj->ec != BEVENT_CLASS_APP ||
+	    !strstr(bj->json, "\"type\":\"EXIT\"") ||
+	    bj->len != str_len(bj->json))
+		f->err = EPROTO;
+
+	/* encoding option of this subscriber */
+	if (0 != strncmp(bj->json, "{\"event\":true,", 14))
+		f->err = EPROTO;
+
+	/* the bus gets the event after the handlers */
+	if (f->n_handler != f->n_app + 1)
+		f->err = EPROTO;
+
+	++f->n_app;
+}
+
+
+static void bus_event_handler(enum bevent_ev ev, struct bevent *event,
+			      void *arg)
+{
+	struct bus_fixture *f = arg;
+
+	if (ev != BEVENT_EXIT)
+		return;
+
+	++f->n_handler;
+
+	/* a stopped event is not published on the bus */
+	if (f->stop)
+		bevent_stop(event);
+}
+
+
+static void bus_async_handler(const struct bevent_json *bj, void *arg)
+{
+	struct bus_fixture *f = arg;
+
+	/* encoded without options */
+	if (strstr(bj->json, "\"event\""))
+		f->err = EPROTO;
+
+	f->last_ev = bj->ev;
+
+	if (++f->n_async == 2)
+		re_cancel();
+}
+
+
+static void bus_thread_handler(const struct bevent_json *bj, void *arg)
+{
+	struct bus_fixture *f = arg;
+	(void)bj;
+
+	re_atomic_rls_add(&f->n_thread, 1);
+}
+
+
+int test_bevent_bus(void)
+{
+	struct bus_fixture f = {0};
+	struct bevent_sub *sub_sync = NULL;
+	struct bevent_sub *sub_async = NULL;
+	struct bevent_sub *sub_thread = NULL;
+	struct ua *ua = NULL;
+	int err;
+
+	err = ua_alloc(&ua, "A <sip:a@127.0.0.1>;regint=0");
+	TEST_ERR(err);
+
+	err = bevent_register(bus_event_handler, &f);
+	TEST_ERR(err);
+
+	err = bevent_sub_alloc(&sub_sync, BEVENT_SUB_SYNC, 0,
+			       bus_sync_handler, &f);
+	TEST_ERR(err);
+	bevent_sub_filter(sub_sync, BEVENT_CLASS_BIT(BEVENT_CLASS_APP),
+			  UINT64_MAX);
+	bevent_sub_set_opts(sub_sync, BEVENT_SUB_OPT_EVENT);
+
+	err = bevent_sub_alloc(&sub_async, BEVENT_SUB_ASYNC, 2,
+			       bus_async_handler, &f);
+	TEST_ERR(err);
+
+	err = bevent_sub_alloc(&sub_thread, BEVENT_SUB_THREAD, 0,
+			       bus_thread_handler, &f);
+	TEST_ERR(err);
+	bevent_sub_filter(sub_thread, UINT32_MAX,
+			  BEVENT_EV_BIT(BEVENT_REGISTER_OK));
+
+	err = bevent_app_emit(BEVENT_EXIT, NULL, "%s", "details");
+	TEST_ERR(err);
+
+	f.stop = true;
+	err = bevent_app_emit(BEVENT_EXIT, NULL, "%s", "stopped");
+	TEST_ERR(err);
+
+	for (int i = 0; i < 3; i++) {
+		err = bevent_ua_emit(BEVENT_REGISTER_OK, ua, NULL);
+		TEST_ERR(err);
+	}
+
+	err = bevent_ua_emit(BEVENT_UNREGISTERING, ua, NULL);
+	TEST_ERR(err);
+
+	/* the sync subscriber got the first app event only */
+	TEST_ERR(f.err);
+	ASSERT_EQ(2, f.n_handler);
+	ASSERT_EQ(1, f.n_app);
+
+	/* the async queue keeps the 2 newest of 5 events */
+	ASSERT_EQ(0, f.n_async);
+	ASSERT_EQ(3, (int)bevent_sub_dropped(sub_async));
+
+	err = re_main_timeout(1000);
+	TEST_ERR(err);
+	TEST_ERR(f.err);
+	ASSERT_EQ(2, f.n_async);
+	ASSERT_EQ(BEVENT_UNREGISTERING, f.last_ev);
+
+	for (int i = 0; i < 1000; i++) {
+		if (re_atomic_acq(&f.n_thread) == 3)
+			break;
+
+		sys_msleep(1);
+	}
+
+	ASSERT_EQ(3, re_atomic_acq(&f.n_thread));
+	ASSERT_EQ(0, (int)bevent_sub_dropped(sub_thread));
+
+ out:
+	bevent_unregister(bus_event_handler);
+	mem_deref(sub_thread);
+	mem_deref(sub_async);
+	mem_deref(sub_sync);
+	mem_deref(ua);
+
+	return err;
+}
@@ -23,6 +23,8 @@
 static int test_call_answer_priv(void)
 {
 	struct fixture fix, *f = &fix;
+	struct call *call;
+	struct pl id;
 	int err = 0;
 
 	fixture_init(f);
@@ -47,6 +49,19 @@ static int test_call_answer_priv(void)
 	ASSERT_EQ(1, fix.b.n_established);
 	ASSERT_EQ(0, fix.b.n_closed);
 
+	/* both calls have the same Call-ID, A was indexed first */
+	call = ua_call(f->a.ua);
+	ASSERT_TRUE(call != NULL);
+	ASSERT_TRUE(call == uag_call_find(call_id(call)));
+
+	pl_set_str(&id, call_id(call));
+	ASSERT_TRUE(call == uag_call_find_pl(&id));
+	ASSERT_TRUE(ua_call(f->b.ua) ==
+		    call_index_find(&id, f->b.ua, NULL, NULL));
+	ASSERT_TRUE(ua_call(f->b.ua) ==
+		    call_index_find_last(&id, NULL, NULL, NULL));
+	ASSERT_TRUE(NULL == uag_call_find("unknown-call-id"));
+
  out:
 	fixture_close(f);
 	return err;
@@ -858,6 +873,42 @@ int test_call_video(void)
 }
 
 
+int test_call_video_txbatch(void)
+{
+	struct config *cfg = conf_config();
+	uint64_t calls0, pkts0;
+	int err;
+
+	txbatch_stats(&calls0, &pkts0);
+
+	cfg->video.txbatch = 8;
+	cfg->video.txgso   = true;
+
+	err = test_call_video();
+	TEST_ERR(err);
+
+#ifdef LINUX
+	{
+		uint64_t calls, pkts;
+
+		/* the video was sent by the batch */
+		txbatch_stats(&calls, &pkts);
+		ASSERT_TRUE(calls > calls0);
+		ASSERT_TRUE(pkts - pkts0 >= calls - calls0);
+	}
+#else
+	(void)calls0;
+	(void)pkts0;
+#endif
+
+ out:
+	cfg->video.txbatch = 0;
+	cfg->video.txgso   = false;
+
+	return err;
+}
+
+
 int test_call_change_videodir(void)
 {
 	struct fixture fix, *f = &fix;
@@ -1444,6 +1495,131 @@ int test_call_format_float(void)
 }
 
 
+int test_call_audio_txpool(void)
+{
+	uint64_t runs0, runs;
+	int err;
+
+	txsched_stats(&runs0, NULL);
+
+	err = module_load(".", "auconv");
+	TEST_ERR(err);
+
+	err = module_load(".", "auresamp");
+	TEST_ERR(err);
+
+	mock_aucodec_register();
+
+	conf_config()->audio.txmode = AUDIO_TX_POOL;
+	conf_config()->audio.txpool = 2;
+
+	err = test_media_base(AUFMT_S16LE, AUFMT_S16LE);
+	TEST_ERR(err);
+
+	/* the audio was encoded by the jobs of the TX pool */
+	txsched_stats(&runs, NULL);
+	ASSERT_TRUE(runs > runs0);
+
+ out:
+	conf_config()->audio.txmode = AUDIO_TX_THREAD;
+
+	mock_aucodec_unregister();
+	module_unload("auresamp");
+	module_unload("auconv");
+
+	return err;
+}
+
+
+int test_call_audio_rxpool(void)
+{
+	struct config *cfg = conf_config();
+	enum rtp_receive_mode rxmode = cfg->avt.rxmode;
+	uint64_t attached0, attached, detached0, detached;
+	int err;
+
+	rxpool_stats(&attached0, &detached0);
+
+	err = module_load(".", "auconv");
+	TEST_ERR(err);
+
+	err = module_load(".", "auresamp");
+	TEST_ERR(err);
+
+	mock_aucodec_register();
+
+	cfg->avt.rxmode = RECEIVE_MODE_POOL;
+	cfg->avt.rxpool = 2;
+
+	err = test_media_base(AUFMT_S16LE, AUFMT_S16LE);
+	TEST_ERR(err);
+
+	/* the RTP sockets of both streams were attached to the pool */
+	rxpool_stats(&attached, &detached);
+	ASSERT_TRUE(attached >= attached0 + 2);
+	ASSERT_EQ((int)(attached - attached0), (int)(detached - detached0));
+
+ out:
+	cfg->avt.rxmode = rxmode;
+
+	mock_aucodec_unregister();
+	module_unload("auresamp");
+	module_unload("auconv");
+
+	return err;
+}
+
+
+int test_call_audio_rxbatch(void)
+{
+	struct config *cfg = conf_config();
+	enum rtp_receive_mode rxmode = cfg->avt.rxmode;
+	uint64_t calls0, pkts0;
+	int err;
+
+	rxbatch_stats(&calls0, &pkts0);
+
+	err = module_load(".", "auconv");
+	TEST_ERR(err);
+
+	err = module_load(".", "auresamp");
+	TEST_ERR(err);
+
+	mock_aucodec_register();
+
+	if (rxmode == RECEIVE_MODE_MAIN)
+		cfg->avt.rxmode = RECEIVE_MODE_THREAD;
+	cfg->avt.rxbatch = 8;
+
+	err = test_media_base(AUFMT_S16LE, AUFMT_S16LE);
+	TEST_ERR(err);
+
+#ifdef LINUX
+	{
+		uint64_t calls, pkts;
+
+		/* the audio was read by the batch, >= 1 packet per call */
+		rxbatch_stats(&calls, &pkts);
+		ASSERT_TRUE(calls > calls0);
+		ASSERT_TRUE(pkts - pkts0 >= calls - calls0);
+	}
+#else
+	(void)calls0;
+	(void)pkts0;
+#endif
+
+ out:
+	cfg->avt.rxmode  = rxmode;
+	cfg->avt.rxbatch = 0;
+
+	mock_aucodec_unregister();
+	module_unload("auresamp");
+	module_unload("auconv");
+
+	return err;
+}
+
+
 static int test_call_mediaenc_param(const char *name, bool rtcp_mux)
 {
 	struct fixture fix = {0}, *f = &fix;
@@ -2016,7 +2192,7 @@ int test_call_webrtc(void)
 	struct sdp_media *sdp_a, *sdp_b;
 	int err;
 
-	if (conf_config()->avt.rxmode == RECEIVE_MODE_THREAD)
+	if (conf_config()->avt.rxmode != RECEIVE_MODE_MAIN)
 		return 0;
 
 	conf_config()->avt.rtcp_mux = true;
@@ -2113,6 +2289,7 @@ static int test_call_bundle_base(bool use_mnat, bool use_menc)
 	struct audio *audiov[2];
 	struct video *videov[2];
 	char *debug_str = NULL;
+	struct pl n_mid;
 	unsigned i;
 	int err;
 
@@ -2235,6 +2412,39 @@ static int test_call_bundle_base(bool use_mnat, bool use_menc)
 		ASSERT_TRUE(stream_is_secure(video_strm(videov[1])));
 	}
 
+	/* verify the SSRC and MID index of the BUNDLE group */
+	for (i=0; i<2; i++) {
+		struct bundle *bun = stream_bundle(video_strm(videov[i]));
+
+		err = re_sdprintf(&debug_str, "%H", bundle_debug, bun);
+		TEST_ERR(err);
+		ASSERT_TRUE(NULL != strstr(debug_str, "index mid:     1\n"));
+		ASSERT_TRUE(NULL != strstr(debug_str, "index ssrc:"));
+		debug_str = mem_deref(debug_str);
+	}
+
+	/* an unknown SSRC is resolved by the MID header extension */
+	bundle_set_ssrc(stream_bundle(video_strm(videov[1])), 0);
+
+	cancel_rule_pop();
+	cancel_rule_new(BEVENT_CUSTOM, f->b.ua, 1, 0, 1);
+	cr->prm = "vidframe";
+	cr->n_vidframe = 3;
+	f->b.n_vidframe = 0;
+
+	err = re_main_timeout(5000);
+	TEST_ERR(err);
+	TEST_ERR(fix.err);
+
+	err = re_sdprintf(&debug_str, "%H", bundle_debug,
+			  stream_bundle(video_strm(videov[1])));
+	TEST_ERR(err);
+	err = re_regex(debug_str, str_len(debug_str),
+		       "resolved:[ ]+[0-9]+ by mid", NULL, &n_mid);
+	TEST_ERR(err);
+	ASSERT_TRUE(pl_u32(&n_mid) >= 1);
+	debug_str = mem_deref(debug_str);
+
 	for (i=0; i<2; i++) {
 
 		err = re_sdprintf(&debug_str, "%H",
@@ -2291,7 +2501,7 @@ int test_call_bundle(void)
 {
 	int err = 0;
 
-	if (conf_config()->avt.rxmode == RECEIVE_MODE_THREAD)
+	if (conf_config()->avt.rxmode != RECEIVE_MODE_MAIN)
 		return 0;
 
 	err = test_call_bundle_base(false, false);
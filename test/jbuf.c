@@ -59,7 +59,7 @@ static uint64_t next_play(const struct jbuf *jb)
 }
 
 
-int test_jbuf(void)
+static int test_jbuf_base(enum jbuf_storage storage)
 {
 	struct jbuf *jb;
 	struct rtp_header hdr = {0};
@@ -71,6 +71,9 @@ int test_jbuf(void)
 	if (err)
 		return err;
 
+	err = jbuf_set_storage(jb, storage);
+	TEST_ERR(err);
+
 	jbuf_set_srate(jb, JBUF_SRATE);
 	jbuf_set_next_play_h(jb, next_play);
 
@@ -181,6 +184,213 @@ int test_jbuf(void)
 }
 
 
+int test_jbuf(void)
+{
+	int err;
+
+	err = test_jbuf_base(JBUF_STORAGE_LIST);
+	TEST_ERR(err);
+
+	err = test_jbuf_base(JBUF_STORAGE_RING);
+	TEST_ERR(err);
+
+ out:
+	return err;
+}
+
+
+int test_jbuf_ring(void)
+{
+	struct jbuf *jb = NULL;
+	struct jbuf_stat stat;
+	char *frv[6] = {NULL};
+	void *mem = NULL;
+	int err;
+
+	/* 4 packets -> ring with 4 slots */
+	err = jbuf_alloc(&jb, 0, 100, 4);
+	TEST_ERR(err);
+
+	err = jbuf_set_storage(jb, JBUF_STORAGE_RING);
+	TEST_ERR(err);
+
+	jbuf_set_srate(jb, JBUF_SRATE);
+	jbuf_set_next_play_h(jb, next_play);
+	next_play_val = 0;
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(frv); i++) {
+		frv[i] = mem_zalloc(32, NULL);
+		if (!frv[i]) {
+			err = ENOMEM;
+			goto out;
+		}
+	}
+
+	/* Out-of-sequence around the sequence number wrap */
+	{
+		static const uint16_t seqv[] = {65534, 0, 65535, 1};
+
+		for (size_t i = 0; i < RE_ARRAY_SIZE(seqv); i++) {
+			struct rtp_header hdr_in = {0};
+
+			hdr_in.seq	 = seqv[i];
+			hdr_in.ts	 = 160 * (uint16_t)(seqv[i] + 2);
+			hdr_in.ts_arrive = hdr_in.ts + 160;
+
+			err = jbuf_put(jb, &hdr_in, frv[i]);
+			TEST_ERR(err);
+		}
+	}
+
+	ASSERT_EQ(4, jbuf_packets(jb));
+
+	/* Duplicate */
+	{
+		struct rtp_header hdr_in = {0};
+
+		hdr_in.seq	 = 0;
+		hdr_in.ts	 = 320;
+		hdr_in.ts_arrive = 480;
+
+		ASSERT_EQ(EALREADY, jbuf_put(jb, &hdr_in, frv[4]));
+	}
+
+	/* Overflow drops the oldest packet (65534) */
+	{
+		struct rtp_header hdr_in = {0};
+
+		hdr_in.seq	 = 2;
+		hdr_in.ts	 = 640;
+		hdr_in.ts_arrive = 800;
+
+		err = jbuf_put(jb, &hdr_in, frv[5]);
+		TEST_ERR(err);
+	}
+
+	ASSERT_EQ(4, jbuf_packets(jb));
+
+	next_play_val = 10000;
+
+	for (uint16_t seq = 65535; seq != 3; seq++) {
+		struct rtp_header hdr_out = {0};
+
+		err = jbuf_get(jb, &hdr_out, &mem);
+		ASSERT_TRUE(err == 0 || err == EAGAIN);
+		ASSERT_EQ(seq, hdr_out.seq);
+		mem = mem_deref(mem);
+	}
+
+	ASSERT_EQ(0, jbuf_packets(jb));
+
+	err = jbuf_stats(jb, &stat);
+	if (err == ENOSYS) {
+		err = 0;
+		goto out;
+	}
+	TEST_ERR(err);
+
+	ASSERT_EQ(1, stat.n_dups);
+	ASSERT_EQ(1, stat.n_overflow);
+	ASSERT_EQ(1, stat.n_oos);
+
+ out:
+	mem_deref(jb);
+	mem_deref(mem);
+	for (size_t i = 0; i < RE_ARRAY_SIZE(frv); i++)
+		mem_deref(frv[i]);
+
+	return err;
+}
+
+
+int test_jbuf_ring_wrap(void)
+{
+	struct jbuf *jb = NULL;
+	struct jbuf_stat stat;
+	char *frv[13] = {NULL};
+	void *mem = NULL;
+	uint16_t seq = 65530;
+	int err;
+
+	err = jbuf_alloc(&jb, 0, 100, 4);
+	TEST_ERR(err);
+
+	err = jbuf_set_storage(jb, JBUF_STORAGE_RING);
+	TEST_ERR(err);
+
+	jbuf_set_srate(jb, JBUF_SRATE);
+	jbuf_set_next_play_h(jb, next_play);
+	next_play_val = 0;
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(frv); i++) {
+		frv[i] = mem_zalloc(32, NULL);
+		if (!frv[i]) {
+			err = ENOMEM;
+			goto out;
+		}
+	}
+
+	/* 12 packets wrap the 4 slots 3 times and the sequence number once */
+	for (size_t i = 0; i < 12; i++, seq++) {
+		struct rtp_header hdr_in = {0};
+
+		hdr_in.seq	 = seq;
+		hdr_in.ts	 = 160 * (uint32_t)(i + 1);
+		hdr_in.ts_arrive = hdr_in.ts + 160;
+
+		err = jbuf_put(jb, &hdr_in, frv[i]);
+		TEST_ERR(err);
+	}
+
+	ASSERT_EQ(4, jbuf_packets(jb));
+
+	/* The slot of seq 0 holds seq 4 now, seq 0 is outside the window */
+	{
+		struct rtp_header hdr_in = {0};
+
+		hdr_in.seq	 = 0;
+		hdr_in.ts	 = 160 * 7;
+		hdr_in.ts_arrive = 160 * 13;
+
+		ASSERT_EQ(ETIMEDOUT, jbuf_put(jb, &hdr_in, frv[12]));
+	}
+
+	ASSERT_EQ(4, jbuf_packets(jb));
+
+	next_play_val = 10000;
+
+	for (seq = 2; seq != 6; seq++) {
+		struct rtp_header hdr_out = {0};
+
+		err = jbuf_get(jb, &hdr_out, &mem);
+		ASSERT_TRUE(err == 0 || err == EAGAIN);
+		ASSERT_EQ(seq, hdr_out.seq);
+		mem = mem_deref(mem);
+	}
+
+	ASSERT_EQ(0, jbuf_packets(jb));
+
+	err = jbuf_stats(jb, &stat);
+	if (err == ENOSYS) {
+		err = 0;
+		goto out;
+	}
+	TEST_ERR(err);
+
+	ASSERT_EQ(8, stat.n_overflow);
+	ASSERT_EQ(1, stat.n_late_lost);
+	ASSERT_EQ(0, stat.n_dups);
+
+ out:
+	mem_deref(jb);
+	mem_deref(mem);
+	for (size_t i = 0; i < RE_ARRAY_SIZE(frv); i++)
+		mem_deref(frv[i]);
+
+	return err;
+}
+
+
 int test_jbuf_adaptive(void)
 {
 	struct jbuf *jb = NULL;
@@ -239,6 +449,104 @@ int test_jbuf_adaptive(void)
 }
 
 
+static int jbuf_put_get(struct jbuf *jb, uint16_t seq, uint32_t delay_ms)
+{
+	struct rtp_header hdr_in = {0}, hdr_out = {0};
+	void *mem = NULL;
+	char *fr;
+	int err;
+
+	fr = mem_zalloc(32, NULL);
+	if (!fr)
+		return ENOMEM;
+
+	hdr_in.seq	 = seq;
+	hdr_in.ts	 = seq * 160;
+	hdr_in.ts_arrive = hdr_in.ts + (20 + delay_ms) * JBUF_SRATE / 1000;
+
+	next_play_val = 0;
+	err = jbuf_put(jb, &hdr_in, fr);
+	if (err)
+		goto out;
+
+	next_play_val = UINT32_MAX;
+	err = jbuf_get(jb, &hdr_out, &mem);
+
+ out:
+	mem_deref(mem);
+	mem_deref(fr);
+
+	return err;
+}
+
+
+int test_jbuf_percentile(void)
+{
+	struct jbuf *jb = NULL;
+	struct jbuf_stat stat;
+	uint16_t seq = 1;
+	int err;
+
+	err = jbuf_alloc(&jb, 0, 500, 50);
+	TEST_ERR(err);
+	err = jbuf_set_type(jb, JBUF_PERCENTILE);
+	TEST_ERR(err);
+
+	ASSERT_EQ(EINVAL, jbuf_set_percentile(jb, 0));
+	ASSERT_EQ(EINVAL, jbuf_set_percentile(jb, 101));
+
+	err = jbuf_set_percentile(jb, 90);
+	TEST_ERR(err);
+
+	jbuf_set_srate(jb, JBUF_SRATE);
+	jbuf_set_next_play_h(jb, next_play);
+
+	/* every 10th frame is 40ms late */
+	for (int i = 0; i < 100; i++) {
+		err = jbuf_put_get(jb, seq++, (i % 10 == 9) ? 40 : 0);
+		TEST_ERR(err);
+	}
+
+	err = jbuf_stats(jb, &stat);
+	if (err == ENOSYS) {
+		err = 0;
+		goto out;
+	}
+	TEST_ERR(err);
+
+	/* 90% of the frames are in the first bucket */
+	ASSERT_EQ(2, (int)stat.c_delay);
+	ASSERT_EQ(90, (int)stat.c_delay_pct);
+
+	/* covering the delay spikes needs a larger delay */
+	err = jbuf_set_percentile(jb, 99);
+	TEST_ERR(err);
+
+	err = jbuf_put_get(jb, seq++, 0);
+	TEST_ERR(err);
+
+	err = jbuf_stats(jb, &stat);
+	TEST_ERR(err);
+	ASSERT_EQ(42, (int)stat.c_delay);
+	ASSERT_EQ(100, (int)stat.c_delay_pct);
+
+	/* the delay shrinks when the spikes have left the window */
+	for (int i = 0; i < 256; i++) {
+		err = jbuf_put_get(jb, seq++, 0);
+		TEST_ERR(err);
+	}
+
+	err = jbuf_stats(jb, &stat);
+	TEST_ERR(err);
+	ASSERT_EQ(2, (int)stat.c_delay);
+
+ out:
+	mem_deref(jb);
+
+	return err;
+}
+
+
 int test_jbuf_video(void)
 {
 	struct jbuf *jb = NULL;
@@ -130,7 +130,7 @@ out:
 }
 
 
-int test_jbuf_gnack(void)
+static int test_jbuf_gnack_base(enum jbuf_storage storage)
 {
 	struct agent a = {.peer = NULL}, b = {.peer = NULL};
 	struct mbuf *mb = NULL;
@@ -153,6 +153,9 @@ int test_jbuf_gnack(void)
 	err = jbuf_set_type(b.jb, JBUF_FIXED);
 	TEST_ERR(err);
 
+	err = jbuf_set_storage(b.jb, storage);
+	TEST_ERR(err);
+
 	jbuf_set_srate(b.jb, 90000);
 
 	jbuf_set_gnack(b.jb, b.rtp_sock);
@@ -189,3 +192,18 @@ out:
 
 	return err;
 }
+
+
+int test_jbuf_gnack(void)
+{
+	int err;
+
+	err = test_jbuf_gnack_base(JBUF_STORAGE_LIST);
+	TEST_ERR(err);
+
+	err = test_jbuf_gnack_base(JBUF_STORAGE_RING);
+	TEST_ERR(err);
+
+out:
+	return err;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file test/log.c  Logging Testcode
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <baresip.h>
+#include "test.h"
+
+
+enum { LOG_MSGS = 200 };
+
+
+static struct {
+	mtx_t *mtx;
+	uint32_t next[2];
+	uint32_t n;
+	uint32_t bad;
+} logt;
+
+
+static void log_handler(uint32_t level, const char *msg)
+{
+	struct pl id, seq;
+	uint32_t i, s;
+	(void)level;
+
+	if (re_regex(msg, strlen(msg), "logtest [0-9]+ [0-9]+",
+		     &id, &seq))
+		return;
+
+	i = pl_u32(&id);
+	s = pl_u32(&seq);
+
+	mtx_lock(logt.mtx);
+
+	/* the messages of one thread must arrive in order */
+	if (i > 1 || s < logt.next[i])
+		++logt.bad;
+	else
+		logt.next[i] = s + 1;
+
+	++logt.n;
+
+	mtx_unlock(logt.mtx);
+}
+
+
+static int log_thread(void *arg)
+{
+	(void)arg;
+
+	for (uint32_t i = 0; i < LOG_MSGS; i++)
+		loglv(LEVEL_ERROR, "logtest 1 %u\n", i);
+
+	return 0;
+}
+
+
+int test_log_async(void)
+{
+	struct log lh = {.h = log_handler};
+	uint64_t drop0, dropped;
+	thrd_t thr;
+	int err;
+
+	memset(&logt, 0, sizeof(logt));
+	drop0 = log_async_dropped();
+
+	err = mutex_alloc(&logt.mtx);
+	TEST_ERR(err);
+
+	log_enable_stdout(false);
+	log_register_handler(&lh);
+
+	err = log_async_start(4096, 64 * 1024);
+	TEST_ERR(err);
+
+	ASSERT_EQ(EALREADY, log_async_start(4096, 64 * 1024));
+
+	err = thread_create_name(&thr, "logtest", log_thread, NULL);
+	TEST_ERR(err);
+
+	for (uint32_t i = 0; i < LOG_MSGS; i++)
+		loglv(LEVEL_ERROR, "logtest 0 %u\n", i);
+
+	thrd_join(thr, NULL);
+
+	dropped = log_async_dropped() - drop0;
+
+	/* all queued messages are written when stopped */
+	log_async_stop();
+
+	ASSERT_EQ(0, (int)logt.bad);
+	ASSERT_EQ(2 * LOG_MSGS, (int)(logt.n + dropped));
+	ASSERT_TRUE(log_async_dropped() - drop0 == dropped);
+
+	/* synchronous logging again */
+	loglv(LEVEL_ERROR, "logtest 0 %u\n", LOG_MSGS);
+	ASSERT_EQ(2 * LOG_MSGS + 1, (int)(logt.n + dropped));
+
+ out:
+	log_async_stop();
+	log_unregister_handler(&lh);
+	log_enable_stdout(true);
+	mem_deref(logt.mtx);
+
+	return err;
+}
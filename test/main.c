@@ -24,11 +24,19 @@ struct test {
 static const struct test tests[] = {
 	TEST(test_account),
 	TEST(test_account_uri_complete),
+	TEST(test_audrift),
+	TEST(test_audsp),
+	TEST(test_aulat),
+	TEST(test_aurecv_plc),
 	TEST(test_ausrc),
+	TEST(test_autsm),
 	TEST(test_call_answer),
 	TEST(test_call_answer_hangup_a),
 	TEST(test_call_answer_hangup_b),
 	TEST(test_call_aulevel),
+	TEST(test_call_audio_txpool),
+	TEST(test_call_audio_rxpool),
+	TEST(test_call_audio_rxbatch),
 	TEST(test_call_custom_headers),
 	TEST(test_call_dtmf),
 	TEST(test_call_format_float),
@@ -48,6 +56,7 @@ static const struct test tests[] = {
 	TEST(test_call_transfer_fail),
 	TEST(test_call_attended_transfer),
 	TEST(test_call_video),
+	TEST(test_call_video_txbatch),
 	TEST(test_call_change_videodir),
 	TEST(test_call_webrtc),
 	TEST(test_call_bundle),
@@ -69,17 +78,26 @@ static const struct test tests[] = {
 	TEST(test_cparam_ua_decode),
 	TEST(test_contact),
 	TEST(test_contact_find_call),
+	TEST(test_bevent_bus),
 	TEST(test_bevent_register),
 	TEST(test_jbuf),
+	TEST(test_jbuf_ring),
+	TEST(test_jbuf_ring_wrap),
 	TEST(test_jbuf_adaptive),
+	TEST(test_jbuf_percentile),
 	TEST(test_jbuf_video),
 	TEST(test_jbuf_gnack),
+	TEST(test_log_async),
 	TEST(test_message),
+	TEST(test_metric),
 	TEST(test_network),
 	TEST(test_peerconn),
 	TEST(test_play),
+	TEST(test_play_cache),
+	TEST(test_spscq),
 	TEST(test_stunuri),
 	TEST(test_ua_alloc),
+	TEST(test_ua_alloc_account),
 	TEST(test_ua_cuser),
 	TEST(test_ua_options),
 	TEST(test_ua_refer),
@@ -87,6 +105,8 @@ static const struct test tests[] = {
 	TEST(test_ua_register_auth),
 	TEST(test_ua_register_auth_dns),
 	TEST(test_ua_register_dns),
+	TEST(test_ua_register_sched),
+	TEST(test_uag_find_index),
 	TEST(test_uag_find_param),
 	TEST(test_video),
 	TEST(test_clean_number),
@@ -265,7 +285,7 @@ static void usage(void)
 			 "options:\n"
 			 "\t-l               List all testcases and exit\n"
 			 "\t-r <rxmode>      RTP RX processing mode "
-			 "[main, thread]\n"
+			 "[main, thread, pool]\n"
 			 "\t-d <path>        Path to data files\n"
 			 "\t-v               Verbose output (INFO level)\n"
 			 );
@@ -0,0 +1,81 @@
+/**
+ * @file test/metric.c  Media metrics Testcode
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <string.h>
+#include <re.h>
+#include <baresip.h>
+#include "../src/core.h"  /* NOTE: temp */
+#include "test.h"
+
+
+enum { METRIC_PACKETS = 100000 };
+
+
+static int sender_thread(void *arg)
+{
+	struct metric *metric = arg;
+
+	for (int i = 0; i < METRIC_PACKETS; i++)
+		metric_add_packet(metric, 100);
+
+	return 0;
+}
+
+
+int test_metric(void)
+{
+	struct metric *metric;
+	char *str = NULL;
+	size_t len;
+	thrd_t thr;
+	int err;
+
+	metric = metric_alloc();
+	ASSERT_TRUE(metric != NULL);
+
+	err = metric_init(metric);
+	TEST_ERR(err);
+
+	ASSERT_EQ(0, (int)metric_n_packets(metric));
+	ASSERT_DOUBLE_EQ(0.0, metric_avg_bitrate(metric), 1e-9);
+
+	/* 64-bit counters do not wrap at 4 GB */
+	metric_add_packet(metric, 3000000000u);
+	metric_add_packet(metric, 3000000000u);
+	metric_inc_err(metric);
+
+	ASSERT_EQ(2, (int)metric_n_packets(metric));
+	ASSERT_TRUE(metric_n_bytes(metric) == 6000000000ull);
+	ASSERT_EQ(1, (int)metric_n_err(metric));
+
+	/* concurrent updates from two threads */
+	err = thread_create_name(&thr, "metric sender", sender_thread,
+				 metric);
+	TEST_ERR(err);
+
+	for (int i = 0; i < METRIC_PACKETS; i++)
+		metric_add_packet(metric, 100);
+
+	thrd_join(thr, NULL);
+
+	ASSERT_EQ(2 + 2 * METRIC_PACKETS, (int)metric_n_packets(metric));
+	ASSERT_TRUE(metric_n_bytes(metric) ==
+		    6000000000ull + 2 * METRIC_PACKETS * 100);
+
+	/* OpenMetrics export */
+	err = re_sdprintf(&str, "%H", metric_print_openmetrics, NULL);
+	TEST_ERR(err);
+
+	len = str_len(str);
+	ASSERT_TRUE(len > 6);
+	ASSERT_TRUE(NULL != strstr(str, "# TYPE baresip_rtp_packets counter"));
+	ASSERT_STREQ("# EOF\n", str + len - 6);
+
+ out:
+	mem_deref(str);
+	mem_deref(metric);
+
+	return err;
+}
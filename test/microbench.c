@@ -0,0 +1,1094 @@
+/**
+ * @file test/microbench.c  Microbenchmarks of the media hot paths
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#ifdef HAVE_GETOPT
+#include <getopt.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <re.h>
+#include <rem.h>
+#include <baresip.h>
+#include "../src/core.h"  /* NOTE: temp */
+
+
+/**
+ * \page Microbench baresip-microbench
+ *
+ * Microbenchmarks of the functions which dominate the media profiles,
+ * each measured in isolation with synthetic input:
+ *
+ *<pre>
+ *   jbuf/inorder        jbuf_put() and jbuf_get(), packets in order
+ *   jbuf/reorder        every pair of packets swapped
+ *   jbuf/lossy          10 % packet loss
+ *   rtpext/decode       RTP header extension parsing of the receiver
+ *   mixminus/encode     read, resample and mix of the conference bridge
+ *   auconv/...          sample format conversion filter
+ *   auresamp/...        resampling filter, 8 kHz <-> 48 kHz
+ *   g711/..., l16/...   encoding and decoding of one packet
+ *   metric/add_packet   RTP packet counters
+ *   bevent/encode       JSON encoding of a call event
+ *</pre>
+ *
+ * The filters and codecs are used through their module interfaces. The
+ * encoder of mixminus needs a conference call, so its steps are run
+ * with the same parameters instead.
+ *
+ * Every benchmark runs in a loop, and the number of iterations is
+ * increased until the loop takes the minimum time. The results are
+ * printed as a table, or as JSON (-j) in the format of Google Benchmark,
+ * so they can be compared with its tools.
+ */
+
+
+enum {
+	DEFAULT_MIN_TIME = 500,        /* [ms] */
+	ITER_MAX         = 1000000000,
+	ASYNC_WORKERS    = 4,
+	PTIME            = 20,         /* [ms] */
+};
+
+
+typedef int (bm_setup_h)(void **statep, const void *arg);
+typedef int (bm_run_h)(void *state, uint64_t iters);
+
+struct bm {
+	const char *name;
+	bm_setup_h *setuph;
+	bm_run_h *runh;
+	const void *arg;
+};
+
+struct result {
+	const char *name;
+	uint64_t iters;
+	double real_ns;    /* Wall clock per iteration [ns] */
+	double cpu_ns;     /* CPU time per iteration [ns]   */
+};
+
+
+static uint64_t min_time_us = DEFAULT_MIN_TIME * 1000;
+
+
+static void fill_samples(int16_t *sampv, size_t sampc)
+{
+	uint32_t seed = 1;
+
+	for (size_t i = 0; i < sampc; i++) {
+		seed = seed * 1103515245 + 12345;
+		sampv[i] = (int16_t)(seed >> 18);
+	}
+}
+
+
+/*
+ * Jitter buffer
+ */
+
+enum jb_pattern {
+	JB_INORDER,
+	JB_REORDER,
+	JB_LOSSY,
+};
+
+enum {
+	JB_SRATE  = 8000,
+	JB_WINDOW = 4,     /* Packets put before draining */
+	JB_LOSS   = 10,    /* One of JB_LOSS packets lost */
+};
+
+static const enum jb_pattern jb_inorder = JB_INORDER;
+static const enum jb_pattern jb_reorder = JB_REORDER;
+static const enum jb_pattern jb_lossy   = JB_LOSSY;
+
+struct jb_state {
+	struct jbuf *jb;
+	void *frame;
+	uint64_t n;
+	enum jb_pattern pat;
+};
+
+static uint32_t jb_play;
+
+
+static uint64_t jb_next_play(const struct jbuf *jb)
+{
+	(void)jb;
+
+	return jb_play;
+}
+
+
+static void jb_destructor(void *arg)
+{
+	struct jb_state *st = arg;
+
+	mem_deref(st->jb);
+	mem_deref(st->frame);
+}
+
+
+static int jb_setup(void **statep, const void *arg)
+{
+	struct jb_state *st;
+	int err;
+
+	st = mem_zalloc(sizeof(*st), jb_destructor);
+	if (!st)
+		return ENOMEM;
+
+	st->pat   = *(const enum jb_pattern *)arg;
+	st->frame = mem_zalloc(160, NULL);
+	if (!st->frame) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	err = jbuf_alloc(&st->jb, 0, 100, 32);
+	if (err)
+		goto out;
+
+	jbuf_set_srate(st->jb, JB_SRATE);
+	jbuf_set_next_play_h(st->jb, jb_next_play);
+
+ out:
+	if (err)
+		mem_deref(st);
+	else
+		*statep = st;
+
+	return err;
+}
+
+
+/*
+ * Put one packet per iteration, and get all packets after every window.
+ * Errors of late or lost packets are part of the measured path.
+ */
+static int jb_run(void *state, uint64_t iters)
+{
+	struct jb_state *st = state;
+	struct rtp_header hdr;
+	void *mem;
+	int err;
+
+	for (uint64_t i = 0; i < iters; i++) {
+
+		const uint64_t n = st->n++;
+		uint64_t k = n;
+
+		if (st->pat == JB_REORDER)
+			k ^= 1;
+
+		if (st->pat != JB_LOSSY || k % JB_LOSS != JB_LOSS / 2) {
+
+			memset(&hdr, 0, sizeof(hdr));
+			hdr.seq       = (uint16_t)(k + 1);
+			hdr.ts        = (uint32_t)(k * 160);
+			hdr.ts_arrive = (n + 1) * 160;
+
+			jb_play = 0;
+			(void)jbuf_put(st->jb, &hdr, st->frame);
+		}
+
+		if (n % JB_WINDOW != JB_WINDOW - 1)
+			continue;
+
+		jb_play = UINT32_MAX;
+
+		do {
+			mem = NULL;
+			err = jbuf_get(st->jb, &hdr, &mem);
+			mem_deref(mem);
+
+		} while (err == 0 || err == EAGAIN);
+	}
+
+	return 0;
+}
+
+
+/*
+ * RTP header extensions, parsed as in the RTP receiver
+ */
+
+struct rtpext_state {
+	struct mbuf *mb;
+};
+
+
+static void rtpext_destructor(void *arg)
+{
+	struct rtpext_state *st = arg;
+
+	mem_deref(st->mb);
+}
+
+
+static int rtpext_setup(void **statep, const void *arg)
+{
+	static const uint8_t level[1] = {0x2a};
+	static const uint8_t abstime[3] = {0x12, 0x34, 0x56};
+	struct rtpext_state *st;
+	int err;
+	(void)arg;
+
+	st = mem_zalloc(sizeof(*st), rtpext_destructor);
+	if (!st)
+		return ENOMEM;
+
+	st->mb = mbuf_alloc(32);
+	if (!st->mb) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	/* audio level, MID and abs-send-time, 12 bytes without padding */
+	err  = rtpext_encode(st->mb, 1, sizeof(level), level);
+	err |= rtpext_encode(st->mb, 2, 5, (const uint8_t *)"audio");
+	err |= rtpext_encode(st->mb, 3, sizeof(abstime), abstime);
+
+ out:
+	if (err)
+		mem_deref(st);
+	else
+		*statep = st;
+
+	return err;
+}
+
+
+static int rtpext_run(void *state, uint64_t iters)
+{
+	struct rtpext_state *st = state;
+	struct rtpext extv[8];
+
+	for (uint64_t i = 0; i < iters; i++) {
+
+		st->mb->pos = 0;
+
+		for (size_t j = 0;
+		     j < RE_ARRAY_SIZE(extv) && mbuf_get_left(st->mb); j++) {
+
+			int err = rtpext_decode(&extv[j], st->mb);
+			if (err)
+				return err;
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ * Mixminus encoder: read the mix of the bridge, resample it to the
+ * sample rate of the call and add it to the frame.
+ */
+
+enum {
+	MIX_SRATE  = 16000,
+	MIX_BRIDGE = 48000,
+	MIX_SAMPC  = MIX_SRATE  * PTIME / 1000,
+	MIX_BSAMPC = MIX_BRIDGE * PTIME / 1000,
+};
+
+struct mix_state {
+	struct aubuf *ab;
+	struct auresamp resamp;
+	int16_t srcv[MIX_BSAMPC];
+	int16_t bsampv[MIX_BSAMPC];
+	int16_t rsampv[MIX_SAMPC];
+	int16_t sampv[MIX_SAMPC];
+};
+
+
+static void mix_destructor(void *arg)
+{
+	struct mix_state *st = arg;
+
+	mem_deref(st->ab);
+}
+
+
+static int mix_setup(void **statep, const void *arg)
+{
+	struct mix_state *st;
+	int err;
+	(void)arg;
+
+	st = mem_zalloc(sizeof(*st), mix_destructor);
+	if (!st)
+		return ENOMEM;
+
+	fill_samples(st->srcv, MIX_BSAMPC);
+	fill_samples(st->sampv, MIX_SAMPC);
+
+	err = aubuf_alloc(&st->ab, 0, 4 * sizeof(st->srcv));
+	if (err)
+		goto out;
+
+	auresamp_init(&st->resamp);
+
+	err = auresamp_setup(&st->resamp, MIX_BRIDGE, 1, MIX_SRATE, 1);
+
+ out:
+	if (err)
+		mem_deref(st);
+	else
+		*statep = st;
+
+	return err;
+}
+
+
+static int mix_run(void *state, uint64_t iters)
+{
+	struct mix_state *st = state;
+
+	for (uint64_t i = 0; i < iters; i++) {
+
+		size_t outc = MIX_SAMPC;
+		int err;
+
+		aubuf_write_samp(st->ab, st->srcv, MIX_BSAMPC);
+		aubuf_read_samp(st->ab, st->bsampv, MIX_BSAMPC);
+
+		err = auresamp(&st->resamp, st->rsampv, &outc,
+			       st->bsampv, MIX_BSAMPC);
+		if (err)
+			return err;
+
+		audsp_add_s16(st->sampv, st->rsampv, outc);
+	}
+
+	return 0;
+}
+
+
+/*
+ * Audio filters
+ */
+
+struct filt_prm {
+	const char *name;
+	bool enc;              /* Encoder or decoder         */
+	uint32_t srate;        /* Input sample rate [Hz]     */
+	int fmt;               /* Input sample format        */
+	struct aufilt_prm oprm;
+};
+
+static const struct filt_prm auconv_enc = {
+	"auconv", true, 48000, AUFMT_S16LE, {48000, 1, AUFMT_FLOAT}
+};
+static const struct filt_prm auconv_dec = {
+	"auconv", false, 48000, AUFMT_FLOAT, {48000, 1, AUFMT_S16LE}
+};
+static const struct filt_prm auresamp_up = {
+	"auresamp", true, 8000, AUFMT_S16LE, {48000, 1, AUFMT_S16LE}
+};
+static const struct filt_prm auresamp_down = {
+	"auresamp", false, 48000, AUFMT_S16LE, {8000, 1, AUFMT_S16LE}
+};
+
+struct filt_state {
+	const struct aufilt *af;
+	struct aufilt_enc_st *enc;
+	struct aufilt_dec_st *dec;
+	void *ctx;
+	void *sampv;
+	struct auframe frame;
+};
+
+
+static const struct aufilt *aufilt_find(const char *name)
+{
+	struct le *le;
+
+	for (le = list_head(baresip_aufiltl()); le; le = le->next) {
+
+		const struct aufilt *af = le->data;
+
+		if (0 == str_casecmp(af->name, name))
+			return af;
+	}
+
+	return NULL;
+}
+
+
+static void filt_destructor(void *arg)
+{
+	struct filt_state *st = arg;
+
+	mem_deref(st->enc);
+	mem_deref(st->dec);
+	mem_deref(st->ctx);
+	mem_deref(st->sampv);
+}
+
+
+static int filt_setup(void **statep, const void *arg)
+{
+	const struct filt_prm *prm = arg;
+	struct config_audio *cfg = &conf_config()->audio;
+	const enum aufmt enc_fmt  = cfg->enc_fmt;
+	const enum aufmt play_fmt = cfg->play_fmt;
+	struct aufilt_prm oprm = prm->oprm;
+	struct filt_state *st;
+	size_t sampc;
+	int err;
+
+	st = mem_zalloc(sizeof(*st), filt_destructor);
+	if (!st)
+		return ENOMEM;
+
+	st->af = aufilt_find(prm->name);
+	if (!st->af) {
+		err = ENOENT;
+		goto out;
+	}
+
+	sampc     = prm->srate * PTIME / 1000;
+	st->sampv = mem_zalloc(sampc * aufmt_sample_size(prm->fmt), NULL);
+	if (!st->sampv) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	if (prm->fmt == AUFMT_S16LE)
+		fill_samples(st->sampv, sampc);
+
+	auframe_init(&st->frame, prm->fmt, st->sampv, sampc, prm->srate, 1);
+
+	/* auconv converts to the configured sample formats */
+	cfg->enc_fmt  = prm->oprm.fmt;
+	cfg->play_fmt = prm->oprm.fmt;
+
+	if (prm->enc)
+		err = st->af->encupdh(&st->enc, &st->ctx, st->af, &oprm, NULL);
+	else
+		err = st->af->decupdh(&st->dec, &st->ctx, st->af, &oprm, NULL);
+
+	cfg->enc_fmt  = enc_fmt;
+	cfg->play_fmt = play_fmt;
+
+ out:
+	if (err)
+		mem_deref(st);
+	else
+		*statep = st;
+
+	return err;
+}
+
+
+static int filt_run(void *state, uint64_t iters)
+{
+	struct filt_state *st = state;
+
+	for (uint64_t i = 0; i < iters; i++) {
+
+		struct auframe af = st->frame;
+		int err;
+
+		if (st->enc)
+			err = st->af->ench(st->enc, &af);
+		else
+			err = st->af->dech(st->dec, &af);
+
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+
+/*
+ * Audio codecs
+ */
+
+struct codec_prm {
+	const char *name;
+	uint32_t srate;
+	uint8_t ch;
+};
+
+static const struct codec_prm pcmu = {"PCMU", 8000, 1};
+static const struct codec_prm pcma = {"PCMA", 8000, 1};
+static const struct codec_prm l16  = {"L16", 48000, 2};
+
+struct codec_state {
+	const struct aucodec *ac;
+	struct auenc_state *enc;
+	struct audec_state *dec;
+	int16_t *sampv;
+	size_t sampc;
+	uint8_t *buf;
+	size_t bufsz;
+	size_t len;        /* Length of the encoded packet */
+};
+
+
+static void codec_destructor(void *arg)
+{
+	struct codec_state *st = arg;
+
+	mem_deref(st->enc);
+	mem_deref(st->dec);
+	mem_deref(st->sampv);
+	mem_deref(st->buf);
+}
+
+
+static int codec_setup(void **statep, const void *arg)
+{
+	const struct codec_prm *prm = arg;
+	struct auenc_param eprm = {0};
+	struct codec_state *st;
+	bool marker = false;
+	int err;
+
+	st = mem_zalloc(sizeof(*st), codec_destructor);
+	if (!st)
+		return ENOMEM;
+
+	st->ac = aucodec_find(baresip_aucodecl(), prm->name, prm->srate,
+			      prm->ch);
+	if (!st->ac) {
+		err = ENOENT;
+		goto out;
+	}
+
+	st->sampc = prm->srate * prm->ch * PTIME / 1000;
+	st->bufsz = st->sampc * sizeof(int16_t);
+	st->sampv = mem_zalloc(st->sampc * sizeof(int16_t), NULL);
+	st->buf   = mem_zalloc(st->bufsz, NULL);
+	if (!st->sampv || !st->buf) {
+		err = ENOMEM;
+		goto out;
+	}
+
+	fill_samples(st->sampv, st->sampc);
+
+	if (st->ac->encupdh) {
+		err = st->ac->encupdh(&st->enc, st->ac, &eprm, NULL);
+		if (err)
+			goto out;
+	}
+
+	if (st->ac->decupdh) {
+		err = st->ac->decupdh(&st->dec, st->ac, NULL);
+		if (err)
+			goto out;
+	}
+
+	/* one packet for the decoder */
+	st->len = st->bufsz;
+	err = st->ac->ench(st->enc, &marker, st->buf, &st->len,
+			   AUFMT_S16LE, st->sampv, st->sampc);
+
+ out:
+	if (err)
+		mem_deref(st);
+	else
+		*statep = st;
+
+	return err;
+}
+
+
+static int codec_enc_run(void *state, uint64_t iters)
+{
+	struct codec_state *st = state;
+	bool marker = false;
+
+	for (uint64_t i = 0; i < iters; i++) {
+
+		size_t len = st->bufsz;
+		int err;
+
+		err = st->ac->ench(st->enc, &marker, st->buf, &len,
+				   AUFMT_S16LE, st->sampv, st->sampc);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+
+static int codec_dec_run(void *state, uint64_t iters)
+{
+	struct codec_state *st = state;
+
+	for (uint64_t i = 0; i < iters; i++) {
+
+		size_t sampc = st->sampc;
+		int err;
+
+		err = st->ac->dech(st->dec, AUFMT_S16LE, st->sampv, &sampc,
+				   false, st->buf, st->len);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+
+/*
+ * RTP metrics
+ */
+
+static int metric_setup(void **statep, const void *arg)
+{
+	struct metric *metric;
+	(void)arg;
+
+	metric = metric_alloc();
+	if (!metric)
+		return ENOMEM;
+
+	*statep = metric;
+
+	return 0;
+}
+
+
+static int metric_run(void *state, uint64_t iters)
+{
+	struct metric *metric = state;
+
+	for (uint64_t i = 0; i < iters; i++)
+		metric_add_packet(metric, 172);
+
+	return 0;
+}
+
+
+/*
+ * Events, encoded in the event handler of an emitted call event
+ */
+
+struct bev_state {
+	struct ua *ua;
+	struct call *call;
+	uint64_t iters;
+	int err;
+};
+
+
+static void bev_handler(enum bevent_ev ev, struct bevent *event, void *arg)
+{
+	struct bev_state *st = arg;
+	(void)ev;
+
+	for (; st->iters; st->iters--) {
+
+		struct odict *od;
+
+		st->err = odict_alloc(&od, 16);
+		if (st->err)
+			return;
+
+		st->err = bevent_odict_encode(od, event);
+		mem_deref(od);
+		if (st->err)
+			return;
+	}
+}
+
+
+static void bev_destructor(void *arg)
+{
+	struct bev_state *st = arg;
+
+	bevent_unregister(bev_handler);
+	mem_deref(st->call);
+	mem_deref(st->ua);
+}
+
+
+static int bev_setup(void **statep, const void *arg)
+{
+	struct bev_state *st;
+	int err;
+	(void)arg;
+
+	st = mem_zalloc(sizeof(*st), bev_destructor);
+	if (!st)
+		return ENOMEM;
+
+	err = ua_alloc(&st->ua, "A <sip:a@127.0.0.1>;regint=0");
+	if (err)
+		goto out;
+
+	err = ua_call_alloc(&st->call, st->ua, VIDMODE_OFF, NULL, NULL, NULL,
+			    false);
+	if (err)
+		goto out;
+
+	err = bevent_register(bev_handler, st);
+
+ out:
+	if (err)
+		mem_deref(st);
+	else
+		*statep = st;
+
+	return err;
+}
+
+
+static int bev_run(void *state, uint64_t iters)
+{
+	struct bev_state *st = state;
+	int err;
+
+	st->iters = iters;
+	st->err   = 0;
+
+	err = bevent_call_emit(BEVENT_CALL_INCOMING, st->call, "%s",
+			       "microbench");
+	st->iters = 0;
+
+	return err ? err : st->err;
+}
+
+
+static const struct bm bmv[] = {
+	{"jbuf/inorder",      jb_setup,     jb_run,        &jb_inorder   },
+	{"jbuf/reorder",      jb_setup,     jb_run,        &jb_reorder   },
+	{"jbuf/lossy",        jb_setup,     jb_run,        &jb_lossy     },
+	{"rtpext/decode",     rtpext_setup, rtpext_run,    NULL          },
+	{"mixminus/encode",   mix_setup,    mix_run,       NULL          },
+	{"auconv/s16_float",  filt_setup,   filt_run,      &auconv_enc   },
+	{"auconv/float_s16",  filt_setup,   filt_run,      &auconv_dec   },
+	{"auresamp/8k_48k",   filt_setup,   filt_run,      &auresamp_up  },
+	{"auresamp/48k_8k",   filt_setup,   filt_run,      &auresamp_down},
+	{"g711/pcmu_encode",  codec_setup,  codec_enc_run, &pcmu         },
+	{"g711/pcmu_decode",  codec_setup,  codec_dec_run, &pcmu         },
+	{"g711/pcma_encode",  codec_setup,  codec_enc_run, &pcma         },
+	{"g711/pcma_decode",  codec_setup,  codec_dec_run, &pcma         },
+	{"l16/encode",        codec_setup,  codec_enc_run, &l16          },
+	{"l16/decode",        codec_setup,  codec_dec_run, &l16          },
+	{"metric/add_packet", metric_setup, metric_run,    NULL          },
+	{"bevent/encode",     bev_setup,    bev_run,       NULL          },
+};
+
+
+/*
+ * Run the benchmark with an increasing number of iterations, until
+ * it takes at least the minimum time.
+ */
+static int bm_measure(const struct bm *bm, struct result *res)
+{
+	void *state = NULL;
+	uint64_t iters = 1;
+	int err;
+
+	err = bm->setuph(&state, bm->arg);
+	if (err)
+		return err;
+
+	/* warm-up */
+	err = bm->runh(state, 1);
+	if (err)
+		goto out;
+
+	for (;;) {
+		const uint64_t t0 = tmr_jiffies_usec();
+		const clock_t c0 = clock();
+		uint64_t t;
+		clock_t c;
+		double mult;
+
+		err = bm->runh(state, iters);
+		if (err)
+			goto out;
+
+		c = clock();
+		t = tmr_jiffies_usec();
+
+		t -= t0;
+		c -= c0;
+
+		if (t >= min_time_us || iters >= ITER_MAX) {
+
+			res->name    = bm->name;
+			res->iters   = iters;
+			res->real_ns = (double)t * 1000 / (double)iters;
+			res->cpu_ns  = (double)c * 1e9 / CLOCKS_PER_SEC /
+				(double)iters;
+			break;
+		}
+
+		/* aim a bit higher than the minimum, but at most 10x */
+		mult = t ? 1.4 * (double)min_time_us / (double)t : 10;
+		if (mult > 10)
+			mult = 10;
+		else if (mult < 2)
+			mult = 2;
+
+		iters = min((uint64_t)((double)iters * mult),
+			    (uint64_t)ITER_MAX);
+	}
+
+ out:
+	mem_deref(state);
+
+	return err;
+}
+
+
+static int print_text(const struct result *resv, size_t n)
+{
+	int err;
+
+	err  = re_printf("\nbaresip-microbench %s (audsp %s)\n\n",
+			 baresip_version(), audsp_isa_name(audsp_isa()));
+	err |= re_printf("%-24s %14s %14s %12s\n",
+			 "Benchmark", "Time", "CPU", "Iterations");
+	err |= re_printf("----------------------------------------"
+			 "--------------------------\n");
+
+	for (size_t i = 0; i < n; i++) {
+		err |= re_printf("%-24s %11.1f ns %11.1f ns %12llu\n",
+				 resv[i].name, resv[i].real_ns,
+				 resv[i].cpu_ns, resv[i].iters);
+	}
+
+	return err;
+}
+
+
+static int print_json(const char *exe, const struct result *resv,
+		      size_t n)
+{
+	struct odict *od = NULL, *ctx = NULL, *arr = NULL;
+	int err;
+
+	err  = odict_alloc(&od, 4);
+	err |= odict_alloc(&ctx, 8);
+	err |= odict_alloc(&arr, 32);
+	if (err)
+		goto out;
+
+	err  = odict_entry_add(ctx, "executable", ODICT_STRING, exe);
+	err |= odict_entry_add(ctx, "library_version", ODICT_STRING,
+			       baresip_version());
+	err |= odict_entry_add(ctx, "audsp_isa", ODICT_STRING,
+			       audsp_isa_name(audsp_isa()));
+	err |= odict_entry_add(ctx, "min_time_ms", ODICT_INT,
+			       (int64_t)(min_time_us / 1000));
+	if (err)
+		goto out;
+
+	for (size_t i = 0; i < n; i++) {
+
+		struct odict *b;
+
+		err = odict_alloc(&b, 8);
+		if (err)
+			goto out;
+
+		err  = odict_entry_add(b, "name", ODICT_STRING, resv[i].name);
+		err |= odict_entry_add(b, "run_name", ODICT_STRING,
+				       resv[i].name);
+		err |= odict_entry_add(b, "run_type", ODICT_STRING,
+				       "iteration");
+		err |= odict_entry_add(b, "iterations", ODICT_INT,
+				       (int64_t)resv[i].iters);
+		err |= odict_entry_add(b, "real_time", ODICT_DOUBLE,
+				       resv[i].real_ns);
+		err |= odict_entry_add(b, "cpu_time", ODICT_DOUBLE,
+				       resv[i].cpu_ns);
+		err |= odict_entry_add(b, "time_unit", ODICT_STRING, "ns");
+		if (!err)
+			err = odict_entry_add(arr, resv[i].name,
+					      ODICT_OBJECT, b);
+
+		mem_deref(b);
+		if (err)
+			goto out;
+	}
+
+	err  = odict_entry_add(od, "context", ODICT_OBJECT, ctx);
+	err |= odict_entry_add(od, "benchmarks", ODICT_ARRAY, arr);
+	if (err)
+		goto out;
+
+	err = re_printf("%H\n", json_encode_odict, od);
+
+ out:
+	mem_deref(arr);
+	mem_deref(ctx);
+	mem_deref(od);
+
+	return err;
+}
+
+
+static int set_isa(const char *name)
+{
+	for (int isa = AUDSP_SCALAR; isa <= AUDSP_NEON; isa++) {
+
+		if (0 == str_casecmp(name, audsp_isa_name(isa)))
+			return audsp_set_isa(isa);
+	}
+
+	return EINVAL;
+}
+
+
+static void usage(void)
+{
+	(void)re_fprintf(stderr,
+			 "Usage: baresip-microbench [options]\n"
+			 "options:\n"
+			 "\t-f <filter>      Run matching benchmarks\n"
+			 "\t-m <ms>          Min. time per benchmark"
+			 " (default %u)\n"
+			 "\t-i <isa>         Audio DSP kernels "
+			 "[scalar, sse2, avx2, neon]\n"
+			 "\t-j               JSON output\n"
+			 "\t-l               List benchmarks\n"
+			 "\t-v               Verbose output (INFO level)\n",
+			 DEFAULT_MIN_TIME);
+}
+
+
+int main(int argc, char *argv[])
+{
+	struct result resv[RE_ARRAY_SIZE(bmv)];
+	struct config *config;
+	const char *filter = NULL;
+	const char *isa = NULL;
+	bool json = false;
+	struct sa sa;
+	size_t n = 0;
+	int err;
+
+	err = libre_init();
+	if (err)
+		return err;
+
+	log_enable_info(false);
+	re_thread_async_init(ASYNC_WORKERS);
+
+#ifdef HAVE_GETOPT
+	for (;;) {
+		const int c = getopt(argc, argv, "hjlvf:m:i:");
+		if (0 > c)
+			break;
+
+		switch (c) {
+
+		case 'f':
+			filter = optarg;
+			break;
+
+		case 'i':
+			isa = optarg;
+			break;
+
+		case 'j':
+			json = true;
+			break;
+
+		case 'l':
+			for (size_t i = 0; i < RE_ARRAY_SIZE(bmv); i++)
+				re_printf("%s\n", bmv[i].name);
+			return 0;
+
+		case 'm':
+			min_time_us = (uint64_t)atoi(optarg) * 1000;
+			break;
+
+		case 'v':
+			log_enable_info(true);
+			break;
+
+		case '?':
+		case 'h':
+		default:
+			usage();
+			return -2;
+		}
+	}
+#else
+	(void)argc;
+#endif
+
+	config = conf_config();
+
+	err = baresip_init(config);
+	err |= sa_set_str(&sa, "127.0.0.1", 0);
+	err |= net_add_address(baresip_network(), &sa);
+	if (err)
+		goto out;
+
+	/* note: run SIP-traffic on localhost */
+	str_ncpy(config->sip.local, "0.0.0.0:0", sizeof(config->sip.local));
+
+	if (isa) {
+		err = set_isa(isa);
+		if (err) {
+			warning("microbench: unsupported isa: %s\n", isa);
+			goto out;
+		}
+	}
+
+	err = ua_init("baresip-microbench", true, false, false);
+	if (err)
+		goto out;
+
+	err  = module_load(".", "g711");
+	err |= module_load(".", "l16");
+	err |= module_load(".", "auconv");
+	err |= module_load(".", "auresamp");
+	if (err)
+		goto out;
+
+	for (size_t i = 0; i < RE_ARRAY_SIZE(bmv); i++) {
+
+		if (filter && !strstr(bmv[i].name, filter))
+			continue;
+
+		err = bm_measure(&bmv[i], &resv[n]);
+		if (err) {
+			warning("microbench: %s failed (%m)\n",
+				bmv[i].name, err);
+			goto out;
+		}
+
+		++n;
+	}
+
+	if (json)
+		err = print_json(argv[0], resv, n);
+	else
+		err = print_text(resv, n);
+
+ out:
+	ua_stop_all(true);
+	ua_close();
+
+	module_unload("auresamp");
+	module_unload("auconv");
+	module_unload("l16");
+	module_unload("g711");
+
+	conf_close();
+	baresip_close();
+
+	re_thread_async_close();
+	libre_close();
+
+	return err;
+}
@@ -498,7 +498,7 @@ int test_peerconn(void)
 	if (!have_real_ip)
 		return 0;
 
-	if (conf_config()->avt.rxmode == RECEIVE_MODE_THREAD)
+	if (conf_config()->avt.rxmode != RECEIVE_MODE_MAIN)
 		return 0;
 
 	err = module_load(".", "dtls_srtp");
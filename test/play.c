@@ -105,3 +105,99 @@ int test_play(void)
 	mem_deref(auplay);
 	return err;
 }
+
+
+static int load_samples(struct mbuf *mb, const char *path, size_t n)
+{
+	struct aufile_prm prm;
+	struct aufile *af;
+	uint8_t buf[NUM_SAMPLES*2];
+	size_t sz = n * 2;
+	int err;
+
+	err = aufile_open(&af, &prm, path, AUFILE_READ);
+	if (err)
+		return err;
+
+	if (prm.fmt != AUFMT_S16LE) {
+		err = EINVAL;
+		goto out;
+	}
+
+	err = aufile_read(af, buf, &sz);
+	if (err)
+		goto out;
+
+	for (size_t i = 0; i < sz / 2; i++) {
+		int16_t s = sys_ltohs(((int16_t *)(void *)buf)[i]);
+		err |= mbuf_write_u16(mb, s);
+	}
+
+ out:
+	mem_deref(af);
+
+	return err;
+}
+
+
+int test_play_cache(void)
+{
+	struct auplay *auplay = NULL;
+	struct player *player = NULL;
+	struct play *play = NULL;
+	struct mbuf *mb_ref = NULL;
+	struct test test = {0};
+	char path[256];
+	int err;
+
+	err = mock_auplay_register(&auplay, baresip_auplayl(),
+				   auframe_handler, &test);
+	TEST_ERR(err);
+
+	err = play_init(&player);
+	TEST_ERR(err);
+
+	re_snprintf(path, sizeof(path), "%s/wav", test_datapath());
+	play_set_path(player, path);
+
+	err = play_preload(player, "square_1kHz_0.4.wav");
+	TEST_ERR(err);
+
+	err = play_preload(player, "not_existing.wav");
+	ASSERT_EQ(ENOENT, err);
+
+	mb_ref = mbuf_alloc(NUM_SAMPLES * 2);
+	ASSERT_TRUE(mb_ref != NULL);
+
+	re_snprintf(path, sizeof(path), "%s/wav/square_1kHz_0.4.wav",
+		    test_datapath());
+	err = load_samples(mb_ref, path, NUM_SAMPLES);
+	TEST_ERR(err);
+
+	/* play the cached file twice, both must start from the beginning */
+	for (int i = 0; i < 2; i++) {
+
+		test.mb_samp = mem_deref(test.mb_samp);
+
+		err = play_file(&play, player, "square_1kHz_0.4.wav", 1,
+				NULL, NULL);
+		TEST_ERR(err);
+
+		err = re_main_timeout(10000);
+		TEST_ERR(err);
+
+		TEST_MEMCMP(mb_ref->buf, mb_ref->end,
+			    test.mb_samp->buf, mb_ref->end);
+
+		play = mem_deref(play);
+	}
+
+ out:
+	mem_deref(test.mb_samp);
+	mem_deref(mb_ref);
+	mem_deref(play);
+	mem_deref(player);
+	mem_deref(auplay);
+
+	return err;
+}
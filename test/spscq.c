@@ -0,0 +1,111 @@
+/**
+ * @file test/spscq.c  Lock-free SPSC queue Testcode
+ *
+ * Copyright (C) 2025 Alfred E. Heggestad
+ */
+#include <re.h>
+#include <baresip.h>
+#include "../src/core.h"  /* NOTE: temp */
+#include "test.h"
+
+
+enum { SPSCQ_ITEMS = 100000 };
+
+
+struct item {
+	uint32_t seq;
+	uint8_t pad[12];
+};
+
+
+static int producer_thread(void *arg)
+{
+	struct spscq *q = arg;
+	struct item it = {0};
+
+	while (it.seq < SPSCQ_ITEMS) {
+		if (spscq_push(q, &it)) {
+			thrd_yield();
+			continue;
+		}
+
+		++it.seq;
+	}
+
+	return 0;
+}
+
+
+int test_spscq(void)
+{
+	struct spscq *q = NULL;
+	struct item it = {0};
+	thrd_t thr;
+	uint32_t seq, bad = 0;
+	int err;
+
+	err = spscq_alloc(&q, 3, sizeof(struct item));
+	TEST_ERR(err);
+
+	/* empty */
+	ASSERT_EQ(0, (int)spscq_count(q));
+	ASSERT_EQ(ENOENT, spscq_pop(q, &it));
+
+	/* capacity is rounded up to a power of two */
+	for (seq = 0; seq < 4; seq++) {
+		it.seq = seq;
+		err = spscq_push(q, &it);
+		TEST_ERR(err);
+	}
+
+	ASSERT_EQ(4, (int)spscq_count(q));
+	ASSERT_EQ(ENOSPC, spscq_push(q, &it));
+
+	/* FIFO order, also across wrap-around */
+	for (seq = 0; seq < 2; seq++) {
+		err = spscq_pop(q, &it);
+		TEST_ERR(err);
+		ASSERT_EQ((int)seq, (int)it.seq);
+	}
+
+	for (seq = 4; seq < 6; seq++) {
+		it.seq = seq;
+		err = spscq_push(q, &it);
+		TEST_ERR(err);
+	}
+
+	for (seq = 2; seq < 6; seq++) {
+		err = spscq_pop(q, &it);
+		TEST_ERR(err);
+		ASSERT_EQ((int)seq, (int)it.seq);
+	}
+
+	ASSERT_EQ(ENOENT, spscq_pop(q, &it));
+
+	/* one producer thread, one consumer thread */
+	err = thread_create_name(&thr, "spscq producer", producer_thread, q);
+	TEST_ERR(err);
+
+	for (seq = 0; seq < SPSCQ_ITEMS;) {
+		if (spscq_pop(q, &it)) {
+			thrd_yield();
+			continue;
+		}
+
+		if (it.seq != seq)
+			++bad;
+
+		++seq;
+	}
+
+	thrd_join(thr, NULL);
+
+	ASSERT_EQ(0, (int)bad);
+
+	ASSERT_EQ(0, (int)spscq_count(q));
+
+ out:
+	mem_deref(q);
+
+	return err;
+}
@@ -197,11 +197,19 @@ int mock_vidisp_register(struct vidisp **vidispp,
 
 int test_account(void);
 int test_account_uri_complete(void);
+int test_audrift(void);
+int test_audsp(void);
+int test_aulat(void);
+int test_aurecv_plc(void);
 int test_ausrc(void);
+int test_autsm(void);
 int test_call_answer(void);
 int test_call_answer_hangup_a(void);
 int test_call_answer_hangup_b(void);
 int test_call_aulevel(void);
+int test_call_audio_txpool(void);
+int test_call_audio_rxpool(void);
+int test_call_audio_rxbatch(void);
 int test_call_custom_headers(void);
 int test_call_dtmf(void);
 int test_call_format_float(void);
@@ -221,6 +229,7 @@ int test_call_transfer(void);
 int test_call_transfer_fail(void);
 int test_call_attended_transfer(void);
 int test_call_video(void);
+int test_call_video_txbatch(void);
 int test_call_change_videodir(void);
 int test_call_webrtc(void);
 int test_call_bundle(void);
@@ -242,17 +251,26 @@ int test_cparam_call_decode(void);
 int test_cparam_ua_decode(void);
 int test_contact(void);
 int test_contact_find_call(void);
+int test_bevent_bus(void);
 int test_bevent_register(void);
 int test_jbuf(void);
+int test_jbuf_ring(void);
+int test_jbuf_ring_wrap(void);
 int test_jbuf_adaptive(void);
+int test_jbuf_percentile(void);
 int test_jbuf_video(void);
 int test_jbuf_gnack(void);
+int test_log_async(void);
 int test_message(void);
+int test_metric(void);
 int test_network(void);
 int test_peerconn(void);
 int test_play(void);
+int test_play_cache(void);
+int test_spscq(void);
 int test_stunuri(void);
 int test_ua_alloc(void);
+int test_ua_alloc_account(void);
 int test_ua_cuser(void);
 int test_ua_options(void);
 int test_ua_refer(void);
@@ -260,6 +278,8 @@ int test_ua_register(void);
 int test_ua_register_auth(void);
 int test_ua_register_auth_dns(void);
 int test_ua_register_dns(void);
+int test_ua_register_sched(void);
+int test_uag_find_index(void);
 int test_uag_find_param(void);
 int test_video(void);
 int test_clean_number(void);
@@ -8,6 +8,7 @@
 #include <baresip.h>
 #include "test.h"
 #include "sip/sipsrv.h"
+#include "../src/core.h"  /* NOTE: temp */
 
 
 #define MAGIC 0x9044bbfc
@@ -224,6 +225,43 @@ int test_ua_alloc(void)
 }
 
 
+int test_ua_alloc_account(void)
+{
+	struct account *acc = NULL;
+	struct ua *ua = NULL;
+	int err;
+
+	err = account_alloc(&acc, "<sip:carol@test.invalid>;regint=0"
+			    ";audio_codecs=pcmu");
+	TEST_ERR(err);
+
+	err = module_load(".", "g711");
+	TEST_ERR(err);
+
+	err = ua_alloc_account(&ua, acc);
+	TEST_ERR(err);
+
+	ASSERT_TRUE(acc == ua_account(ua));
+	ASSERT_TRUE(ua == uag_find_aor("sip:carol@test.invalid"));
+	ASSERT_STREQ("carol", ua_cuser(ua));
+
+	/* the codec list is decoded on first use */
+	ASSERT_EQ(1, list_count(account_aucodecl(acc)));
+
+	/* the User-Agent holds its own reference */
+	acc = mem_deref(acc);
+	ASSERT_STREQ("sip:carol@test.invalid",
+		     account_aor(ua_account(ua)));
+
+ out:
+	mem_deref(ua);
+	mem_deref(acc);
+	module_unload("g711");
+
+	return err;
+}
+
+
 int test_uag_find_param(void)
 {
 	struct ua *ua1 = NULL, *ua2 = NULL;
@@ -251,6 +289,61 @@ int test_uag_find_param(void)
 }
 
 
+int test_uag_find_index(void)
+{
+	struct ua *ua1 = NULL, *ua2 = NULL, *ua3 = NULL;
+	struct pl pl;
+	int err = 0;
+
+	err  = ua_alloc(&ua1, "<sip:alice@a.invalid>;regint=0");
+	err |= ua_alloc(&ua2, "<sip:alice@b.invalid>;regint=0;catchall=yes");
+	err |= ua_alloc(&ua3, "<sip:bob@b.invalid>;regint=0;catchall=yes");
+	TEST_ERR(err);
+
+	/* contact user, then user part of the local URI */
+	pl_set_str(&pl, ua_cuser(ua2));
+	ASSERT_TRUE(ua2 == uag_find(&pl));
+
+	pl_set_str(&pl, "ALICE");
+	ASSERT_TRUE(ua1 == uag_find(&pl));
+
+	pl_set_str(&pl, "bob");
+	ASSERT_TRUE(ua3 == uag_find(&pl));
+
+	/* the first catch-all UA in list order wins */
+	pl_set_str(&pl, "carol");
+	ASSERT_TRUE(ua2 == uag_find(&pl));
+
+	err = ua_raise(ua3);
+	TEST_ERR(err);
+	ASSERT_TRUE(ua3 == uag_find(&pl));
+
+	ua_set_catchall(ua3, false);
+	ASSERT_TRUE(ua2 == uag_find(&pl));
+
+	/* re-keyed entries keep their place in list order */
+	ua_set_catchall(ua3, true);
+	ASSERT_TRUE(ua3 == uag_find(&pl));
+
+	/* the public GRUU replaces the contact user */
+	pl_set_str(&pl, "gruu-1234");
+	ua_pub_gruu_set(ua1, &pl);
+	ASSERT_TRUE(ua1 == uag_find(&pl));
+
+	ASSERT_TRUE(ua2 == uag_find_aor("sip:alice@b.invalid"));
+
+	ua2 = mem_deref(ua2);
+	ASSERT_TRUE(NULL == uag_find_aor("sip:alice@b.invalid"));
+
+ out:
+	mem_deref(ua3);
+	mem_deref(ua2);
+	mem_deref(ua1);
+
+	return err;
+}
+
+
 static const char *_sip_transp_srvid(enum sip_transp tp)
 {
 	switch (tp) {
@@ -416,6 +509,90 @@ int test_ua_register_dns(void)
 }
 
 
+static void sched_event_handler(enum bevent_ev ev, struct bevent *event,
+				void *arg)
+{
+	unsigned *n_ok = arg;
+	(void)event;
+
+	if (ev == BEVENT_REGISTER_OK) {
+		if (++*n_ok == 4)
+			re_cancel();
+	}
+	else if (ev == BEVENT_REGISTER_FAIL) {
+		re_cancel();
+	}
+}
+
+
+int test_ua_register_sched(void)
+{
+	struct sip_server *srv = NULL;
+	struct ua *uav[4] = {NULL};
+	char aor[256];
+	unsigned n_ok = 0;
+	uint64_t sent0, sent, wait0, wait;
+	uint32_t depth_max;
+	size_t i;
+	int err;
+
+	/* the burst allows 3 REGISTERs, the 4th is queued */
+	conf_config()->sip.reg_rate   = 20;
+	conf_config()->sip.reg_spread = 0;
+
+	err = ua_init("test", true, false, false);
+	TEST_ERR(err);
+
+	err = sip_server_alloc(&srv, sip_server_exit_handler, NULL);
+	TEST_ERR(err);
+
+	err = sip_server_uri(srv, aor, sizeof(aor), SIP_TRANSP_UDP);
+	TEST_ERR(err);
+
+	err = bevent_register(sched_event_handler, &n_ok);
+	TEST_ERR(err);
+
+	reg_sched_stats(&sent0, &wait0, NULL);
+
+	for (i=0; i<RE_ARRAY_SIZE(uav); i++) {
+
+		err = ua_alloc(&uav[i], aor);
+		TEST_ERR(err);
+
+		err = ua_register(uav[i]);
+		TEST_ERR(err);
+	}
+
+	err = re_main_timeout(5000);
+	TEST_ERR(err);
+
+	ASSERT_EQ(4, n_ok);
+	ASSERT_TRUE(srv->n_register_req >= RE_ARRAY_SIZE(uav));
+
+	for (i=0; i<RE_ARRAY_SIZE(uav); i++)
+		ASSERT_TRUE(ua_isregistered(uav[i]));
+
+	/* all REGISTERs were queued, the 4th waited for 1/20 s credit */
+	reg_sched_stats(&sent, &wait, &depth_max);
+	ASSERT_EQ(4, (int)(sent - sent0));
+	ASSERT_TRUE(depth_max >= RE_ARRAY_SIZE(uav));
+	ASSERT_TRUE(wait - wait0 >= 1000 / 20);
+
+ out:
+	bevent_unregister(sched_event_handler);
+	conf_config()->sip.reg_rate = 0;
+
+	for (i=0; i<RE_ARRAY_SIZE(uav); i++)
+		mem_deref(uav[i]);
+
+	ua_stop_all(true);
+	ua_close();
+	mem_deref(srv);
+
+	return err;
+}
+
+
 #define USER   "alfredh"
 #define PASS   "pass@word"
 #define DOMAIN "localhost"